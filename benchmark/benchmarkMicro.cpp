@@ -0,0 +1,151 @@
+// Micro-benchmarks of functions called in every step of a simulation.
+// Benchmarks that need data files are skipped if the files are not found.
+
+#include "crpropa/Candidate.h"
+#include "crpropa/Common.h"
+#include "crpropa/Grid.h"
+#include "crpropa/ParticleID.h"
+#include "crpropa/PhotonBackground.h"
+#include "crpropa/Random.h"
+#include "crpropa/Units.h"
+#include "crpropa/magneticField/MagneticField.h"
+#include "crpropa/magneticField/turbulentField/PlaneWaveTurbulence.h"
+#include "crpropa/module/EMInverseComptonScattering.h"
+#include "crpropa/module/HDF5Output.h"
+#include "crpropa/module/PropagationCK.h"
+
+#include "benchmark/benchmark.h"
+
+#include <cstdio>
+#include <fstream>
+#include <stdexcept>
+#include <vector>
+
+namespace crpropa {
+
+static const size_t nPositions = 1024;
+
+// skip the benchmark if the data file is missing
+static bool haveDataFile(benchmark::State &state, const std::string &filename) {
+	if (std::ifstream(getDataPath(filename).c_str()).good())
+		return true;
+	state.SkipWithError(("data file " + filename + " not found").c_str());
+	return false;
+}
+
+static std::vector<Vector3d> randomPositions(double size) {
+	Random random(1);
+	std::vector<Vector3d> positions(nPositions);
+	for (size_t i = 0; i < nPositions; i++)
+		positions[i] = Vector3d(random.rand(), random.rand(), random.rand()) * size;
+	return positions;
+}
+
+static void propagate(benchmark::State &state, ref_ptr<MagneticField> field) {
+	if (not haveDataFile(state, "nuclear_mass.txt"))
+		return;
+	PropagationCK propa(field, 1e-4, 0.1 * kpc, 100 * kpc);
+	Candidate c(nucleusId(1, 1), 10 * EeV, Vector3d(0.), Vector3d(1, 0, 0));
+	c.setNextStep(10 * kpc);
+
+	for (auto _ : state)
+		propa.process(&c);
+	state.SetItemsProcessed(state.iterations());
+}
+
+static void BM_PropagationCK_Uniform(benchmark::State &state) {
+	propagate(state, new UniformMagneticField(Vector3d(0, 0, 1 * muG)));
+}
+BENCHMARK(BM_PropagationCK_Uniform);
+
+// argument: number of wave modes
+static void BM_PropagationCK_PlaneWaveTurbulence(benchmark::State &state) {
+	TurbulenceSpectrum spectrum(1 * muG, 1 * kpc, 100 * kpc);
+	propagate(state, new PlaneWaveTurbulence(spectrum, state.range(0), 1));
+}
+BENCHMARK(BM_PropagationCK_PlaneWaveTurbulence)->Arg(16)->Arg(64)->Arg(256);
+
+// argument: interpolationType
+static void BM_GridInterpolate(benchmark::State &state) {
+	size_t n = 64;
+	ref_ptr<Grid3f> grid = new Grid3f(Vector3d(0.), n, 1 * kpc);
+	Random random(1);
+	std::vector<Vector3f> &values = grid->getGrid();
+	for (size_t i = 0; i < values.size(); i++)
+		values[i] = Vector3f(random.randNorm(), random.randNorm(), random.randNorm());
+	grid->setInterpolationType(interpolationType(state.range(0)));
+	std::vector<Vector3d> positions = randomPositions(n * kpc);
+
+	size_t i = 0;
+	for (auto _ : state)
+		benchmark::DoNotOptimize(grid->interpolate(positions[i++ % nPositions]));
+	state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_GridInterpolate)->Arg(TRILINEAR)->Arg(NEAREST_NEIGHBOUR);
+#ifdef HAVE_SIMD
+BENCHMARK(BM_GridInterpolate)->Arg(TRICUBIC);
+#endif
+
+// argument: number of tabulated points per dimension
+static void BM_Interpolate2d(benchmark::State &state) {
+	size_t n = state.range(0);
+	std::vector<double> X(n), Y(n), Z(n * n);
+	for (size_t i = 0; i < n; i++) {
+		X[i] = i;
+		Y[i] = i;
+	}
+	Random random(1);
+	for (size_t i = 0; i < n * n; i++)
+		Z[i] = random.rand();
+	std::vector<double> x(nPositions), y(nPositions);
+	for (size_t i = 0; i < nPositions; i++) {
+		x[i] = random.rand() * (n - 1);
+		y[i] = random.rand() * (n - 1);
+	}
+
+	size_t i = 0;
+	for (auto _ : state) {
+		benchmark::DoNotOptimize(interpolate2d(x[i], y[i], X, Y, Z));
+		i = (i + 1) % nPositions;
+	}
+	state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_Interpolate2d)->Arg(100)->Arg(1000);
+
+static void BM_EMInverseComptonScattering(benchmark::State &state) {
+	ref_ptr<EMInverseComptonScattering> ics;
+	try {
+		ics = new EMInverseComptonScattering(new CMB(), true);
+	} catch (std::exception &e) {
+		state.SkipWithError(e.what());
+		return;
+	}
+	Random::seedThreads(1);
+	Candidate c(11, 1 * EeV);
+
+	for (auto _ : state) {
+		c.current.setEnergy(1 * EeV);
+		c.setCurrentStep(1 * Mpc);
+		ics->process(&c);
+		c.clearSecondaries();
+	}
+	state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_EMInverseComptonScattering);
+
+#ifdef CRPROPA_HAVE_HDF5
+static void BM_HDF5Output(benchmark::State &state) {
+	std::string filename = "benchmarkHDF5Output.h5";
+	{
+		HDF5Output output(filename, Output::Event3D);
+		Candidate c(22, 1 * EeV);
+		for (auto _ : state)
+			output.process(&c);
+		state.SetItemsProcessed(state.iterations());
+	}
+	std::remove(filename.c_str());
+}
+BENCHMARK(BM_HDF5Output);
+#endif
+
+} // namespace crpropa
@@ -0,0 +1,128 @@
+// End-to-end benchmarks of typical simulations. The argument of each scenario
+// is the number of primaries. Scenarios that need data files are skipped if
+// the files are not found.
+
+#include "crpropa/Common.h"
+#include "crpropa/ModuleList.h"
+#include "crpropa/ParticleID.h"
+#include "crpropa/PhotonBackground.h"
+#include "crpropa/Random.h"
+#include "crpropa/Source.h"
+#include "crpropa/Units.h"
+#include "crpropa/magneticField/turbulentField/PlaneWaveTurbulence.h"
+#include "crpropa/module/BreakCondition.h"
+#include "crpropa/module/EMInverseComptonScattering.h"
+#include "crpropa/module/EMPairProduction.h"
+#include "crpropa/module/ElectronPairProduction.h"
+#include "crpropa/module/Observer.h"
+#include "crpropa/module/PhotoPionProduction.h"
+#include "crpropa/module/PropagationCK.h"
+#include "crpropa/module/Redshift.h"
+#include "crpropa/module/SimplePropagation.h"
+
+#include "benchmark/benchmark.h"
+
+#include <fstream>
+#include <stdexcept>
+
+namespace crpropa {
+
+// skip the benchmark if the data file is missing
+static bool haveDataFile(benchmark::State &state, const std::string &filename) {
+	if (std::ifstream(getDataPath(filename).c_str()).good())
+		return true;
+	state.SkipWithError(("data file " + filename + " not found").c_str());
+	return false;
+}
+
+static void runScenario(benchmark::State &state, ModuleList &sim,
+		SourceInterface *source, bool recursive) {
+	sim.setShowProgress(false);
+	size_t count = state.range(0);
+	for (auto _ : state) {
+		Random::seedThreads(1);
+		sim.run(source, count, recursive);
+	}
+	state.SetItemsProcessed(state.iterations() * count);
+}
+
+// protons from 1 - 100 EeV at 100 Mpc distance with pion and pair production
+static void BM_Scenario1D_UHECR(benchmark::State &state) {
+	if (not haveDataFile(state, "nuclear_mass.txt"))
+		return;
+	ModuleList sim;
+	ref_ptr<Source> source = new Source;
+	try {
+		ref_ptr<PhotonField> cmb = new CMB();
+		ref_ptr<PhotonField> irb = new IRB_Gilmore12();
+		sim.add(new SimplePropagation(1 * kpc, 10 * Mpc));
+		sim.add(new Redshift());
+		sim.add(new PhotoPionProduction(cmb));
+		sim.add(new PhotoPionProduction(irb));
+		sim.add(new ElectronPairProduction(cmb));
+		sim.add(new ElectronPairProduction(irb));
+	} catch (std::exception &e) {
+		state.SkipWithError(e.what());
+		return;
+	}
+	sim.add(new MinimumEnergy(1 * EeV));
+	ref_ptr<Observer> observer = new Observer();
+	observer->add(new Observer1D());
+	sim.add(observer);
+
+	source->add(new SourceParticleType(nucleusId(1, 1)));
+	source->add(new SourcePosition(100 * Mpc));
+	source->add(new SourceRedshift1D());
+	source->add(new SourcePowerLawSpectrum(1 * EeV, 100 * EeV, -1));
+	runScenario(state, sim, source, false);
+}
+BENCHMARK(BM_Scenario1D_UHECR)->Arg(1000)->Unit(benchmark::kMillisecond)->UseRealTime();
+
+// 10 EeV protons over 1 Mpc in a 1 muG plane wave turbulence
+static void BM_Scenario3D_TurbulentProton(benchmark::State &state) {
+	if (not haveDataFile(state, "nuclear_mass.txt"))
+		return;
+	ModuleList sim;
+	ref_ptr<Source> source = new Source;
+	TurbulenceSpectrum spectrum(1 * muG, 1 * kpc, 100 * kpc);
+	sim.add(new PropagationCK(new PlaneWaveTurbulence(spectrum, 64, 1), 1e-4,
+			0.1 * kpc, 10 * kpc));
+	sim.add(new MaximumTrajectoryLength(1 * Mpc));
+
+	source->add(new SourceParticleType(nucleusId(1, 1)));
+	source->add(new SourcePosition(Vector3d(0.)));
+	source->add(new SourceIsotropicEmission());
+	source->add(new SourceEnergy(10 * EeV));
+	runScenario(state, sim, source, false);
+}
+BENCHMARK(BM_Scenario3D_TurbulentProton)->Arg(100)->Unit(benchmark::kMillisecond)->UseRealTime();
+
+// cascade of 100 PeV photons at 10 Mpc distance in the CMB and IRB, thinned
+static void BM_ScenarioEMCascade(benchmark::State &state) {
+	ModuleList sim;
+	try {
+		ref_ptr<PhotonField> cmb = new CMB();
+		ref_ptr<PhotonField> irb = new IRB_Gilmore12();
+		sim.add(new SimplePropagation(1 * kpc, 1 * Mpc));
+		sim.add(new EMPairProduction(cmb, true, 0.9));
+		sim.add(new EMPairProduction(irb, true, 0.9));
+		sim.add(new EMInverseComptonScattering(cmb, true, 0.9));
+		sim.add(new EMInverseComptonScattering(irb, true, 0.9));
+	} catch (std::exception &e) {
+		state.SkipWithError(e.what());
+		return;
+	}
+	sim.add(new MinimumEnergy(10 * TeV));
+	ref_ptr<Observer> observer = new Observer();
+	observer->add(new Observer1D());
+	sim.add(observer);
+
+	ref_ptr<Source> source = new Source;
+	source->add(new SourceParticleType(22));
+	source->add(new SourcePosition(10 * Mpc));
+	source->add(new SourceEnergy(100 * PeV));
+	runScenario(state, sim, source, true);
+}
+BENCHMARK(BM_ScenarioEMCascade)->Arg(100)->Unit(benchmark::kMillisecond)->UseRealTime();
+
+} // namespace crpropa
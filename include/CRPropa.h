@@ -3,15 +3,21 @@
 #define CRPROPA_H
 
 #include "crpropa/Candidate.h"
+#include "crpropa/CascadeInteraction.h"
+#include "crpropa/CascadeSolver1D.h"
 #include "crpropa/Common.h"
+#include "crpropa/ContinuousLoss.h"
 #include "crpropa/Cosmology.h"
 #include "crpropa/EmissionMap.h"
+#include "crpropa/Expression.h"
 #include "crpropa/Geometry.h"
 #include "crpropa/Grid.h"
 #include "crpropa/GridTools.h"
 #include "crpropa/Logging.h"
 #include "crpropa/Module.h"
 #include "crpropa/ModuleList.h"
+#include "crpropa/ModuleProfile.h"
+#include "crpropa/RunTelemetry.h"
 #include "crpropa/ParticleID.h"
 #include "crpropa/ParticleMass.h"
 #include "crpropa/ParticleState.h"
@@ -19,10 +25,13 @@
 #include "crpropa/Random.h"
 #include "crpropa/Referenced.h"
 #include "crpropa/Source.h"
+#include "crpropa/SweepRunner.h"
+#include "crpropa/TableRegistry.h"
 #include "crpropa/Units.h"
 #include "crpropa/Variant.h"
 #include "crpropa/Vector3.h"
 #include "crpropa/Version.h"
+#include "crpropa/WeightWindow.h"
 
 #include "crpropa/module/AdiabaticCooling.h"
 #include "crpropa/module/Acceleration.h"
@@ -35,8 +44,10 @@
 #include "crpropa/module/EMPairProduction.h"
 #include "crpropa/module/EMTripletPairProduction.h"
 #include "crpropa/module/ElasticScattering.h"
+#include "crpropa/module/EventPropagation1D.h"
 #include "crpropa/module/ElectronPairProduction.h"
 #include "crpropa/module/HDF5Output.h"
+#include "crpropa/module/HistogramOutput.h"
 #include "crpropa/module/MomentumDiffusion.h"
 #include "crpropa/module/NuclearDecay.h"
 #include "crpropa/module/Observer.h"
@@ -52,6 +63,7 @@
 #include "crpropa/module/SimplePropagation.h"
 #include "crpropa/module/SynchrotronRadiation.h"
 #include "crpropa/module/TextOutput.h"
+#include "crpropa/module/TimeSnapshotObserver.h"
 #include "crpropa/module/Tools.h"
 
 #include "crpropa/magneticField/ArchimedeanSpiralField.h"
@@ -76,6 +88,7 @@
 #include "crpropa/massDistribution/Density.h"
 #include "crpropa/massDistribution/Nakanishi.h"
 #include "crpropa/massDistribution/Cordes.h"
+#include "crpropa/massDistribution/ExpressionDensity.h"
 #include "crpropa/massDistribution/Massdistribution.h"
 #include "crpropa/massDistribution/Ferriere.h"
 #include "crpropa/massDistribution/ConstantDensity.h"
@@ -47,10 +47,20 @@ private:
 	double currentStep; /**< Size of the currently performed step in [m] comoving units */
 	double nextStep; /**< Proposed size of the next propagation step in [m] comoving units */
 	std::string tagOrigin; /**< Name of interaction/source process which created this candidate*/
+	std::vector<uint64_t> slots; /**< Typed values of modules, see allocateSlot */
 
 	static uint64_t nextSerialNumber;
 	uint64_t serialNumber;
 
+	static uint64_t fetchSerialNumber();
+	static uint64_t addToNextSerialNumber(uint64_t n);
+
+	/**
+	 Creates a secondary of the given parent by copy-constructing the states,
+	 avoiding the default construction and reassignment of all four states.
+	 */
+	Candidate(Candidate *parent, int id, double energy, double w, const std::string &tagOrigin);
+
 public:
 	Candidate(
 		int id = 0,
@@ -58,8 +68,8 @@ public:
 		Vector3d position = Vector3d(0, 0, 0),
 		Vector3d direction = Vector3d(-1, 0, 0),
 		double z = 0,
-		double weight = 1., 
-		std::string tagOrigin = "PRIM"
+		double weight = 1.,
+		const std::string &tagOrigin = "PRIM"
 	);
 
 	/**
@@ -115,6 +125,23 @@ public:
 	bool removeProperty(const std::string &name);
 	bool hasProperty(const std::string &name) const;
 
+	/**
+	 Reserve a slot for a typed value that a module keeps for each candidate,
+	 e.g. the index of the next detection time of ObserverTimeEvolution,
+	 without the string lookup of a property. Each module instance reserves
+	 its own slot once, usually in its constructor, and releases it in its
+	 destructor. Like the properties, the values are copied to secondaries
+	 and clones.
+	 Released slots are handed out again; candidates that outlive the module
+	 keep the old value in the slot.
+	 */
+	static size_t allocateSlot();
+	/** Return a slot from allocateSlot to be reused by later modules */
+	static void releaseSlot(size_t slot);
+	/** Value of the slot, 0 if it was never set */
+	uint64_t getSlot(size_t slot) const;
+	void setSlot(size_t slot, uint64_t value);
+
 	/**
 	 Add a new candidate to the list of secondaries.
 	 @param c Candidate
@@ -133,7 +160,7 @@ public:
 	 @param w			weight of the secondary
 	 @param tagOrigin 	tag of the secondary
 	 */
-	void addSecondary(int id, double energy, double w = 1., std::string tagOrigin = "SEC");
+	void addSecondary(int id, double energy, double w = 1., const std::string &tagOrigin = "SEC");
 	/**
 	 Add a new candidate to the list of secondaries.
 	 @param id			particle ID of the secondary
@@ -142,7 +169,7 @@ public:
 	 @param w			weight of the secondary
 	 @param tagOrigin 	tag of the secondary
 	 */
-	void addSecondary(int id, double energy, Vector3d position, double w = 1., std::string tagOrigin = "SEC");
+	void addSecondary(int id, double energy, Vector3d position, double w = 1., const std::string &tagOrigin = "SEC");
 	void clearSecondaries();
 
 	std::string getDescription() const;
@@ -157,12 +184,44 @@ public:
 	/** Serial number of candidate at creation */
 	uint64_t getCreatedSerialNumber() const;
 
-	/** Set the next serial number to use */
+	/** Set the counter of the serial numbers, the next candidate gets snr + 1 */
 	static void setNextSerialNumber(uint64_t snr);
 
-	/** Get the next serial number that will be assigned */
+	/** Counter of the serial numbers: the last number taken from it, the next
+	 candidate gets getNextSerialNumber() + 1 (in parallel regions, the next
+	 block starts there) */
 	static uint64_t getNextSerialNumber();
 
+	/**
+	 Inside parallel regions, each thread takes blocks of n serial numbers
+	 from the shared counter and assigns them one by one, instead of
+	 incrementing the shared counter for each candidate. The serial numbers
+	 stay unique, but the candidates of one thread are numbered in blocks.
+	 Outside of parallel regions the candidates are numbered consecutively.
+	 n = 1 increments the shared counter for each candidate, default 256.
+	 */
+	static void setSerialNumberBlockSize(uint64_t n);
+	static uint64_t getSerialNumberBlockSize();
+
+	/**
+	 Let the calling thread take the serial numbers first, first + 1, ... up
+	 to first + n - 1 instead of the shared counter, e.g. to give each primary
+	 of ModuleList::runShard the same serial numbers in every run. The serial
+	 numbers of runShard with one shard are thus reproducible for a seed.
+	 When the range is used up, the thread continues with the shared counter
+	 and a warning is logged once; these numbers are unique, but not
+	 reproducible. n = 0 switches back to the shared counter.
+	 */
+	static void setThreadSerialNumberRange(uint64_t first, uint64_t n);
+
+	/**
+	 Reserve the serial numbers 1 to count * n for the ranges of count
+	 primaries with n numbers each: the range of primary i starts at
+	 1 + i * n, and the shared counter is moved above the last range.
+	 Throws if the numbers exceed 64 bits.
+	 */
+	static void reserveSerialNumberRanges(uint64_t count, uint64_t n);
+
 	/**
 	 Create an exact clone of candidate
 	 @param recursive	recursively clone and add the secondaries
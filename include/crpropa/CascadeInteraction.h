@@ -0,0 +1,37 @@
+#ifndef CRPROPA_CASCADEINTERACTION_H
+#define CRPROPA_CASCADEINTERACTION_H
+
+#include "crpropa/Candidate.h"
+
+namespace crpropa {
+
+/**
+ @class CascadeInteraction
+ @brief Interface of interaction modules usable by CascadeSolver1D
+
+ Implemented by the electromagnetic interaction modules next to Module, so
+ that the deterministic solver uses the same rates and secondary spectra as
+ the Monte Carlo simulation.
+ */
+class CascadeInteraction {
+public:
+	virtual ~CascadeInteraction() {
+	}
+
+	/** Interaction rate per comoving length as used in process, 0 for
+	 particles the module does not act on or energies outside the tables.
+	 @param id		particle id
+	 @param energy	energy in the comoving frame [J]
+	 @param z		redshift
+	 @returns		rate [1/m]
+	 */
+	virtual double getInteractionRate(int id, double energy, double z) const = 0;
+
+	/** Perform one interaction of the candidate: change or deactivate it
+	 and add the secondaries */
+	virtual void performInteraction(Candidate *candidate) const = 0;
+};
+
+} // namespace crpropa
+
+#endif // CRPROPA_CASCADEINTERACTION_H
@@ -0,0 +1,127 @@
+#ifndef CRPROPA_CASCADESOLVER1D_H
+#define CRPROPA_CASCADESOLVER1D_H
+
+#include "crpropa/CascadeInteraction.h"
+#include "crpropa/Cosmology.h"
+#include "crpropa/Module.h"
+
+#include <vector>
+
+namespace crpropa {
+
+/**
+ @class CascadeSolver1D
+ @brief Deterministic 1D transport of photon, electron and positron spectra
+
+ A fast alternative to the Monte Carlo simulation of 1D electromagnetic
+ cascades. The particle numbers of photons (22), electrons (11) and
+ positrons (-11) are evolved on a logarithmic energy grid along the comoving
+ distance to the observer.
+
+ The interactions are the same modules that are used in the Monte Carlo
+ simulation (EMPairProduction, EMDoublePairProduction,
+ EMInverseComptonScattering, EMTripletPairProduction or any Module
+ implementing CascadeInteraction): the loss rates are taken from
+ getInteractionRate in every step, the redistribution of each energy bin to
+ the primary and secondary bins is tabulated once per redshift node by
+ calling performInteraction for a number of energies within the bin. The
+ flags of the modules apply, e.g. EMPairProduction without electrons only
+ absorbs photons. Particles leaving the energy grid are discarded.
+
+ Each step solves the transport equation implicitly (backward Euler). Since
+ no interaction increases the energy, the system is triangular in energy and
+ is solved from the highest to the lowest bin, at the cost of one
+ matrix-vector product per step.
+
+ Adiabatic losses and the redshift dependence of the rates are included if
+ the solver contains Redshift, otherwise z = 0. The cosmology of an added
+ Redshift is used unless one is set.
+ */
+class CascadeSolver1D: public Referenced {
+public:
+	/**
+	 @param minEnergy	lower edge of the energy grid
+	 @param maxEnergy	upper edge of the energy grid
+	 @param nBins		number of logarithmic energy bins
+	 */
+	CascadeSolver1D(double minEnergy, double maxEnergy, size_t nBins);
+
+	/** Add an interaction module. ModuleLists are searched for interactions,
+	 Redshift enables redshift losses, other modules are ignored.
+	 @returns	true if the module was used
+	 */
+	bool add(Module *module);
+
+	/** Number of energies per bin used to tabulate the redistribution, default 1000 */
+	void setSamples(size_t samples);
+	size_t getSamples() const;
+	/** Distance step of the transport, default 0.1 Mpc */
+	void setStep(double step);
+	double getStep() const;
+	/** Redshift interval after which the redistribution is tabulated again, default 0.05 */
+	void setRedshiftStep(double redshiftStep);
+	double getRedshiftStep() const;
+	/** Include the redshift (adiabatic) losses and redshift dependent rates */
+	void setRedshiftLosses(bool redshiftLosses);
+	bool getRedshiftLosses() const;
+	/** Cosmology to use instead of the default cosmology, 0 for the default */
+	void setCosmology(ref_ptr<Cosmology> cosmology);
+	ref_ptr<Cosmology> getCosmology() const;
+
+	/** Add weight particles of type id (22, 11 or -11) at the given energy */
+	void inject(int id, double energy, double weight = 1);
+	/** Remove all particles */
+	void clear();
+
+	/** Propagate the current spectra from the given comoving distance to the observer */
+	void propagate(double distance);
+
+	/** Bin centers (geometric mean of the edges) */
+	std::vector<double> getEnergies() const;
+	/** nBins + 1 bin edges */
+	std::vector<double> getBinEdges() const;
+	/** Number of particles of type id in each bin */
+	std::vector<double> getSpectrum(int id) const;
+
+private:
+	struct Interaction {
+		ref_ptr<Module> module;
+		const CascadeInteraction *interaction;
+	};
+	/// redistribution of one interaction of one particle type and energy bin
+	struct Transfer {
+		size_t target; ///< species * nBins + bin
+		double value; ///< particles in the target bin per interaction
+	};
+
+	double minEnergy, maxEnergy, logStep;
+	size_t nBins, samples;
+	double step, redshiftStep;
+	bool redshiftLosses;
+	ref_ptr<Cosmology> cosmology;
+	std::vector<Interaction> interactions;
+
+	/// particles per species and bin, species * nBins + bin
+	std::vector<double> spectrum;
+
+	/// redistribution of each interaction and row (species * nBins + bin)
+	std::vector<std::vector<std::vector<Transfer> > > transfers;
+	/// redshift the redistribution was tabulated for, negative if not yet
+	double transferRedshift;
+
+	size_t species(int id) const;
+	double binCenter(size_t bin) const;
+	/** Bin of the energy, nBins if outside */
+	size_t binFromEnergy(double energy) const;
+	/** Bin of a particle created by an interaction in the given bin, nBins if below the grid */
+	size_t targetBin(double energy, size_t bin) const;
+	void tabulateTransfers(double z);
+	/** One implicit step of the interactions */
+	void interact(double dx, double z);
+	/** Adiabatic loss from redshift z0 to z1 */
+	void redshift(double z0, double z1);
+};
+
+} // namespace crpropa
+
+#endif // CRPROPA_CASCADESOLVER1D_H
@@ -1,6 +1,9 @@
 #ifndef CRPROPA_COMMON_H
 #define CRPROPA_COMMON_H
 
+#include <cstddef>
+#include <cstdint>
+#include <new>
 #include <string>
 #include <vector>
 /**
@@ -82,6 +85,49 @@ double gaussInt(Integrand&& integrand, double A, double B) {
 	return XR * SS;
 }
 
+#ifndef SWIG
+// Maximum number of OpenMP threads supported by the per-thread storage, see Random.cpp
+const static int MAX_THREAD = 256;
+
+// Returns the OpenMP thread number, or 0 without OpenMP
+// Throws if the thread number is MAX_THREAD or above
+int threadIndex();
+
+/**
+ Allocator of cache line aligned storage for the per-thread counters and
+ buffers declared alignas(64). Before C++17, std::allocator only guarantees
+ the alignment of the fundamental types.
+ */
+template <typename T>
+struct CacheLineAllocator {
+	typedef T value_type;
+
+	CacheLineAllocator() {}
+	template <typename U>
+	CacheLineAllocator(const CacheLineAllocator<U> &) {}
+
+	T *allocate(std::size_t n) {
+		// the pointer returned by new is stored in front of the aligned block
+		char *p = static_cast<char *>(::operator new(n * sizeof(T) + 64));
+		char *aligned = p + 64 - reinterpret_cast<std::uintptr_t>(p) % 64;
+		reinterpret_cast<char **>(aligned)[-1] = p;
+		return reinterpret_cast<T *>(aligned);
+	}
+	void deallocate(T *block, std::size_t) {
+		::operator delete(reinterpret_cast<char **>(block)[-1]);
+	}
+};
+
+template <typename T, typename U>
+bool operator==(const CacheLineAllocator<T> &, const CacheLineAllocator<U> &) {
+	return true;
+}
+template <typename T, typename U>
+bool operator!=(const CacheLineAllocator<T> &, const CacheLineAllocator<U> &) {
+	return false;
+}
+#endif
+
 } // namespace crpropa
 
 #endif // CRPROPA_COMMON_H
@@ -0,0 +1,31 @@
+#ifndef CRPROPA_CONTINUOUSLOSS_H
+#define CRPROPA_CONTINUOUSLOSS_H
+
+namespace crpropa {
+
+/**
+ @class ContinuousLoss
+ @brief Interface of continuous energy loss modules usable by EventPropagation1D
+
+ Implemented by the continuous energy loss modules next to Module, so that
+ the loss can be integrated over steps much longer than the step limit the
+ module itself would impose.
+ */
+class ContinuousLoss {
+public:
+	virtual ~ContinuousLoss() {
+	}
+
+	/** Energy loss per comoving length as used in process, 0 for particles
+	 the module does not act on.
+	 @param id		particle id
+	 @param energy	energy [J]
+	 @param z		redshift
+	 @returns		-dE/dx [J/m]
+	 */
+	virtual double getEnergyLossRate(int id, double energy, double z) const = 0;
+};
+
+} // namespace crpropa
+
+#endif // CRPROPA_CONTINUOUSLOSS_H
@@ -1,6 +1,11 @@
 #ifndef CRPROPA_COSMOLOGY_H
 #define CRPROPA_COSMOLOGY_H
 
+#include "crpropa/Referenced.h"
+
+#include <cstddef>
+#include <vector>
+
 namespace crpropa {
 /**
  * \addtogroup PhysicsDefinitions
@@ -12,6 +17,90 @@ namespace crpropa {
  @brief Cosmology functions
  */
 
+/**
+ @class Cosmology
+ @brief Flat LambdaCDM cosmology with precomputed distance tables
+
+ The parameters and tables are fixed at construction, so that one instance
+ can be used by any number of threads and several cosmologies can be used
+ at the same time.
+
+ The distances are tabulated on a grid uniform in log(1 + z), the redshifts
+ on grids uniform in log(1 + d / dH) with the Hubble distance dH, so that
+ every conversion computes its table index directly instead of searching.
+ The tables hold values and derivatives for cubic Hermite interpolation.
+ The conversions do not check their argument: it is clipped to the
+ tabulated range 0 <= z <= zmax (see the checked functions below).
+ The batch conversions apply the conversion to n values.
+ */
+class Cosmology: public Referenced {
+public:
+	/**
+	 @param hubbleParameter	dimensionless Hubble parameter
+	 @param omegaMatter		matter parameter, omegaL = 1 - omegaMatter
+	 @param maximumRedshift	upper end of the tables
+	 @param tableSize		number of points per table
+	 */
+	Cosmology(double hubbleParameter = 0.673, double omegaMatter = 0.315,
+			double maximumRedshift = 100, size_t tableSize = 4096);
+
+	/** Hubble rate H(z) = H0 * sqrt(omegaM * (1 + z)^3 + omegaL) */
+	double hubbleRate(double redshift = 0) const noexcept;
+	double H0() const noexcept;
+	double omegaM() const noexcept;
+	double omegaL() const noexcept;
+	double getMaximumRedshift() const noexcept;
+
+	double comovingDistance2Redshift(double distance) const noexcept;
+	double redshift2ComovingDistance(double redshift) const noexcept;
+	double luminosityDistance2Redshift(double distance) const noexcept;
+	double redshift2LuminosityDistance(double redshift) const noexcept;
+	double lightTravelDistance2Redshift(double distance) const noexcept;
+	double redshift2LightTravelDistance(double redshift) const noexcept;
+	double comoving2LightTravelDistance(double distance) const noexcept;
+	double lightTravel2ComovingDistance(double distance) const noexcept;
+
+	void comovingDistance2Redshift(const double *distance, double *redshift, size_t n) const noexcept;
+	void redshift2ComovingDistance(const double *redshift, double *distance, size_t n) const noexcept;
+	void luminosityDistance2Redshift(const double *distance, double *redshift, size_t n) const noexcept;
+	void redshift2LuminosityDistance(const double *redshift, double *distance, size_t n) const noexcept;
+	void lightTravelDistance2Redshift(const double *distance, double *redshift, size_t n) const noexcept;
+	void redshift2LightTravelDistance(const double *redshift, double *distance, size_t n) const noexcept;
+
+	/** Largest tabulated distances, at the maximum redshift */
+	double getMaximumComovingDistance() const noexcept;
+	double getMaximumLuminosityDistance() const noexcept;
+	double getMaximumLightTravelDistance() const noexcept;
+
+private:
+	/// values and derivatives per grid step on a uniform grid
+	struct Table {
+		std::vector<double> y, dy;
+		double step;
+		double operator()(double x) const noexcept;
+	};
+
+	double h0, oM, oL, zmax;
+	double dH; ///< Hubble distance c / H0
+	Table tabDc, tabDl, tabDt; ///< distances on the grid in log(1 + z)
+	Table tabZc, tabZl, tabZt; ///< redshifts on the grids in log(1 + d / dH)
+
+	double toRedshift(const Table &tab, double distance) const noexcept;
+	double toDistance(const Table &tab, double redshift) const noexcept;
+	void invert(const Table &tab, Table &inverse, int type) const;
+};
+
+/** Cosmology used by the functions below and the modules by default.
+ Each thread holds a reference to the default cosmology it uses, which
+ stays valid until the thread calls defaultCosmology again after it has
+ been replaced. Copy it to keep it longer. */
+const Cosmology &defaultCosmology();
+
+/** Replace the default cosmology. Other threads pick it up with their next
+ call of defaultCosmology; the previous one is freed when no thread uses it
+ anymore. */
+void setDefaultCosmology(ref_ptr<Cosmology> cosmology);
+
 /**
  Set the cosmological parameters for a flat universe. To ensure flatness omegaL is set to 1 - omegaMatter
  @param hubbleParameter	dimensionless Hubble parameter, default = 0.673
@@ -4,22 +4,33 @@
 #include "Referenced.h"
 #include "Candidate.h"
 
+#include <atomic>
+#include <stdint.h>
+
 namespace crpropa {
 
 /**
  @class CylindricalProjectionMap
  @brief 2D histogram of spherical coordinates in equal-area projection
+
+ fillBin may be called by several threads at the same time. Directions are
+ drawn with an alias table in constant time; the table is built by freeze()
+ or by the first draw after filling. Filling and drawing must not overlap.
  */
 class CylindricalProjectionMap : public Referenced {
 private:
 	size_t nPhi, nTheta;
 	double sPhi, sTheta;
-	mutable bool dirty;
+	mutable std::atomic<bool> dirty;
 	std::vector<double> pdf;
 	mutable std::vector<double> cdf;
+	mutable std::vector<double> aliasProbability;
+	mutable std::vector<size_t> aliasBin;
 
-	/** Calculate the cdf from the pdf */
+	/** Calculate the cdf and the alias table from the pdf */
 	void updateCdf() const;
+	/** Build the tables if the pdf changed, safe for concurrent draws */
+	void update() const;
 
 public:
 	CylindricalProjectionMap();
@@ -29,12 +40,15 @@ public:
 	 */
 	CylindricalProjectionMap(size_t nPhi, size_t nTheta);
 
-	/** Increment the bin value in direction by weight. */
+	/** Increment the bin value in direction by weight, thread-safe. */
 	void fillBin(const Vector3d& direction, double weight = 1.);
 
-	/** Increment the bin value by weight. */
+	/** Increment the bin value by weight, thread-safe. */
 	void fillBin(size_t bin, double weight = 1.);
 
+	/** Build the sampling tables, call after filling and before drawing from several threads. */
+	void freeze();
+
 	/** Draw a random vector from the distribution. */
 	Vector3d drawDirection() const;
 
@@ -46,8 +60,8 @@ public:
 
 	const std::vector<double>& getCdf() const;
 
-	size_t getNPhi();
-	size_t getNTheta();
+	size_t getNPhi() const;
+	size_t getNTheta() const;
 
 	/** Calculate the bin from a direction */
 	size_t binFromDirection(const Vector3d& direction) const;
@@ -61,6 +75,15 @@ public:
  @brief Particle Type and energy binned emission maps.
 
  Use SourceEmissionMap to suppress directions at the source. Use EmissionMapFiller to create EmissionMap from Observer.
+
+ fillMap may be called by several threads at the same time: the bins are
+ incremented atomically and each thread caches the maps it has filled, so
+ only the creation of a new map is serialized. Call freeze() after filling to
+ build the sampling tables of all maps and a flat lookup of the maps by
+ particle type and energy bin used by drawDirection and checkDirection.
+ Changing the maps afterwards (fillMap of a new particle type or energy bin,
+ getMap, getMaps, load, merge) falls back to the slower lookup until the
+ next freeze().
  */
 class EmissionMap : public Referenced {
 public:
@@ -125,10 +148,30 @@ public:
 	/** Merge maps from file */
 	void merge(const std::string &filename);
 
+	/** Build the sampling tables of all maps and the lookup table */
+	void freeze();
+	bool isFrozen() const;
+
 protected:
 	double minEnergy, maxEnergy, logStep;
 	size_t nPhi, nTheta, nEnergy;
 	map_t maps;
+
+private:
+	/// maps of one particle type indexed by energy bin
+	struct ParticleMaps {
+		int pid;
+		std::vector<CylindricalProjectionMap *> energyBins;
+	};
+	/// lookup table built by freeze, sorted by particle type
+	std::vector<ParticleMaps> frozenMaps;
+	bool frozen;
+	/// identifies the maps in the caches of the threads, renewed when maps are replaced
+	uint64_t cacheId;
+
+	const CylindricalProjectionMap *findMap(int pid, double energy) const;
+	/** Discard the lookup tables after the maps changed */
+	void thaw();
 };
 
 } // namespace crpropa
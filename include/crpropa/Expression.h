@@ -0,0 +1,65 @@
+#ifndef CRPROPA_EXPRESSION_H
+#define CRPROPA_EXPRESSION_H
+
+#include "crpropa/Referenced.h"
+
+#include <string>
+#include <vector>
+
+#ifdef CRPROPA_HAVE_MUPARSER
+namespace mu {
+class Parser;
+}
+
+namespace crpropa {
+/**
+ * \addtogroup Core
+ * @{
+ */
+
+/**
+ @class Expression
+ @brief Thread-safe, compiled muParser expression with named variables
+
+ The expression string is parsed once and compiled to muParser bytecode.
+ Every OpenMP thread evaluates its own parser instance, so an Expression can
+ be used from within the parallel ModuleList::run loop without locking.
+ Besides the given variables all CRPropa units relevant for fields, energies
+ and distances (e.g. nG, muG, EeV, Mpc, kpc, ccm) are defined as constants.
+ This class is only available if muparser is available.
+ */
+class Expression: public Referenced {
+public:
+	/** Constructor
+	 @param expression	muParser expression string
+	 @param variables	names of the variables in the order they are passed to evaluate
+	 */
+	Expression(const std::string &expression, const std::vector<std::string> &variables);
+	~Expression();
+	/** Not copyable, the parsers of the threads are owned by the instance */
+	Expression(const Expression &) = delete;
+	Expression &operator=(const Expression &) = delete;
+
+	/** Evaluate the expression for the calling thread.
+	 @param values	values of the variables, in the order given in the constructor
+	 */
+	double evaluate(const double *values) const;
+	double evaluate(const std::vector<double> &values) const;
+
+	const std::string &getExpression() const;
+	const std::vector<std::string> &getVariables() const;
+
+private:
+	struct Slot;
+	Slot *createSlot() const;
+
+	std::string expression;
+	std::vector<std::string> variables;
+	mutable std::vector<Slot *> slots; ///< one lazily created parser per thread
+};
+
+/** @}*/
+} // namespace crpropa
+#endif // CRPROPA_HAVE_MUPARSER
+
+#endif // CRPROPA_EXPRESSION_H
@@ -6,6 +6,7 @@
 #include "crpropa/Common.h"
 
 #include <string>
+#include <vector>
 
 namespace crpropa {
 
@@ -27,8 +28,38 @@ public:
 	inline void process(ref_ptr<Candidate> candidate) const {
 		process(candidate.get());
 	}
+
+	/**
+	 State needed to resume a run, e.g. the position in an output file.
+	 Called by ModuleList::run between two blocks of primaries, when no
+	 candidate is processed. Modules holding other modules return the states
+	 of these, see joinCheckpoints.
+	 */
+	virtual std::string saveCheckpoint();
+	/** Restore a state returned by saveCheckpoint, see ModuleList::resume */
+	virtual void loadCheckpoint(const std::string &state);
+
+	/**
+	 Number of results that are buffered in memory and not written yet, e.g.
+	 lines or rows of an output. Reported by the run telemetry of ModuleList
+	 while other threads process candidates. Modules holding other modules
+	 return the sum of these.
+	 */
+	virtual size_t getBacklog() const;
+
+	/**
+	 Called by ModuleList::run after the last candidate of a run, when no
+	 candidate is processed, e.g. to write results buffered by the threads.
+	 Modules holding other modules pass it on to these.
+	 */
+	virtual void finishRun();
 };
 
+/** Combine the checkpoint states of several modules into one state */
+std::string joinCheckpoints(const std::vector<std::string> &states);
+/** Split a state created by joinCheckpoints */
+std::vector<std::string> splitCheckpoints(const std::string &state);
+
 
 /**
  @class AbstractCondition
@@ -59,6 +90,11 @@ public:
 	void setMakeAcceptedInactive(bool makeInactive);
 	void setRejectFlag(std::string key, std::string value);
 	void setAcceptFlag(std::string key, std::string value);
+
+	std::string saveCheckpoint();
+	void loadCheckpoint(const std::string &state);
+	size_t getBacklog() const;
+	void finishRun();
 };
 } // namespace crpropa
 
@@ -2,11 +2,17 @@
 #define CRPROPA_MODULE_LIST_H
 
 #include "crpropa/Candidate.h"
+#include "crpropa/Common.h"
 #include "crpropa/Module.h"
+#include "crpropa/ModuleProfile.h"
+#include "crpropa/RunTelemetry.h"
 #include "crpropa/Source.h"
 
+#include <atomic>
+#include <chrono>
 #include <list>
 #include <sstream>
+#include <vector>
 
 namespace crpropa {
 
@@ -19,10 +25,31 @@ public:
 	typedef std::list<ref_ptr<Module> > module_list_t;
 	typedef std::vector<ref_ptr<Candidate> > candidate_vector_t;
 
+	/**
+	 How to run if modules or sources are implemented in Python (SWIG directors).
+	 Every call into Python has to hold the global interpreter lock, so such
+	 objects serialize the otherwise parallel run.
+	 */
+	enum DirectorPolicy {
+		AllowDirectors, ///< run with all threads, Python calls are serialized by the interpreter lock
+		SerializeDirectors, ///< run on a single thread if any Python object is involved
+		RefuseDirectors ///< throw a std::runtime_error if any Python object is involved
+	};
+
+	/** Function returning true if the given object is implemented in Python.
+	 It is registered by the Python module on import. */
+	typedef bool (*DirectorCheck)(const Referenced *object);
+
 	ModuleList();
 	virtual ~ModuleList();
 	void setShowProgress(bool show = true); ///< activate a progress bar
 
+	void setDirectorPolicy(DirectorPolicy policy);
+	DirectorPolicy getDirectorPolicy() const;
+	/** Returns true if any module, nested ModuleList, the source or one of its features is implemented in Python */
+	bool hasDirectors(const SourceInterface *source = 0) const;
+	static void setDirectorCheck(DirectorCheck check);
+
 	void add(Module* module);
 	void remove(std::size_t i);
 	std::size_t size() const;
@@ -36,6 +63,108 @@ public:
 	void run(const candidate_vector_t *candidates, bool recursive = true, bool secondariesFirst = false); ///< run simulation for a candidate vector
 	void run(SourceInterface* source, size_t count, bool recursive = true, bool secondariesFirst = false); ///< run simulation for a number of candidates from the given source
 
+	/**
+	 Run one shard of a run of count primaries that is split over several
+	 independent processes: the primaries count * shard / shards up to
+	 count * (shard + 1) / shards - 1.
+	 Before primary i, the random number generator of the thread is seeded with
+	 (seed, i), and the primary and its secondaries take the serial numbers
+	 1 + i * getSerialNumbersPerPrimary() and following (see
+	 Candidate::reserveSerialNumberRanges). Thus the events do not
+	 depend on the number of shards, processes or threads, and the outputs of
+	 all shards, e.g. merged with TextOutput::merge or HDF5Output::merge, are
+	 the output of a single run of all primaries with the same seed.
+	 The source must draw its candidates only from Random::instance().
+	 */
+	void runShard(SourceInterface* source, size_t count, size_t shard, size_t shards,
+			uint32_t seed, bool recursive = true, bool secondariesFirst = false);
+	/** Serial numbers reserved for a primary and its secondaries in runShard, default 2^20.
+	 A primary with more candidates continues with the shared counter, these
+	 serial numbers are unique but not reproducible. */
+	void setSerialNumbersPerPrimary(uint64_t n);
+	uint64_t getSerialNumbersPerPrimary() const;
+
+	/**
+	 Write a checkpoint after every interval primaries of run(source, count).
+	 The checkpoint holds the number of completed primaries, the state of the
+	 random number generator of each thread, the next serial number and the
+	 states of the source and the modules, e.g. the sizes of the output files.
+	 It is replaced atomically, a run stopped by SIGINT/SIGTERM keeps the last
+	 complete checkpoint.
+	 All threads finish the primaries before a checkpoint is written, thus
+	 threads that are done wait for the slowest primary of each interval.
+	 Each thread loses up to the run time of the longest primary per
+	 interval, so the interval should be many primaries per thread, in
+	 particular if single primaries (e.g. large cascades) take long.
+	 @param filename	checkpoint file, no checkpoints if empty
+	 @param interval	number of primaries between two checkpoints
+	 */
+	void setCheckpoint(const std::string &filename, size_t interval);
+	std::string getCheckpointFile() const;
+	size_t getCheckpointInterval() const;
+	/**
+	 Continue the run(source, count) that wrote the given checkpoint. The
+	 modules and the source have to be set up as for the original run, with
+	 the TextOutputs opened for resuming (see TextOutput::TextOutput). Output
+	 files are cut back to their size at the checkpoint, thus primaries that
+	 were propagated after the checkpoint are neither lost nor written twice.
+	 Checkpoints continue to be written to the same file unless setCheckpoint
+	 was called.
+	 */
+	void resume(SourceInterface* source, const std::string &filename);
+
+	std::string saveCheckpoint(); ///< states of all modules
+	void loadCheckpoint(const std::string &state);
+
+	/**
+	 Count the calls, the time and the created secondaries of each module.
+	 The counters are kept per thread and summed by getProfile, so profiling
+	 does not synchronize the threads. Timing every call costs two reads of
+	 the steady clock per module and step; with a sampling interval n, only
+	 every n-th step of a thread is timed and the time is extrapolated.
+	 Nested ModuleLists keep their own profile.
+	 @param enable		switch profiling on or off, the counters are kept
+	 @param samplingInterval	time every n-th step
+	 */
+	void setProfiling(bool enable, unsigned int samplingInterval = 1);
+	bool isProfiling() const;
+	void resetProfile();
+	/** Profile of each module, summed over all threads */
+	std::vector<ModuleProfile> getProfile() const;
+	/** Number of steps, i.e. calls of process, while profiling */
+	uint64_t getProfileSteps() const;
+	/** Write the profile as JSON object with the steps and a list of modules */
+	void writeProfileJSON(const std::string &filename) const;
+	/** Write the profile of each thread in the Chrome trace event format,
+	 e.g. for chrome://tracing or https://ui.perfetto.dev */
+	void writeProfileTrace(const std::string &filename) const;
+
+	/**
+	 Publish the telemetry of run(source, count), run(candidates), runShard and
+	 resume every interval seconds: finished primaries and steps per second,
+	 created and finished secondaries, busy and idle time of each thread, the
+	 output backlog and the memory high-water mark.
+	 The threads count without locks; the first thread that finishes a
+	 primary after the interval has passed publishes the update. A last update
+	 is published at the end of the run.
+	 @param seconds	time between two updates, 0 switches the telemetry off
+	 */
+	void setTelemetryInterval(double seconds);
+	double getTelemetryInterval() const;
+	/** Called with each update of the telemetry */
+	void setTelemetryCallback(TelemetryCallback *callback);
+	/** File that is replaced with each update, in the Prometheus text format
+	 if the name ends with .prom and as JSON otherwise. No file if empty. */
+	void setTelemetryFile(const std::string &filename);
+	std::string getTelemetryFile() const;
+	/** Last published telemetry */
+	RunTelemetry getTelemetry() const;
+
+	/** Sum of the backlogs of all modules */
+	size_t getBacklog() const;
+	/** Called for all modules at the end of run(source, count) and run(candidates) */
+	void finishRun();
+
 	std::string getDescription() const;
 	void showModules() const;
 	
@@ -48,8 +177,68 @@ public:
 	const_iterator end() const;
 
 private:
+	int getNumberOfThreads(const SourceInterface *source) const;
+	/** Run the primaries first to count - 1, seeded per primary if seed is not 0 */
+	void runSource(SourceInterface *source, size_t first, size_t count, bool recursive,
+			bool secondariesFirst, const uint32_t *seed);
+	void writeCheckpoint(SourceInterface *source, size_t completed, size_t count,
+			int threads, bool recursive, bool secondariesFirst, const uint32_t *seed);
+
+	/** Counters of one module in one thread */
+	struct ModuleCounters {
+		uint64_t calls;
+		uint64_t sampledCalls;
+		uint64_t ticks;
+		uint64_t secondaries;
+		ModuleCounters() : calls(0), sampledCalls(0), ticks(0), secondaries(0) {}
+	};
+	/** Counters of one thread, only written by this thread */
+	struct alignas(64) ThreadProfile { // no false sharing between threads
+		std::vector<ModuleCounters> modules;
+		uint64_t steps;
+		ThreadProfile() : steps(0) {}
+	};
+
+	void processProfiled(Candidate *candidate) const;
+
+	/** Telemetry counters of one thread, only written by this thread */
+	struct alignas(64) ThreadTelemetry { // no false sharing between threads
+		std::atomic<uint64_t> primaries;
+		std::atomic<uint64_t> steps;
+		std::atomic<uint64_t> secondariesCreated;
+		std::atomic<uint64_t> secondariesFinished;
+		std::atomic<int64_t> busyTicks;
+		std::atomic<int64_t> primaryStart; ///< ticks since the start of the run, -1 if idle
+		ThreadTelemetry() : primaries(0), steps(0), secondariesCreated(0),
+				secondariesFinished(0), busyTicks(0), primaryStart(-1) {}
+	};
+
+	void startTelemetry(size_t primaries, int threads);
+	/** Counters of the calling thread, 0 without telemetry */
+	ThreadTelemetry *beginPrimary();
+	/** Count a finished primary and publish if the interval has passed */
+	void finishPrimary(ThreadTelemetry *counters);
+	void publishTelemetry();
+
 	module_list_t modules;
 	bool showProgress;
+	DirectorPolicy directorPolicy;
+	std::string checkpointFile;
+	size_t checkpointInterval;
+	uint64_t serialNumbersPerPrimary;
+	bool profiling;
+	unsigned int samplingInterval;
+	mutable std::vector<ThreadProfile, CacheLineAllocator<ThreadProfile> > profiles;
+	double telemetryInterval;
+	ref_ptr<TelemetryCallback> telemetryCallback;
+	std::string telemetryFile;
+	std::vector<ThreadTelemetry, CacheLineAllocator<ThreadTelemetry> > telemetryThreads;
+	std::chrono::steady_clock::time_point telemetryStart;
+	std::atomic<int64_t> nextTelemetry; ///< steady clock ticks since telemetryStart
+	std::atomic<bool> publishingTelemetry;
+	int telemetryThreadCount;
+	RunTelemetry telemetry; ///< last update, only written while publishing
+	static DirectorCheck directorCheck;
 };
 
 /**
@@ -64,6 +253,10 @@ public:
 	ModuleListRunner(ModuleList *mlist);
 	void process(Candidate *candidate) const; ///< call run of wrapped ModuleList
 	std::string getDescription() const;
+	std::string saveCheckpoint();
+	void loadCheckpoint(const std::string &state);
+	size_t getBacklog() const;
+	void finishRun();
 };
 
 } // namespace crpropa
@@ -0,0 +1,26 @@
+#ifndef CRPROPA_MODULE_PROFILE_H
+#define CRPROPA_MODULE_PROFILE_H
+
+#include <string>
+#include <stdint.h>
+
+namespace crpropa {
+
+/**
+ @class ModuleProfile
+ @brief Calls, time and secondaries of one module, see ModuleList::setProfiling
+ */
+struct ModuleProfile {
+	std::string description; ///< description of the module
+	uint64_t calls; ///< calls of process
+	uint64_t sampledCalls; ///< calls of process that were timed
+	double time; ///< time spent in process [s], extrapolated from the timed calls
+	uint64_t secondaries; ///< secondaries created in process
+
+	ModuleProfile() : calls(0), sampledCalls(0), time(0), secondaries(0) {
+	}
+};
+
+} // namespace crpropa
+
+#endif // CRPROPA_MODULE_PROFILE_H
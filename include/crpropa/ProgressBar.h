@@ -1,6 +1,7 @@
 #ifndef CRPROPA_PROGRESSBAR_H
 #define CRPROPA_PROGRESSBAR_H
 
+#include <atomic>
 #include <string>
 #include <ctime>
 
@@ -18,10 +19,11 @@ namespace crpropa {
 class ProgressBar {
 private:
 	unsigned long _steps;
-	unsigned long _currentCount;
+	std::atomic<unsigned long> _currentCount;
 	unsigned long _maxbarLength;
-	unsigned long _nextStep;
+	std::atomic<unsigned long> _nextStep;
 	unsigned long _updateSteps;
+	unsigned long _shownPosition;
 	time_t _startTime;
 	std::string stringTmpl;
 	std::string arrow;
@@ -35,7 +37,8 @@ public:
 	void start(const std::string &title);
 
 	/** Update the progressbar
-	 This should be called steps times in a loop.
+	 This should be called steps times in a loop. It may be called by several
+	 threads at once, only the redraw of the bar is serialized.
 	*/
 	void update(); 
 
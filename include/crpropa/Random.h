@@ -200,6 +200,10 @@ public:
 	static Random &instance();
 	static void seedThreads(const uint32_t oneSeed);
 	static std::vector< std::vector<uint32_t> > getSeedThreads();
+	/// States (see save()) of the generators of the first n threads
+	static std::vector< std::vector<uint32_t> > saveThreads(size_t n);
+	/// Restore the generators of the first states.size() threads
+	static void loadThreads(const std::vector< std::vector<uint32_t> > &states);
 
 protected:
 	/// Initialize generator state with seed
@@ -0,0 +1,38 @@
+#ifndef CRPROPA_RUN_GUARD_H
+#define CRPROPA_RUN_GUARD_H
+
+#include <exception>
+#include <string>
+
+namespace crpropa {
+
+/**
+ @class RunGuard
+ @brief Signal and exception handling of the parallel runs of ModuleList and SweepRunner
+
+ While a RunGuard exists, SIGINT and SIGTERM stop the run: the threads skip
+ the remaining primaries. An exception of a primary reported with stop()
+ stops the run as well. The destructor restores the previous signal
+ handlers and passes a received signal on to them.
+ */
+class RunGuard {
+public:
+	RunGuard();
+	~RunGuard();
+	RunGuard(const RunGuard &) = delete;
+	RunGuard &operator=(const RunGuard &) = delete;
+	/** True after a signal or stop() */
+	static bool stopped();
+	/** Report the exception and stop the run
+	 @param context	printed after "Exception in "
+	 */
+	static void stop(const std::string &context, const std::exception &e);
+
+private:
+	typedef void (*handler_t)(int);
+	handler_t oldSigint, oldSigterm;
+};
+
+} // namespace crpropa
+
+#endif // CRPROPA_RUN_GUARD_H
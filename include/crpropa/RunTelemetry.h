@@ -0,0 +1,64 @@
+#ifndef CRPROPA_RUN_TELEMETRY_H
+#define CRPROPA_RUN_TELEMETRY_H
+
+#include "crpropa/Referenced.h"
+
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+namespace crpropa {
+
+/**
+ @class RunTelemetry
+ @brief State of a running simulation, see ModuleList::setTelemetryInterval
+ */
+struct RunTelemetry {
+	double elapsed; ///< time since the start of the run [s]
+	uint64_t primaries; ///< number of primaries of the run
+	uint64_t primariesFinished; ///< primaries propagated including their secondaries
+	double primariesPerSecond; ///< finished primaries per second since the last update
+	uint64_t steps; ///< calls of ModuleList::process
+	double stepsPerSecond; ///< steps per second since the last update
+	uint64_t secondariesCreated; ///< secondaries added to propagated candidates
+	uint64_t secondariesFinished; ///< secondaries propagated in recursive runs
+	uint64_t outputBacklog; ///< buffered results not written yet, see Module::getBacklog
+	uint64_t maxResidentMemory; ///< high-water mark of the resident memory of the process [byte], 0 if unknown
+	std::vector<double> threadBusy; ///< time each thread spent on primaries [s]
+	std::vector<double> threadIdle; ///< time each thread waited for other threads or the run to end [s]
+
+	RunTelemetry() : elapsed(0), primaries(0), primariesFinished(0),
+			primariesPerSecond(0), steps(0), stepsPerSecond(0),
+			secondariesCreated(0), secondariesFinished(0), outputBacklog(0),
+			maxResidentMemory(0) {
+	}
+
+	/** Secondaries waiting to be propagated, i.e. the queue depth of a recursive run */
+	uint64_t getPendingSecondaries() const {
+		return secondariesCreated > secondariesFinished ? secondariesCreated - secondariesFinished : 0;
+	}
+
+	/** JSON object with all values */
+	std::string toJSON() const;
+	/** Prometheus text exposition format, all metrics prefixed with crpropa_ */
+	std::string toPrometheus() const;
+};
+
+/**
+ @class TelemetryCallback
+ @brief Receives the telemetry of a run, see ModuleList::setTelemetryCallback
+
+ update is called by one of the threads of the run, never by two threads at
+ the same time. Implementations in Python hold the interpreter lock during the
+ call and should return quickly.
+ */
+class TelemetryCallback: public Referenced {
+public:
+	virtual ~TelemetryCallback() {
+	}
+	virtual void update(const RunTelemetry &telemetry) = 0;
+};
+
+} // namespace crpropa
+
+#endif // CRPROPA_RUN_TELEMETRY_H
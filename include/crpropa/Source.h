@@ -2,6 +2,7 @@
 #define CRPROPA_SOURCE_H
 
 #include "crpropa/Candidate.h"
+#include "crpropa/Cosmology.h"
 #include "crpropa/Grid.h"
 #include "crpropa/EmissionMap.h"
 #include "crpropa/massDistribution/Density.h"
@@ -37,6 +38,12 @@ class SourceInterface : public Referenced {
 public:
 	virtual ref_ptr<Candidate> getCandidate() const = 0;
 	virtual std::string getDescription() const = 0;
+	/** State needed to resume a run, see Module::saveCheckpoint */
+	virtual std::string saveCheckpoint() const {
+		return "";
+	}
+	virtual void loadCheckpoint(const std::string &) {
+	}
 };
 
 
@@ -54,6 +61,7 @@ public:
 	void add(SourceFeature* feature);
 	ref_ptr<Candidate> getCandidate() const;
 	std::string getDescription() const;
+	const std::vector<ref_ptr<SourceFeature> > &getFeatures() const;
 };
 
 
@@ -75,6 +83,61 @@ public:
 	void add(Source* source, double weight = 1);
 	ref_ptr<Candidate> getCandidate() const;
 	std::string getDescription() const;
+	const std::vector<ref_ptr<Source> > &getSources() const;
+};
+
+
+/**
+ @class SourceFromArrays
+ @brief Source emitting a given list of particles, e.g. from NumPy arrays
+
+ Each call of getCandidate returns the next particle of the list, so a run
+ with size() candidates emits every particle exactly once, also when
+ running with several threads. After the last particle, getCandidate
+ returns no candidate (0, None in Python) and logs a warning once;
+ ModuleList::run and SweepRunner skip these primaries, so a run with more
+ than remaining() primaries ends normally after the last particle. The particles are stored in columns and are
+ filled in a single loop by setArrays, which avoids Python SourceFeatures.
+ */
+class SourceFromArrays: public SourceInterface {
+	std::vector<int> ids;
+	std::vector<double> energies;
+	std::vector<Vector3d> positions;
+	std::vector<Vector3d> directions;
+	std::vector<double> weights;
+	mutable size_t next;
+public:
+	SourceFromArrays();
+	/** Add a single particle.
+	 @param id			id of the particle following the PDG numbering scheme
+	 @param energy		energy of the particle [in Joules]
+	 @param position	position of the particle [in meters]
+	 @param direction	direction of the particle
+	 @param weight		weight of the candidate
+	 */
+	void add(int id, double energy, Vector3d position, Vector3d direction, double weight = 1.);
+	/** Append n particles from arrays.
+	 @param n			number of particles
+	 @param id			particle ids
+	 @param energy		energies [in Joules]
+	 @param position	positions as n rows of x, y, z [in meters]
+	 @param direction	directions as n rows of x, y, z
+	 @param weight		weights, all weights are 1 if 0
+	 */
+	void setArrays(size_t n, const int *id, const double *energy,
+			const double *position, const double *direction, const double *weight = 0);
+	size_t size() const;
+	/** Number of particles not yet emitted */
+	size_t remaining() const;
+	/** Restart with the first particle */
+	void reset();
+	void clear();
+	/** The next particle, 0 if all particles have been emitted */
+	ref_ptr<Candidate> getCandidate() const;
+	std::string getDescription() const;
+	/** Index of the next particle */
+	std::string saveCheckpoint() const;
+	void loadCheckpoint(const std::string &state);
 };
 
 
@@ -508,14 +571,22 @@ public:
 class SourceUniform1D: public SourceFeature {
 	double minD; // minimum light-travel distance
 	double maxD; // maximum light-travel distance
+	double minDistance; // minimum distance as given
+	double maxDistance; // maximum distance as given
 	bool withCosmology;	// whether to account for cosmological effects (expansion of the Universe)
+	ref_ptr<Cosmology> cosmology;
+	void updateDistances();
 public:
 	/** Constructor
 	 @param minD			minimum distance; comoving if withCosmology is True
 	 @param maxD 			maximum distance; comoving if withCosmology is True
 	 @param withCosmology	whether to account for cosmological effects (expansion of the Universe)
+	 @param cosmology		cosmology to use, 0 for the default cosmology
 	 */
-	SourceUniform1D(double minD, double maxD, bool withCosmology = true);
+	SourceUniform1D(double minD, double maxD, bool withCosmology = true,
+			ref_ptr<Cosmology> cosmology = 0);
+	void setCosmology(ref_ptr<Cosmology> cosmology);
+	ref_ptr<Cosmology> getCosmology() const;
 	void prepareParticle(ParticleState& particle) const;
 	void setDescription();
 };
@@ -764,10 +835,14 @@ public:
  computes the redshifts based on the source distance.
  */
 class SourceRedshift1D: public SourceFeature {
+	ref_ptr<Cosmology> cosmology;
 public:
 	/** Constructor
+	 @param cosmology	cosmology to use, 0 for the default cosmology
 	 */
-	SourceRedshift1D();
+	SourceRedshift1D(ref_ptr<Cosmology> cosmology = 0);
+	void setCosmology(ref_ptr<Cosmology> cosmology);
+	ref_ptr<Cosmology> getCosmology() const;
 	void prepareCandidate(Candidate &candidate) const;
 	void setDescription();
 };
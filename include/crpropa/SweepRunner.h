@@ -0,0 +1,82 @@
+#ifndef CRPROPA_SWEEPRUNNER_H
+#define CRPROPA_SWEEPRUNNER_H
+
+#include "crpropa/ModuleList.h"
+#include "crpropa/Source.h"
+
+#include <vector>
+
+namespace crpropa {
+
+/**
+ @class SweepRunner
+ @brief Run many source configurations of a parameter study in one parallel run
+
+ A study such as a scan over energies or source distances usually repeats
+ the same simulation with a different source and a different output. Run one
+ after the other, each run builds its own fields and reads its own tables,
+ and small runs leave most threads idle.
+
+ The SweepRunner holds one ModuleList with the modules that all
+ configurations share, e.g. the propagation in a magnetic field and the
+ interactions, which are set up once. Each configuration adds a source, the
+ number of its primaries and optionally modules that only its candidates
+ pass after the shared modules, typically an Observer with the output of the
+ configuration. All primaries of all configurations are distributed over the
+ threads of a single OpenMP loop, thus every candidate ends up in the output
+ of its own configuration.
+
+ With a seed, the random number generator is seeded before each primary with
+ (seed, configuration, primary), and each primary gets its own range of
+ serial numbers as in ModuleList::runShard (see
+ ModuleList::setSerialNumbersPerPrimary of the shared modules). The results
+ then do not depend on the number of threads.
+ */
+class SweepRunner: public Referenced {
+public:
+	/** @param modules	modules shared by all configurations */
+	SweepRunner(ModuleList *modules);
+
+	/** Add a configuration
+	 @param source	source of the primaries
+	 @param count	number of primaries
+	 @param modules	run after the shared modules for the candidates of this configuration only, may be 0
+	 @returns		index of the configuration
+	 */
+	size_t add(SourceInterface *source, size_t count, Module *modules = 0);
+	/** Number of configurations */
+	size_t size() const;
+	/** Total number of primaries of all configurations */
+	size_t getCount() const;
+
+	ref_ptr<ModuleList> getModules() const;
+	/** The shared and the own modules of a configuration */
+	ref_ptr<ModuleList> getModules(size_t configuration) const;
+
+	void setShowProgress(bool show = true);
+	/** Seed for reproducible runs, 0 (default) keeps the random number generators as they are */
+	void setSeed(uint32_t seed);
+	uint32_t getSeed() const;
+
+	/** Run all primaries of all configurations */
+	void run(bool recursive = true, bool secondariesFirst = false);
+
+private:
+	struct Configuration {
+		ref_ptr<SourceInterface> source;
+		ref_ptr<ModuleList> modules;
+		size_t first; ///< index of the first primary in the run
+	};
+
+	int getNumberOfThreads() const;
+
+	ref_ptr<ModuleList> modules;
+	std::vector<Configuration> configurations;
+	size_t count;
+	bool showProgress;
+	uint32_t seed;
+};
+
+} // namespace crpropa
+
+#endif // CRPROPA_SWEEPRUNNER_H
@@ -0,0 +1,89 @@
+#ifndef CRPROPA_TABLEREGISTRY_H
+#define CRPROPA_TABLEREGISTRY_H
+
+#include "crpropa/PhotonBackground.h"
+#include "crpropa/Referenced.h"
+
+#include <string>
+#include <vector>
+
+namespace crpropa {
+
+/**
+ * \addtogroup Core
+ * @{
+ */
+
+/**
+ @class RateTable
+ @brief Interaction rate as function of energy
+
+ Read from lines "log10(E/eV) rate[1/Mpc]", lines starting with # are skipped.
+ */
+class RateTable: public Referenced {
+public:
+	std::vector<double> energy; ///< energy [J]
+	std::vector<double> rate; ///< interaction rate [1/m]
+};
+
+/**
+ @class RedshiftRateTable
+ @brief Interaction rate as function of energy and redshift
+
+ Read from the files energies.txt (log10(E/eV)), redshifts.txt and
+ rates.txt (1/Mpc, energy major) with a common prefix.
+ */
+class RedshiftRateTable: public Referenced {
+public:
+	std::vector<double> energy; ///< energy [J]
+	std::vector<double> redshift;
+	std::vector<double> rate; ///< interaction rate [1/m] for each energy and redshift
+};
+
+/**
+ @class CumulativeRateTable
+ @brief Cumulative differential interaction rate as function of energy and s_kin
+
+ Read from a header line of log10(s_kin/eV^2) values followed by lines
+ "log10(E/eV) cdf[1/Mpc]...".
+ */
+class CumulativeRateTable: public Referenced {
+public:
+	std::vector<double> energy; ///< energy [J]
+	std::vector<double> s; ///< s_kin = s - m^2 [J^2]
+	std::vector<std::vector<double> > cdf; ///< cumulative interaction rate [1/m]
+};
+
+/**
+ @class TableRegistry
+ @brief Process-wide cache of the interaction tables
+
+ The interaction modules get their tables from here, so that all instances
+ of a module with the same photon field share one read-only copy. A table is
+ read on first use and identified by its kind, its file name and the version
+ (modification time and size) of the file; a changed file is read again
+ while modules holding the old table keep it. All functions are thread-safe,
+ different tables are read concurrently.
+ */
+class TableRegistry {
+public:
+	static ref_ptr<const RateTable> getRateTable(const std::string &filename);
+	static ref_ptr<const RedshiftRateTable> getRedshiftRateTable(const std::string &prefix);
+	static ref_ptr<const CumulativeRateTable> getCumulativeRateTable(const std::string &filename);
+
+	/** Read the tables of EMPairProduction, EMDoublePairProduction,
+	 EMTripletPairProduction and EMInverseComptonScattering for the given
+	 photon fields in parallel */
+	static void prefetch(const std::vector<ref_ptr<PhotonField> > &photonFields);
+
+	/** Number of cached tables */
+	static size_t size();
+	/** Forget all tables, modules holding them keep their copy */
+	static void clear();
+};
+
+/** @}*/
+
+} // namespace crpropa
+
+#endif // CRPROPA_TABLEREGISTRY_H
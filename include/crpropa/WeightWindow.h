@@ -0,0 +1,117 @@
+#ifndef CRPROPA_WEIGHTWINDOW_H
+#define CRPROPA_WEIGHTWINDOW_H
+
+#include "crpropa/Candidate.h"
+#include "crpropa/Referenced.h"
+#include "crpropa/Vector3.h"
+
+#include <string>
+#include <vector>
+
+namespace crpropa {
+
+/**
+ * \addtogroup Core
+ * @{
+ */
+
+/**
+ @class WeightWindow
+ @brief Population control of secondaries by weight windows
+
+ The electromagnetic interaction modules and SynchrotronRadiation reduce the
+ number of secondaries by thinning with a fixed exponent, which has to be
+ tuned for each problem. A WeightWindow shared by these modules (see their
+ setWeightWindow) replaces the thinning by a target weight for each cell of
+ secondary energy (logarithmic bins) and distance to an origin, e.g. the
+ observer (linear bins).
+
+ A secondary with a weight below the window [target / width, target * width]
+ survives a Russian roulette with probability weight / target and then has
+ the target weight; a secondary above the window is split into copies of
+ about the target weight.
+
+ The targets are set with setTargetWeight or learned during a warm-up: after
+ startWarmup, the modules thin as usual while the window sums the expected
+ weight of the secondaries created in each cell. finishWarmup(primaries)
+ sets the target weights such that each cell receives about
+ getParticlesPerCell() candidates per primary. The window is then fixed and
+ can be used by all threads.
+
+ In cells without a target and outside the grid, the modules keep their
+ thinning.
+ */
+class WeightWindow: public Referenced {
+public:
+	/**
+	 @param minEnergy		lower edge of the energy grid
+	 @param maxEnergy		upper edge of the energy grid
+	 @param nEnergyBins		number of logarithmic energy bins
+	 @param maxDistance		upper edge of the distance grid, 0 for a single distance bin
+	 @param nDistanceBins	number of linear distance bins
+	 */
+	WeightWindow(double minEnergy, double maxEnergy, size_t nEnergyBins,
+			double maxDistance = 0, size_t nDistanceBins = 1);
+
+	/** Distances are measured to this point, default (0, 0, 0) */
+	void setOrigin(const Vector3d &origin);
+	Vector3d getOrigin() const;
+	/** Ratio of the upper (and inverse of the lower) edge of the window to the target weight, default 2 */
+	void setWidth(double width);
+	double getWidth() const;
+	/** Maximum number of copies of a split secondary, default 10 */
+	void setMaximumSplit(size_t n);
+	size_t getMaximumSplit() const;
+	/** Candidates per cell and primary aimed at by finishWarmup, default 1 */
+	void setParticlesPerCell(double n);
+	double getParticlesPerCell() const;
+
+	size_t getEnergyBins() const;
+	size_t getDistanceBins() const;
+	/** Cell of the energy and distance bins, getEnergyBins() * getDistanceBins() if outside the grid */
+	size_t getCell(double energy, double distance) const;
+	/** Target weight of a cell, 0 if none */
+	double getTargetWeight(size_t energyBin, size_t distanceBin) const;
+	void setTargetWeight(size_t energyBin, size_t distanceBin, double weight);
+
+	/** Clear the targets and start learning them */
+	void startWarmup();
+	/** Set the targets from the weights seen since startWarmup
+	 @param primaries	number of primaries run during the warm-up
+	 */
+	void finishWarmup(size_t primaries);
+	bool isWarmup() const;
+
+	/**
+	 Add a secondary to the candidate. The module would create it with the
+	 thinning probability and the relative weight weight / probability. In
+	 cells with a target weight, the secondary is created with the relative
+	 weight instead and passes the window.
+	 @param candidate	parent of the secondary
+	 @param id			particle id of the secondary
+	 @param energy		energy of the secondary
+	 @param position	position of the secondary
+	 @param probability	thinning probability of the module
+	 @param tag			interaction tag
+	 @param weight		relative weight before thinning
+	 */
+	void addSecondary(Candidate *candidate, int id, double energy, const Vector3d &position,
+			double probability, const std::string &tag, double weight = 1) const;
+
+private:
+	double minEnergy, logStep, maxDistance;
+	size_t nEnergyBins, nDistanceBins;
+	Vector3d origin;
+	double width;
+	size_t maximumSplit;
+	double particlesPerCell;
+	bool warmup;
+	std::vector<double> targets;
+	mutable std::vector<double> warmupWeights; ///< summed with omp atomic
+};
+
+/** @}*/
+
+} // namespace crpropa
+
+#endif // CRPROPA_WEIGHTWINDOW_H
@@ -7,6 +7,7 @@
 
 #ifdef CRPROPA_HAVE_MUPARSER
 #include "muParser.h"
+#include "crpropa/Expression.h"
 #endif
 
 namespace crpropa {
@@ -164,6 +165,32 @@ public:
 	~RenormalizeMagneticField() { delete p;	}
 	Vector3d getField(const Vector3d &position);
 };
+
+/**
+ @class ExpressionMagneticField
+ @brief Analytic magnetic field given by one muParser expression per component.
+
+ The expressions may use the position variables 'x', 'y', 'z' and 'r' (distance
+ to the origin), the redshift 'redshift' and all units known to crpropa::Expression,
+ e.g. "1*nG * exp(-r/(10*kpc))".
+ The expressions are compiled once and evaluated in C++ by all threads, which
+ avoids the Python director overhead (and the global interpreter lock) of
+ fields defined in Python.
+ */
+class ExpressionMagneticField: public MagneticField {
+	ref_ptr<Expression> Bx, By, Bz;
+public:
+	/**
+	 * Constructor
+	 * @param Bx	expression for the x-component of the field
+	 * @param By	expression for the y-component of the field
+	 * @param Bz	expression for the z-component of the field
+	*/
+	ExpressionMagneticField(const std::string &Bx, const std::string &By,
+			const std::string &Bz);
+	Vector3d getField(const Vector3d &position) const;
+	Vector3d getField(const Vector3d &position, double z) const;
+};
 #endif
 
 /** @} */
@@ -63,6 +63,14 @@ class GridTurbulence : public TurbulentField {
 	std::array<float, 3> getRmsFieldStrengthPerAxis() const;
 	/** Evaluate generated power-spectrum */
 	std::vector<std::pair<int, float>> getPowerSpectrum() const;
+	/**
+	 Validate the generated field against the requested spectrum.
+	 The power spectrum of the grid is compared with the energy spectrum used
+	 in initTurbulence, averaged over the same wavenumber shells.
+	 @returns mean relative deviation, weighted with the number of modes per
+	 shell and after fitting the normalization
+	 */
+	double getPowerSpectrumDeviation() const;
 	/** Dump a Grid3f to a binary file */
 	void dumpToFile(std::string filename) const;
 };
@@ -0,0 +1,61 @@
+#ifndef CRPROPA_EXPRESSIONDENSITY_H
+#define CRPROPA_EXPRESSIONDENSITY_H
+
+#include "crpropa/massDistribution/Density.h"
+#include "crpropa/Expression.h"
+
+#include <string>
+
+namespace crpropa {
+
+#ifdef CRPROPA_HAVE_MUPARSER
+/**
+ @class ExpressionDensity
+ @brief Analytic density model given by one muParser expression per component.
+
+ Each of the HI, HII and H2 components is described by an expression of the
+ position variables 'x', 'y', 'z', the distance to the origin 'r' and the
+ cylindrical radius 'rho', e.g. "1/ccm * exp(-abs(z)/(200*pc))".
+ A component with an empty expression is not active.
+ The expressions are compiled once and evaluated in C++ by all threads.
+ This class is only available if muparser is available.
+ */
+class ExpressionDensity: public Density {
+private:
+	ref_ptr<Expression> HI, HII, H2;
+	double evaluate(const ref_ptr<Expression> &expression, const Vector3d &position) const;
+
+public:
+	/** Constructor for analytic densities
+	 @param HI	expression for the atomic hydrogen density, empty if not active
+	 @param HII	expression for the ionised hydrogen density, empty if not active
+	 @param H2	expression for the molecular hydrogen density, empty if not active
+	 */
+	ExpressionDensity(const std::string &HI, const std::string &HII = "",
+			const std::string &H2 = "");
+
+	/** Get density at a given position.
+	 @param position	position in Galactic coordinates with Earth at (-8.5 kpc, 0, 0)
+	 @returns Density in particles/m^3, sum of all active components
+	 */
+	double getDensity(const Vector3d &position) const;
+	double getHIDensity(const Vector3d &position) const;
+	double getHIIDensity(const Vector3d &position) const;
+	double getH2Density(const Vector3d &position) const;
+	/** Get the density of nucleons.
+	 @param position	position in Galactic coordinates with Earth at (-8.5 kpc, 0, 0)
+	 @returns number of nucleons/m^3, sum of all active components with H2 weighted twice
+	 */
+	double getNucleonDensity(const Vector3d &position) const;
+
+	bool getIsForHI();
+	bool getIsForHII();
+	bool getIsForH2();
+
+	std::string getDescription();
+};
+#endif // CRPROPA_HAVE_MUPARSER
+
+}  // namespace crpropa
+
+#endif  // CRPROPA_EXPRESSIONDENSITY_H
@@ -2,6 +2,7 @@
 #define CRPROPA_BREAKCONDITION_H
 
 #include "crpropa/Module.h"
+#include "crpropa/Expression.h"
 
 namespace crpropa {
 /**
@@ -138,6 +139,30 @@ public:
 	std::string getDescription() const;
 	void process(Candidate *candidate) const;
 };
+
+#ifdef CRPROPA_HAVE_MUPARSER
+/**
+ @class ExpressionCondition
+ @brief Rejects the candidate if an expression evaluates to true (non-zero)
+
+ The condition is a muParser expression which is compiled once and evaluated
+ in C++ by all threads. Available variables are the current energy 'E',
+ particle id 'id', mass number 'A', charge number 'Z', position 'x', 'y', 'z'
+ and distance to the origin 'r', trajectory length 'D', redshift 'redshift'
+ and weight 'w', e.g. "(E < 1*EeV) || (r > 100*Mpc)".
+ Candidates for which the expression is zero are accepted.
+ This module is only available if muparser is available.
+ */
+class ExpressionCondition: public AbstractCondition {
+	ref_ptr<Expression> expression;
+public:
+	ExpressionCondition(const std::string &expression);
+	void setExpression(const std::string &expression);
+	std::string getExpression() const;
+	std::string getDescription() const;
+	void process(Candidate *candidate) const;
+};
+#endif
 /** @}*/
 
 } // namespace crpropa
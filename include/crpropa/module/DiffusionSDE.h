@@ -8,6 +8,7 @@
 #include <cstdlib>
 #include <stdexcept>
 
+#include "crpropa/Common.h"
 #include "crpropa/Module.h"
 #include "crpropa/magneticField/MagneticField.h"
 #include "crpropa/advectionField/AdvectionField.h"
@@ -43,6 +44,10 @@ private:
 	    double epsilon; // ratio of parallel and perpendicular diffusion coefficient D_par = epsilon*D_perp
 	    double alpha; // power law index of the energy dependent diffusion coefficient: D\propto E^alpha
 	    double scale; // scaling factor for the diffusion coefficient D = scale*D_0
+	    mutable std::vector<double, CacheLineAllocator<double> > tensorCache; // per thread, one cache line each: last rigidity and the diagonal of the diffusion tensor
+
+	    void calculateBTensorCached(double rig, double BTen[]) const;
+	    void clearTensorCache();
 
 public:
 	/** Constructor
@@ -65,7 +70,20 @@ public:
 
 	void process(crpropa::Candidate *candidate) const;
 
+	/**
+	 Integrate along the magnetic field line with an adaptive Cash-Karp scheme.
+	 Accepted substeps are kept, rejected ones are retried with a smaller step
+	 and the step grows again where the field line is smooth.
+	 @param PosIn		start position
+	 @param z			redshift
+	 @param propTime	signed integration time along the field line
+	 @param stepNumber	returns the number of substeps of the smallest accepted size
+	 @return			end position
+	 */
+	Vector3d integrateFieldLine(const Vector3d &PosIn, double z, double propTime, size_t &stepNumber) const;
 	void tryStep(const Vector3d &Pos, Vector3d &POut, Vector3d &PosErr, double z, double propStep ) const;
+	/** Cash-Karp step with the field line tangent k0 at Pos already known */
+	void tryStep(const Vector3d &Pos, const Vector3d &k0, Vector3d &POut, Vector3d &PosErr, double z, double propStep ) const;
 	void driftStep(const Vector3d &Pos, Vector3d &LinProp, double h) const;
 	void calculateBTensor(double rig, double BTen[], Vector3d pos, Vector3d dir, double z) const;
 
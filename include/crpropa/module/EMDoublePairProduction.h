@@ -5,7 +5,10 @@
 #include <cmath>
 
 #include "crpropa/Module.h"
+#include "crpropa/CascadeInteraction.h"
 #include "crpropa/PhotonBackground.h"
+#include "crpropa/TableRegistry.h"
+#include "crpropa/WeightWindow.h"
 
 namespace crpropa {
 /**
@@ -24,17 +27,17 @@ namespace crpropa {
  For the maximum thinning of 1, only a few representative particles are added to the list of secondaries.
  Note that for thinning>0 the output must contain the column "weights", which should be included in the post-processing.
  */
-class EMDoublePairProduction: public Module {
+class EMDoublePairProduction: public Module, public CascadeInteraction {
 private:
 	ref_ptr<PhotonField> photonField;
 	bool haveElectrons;
 	double limit;
 	double thinning;
+	ref_ptr<WeightWindow> weightWindow;
 	std::string interactionTag = "EMDP";
 
-	// tabulated interaction rate 1/lambda(E)
-	std::vector<double> tabEnergy;  //!< electron energy in [J]
-	std::vector<double> tabRate;  //!< interaction rate in [1/m]
+	// tabulated interaction rate 1/lambda(E), shared through the TableRegistry
+	ref_ptr<const RateTable> rateTable;
 
 public:
 	/** Constructor
@@ -60,6 +63,13 @@ public:
 	 * @param thinning factor of thinning (0: no thinning, 1: maximum thinning)
 	 */
 	void setThinning(double thinning);
+
+	/** Population control that replaces the thinning where it has a target
+	 weight, see WeightWindow. The window may be shared by several modules.
+	 @param weightWindow	weight window, 0 to use only the thinning
+	 */
+	void setWeightWindow(ref_ptr<WeightWindow> weightWindow);
+	ref_ptr<WeightWindow> getWeightWindow() const;
 	
 	/** set a custom interaction tag to trace back this interaction
 	 * @param tag string that will be added to the candidate and output
@@ -69,6 +79,8 @@ public:
 
 	void initRate(std::string filename);
 	void process(Candidate *candidate) const;
+	/** Interaction rate per comoving length used by process, see CascadeInteraction */
+	double getInteractionRate(int id, double energy, double z) const;
 	void performInteraction(Candidate *candidate) const;
 };
 /** @}*/
@@ -5,7 +5,10 @@
 #include <cmath>
 
 #include "crpropa/Module.h"
+#include "crpropa/CascadeInteraction.h"
 #include "crpropa/PhotonBackground.h"
+#include "crpropa/TableRegistry.h"
+#include "crpropa/WeightWindow.h"
 
 namespace crpropa {
 /**
@@ -24,23 +27,20 @@ namespace crpropa {
  For the maximum thinning of 1, only a few representative particles are added to the list of secondaries.
  Note that for thinning>0 the output must contain the column "weights", which should be included in the post-processing.
 */
-class EMInverseComptonScattering: public Module {
+class EMInverseComptonScattering: public Module, public CascadeInteraction {
 private:
 	ref_ptr<PhotonField> photonField;
 	bool havePhotons;
 	double limit;
 	double thinning;
+	ref_ptr<WeightWindow> weightWindow;
 	std::string interactionTag = "EMIC";
 
-	// tabulated interaction rate 1/lambda(E)
-	std::vector<double> tabICEnergy;  //!< electron energy in [J]
-	std::vector<double> tabICRate;  //!< interaction rate in [1/m]
-	std::vector<double> tabICZ;      // Redshift values, this is newly added for 2D interpolation
+	// tabulated interaction rate 1/lambda(E, z), shared through the TableRegistry
+	ref_ptr<const RedshiftRateTable> rateTable;
 	
 	// tabulated CDF(s_kin, E) = cumulative differential interaction rate
-	std::vector<double> tabE;  //!< electron energy in [J]
-	std::vector<double> tabs;  //!< s_kin = s - m^2 in [J**2]
-	std::vector< std::vector<double> > tabCDF;  //!< cumulative interaction rate
+	ref_ptr<const CumulativeRateTable> cdfTable;
 
 public:
 	/** Constructor
@@ -67,6 +67,13 @@ public:
 	 */
 	void setThinning(double thinning);
 
+	/** Population control that replaces the thinning where it has a target
+	 weight, see WeightWindow. The window may be shared by several modules.
+	 @param weightWindow	weight window, 0 to use only the thinning
+	 */
+	void setWeightWindow(ref_ptr<WeightWindow> weightWindow);
+	ref_ptr<WeightWindow> getWeightWindow() const;
+
 	/** set a custom interaction tag to trace back this interaction
 	 * @param tag string that will be added to the candidate and output
 	 */
@@ -78,6 +85,8 @@ public:
 	void initCumulativeRate(std::string filename);
 
 	void process(Candidate *candidate) const;
+	/** Interaction rate per comoving length used by process, see CascadeInteraction */
+	double getInteractionRate(int id, double energy, double z) const;
 	void performInteraction(Candidate *candidate) const;
 };
 /** @}*/
@@ -1,6 +1,7 @@
 #ifndef CRPROPA_ELECTRONPAIRPRODUCTION_H
 #define CRPROPA_ELECTRONPAIRPRODUCTION_H
 
+#include "crpropa/ContinuousLoss.h"
 #include "crpropa/Module.h"
 #include "crpropa/PhotonBackground.h"
 
@@ -18,9 +19,10 @@ namespace crpropa {
  This module simulates electron-pair production as a continuous energy loss.\n
  Several photon fields can be selected.\n
  The production of secondary e+/e- pairs and photons can by activated.\n
+ Instead of individual pairs, each step can add a few weighted macro-particles per energy bin.\n
  By default, the module limits the step size to 10% of the energy loss length of the particle.
  */
-class ElectronPairProduction: public Module {
+class ElectronPairProduction: public Module, public ContinuousLoss {
 private:
 	ref_ptr<PhotonField> photonField;
 	std::vector<double> tabLossRate; /*< tabulated energy loss rate in [J/m] for protons at z = 0 */
@@ -28,8 +30,14 @@ private:
 	std::vector<std::vector<double> > tabSpectrum; /*< electron/positron cdf(Ee|log10(gamma)) for log10(Ee/eV)=7-24 in 170 steps and log10(gamma)=6-13 in 70 steps and*/
 	double limit; ///< fraction of energy loss length to limit the next step
 	bool haveElectrons; /*< if true, secondary electrons will be added to the simulation */
+	double minimumSecondaryEnergy = 0; ///< no secondary electrons below this energy
+	size_t macroParticles = 0; ///< number of energy bins of the macro-particles, 0 if off
+	std::vector<std::vector<double> > macroEnergy; ///< mean electron energy [J] of each macro-particle bin for each Lorentz factor of tabSpectrum
+	std::vector<std::vector<double> > macroFraction; ///< fraction of the energy loss in each macro-particle bin for each Lorentz factor
 	std::string interactionTag = "EPP";
 
+	void initMacroParticles();
+
 public:
 	/**
 	 * @brief Constructor for the Electron Pair Production
@@ -46,11 +54,29 @@ public:
 
 	// decide if secondary electrons are added to the simulation
 	void setHaveElectrons(bool haveElectrons);
+	bool getHaveElectrons() const;
 	
 	/** Limit the propagation step to a fraction of the mean free path
 	 * @param limit fraction of the mean free path
 	 */
 	void setLimit(double limit);
+
+	/** Secondary electrons and positrons below this energy are not created,
+	 their energy is lost. Default 0.
+	 @param energy	minimum energy of the secondaries [J]
+	 */
+	void setMinimumSecondaryEnergy(double energy);
+	double getMinimumSecondaryEnergy() const;
+
+	/** Macro-particle mode: instead of drawing individual pairs, each step
+	 adds one electron and one positron per energy bin, weighted with the
+	 expected number of pairs in the bin. The total energy and the spectrum
+	 of the pairs are conserved on average, the number of secondaries per
+	 step is at most 2 nBins.
+	 @param nBins	number of logarithmic bins of the pair spectrum above the minimum secondary energy, 0 to draw individual pairs (default)
+	 */
+	void setMacroParticles(size_t nBins);
+	size_t getMacroParticles() const;
 	
 	/** set a custom interaction tag to trace back this interaction
 	 * @param tag string that will be added to the candidate and output
@@ -75,6 +101,9 @@ public:
 	 beta(E,z) = (1+z)^3 beta((1+z)E).
 	 */
 	double lossLength(int id, double lf, double z=0) const;
+
+	/** Energy loss per comoving length of a nucleus, see lossLength */
+	double getEnergyLossRate(int id, double energy, double z) const;
 	
 };
 /** @}*/
@@ -0,0 +1,93 @@
+#ifndef CRPROPA_EVENTPROPAGATION1D_H
+#define CRPROPA_EVENTPROPAGATION1D_H
+
+#include "crpropa/CascadeInteraction.h"
+#include "crpropa/ContinuousLoss.h"
+#include "crpropa/Cosmology.h"
+#include "crpropa/Module.h"
+#include "crpropa/Units.h"
+
+#include <vector>
+
+namespace crpropa {
+
+/**
+ * \addtogroup Propagation
+ * @{
+ */
+
+/**
+ @class EventPropagation1D
+ @brief Event-driven rectilinear propagation that jumps to the next interaction
+
+ Replaces SimplePropagation and the interaction and energy loss modules of a
+ 1D simulation. Instead of steps limited to a fraction of every mean free
+ path, each step samples the free path from the total rate of all
+ interactions at the current energy and redshift and moves the candidate
+ directly to the interaction point, unless an observer or boundary limited
+ the next step before (limitNextStep).
+
+ The interactions are modules implementing CascadeInteraction (e.g.
+ EMPairProduction, EMInverseComptonScattering), the continuous losses are
+ Redshift and modules implementing ContinuousLoss (ElectronPairProduction,
+ SynchrotronRadiation with a RMS field). The continuous losses are integrated
+ over the step (RK4 with the redshift interpolated along the step, adiabatic
+ loss exactly). Since the rates are taken at the start of the step, a step
+ is limited to the distance over which the continuous losses take the
+ fraction tolerance of the energy. Secondaries of the continuous losses are
+ not produced.
+
+ Modules added here must not be part of the ModuleList. The cosmology of an
+ added Redshift is used unless one is set.
+ */
+class EventPropagation1D: public Module {
+private:
+	double minStep, maxStep, tolerance;
+	bool redshiftLosses;
+	ref_ptr<Cosmology> cosmology;
+	std::vector<ref_ptr<Module> > modules; ///< keeps the added modules alive
+	std::vector<const CascadeInteraction *> interactions;
+	std::vector<const ContinuousLoss *> losses;
+
+	/** -dE/dx of all continuous losses except the adiabatic loss */
+	double lossRate(int id, double energy, double z) const;
+
+public:
+	/**
+	 @param minStep		minimum step for steps limited by other modules
+	 @param maxStep		maximum step
+	 @param tolerance	maximum relative energy loss in one step
+	 */
+	EventPropagation1D(double minStep = (0.1 * kpc), double maxStep = (1 * Gpc),
+			double tolerance = 0.1);
+
+	/** Add an interaction or continuous loss module. ModuleLists are searched
+	 for such modules, Redshift enables the adiabatic loss.
+	 SynchrotronRadiation has to be constructed with a RMS field strength,
+	 with a MagneticField it throws.
+	 @returns	true if the module was used
+	 */
+	bool add(Module *module);
+
+	void setMinimumStep(double minStep);
+	void setMaximumStep(double maxStep);
+	void setTolerance(double tolerance);
+	/** Update the redshift and include the adiabatic loss */
+	void setRedshiftLosses(bool redshiftLosses);
+	/** Cosmology to use instead of the default cosmology, 0 for the default */
+	void setCosmology(ref_ptr<Cosmology> cosmology);
+	ref_ptr<Cosmology> getCosmology() const;
+	double getMinimumStep() const;
+	double getMaximumStep() const;
+	double getTolerance() const;
+	bool getRedshiftLosses() const;
+
+	void process(Candidate *candidate) const;
+	std::string getDescription() const;
+};
+
+/** @}*/
+
+} // namespace crpropa
+
+#endif // CRPROPA_EVENTPROPAGATION1D_H
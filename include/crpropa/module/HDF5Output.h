@@ -7,6 +7,8 @@
 #include "crpropa/module/Output.h"
 #include <stdint.h>
 #include <ctime>
+#include <string>
+#include <vector>
 
 #include <H5Ipublic.h>
 
@@ -131,6 +133,21 @@ public:
 	void close();
 	void flush() const;
 
+	/** Number of rows in the file, see Module::saveCheckpoint */
+	std::string saveCheckpoint();
+	/** Open the existing file and cut the dataset back to its size at the checkpoint */
+	void loadCheckpoint(const std::string &state);
+	/** Number of buffered rows */
+	size_t getBacklog() const;
+
+	/** Concatenate the files of a sharded run, see ModuleList::runShard.
+	 The attributes of the first file are kept, all files need the same
+	 columns. Missing files, i.e. shards without output, are skipped.
+	 @param shards		names of the files in the order of the shards
+	 @param filename	name of the merged file
+	 */
+	static void merge(const std::vector<std::string> &shards, const std::string &filename);
+
 };
 /** @}*/
 
@@ -0,0 +1,116 @@
+#ifndef CRPROPA_HISTOGRAMOUTPUT_H
+#define CRPROPA_HISTOGRAMOUTPUT_H
+
+#include "crpropa/Module.h"
+
+#include <string>
+#include <vector>
+
+namespace crpropa {
+
+class Pixelization;
+
+/**
+ * \addtogroup Output
+ * @{
+ */
+
+/**
+ @class HistogramOutput
+ @brief Weighted N-dimensional histogram of candidates, e.g. as action of an Observer
+
+ Instead of writing every event, the weights of the candidates are accumulated
+ in the bins of the configured axes. Each thread fills its own copy of the bins,
+ the copies are merged when the histogram is requested or written by close().
+ Candidates outside of the range of any axis are not binned, their total weight
+ is returned by getOutsideWeight().
+
+ The histogram is written as NumPy .npy file (C order, float64). If the file
+ name ends with .h5 and CRPropa is built with HDF5, an HDF5 file with the
+ dataset "histogram" and the bin edges of each axis ("axis0", "axis1", ...)
+ is written instead.
+ */
+class HistogramOutput: public Module {
+public:
+	enum Quantity {
+		Energy, ///< current energy [J]
+		SourceEnergy, ///< energy at the source [J]
+		ParticleId, ///< current particle id
+		ArrivalDirection, ///< direction the particle arrives from, -p
+		TrajectoryLength, ///< trajectory length [m]
+		Redshift ///< current redshift
+	};
+
+	/**
+	 @param filename	name of the .npy or .h5 file written by close(), no file if empty
+	 */
+	HistogramOutput(const std::string &filename = "");
+	~HistogramOutput();
+	/** Not copyable, the pixelization and the bins of the threads are owned by the instance */
+	HistogramOutput(const HistogramOutput &) = delete;
+	HistogramOutput &operator=(const HistogramOutput &) = delete;
+
+	/** Add an axis with nBins equal bins in [min, max) */
+	void addLinearAxis(Quantity quantity, size_t nBins, double min, double max);
+	/** Add an axis with nBins logarithmically equal bins in [min, max) */
+	void addLogAxis(Quantity quantity, size_t nBins, double min, double max);
+	/** Add an axis with one bin for each of the given particle ids */
+	void addIdAxis(const std::vector<int> &ids);
+	/** Add an axis with the Healpix pixels (RING scheme) of the arrival
+	 direction, requires the galactic magnetic lens support */
+	void addDirectionAxis(unsigned int order);
+
+	void process(Candidate *candidate) const;
+
+	/** Merge the bins of all threads and write the file */
+	void close();
+	/** Reset all bins */
+	void clear();
+	/** Merged bins, see Module::saveCheckpoint */
+	std::string saveCheckpoint();
+	void loadCheckpoint(const std::string &state);
+
+	size_t getNumberOfAxes() const;
+	/** Number of bins along each axis */
+	std::vector<size_t> getShape() const;
+	/** Bin edges of linear and logarithmic axes, the ids of id axes and the
+	 pixel numbers of direction axes */
+	std::vector<double> getBinEdges(size_t axis) const;
+	/** Merged histogram of all threads in C order */
+	std::vector<double> getHistogram() const;
+	/** Total weight of the candidates outside of the histogram */
+	double getOutsideWeight() const;
+
+	std::string getDescription() const;
+
+private:
+	enum AxisType {
+		LinearAxis, LogAxis, IdAxis, DirectionAxis
+	};
+	struct Axis {
+		Quantity quantity;
+		AxisType type;
+		size_t nBins;
+		double min, max;
+		std::vector<int> ids;
+	};
+
+	std::string filename;
+	std::vector<Axis> axes;
+	size_t nBins;
+	Pixelization *pixelization;
+	bool closed;
+	/// bins of each thread followed by the weight outside of the histogram
+	mutable std::vector<std::vector<double> *> threadBins;
+
+	void addAxis(const Axis &axis);
+	long binIndex(const Axis &axis, const Candidate *candidate) const;
+	std::vector<double> merge() const;
+	void writeNpy(const std::vector<double> &histogram) const;
+	void writeHDF5(const std::vector<double> &histogram) const;
+};
+
+/** @}*/
+} // namespace crpropa
+
+#endif // CRPROPA_HISTOGRAMOUTPUT_H
@@ -69,6 +69,11 @@ public:
 	 @param deactivate	if true, deactivate detected particles; if false, continue tracking them
 	 */
 	void setDeactivateOnDetection(bool deactivate);
+	/** State of the detection action, see Module::saveCheckpoint */
+	std::string saveCheckpoint();
+	void loadCheckpoint(const std::string &state);
+	size_t getBacklog() const;
+	void finishRun();
 };
 
 
@@ -246,10 +251,13 @@ public:
  @class ObserverTimeEvolution
  @brief Observes the time evolution of the candidates (phase-space elements)
  This observer is very useful if the time evolution of the particle density is needed. It detects all candidates in lin-spaced, log-spaced, or user-defined time intervals and limits the nextStep of candidates to prevent overshooting of detection intervals.
+ The times are kept in ascending order, the index of the next time of each candidate is kept in a slot of the candidate (see Candidate::allocateSlot).
+ A candidate is detected at most once per step; to record all times a long step has passed, use TimeSnapshotObserver.
  */
 class ObserverTimeEvolution: public ObserverFeature {
 private:
 	std::vector<double> detList;
+	size_t slot;
 public:
 	/** Default constructor
 	 */
@@ -267,7 +275,11 @@ public:
 	 @param log     log (input: true) or lin (input: false) scaling between min and max with numb steps
 	 */
 	ObserverTimeEvolution(double min, double max, double numb, bool log);
-	// Add a new time step to the detection time list of the observer
+	~ObserverTimeEvolution();
+	/** Not copyable, the slot is released by the destructor */
+	ObserverTimeEvolution(const ObserverTimeEvolution &) = delete;
+	ObserverTimeEvolution &operator=(const ObserverTimeEvolution &) = delete;
+	// Add a new time step to the detection time list of the observer, the list stays sorted
 	void addTime(const double &position);
 	// Using log or lin spacing of times in the range between min and
 	// max for observing particles
@@ -2,6 +2,7 @@
 #define CRPROPA_PARTICLECOLLECTOR_H
 #include <vector>
 #include <string>
+#include <stdint.h>
 
 #include "crpropa/Module.h"
 #include "crpropa/ModuleList.h"
@@ -13,6 +14,25 @@ namespace crpropa {
  * @{
  */
 
+/**
+ @struct CandidateRecord
+ @brief Flat copy of the state of a candidate, e.g. for the export to NumPy structured arrays
+
+ All quantities are given in SI units (Joule, meter).
+ Index 0 refers to the state at the source, index 1 to the state at creation.
+ */
+struct CandidateRecord {
+	double D; ///< trajectory length
+	double z; ///< redshift
+	double W; ///< weight
+	uint64_t SN, SN0, SN1; ///< serial numbers
+	int32_t ID, ID0, ID1; ///< particle ids
+	int32_t reserved; ///< explicit padding
+	double E, X, Y, Z, Px, Py, Pz;
+	double E0, X0, Y0, Z0, P0x, P0y, P0z;
+	double E1, X1, Y1, Z1, P1x, P1y, P1z;
+};
+
 /**
  @class ParticleCollector
  @brief A helper ouput mechanism to keep candidates in-memory and directly transfer them to Python
@@ -44,6 +64,13 @@ public:
 
 	std::string getDescription() const;
 	std::vector<ref_ptr<Candidate> >& getContainer() const;
+
+	/**
+	 Copy the state of all collected candidates into a contiguous array in a single loop.
+	 @param records	array with at least size() elements
+	 */
+	void getRecords(CandidateRecord *records) const;
+	std::vector<CandidateRecord> getRecords() const;
 	void setClone(bool b);
 	bool getClone() const;
 
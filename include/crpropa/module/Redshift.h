@@ -1,6 +1,7 @@
 #ifndef CRPROPA_REDSHIFT_H
 #define CRPROPA_REDSHIFT_H
 
+#include "crpropa/Cosmology.h"
 #include "crpropa/Module.h"
 
 namespace crpropa {
@@ -12,9 +13,17 @@ namespace crpropa {
 /**
  @class Redshift
  @brief Updates redshift and applies adiabatic energy loss according to the traveled distance.
+
+ Uses the given cosmology or, if none is set, the default cosmology.
  */
 class Redshift: public Module {
+private:
+	ref_ptr<Cosmology> cosmology;
 public:
+	Redshift(ref_ptr<Cosmology> cosmology = 0);
+	/** Cosmology to use instead of the default cosmology, 0 for the default */
+	void setCosmology(ref_ptr<Cosmology> cosmology);
+	ref_ptr<Cosmology> getCosmology() const;
 	void process(Candidate *candidate) const;
 	std::string getDescription() const;
 };
@@ -22,9 +31,17 @@ public:
 /**
  @class FutureRedshift
  @brief Updates redshift and applies adiabatic energy loss according to the traveled distance. Extends to negative redshift values to allow for symmetric time windows around z=0.
+
+ Uses the given cosmology or, if none is set, the default cosmology.
  */
 class FutureRedshift: public Module {
+private:
+	ref_ptr<Cosmology> cosmology;
 public:
+	FutureRedshift(ref_ptr<Cosmology> cosmology = 0);
+	/** Cosmology to use instead of the default cosmology, 0 for the default */
+	void setCosmology(ref_ptr<Cosmology> cosmology);
+	ref_ptr<Cosmology> getCosmology() const;
 	void process(Candidate *candidate) const;
 	std::string getDescription() const;
 };
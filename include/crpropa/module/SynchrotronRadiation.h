@@ -1,7 +1,10 @@
 #ifndef CRPROPA_SYNCHROTRONRADIATION_H
 #define CRPROPA_SYNCHROTRONRADIATION_H
 
+#include "crpropa/ContinuousLoss.h"
 #include "crpropa/Module.h"
+#include "crpropa/Random.h"
+#include "crpropa/WeightWindow.h"
 #include "crpropa/magneticField/MagneticField.h"
 
 namespace crpropa {
@@ -21,20 +24,30 @@ namespace crpropa {
  Note that the large number of secondary photons per propagation can cause memory problems.
  To mitigate this, use thinning. However, this still does not solve the problem completely.
  For this reason, a break-condition stops tracking secondary photons and reweights the current ones. 
+ Alternatively, the collective photon mode emits one weighted photon per energy bin and step.
  */
-class SynchrotronRadiation: public Module {
+class SynchrotronRadiation: public Module, public ContinuousLoss {
 private:
 	ref_ptr<MagneticField> field; ///< MagneticField instance
 	double Brms; ///< Brms value in case no MagneticField is specified
 	double limit; ///< fraction of energy loss length to limit the next step
 	double thinning; ///< thinning parameter for weighted-sampling (maximum 1, minimum 0)
+	ref_ptr<WeightWindow> weightWindow; ///< population control of the photons, replaces the thinning
 	bool havePhotons; ///< flag for production of secondary photons
 	int maximumSamples; ///< maximum number of samples of synchrotron photons (break condition; defaults to 100; 0 or <0 means no sampling)
 	double secondaryThreshold; ///< threshold energy for secondary photons
 	std::vector<double> tabx; ///< tabulated fraction E_photon/E_critical from 10^-6 to 10^2 in 801 log-spaced steps
 	std::vector<double> tabCDF; ///< tabulated CDF of synchrotron spectrum
+	std::vector<size_t> tabGuide; ///< guide table: first CDF index of each of tabCDF.size() equal intervals of the CDF
+	size_t collectivePhotons = 0; ///< number of energy bins of the collective photon mode, 0 if off
+	std::vector<double> collectiveX; ///< mean E_photon/E_critical of each collective bin
+	std::vector<double> collectiveEnergy; ///< fraction of the radiated energy in each collective bin
 	std::string interactionTag = "SYN";
 
+	void initCollectivePhotons();
+	/** Draw E_photon/E_critical from the tabulated spectrum in constant time */
+	double sampleX(Random &random) const;
+
 public:
 	/** Constructor
 	 @param field			magnetic field object
@@ -67,6 +80,13 @@ public:
 	 */
 	void setThinning(double thinning);
 
+	/** Population control that replaces the thinning where it has a target
+	 weight, see WeightWindow. The window may be shared by several modules.
+	 @param weightWindow	weight window, 0 to use only the thinning
+	 */
+	void setWeightWindow(ref_ptr<WeightWindow> weightWindow);
+	ref_ptr<WeightWindow> getWeightWindow() const;
+
 	/** Limit the propagation step to a fraction of the mean free path
 	 * @param limit fraction of the mean free path
 	 */
@@ -82,6 +102,14 @@ public:
 	 @param threshold	energy threshold above which photons will be added [in Joules]
 	 */
 	void setSecondaryThreshold(double threshold);	
+	/** Collective photon mode: instead of sampling individual photons, each
+	 step adds one photon per energy bin, weighted with the expected number of
+	 photons in the bin. Energy and number of the photons are conserved on
+	 average, the number of secondaries per step is at most nBins.
+	 Thinning and the maximum number of samples do not apply.
+	 @param nBins	number of logarithmic bins of E_photon/E_critical, 0 to sample individual photons (default)
+	 */
+	void setCollectivePhotons(size_t nBins);
 	void setInteractionTag(std::string tag);
 	ref_ptr<MagneticField> getField();
 
@@ -91,9 +119,13 @@ public:
 	double getLimit();
 	int getMaximumSamples();
 	double getSecondaryThreshold() const;
+	size_t getCollectivePhotons() const;
 	std::string getInteractionTag() const;
 
 	void initSpectrum();
+	/** Energy loss per comoving length in the RMS field; not available if a
+	 MagneticField is set, since the loss then depends on the position */
+	double getEnergyLossRate(int id, double energy, double z) const;
 	void process(Candidate *candidate) const;
 	std::string getDescription() const;
 };
@@ -1,10 +1,14 @@
 #ifndef CRPROPA_TEXTOUTPUT_H
 #define CRPROPA_TEXTOUTPUT_H
 
+#include "crpropa/Common.h"
 #include "crpropa/module/Output.h"
 #include "crpropa/module/ParticleCollector.h"
 
+#include <atomic>
 #include <fstream>
+#include <string>
+#include <vector>
 
 namespace crpropa {
 /**
@@ -25,8 +29,21 @@ protected:
 	std::ofstream outfile;
 	std::string filename;
 	bool storeRandomSeeds;
-	
+
+	/** Lines of one thread that have not been written yet */
+	struct alignas(64) LineBuffer { // no false sharing between threads
+		std::string data;
+		size_t lines;
+		std::atomic<size_t> backlog; // lines, published for getBacklog in other threads
+		LineBuffer() : lines(0), backlog(0) {}
+	};
+	mutable bool headerWritten;
+	size_t blockSize;
+	mutable std::vector<LineBuffer, CacheLineAllocator<LineBuffer> > buffers;
+
+	void open(bool resume);
 	void printHeader() const;
+	void writeBlock(LineBuffer &buffer) const;
 
 public:
 	/** Default constructor
@@ -52,8 +69,10 @@ public:
 	/** Constructor
 	 @param filename	string containing name of output text file
 	 @param outputType	type of output: Trajectory1D, Trajectory3D, Event1D, Event3D, Everything
+	 @param resume		keep the content of the file to resume a run from a checkpoint (see
+						ModuleList::resume), otherwise the file is truncated
 	 */
-	TextOutput(const std::string &filename, OutputType outputType);
+	TextOutput(const std::string &filename, OutputType outputType, bool resume = false);
 	/** Destructor
 	 */
 	~TextOutput();
@@ -63,6 +82,26 @@ public:
 	void enableRandomSeeds() {storeRandomSeeds = true;};
 	void close();
 	void gzip();
+	/** Write all buffered lines to the output stream.
+	 During a parallel run each thread collects its lines and writes them in
+	 blocks of about getBlockSize() bytes. Outside of parallel regions, every
+	 line is written immediately. The remaining lines are flushed at the end
+	 of each ModuleList::run (see finishRun) and by close().
+	 */
+	void flush();
+	/** Flushes the lines, see Module::finishRun */
+	void finishRun();
+	/** Size of the per-thread blocks in bytes, default 64 kB */
+	void setBlockSize(size_t bytes);
+	size_t getBlockSize() const;
+
+	/** Number of lines and size of the file, see Module::saveCheckpoint.
+	 Compressed files cannot be resumed. */
+	std::string saveCheckpoint();
+	/** Cut the file back to its size at the checkpoint and append to it */
+	void loadCheckpoint(const std::string &state);
+	/** Number of lines buffered by the threads */
+	size_t getBacklog() const;
 	void process(Candidate *candidate) const;
 	/** Loads a file to a particle collector.
 	 This is useful for analysis involving, e.g., magnetic lenses.
@@ -70,6 +109,13 @@ public:
 	 @param collector	object of type ParticleCollector that will store the information
 	 */
 	static void load(const std::string &filename, ParticleCollector *collector);
+	/** Concatenate the files of a sharded run, see ModuleList::runShard.
+	 The header of the first file is kept, all files need the same columns.
+	 Compressed (.gz) files are supported if CRPropa is built with zlib.
+	 @param shards		names of the files in the order of the shards
+	 @param filename	name of the merged file
+	 */
+	static void merge(const std::vector<std::string> &shards, const std::string &filename);
 	std::string getDescription() const;
 };
 /** @}*/
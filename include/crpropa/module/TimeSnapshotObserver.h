@@ -0,0 +1,125 @@
+#ifndef CRPROPA_TIMESNAPSHOTOBSERVER_H
+#define CRPROPA_TIMESNAPSHOTOBSERVER_H
+
+#include "crpropa/Module.h"
+
+#include <string>
+#include <vector>
+
+namespace crpropa {
+
+/**
+ * \addtogroup Observer
+ * @{
+ */
+
+/**
+ @class SnapshotStore
+ @brief Columnar store of the snapshots of a TimeSnapshotObserver
+
+ Each thread appends to its own columns. The columns of all threads are merged
+ and sorted by snapshot and serial number when they are requested, thus the
+ content does not depend on the number of threads.
+ Available columns: "snapshot" (index of the time), "time" (trajectory length
+ [m]), "serialNumber", "id", "energy" [J], "x", "y", "z" [m], "px", "py", "pz"
+ (direction) and "weight".
+ */
+class SnapshotStore: public Referenced {
+public:
+	SnapshotStore();
+	~SnapshotStore();
+
+	/** Append a row for the given snapshot, the other values are taken from
+	 the current state of the candidate */
+	void add(size_t snapshot, double time, const Candidate *candidate,
+			const Vector3d &position);
+
+	/** Number of rows */
+	size_t size() const;
+	void clear();
+	/** Names of all columns */
+	std::vector<std::string> getColumnNames() const;
+	/** Merged column, serial numbers are exact up to 2^53 */
+	std::vector<double> getColumn(const std::string &name) const;
+	/** Write all rows as text file with one column per quantity, lengths in
+	 Mpc and energies in EeV */
+	void write(const std::string &filename) const;
+
+private:
+	struct Columns {
+		std::vector<size_t> snapshot;
+		std::vector<double> time;
+		std::vector<uint64_t> serialNumber;
+		std::vector<int> id;
+		std::vector<double> energy;
+		std::vector<Vector3d> position;
+		std::vector<Vector3d> direction;
+		std::vector<double> weight;
+		size_t size() const {
+			return snapshot.size();
+		}
+	};
+
+	/// columns of each thread, allocated by the thread
+	mutable std::vector<Columns *> threadColumns;
+	/// sorted rows of all threads, updated when the columns are requested
+	mutable Columns merged;
+
+	void merge() const;
+};
+
+/**
+ @class TimeSnapshotObserver
+ @brief Records the candidates at given trajectory lengths (times) in a SnapshotStore
+
+ Unlike Observer with ObserverTimeEvolution, all times a candidate passed in
+ a step are recorded, with the position interpolated linearly between the
+ start and the end of the step. A step records the times in (start, end];
+ a time at the end of a step is thus recorded once, also if a secondary
+ starts there. Only the first step of a primary includes its start. The other values are taken from the end of
+ the step. The rows are written directly into the store instead of cloning
+ the candidate for a detection action.
+ The index of the next time of each candidate is kept in a slot of the
+ candidate (see Candidate::allocateSlot); the times are searched only for
+ candidates that were not seen before, e.g. candidates starting with a
+ trajectory length larger than zero.
+ Place it after the propagation module.
+ */
+class TimeSnapshotObserver: public Module {
+public:
+	/**
+	 @param store	store for the snapshots, a new one is created if 0
+	 */
+	TimeSnapshotObserver(SnapshotStore *store = 0);
+	~TimeSnapshotObserver();
+	/** Not copyable, the slot is released by the destructor */
+	TimeSnapshotObserver(const TimeSnapshotObserver &) = delete;
+	TimeSnapshotObserver &operator=(const TimeSnapshotObserver &) = delete;
+
+	/** Add a time (trajectory length), the times are kept sorted */
+	void addTime(double time);
+	/** Add numb times between min and max with lin or log spacing, see ObserverTimeEvolution */
+	void addTimeRange(double min, double max, double numb, bool log = false);
+	const std::vector<double> &getTimes() const;
+
+	/** Limit the next step to the next time, default true. Without the limit,
+	 long steps record several times at once with interpolated positions. */
+	void setLimitStep(bool limit);
+	bool getLimitStep() const;
+
+	SnapshotStore *getStore() const;
+
+	void process(Candidate *candidate) const;
+	std::string getDescription() const;
+
+private:
+	std::vector<double> times;
+	ref_ptr<SnapshotStore> store;
+	size_t slot;
+	bool limitStep;
+};
+
+/** @}*/
+} // namespace crpropa
+
+#endif // CRPROPA_TIMESNAPSHOTOBSERVER_H
@@ -18,6 +18,9 @@ namespace crpropa {
  @brief Module to monitor the simulation performance
 
  Add modules under investigation to this module instead of the ModuleList.
+ The time is measured in a critical section and reported when the module is
+ destroyed. For profiling a whole simulation with little overhead, see
+ ModuleList::setProfiling.
  */
 class PerformanceModule: public Module {
 private:
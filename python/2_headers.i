@@ -171,10 +171,23 @@ using namespace crpropa;   // for usage of namespace in header files, necessary
 %include "crpropa/Referenced.h"
 %include "crpropa/Units.h"
 %include "crpropa/Common.h"
+%implicitconv crpropa::ref_ptr<crpropa::Cosmology>;
+%template(CosmologyRefPtr) crpropa::ref_ptr<crpropa::Cosmology>;
+%ignore crpropa::Cosmology::comovingDistance2Redshift(const double *, double *, size_t) const;
+%ignore crpropa::Cosmology::redshift2ComovingDistance(const double *, double *, size_t) const;
+%ignore crpropa::Cosmology::luminosityDistance2Redshift(const double *, double *, size_t) const;
+%ignore crpropa::Cosmology::redshift2LuminosityDistance(const double *, double *, size_t) const;
+%ignore crpropa::Cosmology::lightTravelDistance2Redshift(const double *, double *, size_t) const;
+%ignore crpropa::Cosmology::redshift2LightTravelDistance(const double *, double *, size_t) const;
 %include "crpropa/Cosmology.h"
+
+%template(WeightWindowRefPtr) crpropa::ref_ptr<crpropa::WeightWindow>;
+%include "crpropa/WeightWindow.h"
 %template(RandomSeed) std::vector<uint32_t>;
 %template(RandomSeedThreads) std::vector< std::vector<uint32_t> >;
+%template(StringVector) std::vector<std::string>;
 %include "crpropa/Random.h"
+%include "crpropa/Expression.h"
 %include "crpropa/ParticleState.h"
 %include "crpropa/ParticleID.h"
 %include "crpropa/ParticleMass.h"
@@ -464,6 +477,31 @@ using namespace crpropa;   // for usage of namespace in header files, necessary
 %feature("director") crpropa::Observer;
 %feature("director") crpropa::ObserverFeature;
 %include "crpropa/module/Observer.h"
+%include "crpropa/module/TimeSnapshotObserver.h"
+
+%nothread;
+#ifdef WITHNUMPY
+%extend crpropa::SnapshotStore {
+  PyObject *getArray(const std::string &name) {
+    std::vector<double> column = $self->getColumn(name);
+    npy_intp dims[1] = {(npy_intp) column.size()};
+    PyObject *out = PyArray_SimpleNew(1, dims, NPY_DOUBLE);
+    if (out == NULL)
+      return NULL;
+    if (!column.empty())
+      std::copy(column.begin(), column.end(), (double *) PyArray_DATA((PyArrayObject *) out));
+    return out;
+  }
+};
+#else
+%extend crpropa::SnapshotStore {
+  PyObject *getArray(const std::string &name) {
+      std::cerr << "ERROR: CRPropa was compiled without NumPy support!" << std::endl;
+      Py_RETURN_NONE;
+  }
+};
+#endif
+%thread;
 %include "crpropa/module/SimplePropagation.h"
 %include "crpropa/module/PropagationCK.h"
 %include "crpropa/module/PropagationBP.h"
@@ -546,19 +584,53 @@ using namespace crpropa;   // for usage of namespace in header files, necessary
 
 %include "crpropa/module/HDF5Output.h"
 %include "crpropa/module/OutputShell.h"
+%include "crpropa/module/HistogramOutput.h"
+
+%nothread;
+#ifdef WITHNUMPY
+%extend crpropa::HistogramOutput {
+  PyObject *getArray() {
+    std::vector<size_t> shape = $self->getShape();
+    std::vector<npy_intp> dims(shape.begin(), shape.end());
+    PyObject *out = PyArray_SimpleNew(dims.size(), dims.empty() ? NULL : &dims[0], NPY_DOUBLE);
+    if (out == NULL)
+      return NULL;
+    std::vector<double> histogram = $self->getHistogram();
+    if (!histogram.empty())
+      std::copy(histogram.begin(), histogram.end(), (double *) PyArray_DATA((PyArrayObject *) out));
+    return out;
+  }
+};
+#else
+%extend crpropa::HistogramOutput {
+  PyObject *getArray() {
+      std::cerr << "ERROR: CRPropa was compiled without NumPy support!" << std::endl;
+      Py_RETURN_NONE;
+  }
+};
+#endif
+%thread;
 %include "crpropa/module/PhotonOutput1D.h"
 %include "crpropa/module/NuclearDecay.h"
+%include "crpropa/ContinuousLoss.h"
 %include "crpropa/module/ElectronPairProduction.h"
 %include "crpropa/module/PhotoPionProduction.h"
 %include "crpropa/module/PhotoDisintegration.h"
 %include "crpropa/module/ElasticScattering.h"
 %include "crpropa/module/Redshift.h"
 %include "crpropa/module/RestrictToRegion.h"
+%include "crpropa/CascadeInteraction.h"
 %include "crpropa/module/EMPairProduction.h"
 %include "crpropa/module/EMDoublePairProduction.h"
 %include "crpropa/module/EMTripletPairProduction.h"
 %include "crpropa/module/EMInverseComptonScattering.h"
+%template(PhotonFieldVector) std::vector< crpropa::ref_ptr<crpropa::PhotonField> >;
+%ignore crpropa::TableRegistry::getRateTable;
+%ignore crpropa::TableRegistry::getRedshiftRateTable;
+%ignore crpropa::TableRegistry::getCumulativeRateTable;
+%include "crpropa/TableRegistry.h"
 %include "crpropa/module/SynchrotronRadiation.h"
+%include "crpropa/module/EventPropagation1D.h"
 %include "crpropa/module/AdiabaticCooling.h"
 %include "crpropa/module/MomentumDiffusion.h"
 %include "crpropa/module/CandidateSplitting.h"
@@ -570,8 +642,64 @@ using namespace crpropa;   // for usage of namespace in header files, necessary
 %feature("director") crpropa::SourceInterface;
 %template(SourceFeatureRefPtr) crpropa::ref_ptr<crpropa::SourceFeature>;
 %feature("director") crpropa::SourceFeature;
+%ignore crpropa::SourceFromArrays::setArrays;
 %include "crpropa/Source.h"
 
+%nothread;
+#ifdef WITHNUMPY
+%extend crpropa::SourceFromArrays {
+  PyObject *addArrays(PyObject *ids, PyObject *energies, PyObject *positions,
+      PyObject *directions, PyObject *weights = NULL) {
+    int flags = NPY_ARRAY_IN_ARRAY | NPY_ARRAY_FORCECAST;
+    PyArrayObject *id_arr = (PyArrayObject *) PyArray_FROMANY(ids, NPY_INT, 1, 1, flags);
+    PyArrayObject *e_arr = (PyArrayObject *) PyArray_FROMANY(energies, NPY_DOUBLE, 1, 1, flags);
+    PyArrayObject *x_arr = (PyArrayObject *) PyArray_FROMANY(positions, NPY_DOUBLE, 2, 2, flags);
+    PyArrayObject *p_arr = (PyArrayObject *) PyArray_FROMANY(directions, NPY_DOUBLE, 2, 2, flags);
+    PyArrayObject *w_arr = NULL;
+    if ((weights != NULL) && (weights != Py_None))
+      w_arr = (PyArrayObject *) PyArray_FROMANY(weights, NPY_DOUBLE, 1, 1, flags);
+
+    bool valid = id_arr && e_arr && x_arr && p_arr
+        && ((weights == NULL) || (weights == Py_None) || w_arr);
+    npy_intp n = valid ? PyArray_DIM(id_arr, 0) : 0;
+    if (valid) {
+      valid = (PyArray_DIM(e_arr, 0) == n)
+          && (PyArray_DIM(x_arr, 0) == n) && (PyArray_DIM(x_arr, 1) == 3)
+          && (PyArray_DIM(p_arr, 0) == n) && (PyArray_DIM(p_arr, 1) == 3)
+          && ((w_arr == NULL) || (PyArray_DIM(w_arr, 0) == n));
+      if (valid)
+        $self->setArrays(n, (const int *) PyArray_DATA(id_arr),
+            (const double *) PyArray_DATA(e_arr),
+            (const double *) PyArray_DATA(x_arr),
+            (const double *) PyArray_DATA(p_arr),
+            w_arr ? (const double *) PyArray_DATA(w_arr) : NULL);
+      else
+        PyErr_SetString(PyExc_ValueError, "SourceFromArrays.addArrays: "
+            "require arrays of length n for ids, energies (and weights) "
+            "and of shape (n, 3) for positions and directions");
+    }
+
+    Py_XDECREF(id_arr);
+    Py_XDECREF(e_arr);
+    Py_XDECREF(x_arr);
+    Py_XDECREF(p_arr);
+    Py_XDECREF(w_arr);
+    if (!valid)
+      return NULL;
+    Py_RETURN_TRUE;
+  }
+};
+#else
+%extend crpropa::SourceFromArrays {
+  PyObject *addArrays(PyObject *ids, PyObject *energies, PyObject *positions,
+      PyObject *directions, PyObject *weights = NULL) {
+      std::cerr << "ERROR: CRPropa was compiled without NumPy support!" << std::endl;
+      Py_RETURN_NONE;
+  }
+};
+#endif
+%thread;
+
 %inline %{
 class ModuleListIterator {
   public:
@@ -613,8 +741,54 @@ class ModuleListIterator {
   }
 };
 
+/* ModuleList::run releases the global interpreter lock for the whole OpenMP
+ * loop (threads="1" of the module). Modules and source features implemented
+ * in Python reacquire it in their directors, which ModuleList detects
+ * through the registered check. */
+
+%{
+static bool crpropa_isDirector(const crpropa::Referenced *object) {
+  return dynamic_cast<const Swig::Director *>(object) != 0;
+}
+%}
+
+%init %{
+crpropa::ModuleList::setDirectorCheck(&crpropa_isDirector);
+%}
+
+%include "crpropa/ModuleProfile.h"
+%template(ModuleProfileVector) std::vector<crpropa::ModuleProfile>;
+%feature("director") crpropa::TelemetryCallback;
+%include "crpropa/RunTelemetry.h"
 %template(ModuleListRefPtr) crpropa::ref_ptr<crpropa::ModuleList>;
 %include "crpropa/ModuleList.h"
+%include "crpropa/CascadeSolver1D.h"
+%include "crpropa/SweepRunner.h"
+
+%nothread;
+#ifdef WITHNUMPY
+%extend crpropa::CascadeSolver1D {
+  PyObject *getSpectrumArray(int id) {
+    std::vector<double> spectrum = $self->getSpectrum(id);
+    npy_intp dims[1] = {(npy_intp) spectrum.size()};
+    PyObject *out = PyArray_SimpleNew(1, dims, NPY_DOUBLE);
+    if (out == NULL)
+      return NULL;
+    std::copy(spectrum.begin(), spectrum.end(), (double *) PyArray_DATA((PyArrayObject *) out));
+    return out;
+  }
+  PyObject *getEnergyArray() {
+    std::vector<double> energies = $self->getEnergies();
+    npy_intp dims[1] = {(npy_intp) energies.size()};
+    PyObject *out = PyArray_SimpleNew(1, dims, NPY_DOUBLE);
+    if (out == NULL)
+      return NULL;
+    std::copy(energies.begin(), energies.end(), (double *) PyArray_DATA((PyArrayObject *) out));
+    return out;
+  }
+};
+#endif
+%thread;
 
 %template(ParticleCollectorRefPtr) crpropa::ref_ptr<crpropa::ParticleCollector>;
 
@@ -683,14 +857,105 @@ class ParticleCollectorIterator {
   }
 };
 
+%ignore crpropa::ParticleCollector::getRecords;
 %include "crpropa/module/ParticleCollector.h"
 
+/* Export of collected candidates and import of source particles as NumPy
+ * arrays. The Python C-API is used, thus the interpreter lock is kept. */
+%nothread;
+#ifdef WITHNUMPY
+%{
+static void crpropa_appendRecordField(PyObject *names, PyObject *formats,
+    PyObject *offsets, const char *name, const char *format, size_t offset) {
+  PyObject *o = PyUnicode_FromString(name);
+  PyList_Append(names, o);
+  Py_DECREF(o);
+  o = PyUnicode_FromString(format);
+  PyList_Append(formats, o);
+  Py_DECREF(o);
+  o = PyLong_FromSize_t(offset);
+  PyList_Append(offsets, o);
+  Py_DECREF(o);
+}
+
+static PyArray_Descr *crpropa_candidateRecordDescr() {
+  PyObject *names = PyList_New(0);
+  PyObject *formats = PyList_New(0);
+  PyObject *offsets = PyList_New(0);
+#define CRPROPA_RECORD_FIELD(field, format) \
+  crpropa_appendRecordField(names, formats, offsets, #field, format, \
+      offsetof(crpropa::CandidateRecord, field))
+  CRPROPA_RECORD_FIELD(D, "f8");
+  CRPROPA_RECORD_FIELD(z, "f8");
+  CRPROPA_RECORD_FIELD(W, "f8");
+  CRPROPA_RECORD_FIELD(SN, "u8");
+  CRPROPA_RECORD_FIELD(SN0, "u8");
+  CRPROPA_RECORD_FIELD(SN1, "u8");
+  CRPROPA_RECORD_FIELD(ID, "i4");
+  CRPROPA_RECORD_FIELD(ID0, "i4");
+  CRPROPA_RECORD_FIELD(ID1, "i4");
+  CRPROPA_RECORD_FIELD(E, "f8");
+  CRPROPA_RECORD_FIELD(X, "f8");
+  CRPROPA_RECORD_FIELD(Y, "f8");
+  CRPROPA_RECORD_FIELD(Z, "f8");
+  CRPROPA_RECORD_FIELD(Px, "f8");
+  CRPROPA_RECORD_FIELD(Py, "f8");
+  CRPROPA_RECORD_FIELD(Pz, "f8");
+  CRPROPA_RECORD_FIELD(E0, "f8");
+  CRPROPA_RECORD_FIELD(X0, "f8");
+  CRPROPA_RECORD_FIELD(Y0, "f8");
+  CRPROPA_RECORD_FIELD(Z0, "f8");
+  CRPROPA_RECORD_FIELD(P0x, "f8");
+  CRPROPA_RECORD_FIELD(P0y, "f8");
+  CRPROPA_RECORD_FIELD(P0z, "f8");
+  CRPROPA_RECORD_FIELD(E1, "f8");
+  CRPROPA_RECORD_FIELD(X1, "f8");
+  CRPROPA_RECORD_FIELD(Y1, "f8");
+  CRPROPA_RECORD_FIELD(Z1, "f8");
+  CRPROPA_RECORD_FIELD(P1x, "f8");
+  CRPROPA_RECORD_FIELD(P1y, "f8");
+  CRPROPA_RECORD_FIELD(P1z, "f8");
+#undef CRPROPA_RECORD_FIELD
+  PyObject *spec = Py_BuildValue("{s:N,s:N,s:N,s:n}", "names", names,
+      "formats", formats, "offsets", offsets, "itemsize",
+      (Py_ssize_t) sizeof(crpropa::CandidateRecord));
+  PyArray_Descr *descr = NULL;
+  PyArray_DescrConverter(spec, &descr);
+  Py_DECREF(spec);
+  return descr;
+}
+%}
+
+%extend crpropa::ParticleCollector {
+  PyObject *getRecords() {
+    PyArray_Descr *descr = crpropa_candidateRecordDescr();
+    if (descr == NULL)
+      return NULL;
+    npy_intp size = $self->size();
+    PyObject *out = PyArray_NewFromDescr(&PyArray_Type, descr, 1, &size, NULL,
+        NULL, 0, NULL);
+    if ((out != NULL) && (size > 0))
+      $self->getRecords((crpropa::CandidateRecord *) PyArray_DATA((PyArrayObject *) out));
+    return out;
+  }
+};
+#else
+%extend crpropa::ParticleCollector {
+  PyObject *getRecords() {
+      std::cerr << "ERROR: CRPropa was compiled without NumPy support!" << std::endl;
+      Py_RETURN_NONE;
+  }
+};
+#endif
+%thread;
+
 %include "crpropa/massDistribution/Density.h"
 %include "crpropa/massDistribution/Nakanishi.h"
 %include "crpropa/massDistribution/Cordes.h"
 %include "crpropa/massDistribution/Ferriere.h"
 %include "crpropa/massDistribution/Massdistribution.h"
 %include "crpropa/massDistribution/ConstantDensity.h"
+%include "crpropa/massDistribution/ExpressionDensity.h"
 
 
 
@@ -1,44 +1,108 @@
 #include "crpropa/Candidate.h"
+#include "crpropa/Common.h"
 #include "crpropa/ParticleID.h"
 #include "crpropa/Units.h"
 
+#include "kiss/logger.h"
+
+#include <atomic>
 #include <stdexcept>
 
-namespace crpropa {
+#ifdef _OPENMP
+#include <omp.h>
+#endif
 
-Candidate::Candidate(int id, double E, Vector3d pos, Vector3d dir, double z, double weight, std::string tagOrigin) :
-  redshift(z), trajectoryLength(0), weight(weight), currentStep(0), nextStep(0), active(true), parent(0), tagOrigin(tagOrigin) {
-	ParticleState state(id, E, pos, dir);
-	source = state;
-	created = state;
-	previous = state;
-	current = state;
+namespace crpropa {
 
-#if defined(OPENMP_3_1)
-		#pragma omp atomic capture
-		{serialNumber = nextSerialNumber++;}
-#elif defined(__GNUC__)
-		{serialNumber = __sync_add_and_fetch(&nextSerialNumber, 1);}
+static bool inParallel() {
+#ifdef _OPENMP
+	return omp_in_parallel();
 #else
-		#pragma omp critical
-		{serialNumber = nextSerialNumber++;}
+	return false;
 #endif
+}
+
+/** Serial numbers of one thread: the range reserved with
+ setThreadSerialNumberRange and the block taken from the shared counter */
+struct alignas(64) SerialNumberRange { // no false sharing between threads
+	uint64_t first;
+	uint64_t next;
+	uint64_t end;
+	uint64_t blockNext;
+	uint64_t blockEnd;
+	uint64_t blockGeneration;
+};
+
+static SerialNumberRange serialNumberRanges[MAX_THREAD];
+static uint64_t serialNumberBlockSize = 256;
+/// incremented by setNextSerialNumber to invalidate the blocks of all threads
+static uint64_t serialNumberGeneration = 0;
+/// set when the first range is used up
+static std::atomic<bool> serialNumberRangeExhausted(false);
 
+Candidate::Candidate(int id, double E, Vector3d pos, Vector3d dir, double z, double weight, const std::string &tagOrigin) :
+		source(id, E, pos, dir), created(source), current(source), previous(source),
+		redshift(z), trajectoryLength(0), weight(weight), currentStep(0), nextStep(0), active(true), parent(0), tagOrigin(tagOrigin) {
+	serialNumber = fetchSerialNumber();
 }
 
 Candidate::Candidate(const ParticleState &state) :
 		source(state), created(state), current(state), previous(state), redshift(0), trajectoryLength(0), currentStep(0), nextStep(0), active(true), parent(0), tagOrigin ("PRIM") {
+	serialNumber = fetchSerialNumber();
+}
+
+Candidate::Candidate(Candidate *parent, int id, double energy, double w, const std::string &tagOrigin) :
+		source(parent->source), created(parent->previous), current(parent->current), previous(parent->previous),
+		properties(parent->properties), slots(parent->slots), parent(parent), active(true), weight(parent->weight * w),
+		redshift(parent->redshift), trajectoryLength(parent->trajectoryLength), currentStep(0), nextStep(0), tagOrigin(tagOrigin) {
+	// setId involves a mass and charge lookup, skip it if the id is unchanged
+	if (id != current.getId())
+		current.setId(id);
+	current.setEnergy(energy);
+	serialNumber = fetchSerialNumber();
+}
 
+/** Add n to the shared counter and return the new value */
+uint64_t Candidate::addToNextSerialNumber(uint64_t n) {
+	uint64_t snr;
 #if defined(OPENMP_3_1)
 		#pragma omp atomic capture
-		{serialNumber = nextSerialNumber++;}
+		{nextSerialNumber += n; snr = nextSerialNumber;}
 #elif defined(__GNUC__)
-		{serialNumber = __sync_add_and_fetch(&nextSerialNumber, 1);}
+		{snr = __sync_add_and_fetch(&nextSerialNumber, n);}
 #else
 		#pragma omp critical
-		{serialNumber = nextSerialNumber++;}
+		{nextSerialNumber += n; snr = nextSerialNumber;}
 #endif
+	return snr;
+}
+
+uint64_t Candidate::fetchSerialNumber() {
+	SerialNumberRange &range = serialNumberRanges[threadIndex()];
+	if (range.end != 0) {
+		if (range.next != range.end)
+			return range.next++;
+		// continue with the shared counter, which is above all ranges
+		if (!serialNumberRangeExhausted.exchange(true)) {
+			KISS_LOG_WARNING << "crpropa::Candidate: a primary used up its " << range.end - range.first
+					<< " serial numbers, the further numbers are not reproducible."
+					" Increase ModuleList::setSerialNumbersPerPrimary.";
+		}
+	}
 
+	// in parallel regions each thread takes a block of numbers at once,
+	// so that the threads do not contend for the shared counter
+	if ((serialNumberBlockSize > 1) && inParallel()) {
+		if ((range.blockNext == range.blockEnd) || (range.blockGeneration != serialNumberGeneration)) {
+			uint64_t last = addToNextSerialNumber(serialNumberBlockSize);
+			range.blockNext = last - serialNumberBlockSize + 1;
+			range.blockEnd = last + 1;
+			range.blockGeneration = serialNumberGeneration;
+		}
+		return range.blockNext++;
+	}
+
+	return addToNextSerialNumber(1);
 }
 
 bool Candidate::isActive() const {
@@ -132,47 +196,56 @@ bool Candidate::hasProperty(const std::string &name) const {
 	return true;
 }
 
+// slots returned by releaseSlot, reused before new slots are taken
+static std::vector<size_t> &releasedSlots() {
+	static std::vector<size_t> released;
+	return released;
+}
+
+size_t Candidate::allocateSlot() {
+	static size_t nextSlot = 0;
+	size_t slot;
+#pragma omp critical(allocateSlot)
+	{
+		std::vector<size_t> &released = releasedSlots();
+		if (released.empty()) {
+			slot = nextSlot++;
+		} else {
+			slot = released.back();
+			released.pop_back();
+		}
+	}
+	return slot;
+}
+
+void Candidate::releaseSlot(size_t slot) {
+#pragma omp critical(allocateSlot)
+	releasedSlots().push_back(slot);
+}
+
+uint64_t Candidate::getSlot(size_t slot) const {
+	return (slot < slots.size()) ? slots[slot] : 0;
+}
+
+void Candidate::setSlot(size_t slot, uint64_t value) {
+	if (slot >= slots.size())
+		slots.resize(slot + 1, 0);
+	slots[slot] = value;
+}
+
 void Candidate::addSecondary(Candidate *c) {
 	secondaries.push_back(c);
 }
 
-void Candidate::addSecondary(int id, double energy, double w, std::string tagOrigin) {
-	ref_ptr<Candidate> secondary = new Candidate;
-	secondary->setRedshift(redshift);
-	secondary->setTrajectoryLength(trajectoryLength);
-	secondary->setWeight(weight * w);
-	secondary->setTagOrigin(tagOrigin);
-	for (PropertyMap::const_iterator it = properties.begin(); it != properties.end(); ++it) {
-		secondary->setProperty(it->first, it->second);		
-	}
-	secondary->source = source;
-	secondary->previous = previous;
-	secondary->created = previous;
-	secondary->current = current;
-	secondary->current.setId(id);
-	secondary->current.setEnergy(energy);
-	secondary->parent = this;
-	secondaries.push_back(secondary);
+void Candidate::addSecondary(int id, double energy, double w, const std::string &tagOrigin) {
+	secondaries.push_back(new Candidate(this, id, energy, w, tagOrigin));
 }
 
-void Candidate::addSecondary(int id, double energy, Vector3d position, double w, std::string tagOrigin) {
-	ref_ptr<Candidate> secondary = new Candidate;
-	secondary->setRedshift(redshift);
+void Candidate::addSecondary(int id, double energy, Vector3d position, double w, const std::string &tagOrigin) {
+	ref_ptr<Candidate> secondary = new Candidate(this, id, energy, w, tagOrigin);
 	secondary->setTrajectoryLength(trajectoryLength - (current.getPosition() - position).getR());
-	secondary->setWeight(weight * w);
-	secondary->setTagOrigin(tagOrigin);
-	for (PropertyMap::const_iterator it = properties.begin(); it != properties.end(); ++it) {
-		secondary->setProperty(it->first, it->second);		
-	}
-	secondary->source = source;
-	secondary->previous = previous;
-	secondary->created = previous;
-	secondary->current = current;
-	secondary->current.setId(id);
-	secondary->current.setEnergy(energy);
 	secondary->current.setPosition(position);
 	secondary->created.setPosition(position);
-	secondary->parent = this;
 	secondaries.push_back(secondary);
 }
 
@@ -196,6 +269,7 @@ ref_ptr<Candidate> Candidate::clone(bool recursive) const {
 	cloned->previous = previous;
 
 	cloned->properties = properties;
+	cloned->slots = slots;
 	cloned->active = active;
 	cloned->redshift = redshift;
 	cloned->weight = weight;
@@ -237,12 +311,41 @@ uint64_t Candidate::getCreatedSerialNumber() const {
 
 void Candidate::setNextSerialNumber(uint64_t snr) {
 	nextSerialNumber = snr;
+	serialNumberGeneration++;
 }
 
 uint64_t Candidate::getNextSerialNumber() {
 	return nextSerialNumber;
 }
 
+void Candidate::setThreadSerialNumberRange(uint64_t first, uint64_t n) {
+	if (first + n < first)
+		throw std::runtime_error("crpropa::Candidate: serial number range overflows");
+	SerialNumberRange &range = serialNumberRanges[threadIndex()];
+	range.first = first;
+	range.next = first;
+	range.end = (n == 0) ? 0 : first + n;
+}
+
+void Candidate::reserveSerialNumberRanges(uint64_t count, uint64_t n) {
+	if ((n > 0) && (count > UINT64_MAX / n))
+		throw std::runtime_error("crpropa::Candidate: not enough serial numbers for all primaries, "
+				"reduce the serial numbers per primary");
+	if (nextSerialNumber < count * n)
+		setNextSerialNumber(count * n);
+}
+
+void Candidate::setSerialNumberBlockSize(uint64_t n) {
+	if (n == 0)
+		throw std::runtime_error("crpropa::Candidate: the serial number block size must be at least 1");
+	serialNumberBlockSize = n;
+	serialNumberGeneration++;
+}
+
+uint64_t Candidate::getSerialNumberBlockSize() {
+	return serialNumberBlockSize;
+}
+
 uint64_t Candidate::nextSerialNumber = 0;
 
 void Candidate::restart() {
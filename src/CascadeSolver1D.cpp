@@ -0,0 +1,334 @@
+#include "crpropa/CascadeSolver1D.h"
+#include "crpropa/Cosmology.h"
+#include "crpropa/ModuleList.h"
+#include "crpropa/Units.h"
+#include "crpropa/module/Redshift.h"
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+namespace crpropa {
+
+static const size_t nSpecies = 3;
+static const int speciesId[nSpecies] = {22, 11, -11};
+
+CascadeSolver1D::CascadeSolver1D(double minEnergy, double maxEnergy, size_t nBins) :
+		minEnergy(minEnergy), maxEnergy(maxEnergy), nBins(nBins), samples(1000),
+		step(0.1 * Mpc), redshiftStep(0.05), redshiftLosses(false),
+		spectrum(nSpecies * nBins, 0), transferRedshift(-1) {
+	if ((nBins == 0) or (minEnergy <= 0) or (maxEnergy <= minEnergy))
+		throw std::runtime_error("CascadeSolver1D: invalid energy grid");
+	logStep = log(maxEnergy / minEnergy) / nBins;
+}
+
+bool CascadeSolver1D::add(Module *module) {
+	ModuleList *list = dynamic_cast<ModuleList *>(module);
+	if (list) {
+		bool used = false;
+		for (ModuleList::iterator i = list->begin(); i != list->end(); i++)
+			used |= add(*i);
+		return used;
+	}
+
+	Redshift *redshift = dynamic_cast<Redshift *>(module);
+	if (redshift) {
+		redshiftLosses = true;
+		if (not cosmology.valid())
+			cosmology = redshift->getCosmology();
+		transferRedshift = -1;
+		return true;
+	}
+
+	const CascadeInteraction *interaction = dynamic_cast<const CascadeInteraction *>(module);
+	if (interaction == 0)
+		return false;
+	Interaction i;
+	i.module = module;
+	i.interaction = interaction;
+	interactions.push_back(i);
+	transferRedshift = -1;
+	return true;
+}
+
+void CascadeSolver1D::setSamples(size_t samples) {
+	if (samples == 0)
+		throw std::runtime_error("CascadeSolver1D: at least one sample per bin needed");
+	this->samples = samples;
+	transferRedshift = -1;
+}
+
+size_t CascadeSolver1D::getSamples() const {
+	return samples;
+}
+
+void CascadeSolver1D::setStep(double step) {
+	if (step <= 0)
+		throw std::runtime_error("CascadeSolver1D: step must be positive");
+	this->step = step;
+}
+
+double CascadeSolver1D::getStep() const {
+	return step;
+}
+
+void CascadeSolver1D::setRedshiftStep(double redshiftStep) {
+	this->redshiftStep = redshiftStep;
+}
+
+double CascadeSolver1D::getRedshiftStep() const {
+	return redshiftStep;
+}
+
+void CascadeSolver1D::setRedshiftLosses(bool redshiftLosses) {
+	this->redshiftLosses = redshiftLosses;
+	transferRedshift = -1;
+}
+
+bool CascadeSolver1D::getRedshiftLosses() const {
+	return redshiftLosses;
+}
+
+void CascadeSolver1D::setCosmology(ref_ptr<Cosmology> cosmology) {
+	this->cosmology = cosmology;
+	transferRedshift = -1;
+}
+
+ref_ptr<Cosmology> CascadeSolver1D::getCosmology() const {
+	return cosmology;
+}
+
+size_t CascadeSolver1D::species(int id) const {
+	for (size_t s = 0; s < nSpecies; s++)
+		if (speciesId[s] == id)
+			return s;
+	throw std::runtime_error("CascadeSolver1D: only photons, electrons and positrons are supported");
+}
+
+double CascadeSolver1D::binCenter(size_t bin) const {
+	return minEnergy * exp((bin + 0.5) * logStep);
+}
+
+size_t CascadeSolver1D::binFromEnergy(double energy) const {
+	if ((energy < minEnergy) or (energy >= maxEnergy))
+		return nBins;
+	return std::min(size_t(log(energy / minEnergy) / logStep), nBins - 1);
+}
+
+size_t CascadeSolver1D::targetBin(double energy, size_t bin) const {
+	// energies cannot increase, rounding to a higher bin is kept in the bin
+	if (energy >= minEnergy * exp((bin + 1) * logStep))
+		return bin;
+	return binFromEnergy(energy);
+}
+
+void CascadeSolver1D::inject(int id, double energy, double weight) {
+	size_t s = species(id);
+	size_t bin = binFromEnergy(energy);
+	if (bin < nBins)
+		spectrum[s * nBins + bin] += weight;
+}
+
+void CascadeSolver1D::clear() {
+	std::fill(spectrum.begin(), spectrum.end(), 0.);
+}
+
+std::vector<double> CascadeSolver1D::getEnergies() const {
+	std::vector<double> energies(nBins);
+	for (size_t i = 0; i < nBins; i++)
+		energies[i] = binCenter(i);
+	return energies;
+}
+
+std::vector<double> CascadeSolver1D::getBinEdges() const {
+	std::vector<double> edges(nBins + 1);
+	for (size_t i = 0; i <= nBins; i++)
+		edges[i] = minEnergy * exp(i * logStep);
+	return edges;
+}
+
+std::vector<double> CascadeSolver1D::getSpectrum(int id) const {
+	size_t s = species(id);
+	return std::vector<double>(spectrum.begin() + s * nBins,
+			spectrum.begin() + (s + 1) * nBins);
+}
+
+void CascadeSolver1D::tabulateTransfers(double z) {
+	size_t nRows = nSpecies * nBins;
+	transfers.assign(interactions.size(), std::vector<std::vector<Transfer> >(nRows));
+	std::vector<double> row(nRows);
+
+	for (size_t m = 0; m < interactions.size(); m++) {
+		const CascadeInteraction *interaction = interactions[m].interaction;
+		for (size_t s = 0; s < nSpecies; s++) {
+			// skip particle types the interaction does not act on
+			bool acts = false;
+			for (size_t bin = 0; (bin < nBins) and not acts; bin++)
+				acts = interaction->getInteractionRate(speciesId[s], binCenter(bin), z) > 0;
+			if (not acts)
+				continue;
+
+			for (size_t bin = 0; bin < nBins; bin++) {
+				std::fill(row.begin(), row.end(), 0.);
+				for (size_t k = 0; k < samples; k++) {
+					// energies evenly spaced in log within the bin
+					double E = minEnergy * exp((bin + (k + 0.5) / samples) * logStep);
+					Candidate c(speciesId[s], E);
+					c.setRedshift(z);
+					interaction->performInteraction(&c);
+
+					// the remaining primary and the secondaries
+					if (c.isActive()) {
+						size_t target = targetBin(c.current.getEnergy(), bin);
+						if (target < nBins)
+							row[s * nBins + target] += c.getWeight();
+					}
+					for (size_t i = 0; i < c.secondaries.size(); i++) {
+						const Candidate *secondary = c.secondaries[i];
+						int id = secondary->current.getId();
+						if ((id != 22) and (std::abs(id) != 11))
+							continue;
+						size_t target = targetBin(secondary->current.getEnergy(), bin);
+						if (target < nBins)
+							row[species(id) * nBins + target] += secondary->getWeight();
+					}
+				}
+
+				std::vector<Transfer> &transfer = transfers[m][s * nBins + bin];
+				for (size_t i = 0; i < nRows; i++) {
+					if (row[i] == 0)
+						continue;
+					Transfer t;
+					t.target = i;
+					t.value = row[i] / samples;
+					transfer.push_back(t);
+				}
+			}
+		}
+	}
+	transferRedshift = z;
+}
+
+// solve the small system a x = b in place by Gaussian elimination with partial pivoting
+static void solve(double a[nSpecies][nSpecies], double b[nSpecies]) {
+	for (size_t col = 0; col < nSpecies; col++) {
+		size_t pivot = col;
+		for (size_t r = col + 1; r < nSpecies; r++)
+			if (std::fabs(a[r][col]) > std::fabs(a[pivot][col]))
+				pivot = r;
+		if (pivot != col) {
+			for (size_t k = 0; k < nSpecies; k++)
+				std::swap(a[col][k], a[pivot][k]);
+			std::swap(b[col], b[pivot]);
+		}
+		for (size_t r = col + 1; r < nSpecies; r++) {
+			double f = a[r][col] / a[col][col];
+			for (size_t k = col; k < nSpecies; k++)
+				a[r][k] -= f * a[col][k];
+			b[r] -= f * b[col];
+		}
+	}
+	for (size_t col = nSpecies; col-- > 0;) {
+		for (size_t k = col + 1; k < nSpecies; k++)
+			b[col] -= a[col][k] * b[k];
+		b[col] /= a[col][col];
+	}
+}
+
+void CascadeSolver1D::interact(double dx, double z) {
+	size_t nRows = nSpecies * nBins;
+
+	// rates of all interactions at this redshift
+	std::vector<std::vector<double> > rates(interactions.size(), std::vector<double>(nRows, 0.));
+	std::vector<double> loss(nRows, 0.);
+	for (size_t m = 0; m < interactions.size(); m++) {
+		for (size_t r = 0; r < nRows; r++) {
+			double rate = interactions[m].interaction->getInteractionRate(
+					speciesId[r / nBins], binCenter(r % nBins), z);
+			rates[m][r] = rate;
+			loss[r] += rate;
+		}
+	}
+
+	// backward Euler: (1 - dx A) N' = N, from the highest to the lowest bin
+	// where gains from higher bins are already known
+	std::vector<double> gain(nRows, 0.);
+	for (size_t bin = nBins; bin-- > 0;) {
+		double a[nSpecies][nSpecies];
+		double b[nSpecies];
+		for (size_t s = 0; s < nSpecies; s++) {
+			for (size_t t = 0; t < nSpecies; t++)
+				a[t][s] = (s == t) ? 1 + dx * loss[s * nBins + bin] : 0;
+			b[s] = spectrum[s * nBins + bin] + dx * gain[s * nBins + bin];
+		}
+		for (size_t m = 0; m < interactions.size(); m++) {
+			for (size_t s = 0; s < nSpecies; s++) {
+				size_t r = s * nBins + bin;
+				double rate = rates[m][r];
+				if (rate == 0)
+					continue;
+				const std::vector<Transfer> &transfer = transfers[m][r];
+				for (size_t i = 0; i < transfer.size(); i++)
+					if (transfer[i].target % nBins == bin)
+						a[transfer[i].target / nBins][s] -= dx * rate * transfer[i].value;
+			}
+		}
+		solve(a, b);
+
+		// gains of the lower bins
+		for (size_t s = 0; s < nSpecies; s++) {
+			size_t r = s * nBins + bin;
+			spectrum[r] = b[s];
+			if (b[s] == 0)
+				continue;
+			for (size_t m = 0; m < interactions.size(); m++) {
+				double rate = rates[m][r];
+				if (rate == 0)
+					continue;
+				const std::vector<Transfer> &transfer = transfers[m][r];
+				for (size_t i = 0; i < transfer.size(); i++)
+					if (transfer[i].target % nBins != bin)
+						gain[transfer[i].target] += rate * transfer[i].value * b[s];
+			}
+		}
+	}
+}
+
+void CascadeSolver1D::redshift(double z0, double z1) {
+	// E ~ 1 / (1 + z): shift the spectra by the fraction of a bin
+	double f = log((1 + z0) / (1 + z1)) / logStep;
+	while (f > 0) {
+		double g = std::min(f, 1.);
+		for (size_t s = 0; s < nSpecies; s++) {
+			double *n = &spectrum[s * nBins];
+			for (size_t bin = 0; bin < nBins; bin++)
+				n[bin] = (1 - g) * n[bin] + ((bin + 1 < nBins) ? g * n[bin + 1] : 0);
+		}
+		f -= g;
+	}
+}
+
+void CascadeSolver1D::propagate(double distance) {
+	const Cosmology &cosmo = cosmology.valid() ? *cosmology : defaultCosmology();
+	if (redshiftLosses and (distance > cosmo.getMaximumComovingDistance()))
+		throw std::runtime_error("CascadeSolver1D: distance beyond the cosmology tables");
+	double x = distance;
+	while (x > 0) {
+		double dx = std::min(step, x);
+		double z0 = 0, z1 = 0;
+		if (redshiftLosses) {
+			z0 = cosmo.comovingDistance2Redshift(x);
+			z1 = cosmo.comovingDistance2Redshift(x - dx);
+		}
+		double z = (z0 + z1) / 2;
+		if ((transferRedshift < 0) or (std::fabs(z - transferRedshift) > redshiftStep))
+			tabulateTransfers(z);
+
+		interact(dx, z);
+		if (redshiftLosses)
+			redshift(z0, z1);
+		x -= dx;
+	}
+}
+
+} // namespace crpropa
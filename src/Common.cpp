@@ -8,11 +8,27 @@
 #include <string>
 #include <cmath>
 #include <algorithm>
+#include <stdexcept>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
 
 #define index(i,j) ((j)+(i)*Y.size())
 
 namespace crpropa {
 
+int threadIndex() {
+#ifdef _OPENMP
+	int i = omp_get_thread_num();
+	if (i >= MAX_THREAD)
+		throw std::runtime_error("crpropa: more than MAX_THREAD threads!");
+	return i;
+#else
+	return 0;
+#endif
+}
+
 std::string getDataPath(std::string filename) {
 	static std::string dataPath;
 	if (dataPath.size())
@@ -2,168 +2,360 @@
 #include "crpropa/Units.h"
 #include "crpropa/Common.h"
 
+#include <algorithm>
+#include <atomic>
 #include <vector>
 #include <cmath>
 #include <stdexcept>
 
 namespace crpropa {
 
-/**
- @class Cosmology
- @brief Cosmology calculations
- */
-struct Cosmology {
-	double H0; // Hubble parameter at z=0
-	double omegaM; // matter density parameter
-	double omegaL; // vacuum energy parameter
-
-	static const int n;
-	static const double zmin;
-	static const double zmax;
-
-	std::vector<double> Z;  // redshift
-	std::vector<double> Dc; // comoving distance [m]
-	std::vector<double> Dl; // luminosity distance [m]
-	std::vector<double> Dt; // light travel distance [m]
-
-	void update() {
-		double dH = c_light / H0; // Hubble distance
-
-		std::vector<double> E(n);
-		E[0] = 1;
-
-		// Relation between comoving distance r and redshift z (cf. J.A. Peacock, Cosmological physics, p. 89 eq. 3.76)
-		// dr = c / H(z) dz, integration using midpoint rule
-		double dlz = log10(zmax) - log10(zmin);
-		for (int i = 1; i < n; i++) {
-			Z[i] = zmin * pow(10, i * dlz / (n - 1)); // logarithmic even spacing
-			double dz = (Z[i] - Z[i - 1]); // redshift step
-			E[i] = sqrt(omegaL + omegaM * pow_integer<3>(1 + Z[i]));
-			Dc[i] = Dc[i - 1] + dH * dz * (1 / E[i] + 1 / E[i - 1]) / 2;
-			Dl[i] = (1 + Z[i]) * Dc[i];
-			Dt[i] = Dt[i - 1]
-					+ dH * dz
-							* (1 / ((1 + Z[i]) * E[i])
-									+ 1 / ((1 + Z[i - 1]) * E[i - 1])) / 2;
+// cubic Hermite interpolation at x in units of the grid step, x clipped to the table
+double Cosmology::Table::operator()(double x) const noexcept {
+	size_t n = y.size();
+	x = std::min(std::max(x / step, 0.), double(n - 1));
+	size_t i = std::min(size_t(x), n - 2);
+	double t = x - i;
+	double s = 1 - t;
+	return s * s * ((1 + 2 * t) * y[i] + t * dy[i])
+			+ t * t * ((3 - 2 * t) * y[i + 1] - s * dy[i + 1]);
+}
+
+// distance types of the tables
+enum { COMOVING, LUMINOSITY, LIGHTTRAVEL };
+
+Cosmology::Cosmology(double hubbleParameter, double omegaMatter,
+		double maximumRedshift, size_t tableSize) {
+	if (tableSize < 2)
+		throw std::runtime_error("Cosmology: at least two table points needed");
+	if (maximumRedshift <= 0)
+		throw std::runtime_error("Cosmology: maximum redshift must be positive");
+
+	// Cosmological parameters (K.A. Olive et al. (Particle Data Group), Chin. Phys. C, 38, 090001 (2014))
+	h0 = hubbleParameter * 1e5 / Mpc;
+	oM = omegaMatter;
+	oL = 1 - omegaMatter;
+	zmax = maximumRedshift;
+	dH = c_light / h0;
+
+	// Relation between comoving distance r and redshift z (cf. J.A. Peacock, Cosmological physics, p. 89 eq. 3.76)
+	// dr = c / H(z) dz, with u = log(1 + z): dr = c / H(z) (1 + z) du,
+	// integration using Simpson's rule
+	size_t n = tableSize;
+	double du = log1p(zmax) / (n - 1);
+	Table *tabs[3] = {&tabDc, &tabDl, &tabDt};
+	for (int k = 0; k < 3; k++) {
+		tabs[k]->y.resize(n);
+		tabs[k]->dy.resize(n);
+		tabs[k]->step = du;
+	}
+	double fc[3], ft[3];
+	for (size_t i = 0; i < n; i++) {
+		for (int k = 0; k < 3; k++) {
+			double z = expm1((double(i) - 1 + 0.5 * k) * du);
+			double E = sqrt(oL + oM * pow_integer<3>(1 + z));
+			fc[k] = dH * (1 + z) / E; // dDc / du
+			ft[k] = dH / E; // dDt / du
+		}
+		double z = expm1(i * du);
+		if (i == 0) {
+			tabDc.y[i] = tabDt.y[i] = 0;
+		} else {
+			tabDc.y[i] = tabDc.y[i - 1] + du * (fc[0] + 4 * fc[1] + fc[2]) / 6;
+			tabDt.y[i] = tabDt.y[i - 1] + du * (ft[0] + 4 * ft[1] + ft[2]) / 6;
 		}
+		tabDl.y[i] = (1 + z) * tabDc.y[i];
+		tabDc.dy[i] = du * fc[2];
+		tabDt.dy[i] = du * ft[2];
+		tabDl.dy[i] = du * (tabDl.y[i] + (1 + z) * fc[2]);
 	}
 
-	Cosmology() {
-        // Cosmological parameters (K.A. Olive et al. (Particle Data Group), Chin. Phys. C, 38, 090001 (2014))
-		H0 = 67.3 * 1000 * meter / second / Mpc; // default values
-		omegaM = 0.315;
-		omegaL = 1 - omegaM;
+	invert(tabDc, tabZc, COMOVING);
+	invert(tabDl, tabZl, LUMINOSITY);
+	invert(tabDt, tabZt, LIGHTTRAVEL);
+}
 
-		Z.resize(n);
-		Dc.resize(n);
-		Dl.resize(n);
-		Dt.resize(n);
+// tabulate the inverse of the increasing distance table tab on a grid
+// uniform in v = log(1 + d / dH)
+void Cosmology::invert(const Table &tab, Table &inverse, int type) const {
+	size_t n = tab.y.size();
+	double dv = log1p(tab.y.back() / dH) / (n - 1);
+	inverse.y.resize(n);
+	inverse.dy.resize(n);
+	inverse.step = dv;
+	size_t k = 0;
+	for (size_t j = 0; j < n; j++) {
+		double d = dH * expm1(j * dv);
+		while ((k + 2 < n) and (tab.y[k + 1] < d))
+			k++;
 
-		Z[0] = 0;
-		Dc[0] = 0;
-		Dl[0] = 0;
-		Dt[0] = 0;
+		// Newton iteration on the interpolation in [k, k + 1]
+		double t = (d - tab.y[k]) / (tab.y[k + 1] - tab.y[k]);
+		for (int it = 0; it < 20; it++) {
+			t = std::min(std::max(t, 0.), 1.);
+			double s = 1 - t;
+			double f = s * s * ((1 + 2 * t) * tab.y[k] + t * tab.dy[k])
+					+ t * t * ((3 - 2 * t) * tab.y[k + 1] - s * tab.dy[k + 1]) - d;
+			double df = 6 * t * s * (tab.y[k + 1] - tab.y[k])
+					+ s * (1 - 3 * t) * tab.dy[k] + t * (3 * t - 2) * tab.dy[k + 1];
+			double dt = f / df;
+			t -= dt;
+			if (std::fabs(dt) < 1e-14)
+				break;
+		}
+		t = std::min(std::max(t, 0.), 1.);
+		double z = expm1((k + t) * tab.step);
+		if (j == n - 1)
+			z = zmax;
+		inverse.y[j] = z;
 
-		update();
+		// dz / dv = dz / dd * dd / dv with dd / dv = dH exp(v)
+		double E = sqrt(oL + oM * pow_integer<3>(1 + z));
+		double dddz;
+		if (type == COMOVING)
+			dddz = dH / E;
+		else if (type == LIGHTTRAVEL)
+			dddz = dH / E / (1 + z);
+		else
+			dddz = toDistance(tabDc, z) + (1 + z) * dH / E;
+		inverse.dy[j] = dv * dH * exp(j * dv) / dddz;
 	}
+}
 
-	void setParameters(double h, double oM) {
-		H0 = h * 1e5 / Mpc;
-		omegaM = oM;
-		omegaL = 1 - oM;
-		update();
-	}
+double Cosmology::toRedshift(const Table &tab, double d) const noexcept {
+	return tab(log1p(std::max(d, 0.) / dH));
+}
+
+double Cosmology::toDistance(const Table &tab, double z) const noexcept {
+	return tab(log1p(std::max(z, 0.)));
+}
+
+double Cosmology::hubbleRate(double z) const noexcept {
+	return h0 * sqrt(oL + oM * pow_integer<3>(1 + z));
+}
+
+double Cosmology::H0() const noexcept {
+	return h0;
+}
+
+double Cosmology::omegaM() const noexcept {
+	return oM;
+}
+
+double Cosmology::omegaL() const noexcept {
+	return oL;
+}
+
+double Cosmology::getMaximumRedshift() const noexcept {
+	return zmax;
+}
+
+double Cosmology::getMaximumComovingDistance() const noexcept {
+	return tabDc.y.back();
+}
+
+double Cosmology::getMaximumLuminosityDistance() const noexcept {
+	return tabDl.y.back();
+}
+
+double Cosmology::getMaximumLightTravelDistance() const noexcept {
+	return tabDt.y.back();
+}
+
+double Cosmology::comovingDistance2Redshift(double d) const noexcept {
+	return toRedshift(tabZc, d);
+}
+
+double Cosmology::redshift2ComovingDistance(double z) const noexcept {
+	return toDistance(tabDc, z);
+}
+
+double Cosmology::luminosityDistance2Redshift(double d) const noexcept {
+	return toRedshift(tabZl, d);
+}
+
+double Cosmology::redshift2LuminosityDistance(double z) const noexcept {
+	return toDistance(tabDl, z);
+}
+
+double Cosmology::lightTravelDistance2Redshift(double d) const noexcept {
+	return toRedshift(tabZt, d);
+}
+
+double Cosmology::redshift2LightTravelDistance(double z) const noexcept {
+	return toDistance(tabDt, z);
+}
+
+double Cosmology::comoving2LightTravelDistance(double d) const noexcept {
+	return toDistance(tabDt, toRedshift(tabZc, d));
+}
+
+double Cosmology::lightTravel2ComovingDistance(double d) const noexcept {
+	return toDistance(tabDc, toRedshift(tabZt, d));
+}
+
+void Cosmology::comovingDistance2Redshift(const double *d, double *z, size_t n) const noexcept {
+	for (size_t i = 0; i < n; i++)
+		z[i] = toRedshift(tabZc, d[i]);
+}
+
+void Cosmology::redshift2ComovingDistance(const double *z, double *d, size_t n) const noexcept {
+	for (size_t i = 0; i < n; i++)
+		d[i] = toDistance(tabDc, z[i]);
+}
+
+void Cosmology::luminosityDistance2Redshift(const double *d, double *z, size_t n) const noexcept {
+	for (size_t i = 0; i < n; i++)
+		z[i] = toRedshift(tabZl, d[i]);
+}
+
+void Cosmology::redshift2LuminosityDistance(const double *z, double *d, size_t n) const noexcept {
+	for (size_t i = 0; i < n; i++)
+		d[i] = toDistance(tabDl, z[i]);
+}
+
+void Cosmology::lightTravelDistance2Redshift(const double *d, double *z, size_t n) const noexcept {
+	for (size_t i = 0; i < n; i++)
+		z[i] = toRedshift(tabZt, d[i]);
+}
+
+void Cosmology::redshift2LightTravelDistance(const double *z, double *d, size_t n) const noexcept {
+	for (size_t i = 0; i < n; i++)
+		d[i] = toDistance(tabDt, z[i]);
+}
+
+// Default cosmology -----------------------------------------------------------
+// Each thread keeps a reference to the default cosmology in its cache and
+// renews it when the version changes. A replaced cosmology is freed when the
+// last thread has picked up the new one.
+static ref_ptr<Cosmology> &sharedCosmology() {
+	static ref_ptr<Cosmology> cosmology; // guarded by critical(defaultCosmology)
+	return cosmology;
+}
+static std::atomic<uint64_t> cosmologyVersion(1);
+
+struct CosmologyCache {
+	uint64_t version;
+	ref_ptr<Cosmology> cosmology;
+	CosmologyCache() : version(0) {}
 };
+static thread_local CosmologyCache cosmologyCache;
 
-const int Cosmology::n = 1000;
-const double Cosmology::zmin = 0.0001;
-const double Cosmology::zmax = 100;
+const Cosmology &defaultCosmology() {
+	CosmologyCache &cache = cosmologyCache;
+	if (cache.version != cosmologyVersion.load(std::memory_order_acquire)) {
+#pragma omp critical(defaultCosmology)
+		{
+			ref_ptr<Cosmology> &c = sharedCosmology();
+			if (!c.valid())
+				c = new Cosmology();
+			cache.cosmology = c;
+			cache.version = cosmologyVersion.load(std::memory_order_relaxed);
+		}
+	}
+	return *cache.cosmology;
+}
 
-static Cosmology cosmology; // instance is created at runtime
+void setDefaultCosmology(ref_ptr<Cosmology> c) {
+	if (!c.valid())
+		throw std::runtime_error("Cosmology: invalid default cosmology");
+#pragma omp critical(defaultCosmology)
+	{
+		sharedCosmology() = c;
+		cosmologyVersion++;
+	}
+}
 
 void setCosmologyParameters(double h, double oM) {
-	cosmology.setParameters(h, oM);
+	setDefaultCosmology(new Cosmology(h, oM));
 }
 
 double hubbleRate(double z) {
-	return cosmology.H0
-			* sqrt(cosmology.omegaL + cosmology.omegaM * pow(1 + z, 3));
+	return defaultCosmology().hubbleRate(z);
 }
 
 double omegaL() {
-	return cosmology.omegaL;
+	return defaultCosmology().omegaL();
 }
 
 double omegaM() {
-	return cosmology.omegaM;
+	return defaultCosmology().omegaM();
 }
 
 double H0() {
-	return cosmology.H0;
+	return defaultCosmology().H0();
 }
 
 double comovingDistance2Redshift(double d) {
+	const Cosmology &c = defaultCosmology();
 	if (d < 0)
 		throw std::runtime_error("Cosmology: d < 0");
-	if (d > cosmology.Dc.back())
+	if (d > c.getMaximumComovingDistance())
 		throw std::runtime_error("Cosmology: d > dmax");
-	return interpolate(d, cosmology.Dc, cosmology.Z);
+	return c.comovingDistance2Redshift(d);
 }
 
 double redshift2ComovingDistance(double z) {
+	const Cosmology &c = defaultCosmology();
 	if (z < 0)
 		throw std::runtime_error("Cosmology: z < 0");
-	if (z > cosmology.zmax)
+	if (z > c.getMaximumRedshift())
 		throw std::runtime_error("Cosmology: z > zmax");
-	return interpolate(z, cosmology.Z, cosmology.Dc);
+	return c.redshift2ComovingDistance(z);
 }
 
 double luminosityDistance2Redshift(double d) {
+	const Cosmology &c = defaultCosmology();
 	if (d < 0)
 		throw std::runtime_error("Cosmology: d < 0");
-	if (d > cosmology.Dl.back())
+	if (d > c.getMaximumLuminosityDistance())
 		throw std::runtime_error("Cosmology: d > dmax");
-	return interpolate(d, cosmology.Dl, cosmology.Z);
+	return c.luminosityDistance2Redshift(d);
 }
 
 double redshift2LuminosityDistance(double z) {
+	const Cosmology &c = defaultCosmology();
 	if (z < 0)
 		throw std::runtime_error("Cosmology: z < 0");
-	if (z > cosmology.zmax)
+	if (z > c.getMaximumRedshift())
 		throw std::runtime_error("Cosmology: z > zmax");
-	return interpolate(z, cosmology.Z, cosmology.Dl);
+	return c.redshift2LuminosityDistance(z);
 }
 
 double lightTravelDistance2Redshift(double d) {
+	const Cosmology &c = defaultCosmology();
 	if (d < 0)
 		throw std::runtime_error("Cosmology: d < 0");
-	if (d > cosmology.Dt.back())
+	if (d > c.getMaximumLightTravelDistance())
 		throw std::runtime_error("Cosmology: d > dmax");
-	return interpolate(d, cosmology.Dt, cosmology.Z);
+	return c.lightTravelDistance2Redshift(d);
 }
 
 double redshift2LightTravelDistance(double z) {
+	const Cosmology &c = defaultCosmology();
 	if (z < 0)
 		throw std::runtime_error("Cosmology: z < 0");
-	if (z > cosmology.zmax)
+	if (z > c.getMaximumRedshift())
 		throw std::runtime_error("Cosmology: z > zmax");
-	return interpolate(z, cosmology.Z, cosmology.Dt);
+	return c.redshift2LightTravelDistance(z);
 }
 
 double comoving2LightTravelDistance(double d) {
+	const Cosmology &c = defaultCosmology();
 	if (d < 0)
 		throw std::runtime_error("Cosmology: d < 0");
-	if (d > cosmology.Dc.back())
+	if (d > c.getMaximumComovingDistance())
 		throw std::runtime_error("Cosmology: d > dmax");
-	return interpolate(d, cosmology.Dc, cosmology.Dt);
+	return c.comoving2LightTravelDistance(d);
 }
 
 double lightTravel2ComovingDistance(double d) {
+	const Cosmology &c = defaultCosmology();
 	if (d < 0)
 		throw std::runtime_error("Cosmology: d < 0");
-	if (d > cosmology.Dt.back())
+	if (d > c.getMaximumLightTravelDistance())
 		throw std::runtime_error("Cosmology: d > dmax");
-	return interpolate(d, cosmology.Dt, cosmology.Dc);
+	return c.lightTravel2ComovingDistance(d);
 }
 
 } // namespace crpropa
@@ -4,16 +4,27 @@
 
 #include "kiss/logger.h"
 
+#include <algorithm>
 #include <fstream>
 
 namespace crpropa {
 
-CylindricalProjectionMap::CylindricalProjectionMap() : nPhi(360), nTheta(180), dirty(false), pdf(nPhi* nTheta, 0), cdf(nPhi* nTheta, 0) {
+/// maps filled by the calling thread, pointing into the maps of the EmissionMap with the cacheId owner.
+/// Thread local rather than indexed by the OpenMP thread number, which is 0 for all threads not created by OpenMP.
+struct EmissionMapCache {
+	uint64_t owner;
+	std::map<EmissionMap::key_t, CylindricalProjectionMap *> maps;
+	EmissionMapCache() : owner(0) {}
+};
+static thread_local EmissionMapCache threadCache;
+static std::atomic<uint64_t> nextCacheId(1);
+
+CylindricalProjectionMap::CylindricalProjectionMap() : nPhi(360), nTheta(180), dirty(true), pdf(nPhi* nTheta, 0), cdf(nPhi* nTheta, 0) {
 	sPhi = 2. * M_PI / nPhi;
 	sTheta = 2. / nTheta;
 }
 
-CylindricalProjectionMap::CylindricalProjectionMap(size_t nPhi, size_t nTheta) : nPhi(nPhi), nTheta(nTheta), dirty(false), pdf(nPhi* nTheta, 0), cdf(nPhi* nTheta, 0) {
+CylindricalProjectionMap::CylindricalProjectionMap(size_t nPhi, size_t nTheta) : nPhi(nPhi), nTheta(nTheta), dirty(true), pdf(nPhi* nTheta, 0), cdf(nPhi* nTheta, 0) {
 	sPhi = 2 * M_PI / nPhi;
 	sTheta = 2. / nTheta;
 }
@@ -24,15 +35,36 @@ void CylindricalProjectionMap::fillBin(const Vector3d& direction, double weight)
 }
 
 void CylindricalProjectionMap::fillBin(size_t bin, double weight) {
-	pdf[bin] += weight;
-	dirty = true;
+	double &value = pdf[bin];
+	#pragma omp atomic
+	value += weight;
+	if (!dirty.load(std::memory_order_relaxed))
+		dirty.store(true, std::memory_order_release);
+}
+
+void CylindricalProjectionMap::freeze() {
+	update();
+}
+
+void CylindricalProjectionMap::update() const {
+	if (!dirty.load(std::memory_order_acquire))
+		return;
+	#pragma omp critical(CylindricalProjectionMapUpdate)
+	{
+		if (dirty.load(std::memory_order_relaxed))
+			updateCdf();
+	}
 }
 
 Vector3d CylindricalProjectionMap::drawDirection() const {
-	if (dirty)
-		updateCdf();
+	update();
 
-	size_t bin = Random::instance().randBin(cdf);
+	// alias method: one uniform number selects the bin and the side
+	size_t n = aliasBin.size();
+	double u = Random::instance().rand() * n;
+	size_t bin = std::min(size_t(u), n - 1);
+	if (u - bin >= aliasProbability[bin])
+		bin = aliasBin[bin];
 
 	return directionFromBin(bin);
 }
@@ -48,18 +80,21 @@ const std::vector<double>& CylindricalProjectionMap::getPdf() const {
 }
 
 std::vector<double>& CylindricalProjectionMap::getPdf() {
+	// the pdf may be changed by the caller
+	dirty.store(true, std::memory_order_release);
 	return pdf;
 }
 
 const std::vector<double>& CylindricalProjectionMap::getCdf() const {
+	update();
 	return cdf;
 }
 
-size_t CylindricalProjectionMap::getNPhi() {
+size_t CylindricalProjectionMap::getNPhi() const {
 	return nPhi;
 }
 
-size_t CylindricalProjectionMap::getNTheta() {
+size_t CylindricalProjectionMap::getNTheta() const {
 	return nTheta;
 }
 
@@ -109,26 +144,75 @@ Vector3d CylindricalProjectionMap::directionFromBin(size_t bin) const {
 }
 
 void CylindricalProjectionMap::updateCdf() const {
-	if (dirty) {
-		cdf[0] = pdf[0];
-		for (size_t i = 1; i < pdf.size(); i++) {
-			cdf[i] = cdf[i-1] + pdf[i];
+	size_t n = pdf.size();
+	cdf[0] = pdf[0];
+	for (size_t i = 1; i < n; i++) {
+		cdf[i] = cdf[i-1] + pdf[i];
+	}
+
+	// alias table (Vose): each bin keeps the probability to be drawn itself
+	// and the bin drawn otherwise; bins with zero pdf are never drawn
+	aliasProbability.assign(n, 1.);
+	aliasBin.resize(n);
+	for (size_t i = 0; i < n; i++)
+		aliasBin[i] = i;
+	double total = cdf[n - 1];
+	if (total > 0) {
+		std::vector<double> scaled(n);
+		std::vector<size_t> small, large;
+		for (size_t i = 0; i < n; i++) {
+			scaled[i] = pdf[i] * n / total;
+			if (scaled[i] < 1)
+				small.push_back(i);
+			else
+				large.push_back(i);
+		}
+		// target of empty bins left over, any bin that can be drawn
+		size_t nonEmpty = 0;
+		while (pdf[nonEmpty] <= 0)
+			nonEmpty++;
+		while (!small.empty() && !large.empty()) {
+			size_t s = small.back();
+			size_t l = large.back();
+			small.pop_back();
+			aliasProbability[s] = scaled[s];
+			aliasBin[s] = l;
+			scaled[l] -= 1 - scaled[s];
+			if (scaled[l] < 1) {
+				large.pop_back();
+				small.push_back(l);
+			}
+		}
+		// leftovers from rounding (small or large) are drawn with
+		// probability 1, unless empty; large may be empty if rounding left
+		// all scaled weights just below 1
+		for (size_t i = 0; i < large.size(); i++)
+			aliasProbability[large[i]] = 1;
+		for (size_t i = 0; i < small.size(); i++) {
+			if (pdf[small[i]] <= 0) {
+				aliasProbability[small[i]] = 0;
+				aliasBin[small[i]] = nonEmpty;
+			} else {
+				aliasProbability[small[i]] = 1;
+			}
 		}
-		dirty = false;
 	}
+
+	dirty.store(false, std::memory_order_release);
 }
 
 EmissionMap::EmissionMap() : minEnergy(0.0001 * EeV), maxEnergy(10000 * EeV),
-	nEnergy(8*2), nPhi(360), nTheta(180) {
+	nEnergy(8*2), nPhi(360), nTheta(180), frozen(false), cacheId(nextCacheId++) {
 	logStep = log10(maxEnergy / minEnergy) / nEnergy;
 }
 
 EmissionMap::EmissionMap(size_t nPhi, size_t nTheta, size_t nEnergy) : minEnergy(0.0001 * EeV), maxEnergy(10000 * EeV),
-	nEnergy(nEnergy), nPhi(nPhi), nTheta(nTheta) {
+	nEnergy(nEnergy), nPhi(nPhi), nTheta(nTheta), frozen(false), cacheId(nextCacheId++) {
 	logStep = log10(maxEnergy / minEnergy) / nEnergy;
 }
 
-EmissionMap::EmissionMap(size_t nPhi, size_t nTheta, size_t nEnergy, double minEnergy, double maxEnergy) : minEnergy(minEnergy), maxEnergy(maxEnergy), nEnergy(nEnergy), nPhi(nPhi), nTheta(nTheta) {
+EmissionMap::EmissionMap(size_t nPhi, size_t nTheta, size_t nEnergy, double minEnergy, double maxEnergy) : minEnergy(minEnergy), maxEnergy(maxEnergy), nEnergy(nEnergy), nPhi(nPhi), nTheta(nTheta),
+	frozen(false), cacheId(nextCacheId++) {
 	logStep = log10(maxEnergy / minEnergy) / nEnergy;
 }
 
@@ -141,7 +225,22 @@ size_t EmissionMap::binFromEnergy(double energy) const {
 }
 
 void EmissionMap::fillMap(int pid, double energy, const Vector3d& direction, double weight) {
-	getMap(pid, energy)->fillBin(direction, weight);
+	key_t key(pid, binFromEnergy(energy));
+	if (threadCache.owner != cacheId) {
+		threadCache.maps.clear();
+		threadCache.owner = cacheId;
+	}
+	std::map<key_t, CylindricalProjectionMap *> &cache = threadCache.maps;
+	std::map<key_t, CylindricalProjectionMap *>::iterator i = cache.find(key);
+	if (i == cache.end()) {
+		CylindricalProjectionMap *cpm;
+		#pragma omp critical(EmissionMapInsert)
+		{
+			cpm = getMap(pid, energy);
+		}
+		i = cache.insert(std::make_pair(key, cpm)).first;
+	}
+	i->second->fillBin(direction, weight);
 }
 
 void EmissionMap::fillMap(const ParticleState& state, double weight) {
@@ -149,6 +248,9 @@ void EmissionMap::fillMap(const ParticleState& state, double weight) {
 }
 
 EmissionMap::map_t &EmissionMap::getMaps() {
+	// the maps may be replaced by the caller
+	thaw();
+	cacheId = nextCacheId++;
 	return maps;
 }
 
@@ -156,16 +258,30 @@ const EmissionMap::map_t &EmissionMap::getMaps() const {
 	return maps;
 }
 
-bool EmissionMap::drawDirection(int pid, double energy, Vector3d& direction) const {
-	key_t key(pid, binFromEnergy(energy));
-	map_t::const_iterator i = maps.find(key);
+const CylindricalProjectionMap *EmissionMap::findMap(int pid, double energy) const {
+	size_t bin = binFromEnergy(energy);
+	if (frozen) {
+		for (size_t i = 0; i < frozenMaps.size(); i++) {
+			if (frozenMaps[i].pid != pid)
+				continue;
+			const std::vector<CylindricalProjectionMap *> &energyBins = frozenMaps[i].energyBins;
+			return (bin < energyBins.size()) ? energyBins[bin] : 0;
+		}
+		return 0;
+	}
 
-	if (i == maps.end() || !i->second.valid()) {
+	map_t::const_iterator i = maps.find(key_t(pid, bin));
+	if (i == maps.end() || !i->second.valid())
+		return 0;
+	return i->second;
+}
+
+bool EmissionMap::drawDirection(int pid, double energy, Vector3d& direction) const {
+	const CylindricalProjectionMap *cpm = findMap(pid, energy);
+	if (cpm == 0)
 		return false;
-	} else {
-		direction = i->second->drawDirection();
-		return true;
-	}
+	direction = cpm->drawDirection();
+	return true;
 }
 
 bool EmissionMap::drawDirection(const ParticleState& state, Vector3d& direction) const {
@@ -173,14 +289,10 @@ bool EmissionMap::drawDirection(const ParticleState& state, Vector3d& direction)
 }
 
 bool EmissionMap::checkDirection(int pid, double energy, const Vector3d& direction) const {
-	key_t key(pid, binFromEnergy(energy));
-	map_t::const_iterator i = maps.find(key);
-
-	if (i == maps.end() || !i->second.valid()) {
+	const CylindricalProjectionMap *cpm = findMap(pid, energy);
+	if (cpm == 0)
 		return false;
-	} else {
-		return i->second->checkDirection(direction);
-	}
+	return cpm->checkDirection(direction);
 }
 
 bool EmissionMap::checkDirection(const ParticleState& state) const {
@@ -202,6 +314,7 @@ ref_ptr<CylindricalProjectionMap> EmissionMap::getMap(int pid, double energy) {
 	if (i == maps.end() || !i->second.valid()) {
 		ref_ptr<CylindricalProjectionMap> cpm = new CylindricalProjectionMap(nPhi, nTheta);
 		maps[key] = cpm;
+		thaw();
 		return cpm;
 	} else {
 		return i->second;
@@ -217,7 +330,8 @@ void EmissionMap::save(const std::string &filename) {
 			continue;
 		out << i->first.first << " " << i->first.second << " " << energyFromBin(i->first.second) << " ";
 		out << i->second->getNPhi() << " " << i->second->getNTheta();
-		const std::vector<double> &pdf = i->second->getPdf();
+		const CylindricalProjectionMap *cpm = i->second;
+		const std::vector<double> &pdf = cpm->getPdf();
 		for (size_t i = 0; i < pdf.size(); i++)
 			out << " " << pdf[i];
 		out << std::endl;
@@ -233,7 +347,8 @@ void EmissionMap::merge(const EmissionMap *other) {
 		if (!i->second.valid())
 			continue;
 
-		std::vector<double> &otherpdf = i->second->getPdf();
+		const CylindricalProjectionMap *othercpm = i->second;
+		const std::vector<double> &otherpdf = othercpm->getPdf();
 		ref_ptr<CylindricalProjectionMap> cpm = getMap(i->first.first, i->first.second);
 
 		if (otherpdf.size() != cpm->getPdf().size()) {
@@ -247,6 +362,35 @@ void EmissionMap::merge(const EmissionMap *other) {
 	}
 }
 
+void EmissionMap::freeze() {
+	frozenMaps.clear();
+	for (map_t::iterator i = maps.begin(); i != maps.end(); i++) {
+		if (!i->second.valid())
+			continue;
+		i->second->freeze();
+		// maps are sorted by particle type and energy bin
+		if (frozenMaps.empty() || frozenMaps.back().pid != i->first.first) {
+			frozenMaps.push_back(ParticleMaps());
+			frozenMaps.back().pid = i->first.first;
+		}
+		std::vector<CylindricalProjectionMap *> &energyBins = frozenMaps.back().energyBins;
+		size_t bin = i->first.second;
+		if (bin >= energyBins.size())
+			energyBins.resize(bin + 1, 0);
+		energyBins[bin] = i->second;
+	}
+	frozen = true;
+}
+
+bool EmissionMap::isFrozen() const {
+	return frozen;
+}
+
+void EmissionMap::thaw() {
+	frozen = false;
+	frozenMaps.clear();
+}
+
 void EmissionMap::merge(const std::string &filename) {
 	EmissionMap em;
 	em.load(filename);
@@ -254,6 +398,10 @@ void EmissionMap::merge(const std::string &filename) {
 }
 
 void EmissionMap::load(const std::string &filename) {
+	// existing maps are replaced
+	thaw();
+	cacheId = nextCacheId++;
+
 	std::ifstream in(filename.c_str());
 	in.imbue(std::locale("C"));
 
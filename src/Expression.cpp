@@ -0,0 +1,102 @@
+#include "crpropa/Expression.h"
+
+#ifdef CRPROPA_HAVE_MUPARSER
+#include "crpropa/Common.h"
+#include "crpropa/Units.h"
+
+#include "muParser.h"
+
+#include <stdexcept>
+
+namespace crpropa {
+
+struct Expression::Slot {
+	mu::Parser parser;
+	std::vector<double> values;
+};
+
+Expression::Expression(const std::string &expression,
+		const std::vector<std::string> &variables) :
+		expression(expression), variables(variables), slots(MAX_THREAD, 0) {
+	// compile once to report syntax errors at construction
+	Slot *slot = createSlot();
+	try {
+		slot->parser.Eval();
+	} catch (mu::Parser::exception_type &e) {
+		delete slot;
+		throw std::runtime_error("crpropa::Expression: cannot parse '"
+				+ expression + "': " + e.GetMsg());
+	}
+	slots[threadIndex()] = slot;
+}
+
+Expression::~Expression() {
+	for (size_t i = 0; i < slots.size(); i++)
+		delete slots[i];
+}
+
+Expression::Slot *Expression::createSlot() const {
+	Slot *slot = new Slot;
+	slot->values.resize(variables.size(), 0.);
+	mu::Parser &p = slot->parser;
+	for (size_t i = 0; i < variables.size(); i++)
+		p.DefineVar(variables[i], &slot->values[i]);
+
+	p.DefineConst("pi", M_PI);
+
+	p.DefineConst("tesla", tesla);
+	p.DefineConst("gauss", gauss);
+	p.DefineConst("muG", muG);
+	p.DefineConst("nG", nG);
+
+	p.DefineConst("eV", eV);
+	p.DefineConst("keV", keV);
+	p.DefineConst("MeV", MeV);
+	p.DefineConst("GeV", GeV);
+	p.DefineConst("TeV", TeV);
+	p.DefineConst("PeV", PeV);
+	p.DefineConst("EeV", EeV);
+
+	p.DefineConst("meter", meter);
+	p.DefineConst("km", km);
+	p.DefineConst("au", au);
+	p.DefineConst("pc", pc);
+	p.DefineConst("kpc", kpc);
+	p.DefineConst("Mpc", Mpc);
+	p.DefineConst("Gpc", Gpc);
+	p.DefineConst("ccm", ccm);
+
+	p.SetExpr(expression);
+	return slot;
+}
+
+double Expression::evaluate(const double *values) const {
+	int i = threadIndex();
+	Slot *slot = slots[i];
+	if (slot == 0) {
+		// each thread only ever writes its own entry
+		slot = createSlot();
+		slots[i] = slot;
+	}
+	for (size_t j = 0; j < slot->values.size(); j++)
+		slot->values[j] = values[j];
+	return slot->parser.Eval();
+}
+
+double Expression::evaluate(const std::vector<double> &values) const {
+	if (values.size() != variables.size())
+		throw std::runtime_error("crpropa::Expression: wrong number of variables");
+	return evaluate(values.empty() ? 0 : &values[0]);
+}
+
+const std::string &Expression::getExpression() const {
+	return expression;
+}
+
+const std::vector<std::string> &Expression::getVariables() const {
+	return variables;
+}
+
+} // namespace crpropa
+
+#endif // CRPROPA_HAVE_MUPARSER
@@ -4,19 +4,23 @@
 #include <fstream>
 #include <sstream>
 
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
 namespace crpropa {
 
 void scaleGrid(ref_ptr<Grid1f> grid, double a) {
-	for (int ix = 0; ix < grid->getNx(); ix++)
-		for (int iy = 0; iy < grid->getNy(); iy++)
-			for (int iz = 0; iz < grid->getNz(); iz++)
+	for (size_t ix = 0; ix < grid->getNx(); ix++)
+		for (size_t iy = 0; iy < grid->getNy(); iy++)
+			for (size_t iz = 0; iz < grid->getNz(); iz++)
 				grid->get(ix, iy, iz) *= a;
 }
 
 void scaleGrid(ref_ptr<Grid3f> grid, double a) {
-	for (int ix = 0; ix < grid->getNx(); ix++)
-		for (int iy = 0; iy < grid->getNy(); iy++)
-			for (int iz = 0; iz < grid->getNz(); iz++)
+	for (size_t ix = 0; ix < grid->getNx(); ix++)
+		for (size_t iy = 0; iy < grid->getNy(); iy++)
+			for (size_t iz = 0; iz < grid->getNz(); iz++)
 				grid->get(ix, iy, iz) *= a;
 }
 
@@ -25,9 +29,9 @@ Vector3f meanFieldVector(ref_ptr<Grid3f> grid) {
 	size_t Ny = grid->getNy();
 	size_t Nz = grid->getNz();
 	Vector3f mean(0.);
-	for (int ix = 0; ix < Nx; ix++)
-		for (int iy = 0; iy < Ny; iy++)
-			for (int iz = 0; iz < Nz; iz++)
+	for (size_t ix = 0; ix < Nx; ix++)
+		for (size_t iy = 0; iy < Ny; iy++)
+			for (size_t iz = 0; iz < Nz; iz++)
 				mean += grid->get(ix, iy, iz);
 	return mean / Nx / Ny / Nz;
 }
@@ -37,9 +41,9 @@ double meanFieldStrength(ref_ptr<Grid3f> grid) {
 	size_t Ny = grid->getNy();
 	size_t Nz = grid->getNz();
 	double mean = 0;
-	for (int ix = 0; ix < Nx; ix++)
-		for (int iy = 0; iy < Ny; iy++)
-			for (int iz = 0; iz < Nz; iz++)
+	for (size_t ix = 0; ix < Nx; ix++)
+		for (size_t iy = 0; iy < Ny; iy++)
+			for (size_t iz = 0; iz < Nz; iz++)
 				mean += grid->get(ix, iy, iz).getR();
 	return mean / Nx / Ny / Nz;
 }
@@ -49,9 +53,9 @@ double meanFieldStrength(ref_ptr<Grid1f> grid) {
 	size_t Ny = grid->getNy();
 	size_t Nz = grid->getNz();
 	double mean = 0;
-	for (int ix = 0; ix < Nx; ix++)
-		for (int iy = 0; iy < Ny; iy++)
-			for (int iz = 0; iz < Nz; iz++)
+	for (size_t ix = 0; ix < Nx; ix++)
+		for (size_t iy = 0; iy < Ny; iy++)
+			for (size_t iz = 0; iz < Nz; iz++)
 				mean += grid->get(ix, iy, iz);
 	return mean / Nx / Ny / Nz;
 }
@@ -61,9 +65,9 @@ double rmsFieldStrength(ref_ptr<Grid3f> grid) {
 	size_t Ny = grid->getNy();
 	size_t Nz = grid->getNz();
 	double sumV2 = 0;
-	for (int ix = 0; ix < Nx; ix++)
-		for (int iy = 0; iy < Ny; iy++)
-			for (int iz = 0; iz < Nz; iz++)
+	for (size_t ix = 0; ix < Nx; ix++)
+		for (size_t iy = 0; iy < Ny; iy++)
+			for (size_t iz = 0; iz < Nz; iz++)
 				sumV2 += grid->get(ix, iy, iz).getR2();
 	return std::sqrt(sumV2 / Nx / Ny / Nz);
 }
@@ -73,9 +77,9 @@ double rmsFieldStrength(ref_ptr<Grid1f> grid) {
 	size_t Ny = grid->getNy();
 	size_t Nz = grid->getNz();
 	double sumV2 = 0;
-	for (int ix = 0; ix < Nx; ix++)
-		for (int iy = 0; iy < Ny; iy++)
-			for (int iz = 0; iz < Nz; iz++)
+	for (size_t ix = 0; ix < Nx; ix++)
+		for (size_t iy = 0; iy < Ny; iy++)
+			for (size_t iz = 0; iz < Nz; iz++)
 				sumV2 += pow(grid->get(ix, iy, iz), 2);
 	return std::sqrt(sumV2 / Nx / Ny / Nz);
 }
@@ -87,9 +91,9 @@ std::array<float, 3> rmsFieldStrengthPerAxis(ref_ptr<Grid3f> grid) {
     float sumV2_x = 0;
     float sumV2_y = 0;
     float sumV2_z = 0;
-    for (int ix = 0; ix < Nx; ix++)
-        for (int iy = 0; iy < Ny; iy++)
-            for (int iz = 0; iz < Nz; iz++) {
+    for (size_t ix = 0; ix < Nx; ix++)
+        for (size_t iy = 0; iy < Ny; iy++)
+            for (size_t iz = 0; iz < Nz; iz++) {
                 sumV2_x += pow(grid->get(ix, iy, iz).x, 2);
                 sumV2_y += pow(grid->get(ix, iy, iz).y, 2);
                 sumV2_z += pow(grid->get(ix, iy, iz).z, 2);
@@ -151,9 +155,9 @@ void loadGrid(ref_ptr<Grid3f> grid, std::string filename, double c) {
 	if (length != (3 * nx * ny * nz))
 		throw std::runtime_error("loadGrid: file and grid size do not match");
 
-	for (int ix = 0; ix < grid->getNx(); ix++) {
-		for (int iy = 0; iy < grid->getNy(); iy++) {
-			for (int iz = 0; iz < grid->getNz(); iz++) {
+	for (size_t ix = 0; ix < grid->getNx(); ix++) {
+		for (size_t iy = 0; iy < grid->getNy(); iy++) {
+			for (size_t iz = 0; iz < grid->getNz(); iz++) {
 				Vector3f &b = grid->get(ix, iy, iz);
 				fin.read((char*) &(b.x), sizeof(float));
 				fin.read((char*) &(b.y), sizeof(float));
@@ -185,9 +189,9 @@ void loadGrid(ref_ptr<Grid1f> grid, std::string filename, double c) {
 	if (length != (nx * ny * nz))
 		throw std::runtime_error("loadGrid: file and grid size do not match");
 
-	for (int ix = 0; ix < nx; ix++) {
-		for (int iy = 0; iy < ny; iy++) {
-			for (int iz = 0; iz < nz; iz++) {
+	for (size_t ix = 0; ix < nx; ix++) {
+		for (size_t iy = 0; iy < ny; iy++) {
+			for (size_t iz = 0; iz < nz; iz++) {
 				float &b = grid->get(ix, iy, iz);
 				fin.read((char*) &b, sizeof(float));
 				b *= c;
@@ -204,9 +208,9 @@ void dumpGrid(ref_ptr<Grid3f> grid, std::string filename, double c) {
 		ss << "dump Grid3f: " << filename << " not found";
 		throw std::runtime_error(ss.str());
 	}
-	for (int ix = 0; ix < grid->getNx(); ix++) {
-		for (int iy = 0; iy < grid->getNy(); iy++) {
-			for (int iz = 0; iz < grid->getNz(); iz++) {
+	for (size_t ix = 0; ix < grid->getNx(); ix++) {
+		for (size_t iy = 0; iy < grid->getNy(); iy++) {
+			for (size_t iz = 0; iz < grid->getNz(); iz++) {
 				Vector3f b = grid->get(ix, iy, iz) * c;
 				fout.write((char*) &(b.x), sizeof(float));
 				fout.write((char*) &(b.y), sizeof(float));
@@ -224,9 +228,9 @@ void dumpGrid(ref_ptr<Grid1f> grid, std::string filename, double c) {
 		ss << "dump Grid1f: " << filename << " not found";
 		throw std::runtime_error(ss.str());
 	}
-	for (int ix = 0; ix < grid->getNx(); ix++) {
-		for (int iy = 0; iy < grid->getNy(); iy++) {
-			for (int iz = 0; iz < grid->getNz(); iz++) {
+	for (size_t ix = 0; ix < grid->getNx(); ix++) {
+		for (size_t iy = 0; iy < grid->getNy(); iy++) {
+			for (size_t iz = 0; iz < grid->getNz(); iz++) {
 				float b = grid->get(ix, iy, iz) * c;
 				fout.write((char*) &b, sizeof(float));
 			}
@@ -246,9 +250,9 @@ void loadGridFromTxt(ref_ptr<Grid3f> grid, std::string filename, double c) {
 	while (fin.peek() == '#')
 		fin.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
 
-	for (int ix = 0; ix < grid->getNx(); ix++) {
-		for (int iy = 0; iy < grid->getNy(); iy++) {
-			for (int iz = 0; iz < grid->getNz(); iz++) {
+	for (size_t ix = 0; ix < grid->getNx(); ix++) {
+		for (size_t iy = 0; iy < grid->getNy(); iy++) {
+			for (size_t iz = 0; iz < grid->getNz(); iz++) {
 				Vector3f &b = grid->get(ix, iy, iz);
 				fin >> b.x >> b.y >> b.z;
 				b *= c;
@@ -271,9 +275,9 @@ void loadGridFromTxt(ref_ptr<Grid1f> grid, std::string filename, double c) {
 	while (fin.peek() == '#')
 		fin.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
 
-	for (int ix = 0; ix < grid->getNx(); ix++) {
-		for (int iy = 0; iy < grid->getNy(); iy++) {
-			for (int iz = 0; iz < grid->getNz(); iz++) {
+	for (size_t ix = 0; ix < grid->getNx(); ix++) {
+		for (size_t iy = 0; iy < grid->getNy(); iy++) {
+			for (size_t iz = 0; iz < grid->getNz(); iz++) {
 				float &b = grid->get(ix, iy, iz);
 				fin >> b;
 				b *= c;
@@ -292,9 +296,9 @@ void dumpGridToTxt(ref_ptr<Grid3f> grid, std::string filename, double c) {
 		ss << "dump Grid3f: " << filename << " not found";
 		throw std::runtime_error(ss.str());
 	}
-	for (int ix = 0; ix < grid->getNx(); ix++) {
-		for (int iy = 0; iy < grid->getNy(); iy++) {
-			for (int iz = 0; iz < grid->getNz(); iz++) {
+	for (size_t ix = 0; ix < grid->getNx(); ix++) {
+		for (size_t iy = 0; iy < grid->getNy(); iy++) {
+			for (size_t iz = 0; iz < grid->getNz(); iz++) {
 				Vector3f b = grid->get(ix, iy, iz) * c;
 				fout << b << "\n";
 			}
@@ -310,9 +314,9 @@ void dumpGridToTxt(ref_ptr<Grid1f> grid, std::string filename, double c) {
 		ss << "dump Grid1f: " << filename << " not found";
 		throw std::runtime_error(ss.str());
 	}
-	for (int ix = 0; ix < grid->getNx(); ix++) {
-		for (int iy = 0; iy < grid->getNy(); iy++) {
-			for (int iz = 0; iz < grid->getNz(); iz++) {
+	for (size_t ix = 0; ix < grid->getNx(); ix++) {
+		for (size_t iy = 0; iy < grid->getNy(); iy++) {
+			for (size_t iz = 0; iz < grid->getNz(); iz++) {
 				float b = grid->get(ix, iy, iz) * c;
 				fout << b << "\n";
 			}
@@ -323,87 +327,95 @@ void dumpGridToTxt(ref_ptr<Grid1f> grid, std::string filename, double c) {
 
 #ifdef CRPROPA_HAVE_FFTW3F
 
+// Add the power |B(k)|^2 of one component to the shells k = floor(|(ix, iy, iz)|),
+// 0 < k <= n/2, using the modes of the positive octant of the r2c output.
+// If count is given, the number of modes per shell is counted as well.
+static void binPowerSpectrum(const fftwf_complex *Bk, size_t n,
+		std::vector<double> &power, std::vector<size_t> *count) {
+	size_t n2 = n / 2 + 1;
+	size_t kmax = n / 2;
+
+#pragma omp parallel
+	{
+		std::vector<double> localPower(kmax + 1, 0.);
+		std::vector<size_t> localCount(kmax + 1, 0);
+
+#pragma omp for
+		for (size_t ix = 0; ix <= kmax; ix++) {
+			for (size_t iy = 0; iy <= kmax; iy++) {
+				for (size_t iz = 0; iz <= kmax; iz++) {
+					size_t k = static_cast<size_t>(
+							std::floor(std::sqrt(double(ix * ix + iy * iy + iz * iz))));
+					if (k > kmax || k == 0)
+						continue;
+					size_t i = ix * n * n2 + iy * n2 + iz;
+					localPower[k] += Bk[i][0] * Bk[i][0] + Bk[i][1] * Bk[i][1];
+					localCount[k] += 1;
+				}
+			}
+		}
+
+#pragma omp critical(crpropa_power_spectrum)
+		{
+			for (size_t k = 0; k <= kmax; k++) {
+				power[k] += localPower[k];
+				if (count)
+					(*count)[k] += localCount[k];
+			}
+		}
+	}
+}
+
 std::vector<std::pair<int, float>> gridPowerSpectrum(ref_ptr<Grid3f> grid) {
 
   double rms = rmsFieldStrength(grid);
   size_t n = grid->getNx(); // size of array
-
-  // arrays to hold the complex vector components of the B(k)-field
-  fftwf_complex *Bkx, *Bky, *Bkz;
-  Bkx = (fftwf_complex *)fftwf_malloc(sizeof(fftwf_complex) * n * n * n);
-  Bky = (fftwf_complex *)fftwf_malloc(sizeof(fftwf_complex) * n * n * n);
-  Bkz = (fftwf_complex *)fftwf_malloc(sizeof(fftwf_complex) * n * n * n);
-
-  fftwf_complex *Bx = (fftwf_complex *)Bkx;
-  fftwf_complex *By = (fftwf_complex *)Bky;
-  fftwf_complex *Bz = (fftwf_complex *)Bkz;
-
-  // save to temp
-  int i;
-  for (size_t ix = 0; ix < n; ix++) {
-    for (size_t iy = 0; iy < n; iy++) {
-      for (size_t iz = 0; iz < n; iz++) {
-        i = ix * n * n + iy * n + iz;
-        Vector3<float> &b = grid->get(ix, iy, iz);
-        Bx[i][0] = b.x / rms;
-        By[i][0] = b.y / rms;
-        Bz[i][0] = b.z / rms;
-      }
-    }
+  size_t n2 = n / 2 + 1; // size of the complex array in z-direction
+
+#ifdef CRPROPA_HAVE_FFTW3F_OMP
+  static bool threadsInitialized = false;
+#pragma omp critical(crpropa_fftw_threads)
+  {
+    if (!threadsInitialized)
+      threadsInitialized = fftwf_init_threads();
   }
-
-  // in-place, real to complex, inverse Fourier transformation on each component
-  // note that the last elements of B(x) are unused now
-  fftwf_plan plan_x =
-      fftwf_plan_dft_3d(n, n, n, Bx, Bkx, FFTW_FORWARD, FFTW_ESTIMATE);
-  fftwf_execute(plan_x);
-  fftwf_destroy_plan(plan_x);
-
-  fftwf_plan plan_y =
-      fftwf_plan_dft_3d(n, n, n, By, Bky, FFTW_FORWARD, FFTW_ESTIMATE);
-  fftwf_execute(plan_y);
-  fftwf_destroy_plan(plan_y);
-
-  fftwf_plan plan_z =
-      fftwf_plan_dft_3d(n, n, n, Bz, Bkz, FFTW_FORWARD, FFTW_ESTIMATE);
-  fftwf_execute(plan_z);
-  fftwf_destroy_plan(plan_z);
-
-  float power;
-  std::map<size_t, std::pair<float, int>> spectrum;
-  int k;
-
-  for (size_t ix = 0; ix < n; ix++) {
-    for (size_t iy = 0; iy < n; iy++) {
-      for (size_t iz = 0; iz < n; iz++) {
-        i = ix * n * n + iy * n + iz;
-        k = static_cast<int>(
-            std::floor(std::sqrt(ix * ix + iy * iy + iz * iz)));
-        if (k > n / 2. || k == 0)
-          continue;
-        power = ((Bkx[i][0] * Bkx[i][0] + Bkx[i][1] * Bkx[i][1]) +
-                 (Bky[i][0] * Bky[i][0] + Bky[i][1] * Bky[i][1]) +
-                 (Bkz[i][0] * Bkz[i][0] + Bkz[i][1] * Bkz[i][1]));
-        if (spectrum.find(k) == spectrum.end()) {
-          spectrum[k].first = power;
-          spectrum[k].second = 1;
-        } else {
-          spectrum[k].first += power;
-          spectrum[k].second += 1;
+  fftwf_plan_with_nthreads(omp_get_max_threads());
+#endif
+
+  // one in-place array for one vector component at a time, see
+  // GridTurbulence::executeInverseFFTInplace for the padded real layout
+  fftwf_complex *Bk =
+      (fftwf_complex *)fftwf_malloc(sizeof(fftwf_complex) * n * n * n2);
+  float *B = (float *)Bk;
+  fftwf_plan plan = fftwf_plan_dft_r2c_3d(n, n, n, B, Bk, FFTW_ESTIMATE);
+
+  std::vector<double> power(n / 2 + 1, 0.);
+  std::vector<size_t> count(n / 2 + 1, 0);
+
+  for (int c = 0; c < 3; c++) {
+#pragma omp parallel for
+    for (size_t ix = 0; ix < n; ix++) {
+      for (size_t iy = 0; iy < n; iy++) {
+        for (size_t iz = 0; iz < n; iz++) {
+          size_t i = ix * n * 2 * n2 + iy * 2 * n2 + iz;
+          B[i] = grid->get(ix, iy, iz).data[c] / rms;
         }
       }
     }
+
+    // real to complex, forward Fourier transformation
+    fftwf_execute(plan);
+    binPowerSpectrum(Bk, n, power, (c == 0) ? &count : 0);
   }
 
-  fftwf_free(Bkx);
-  fftwf_free(Bky);
-  fftwf_free(Bkz);
+  fftwf_destroy_plan(plan);
+  fftwf_free(Bk);
 
   std::vector<std::pair<int, float>> points;
-  for (std::map<size_t, std::pair<float, int>>::iterator it = spectrum.begin();
-       it != spectrum.end(); ++it) {
-    points.push_back(
-        std::make_pair(it->first, (it->second).first / (it->second).second));
+  for (size_t k = 1; k < power.size(); k++) {
+    if (count[k] == 0)
+      continue;
+    points.push_back(std::make_pair(int(k), float(power[k] / count[k])));
   }
 
   return points;
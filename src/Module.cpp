@@ -1,5 +1,7 @@
 #include "crpropa/Module.h"
 
+#include <sstream>
+#include <stdexcept>
 #include <typeinfo>
 
 namespace crpropa {
@@ -17,6 +19,48 @@ void Module::setDescription(const std::string &d) {
 	description = d;
 }
 
+std::string Module::saveCheckpoint() {
+	return "";
+}
+
+void Module::loadCheckpoint(const std::string &) {
+}
+
+size_t Module::getBacklog() const {
+	return 0;
+}
+
+void Module::finishRun() {
+}
+
+std::string joinCheckpoints(const std::vector<std::string> &states) {
+	// number of states, then the length of each state followed by the state
+	std::stringstream ss;
+	ss << states.size() << "\n";
+	for (size_t i = 0; i < states.size(); i++)
+		ss << states[i].size() << "\n" << states[i] << "\n";
+	return ss.str();
+}
+
+std::vector<std::string> splitCheckpoints(const std::string &state) {
+	std::stringstream ss(state);
+	size_t n = 0;
+	if (!(ss >> n))
+		throw std::runtime_error("crpropa::splitCheckpoints: invalid checkpoint state");
+	std::vector<std::string> states(n);
+	for (size_t i = 0; i < n; i++) {
+		size_t length = 0;
+		if (!(ss >> length) || ss.get() != '\n')
+			throw std::runtime_error("crpropa::splitCheckpoints: invalid checkpoint state");
+		states[i].resize(length);
+		if (length > 0)
+			ss.read(&states[i][0], length);
+		if (!ss || ss.get() != '\n')
+			throw std::runtime_error("crpropa::splitCheckpoints: truncated checkpoint state");
+	}
+	return states;
+}
+
 AbstractCondition::AbstractCondition() :
 		makeRejectedInactive(true), makeAcceptedInactive(false), rejectFlagKey(
 				"Rejected") {
@@ -77,4 +121,39 @@ void AbstractCondition::setAcceptFlag(std::string key, std::string value) {
 	acceptFlagValue = value;
 }
 
+std::string AbstractCondition::saveCheckpoint() {
+	std::vector<std::string> states(2);
+	if (rejectAction.valid())
+		states[0] = rejectAction->saveCheckpoint();
+	if (acceptAction.valid())
+		states[1] = acceptAction->saveCheckpoint();
+	return joinCheckpoints(states);
+}
+
+void AbstractCondition::loadCheckpoint(const std::string &state) {
+	std::vector<std::string> states = splitCheckpoints(state);
+	if (states.size() != 2)
+		throw std::runtime_error("crpropa::AbstractCondition: checkpoint does not match");
+	if (rejectAction.valid())
+		rejectAction->loadCheckpoint(states[0]);
+	if (acceptAction.valid())
+		acceptAction->loadCheckpoint(states[1]);
+}
+
+size_t AbstractCondition::getBacklog() const {
+	size_t backlog = 0;
+	if (rejectAction.valid())
+		backlog += rejectAction->getBacklog();
+	if (acceptAction.valid())
+		backlog += acceptAction->getBacklog();
+	return backlog;
+}
+
+void AbstractCondition::finishRun() {
+	if (rejectAction.valid())
+		rejectAction->finishRun();
+	if (acceptAction.valid())
+		acceptAction->finishRun();
+}
+
 } // namespace crpropa
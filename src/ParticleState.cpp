@@ -54,9 +54,13 @@ void ParticleState::setId(int newId) {
 		charge = chargeNumber(id) * eplus;
 		if (id < 0)
 			charge *= -1; // anti-nucleus
+	} else if (id == 0 || id == 22 || abs(id) == 12 || abs(id) == 14 || abs(id) == 16) {
+		// photons and neutrinos dominate cascades, skip the HepPID lookup
+		charge = 0;
+	} else if (abs(id) == 11) {
+		pmass = mass_electron;
+		charge = (id > 0) ? -eplus : eplus;
 	} else {
-		if (abs(id) == 11)
-			pmass = mass_electron;
 		charge = HepPID::charge(id) * eplus;
 	}
 }
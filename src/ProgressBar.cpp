@@ -1,5 +1,6 @@
 #include "crpropa/ProgressBar.h"
 
+#include <algorithm>
 #include <cstdio>
 #include <iostream>
 
@@ -7,8 +8,8 @@ namespace crpropa {
 
 /// Initialize a ProgressBar with [steps] number of steps, updated at [updateSteps] intervalls
 ProgressBar::ProgressBar(unsigned long steps, unsigned long updateSteps) :
-		_steps(steps), _currentCount(0), _maxbarLength(10), _updateSteps(
-				updateSteps), _nextStep(1), _startTime(0) {
+		_steps(steps), _currentCount(0), _maxbarLength(10), _nextStep(1),
+		_updateSteps(updateSteps), _shownPosition(0), _startTime(0) {
 	if (_updateSteps > _steps)
 		_updateSteps = _steps;
 	arrow.append(">");
@@ -27,12 +28,28 @@ void ProgressBar::start(const std::string &title) {
 /// update the progressbar
 /// should be called steps times in a loop
 void ProgressBar::update() {
-	_currentCount++;
-	if (_currentCount == _nextStep || _currentCount == _steps
-			|| _currentCount == 1000) {
-				_nextStep += long(_steps / float(_updateSteps));
-			setPosition(_currentCount);
-			}
+	unsigned long count = ++_currentCount;
+	bool redraw = (count == _steps) || (count == 1000);
+
+	// the thread that passes the next update step moves it on and redraws
+	unsigned long next = _nextStep.load();
+	while (count >= next) {
+		unsigned long width = std::max(1L, long(_steps / float(_updateSteps)));
+		if (_nextStep.compare_exchange_weak(next, next + width)) {
+			redraw = true;
+			break;
+		}
+	}
+
+	if (redraw)
+#pragma omp critical(progressbarUpdate)
+	{
+		// a redraw of another thread may have shown a later position already
+		if (count > _shownPosition) {
+			_shownPosition = count;
+			setPosition(count);
+		}
+	}
 }
 
 void ProgressBar::setPosition(unsigned long position) {
@@ -69,7 +86,7 @@ void ProgressBar::setError() {
 	s.append(ctime(&currentTime));
 	char fs[255];
 	std::sprintf(fs, "%c[%d;%dm  ERROR   %c[%dm", 27, 1, 31, 27, 0);
-	std::printf(stringTmpl.c_str(), fs, _currentCount, "Needed",
+	std::printf(stringTmpl.c_str(), fs, int(_currentCount.load()), "Needed",
 			int(tElapsed / 3600), (int(tElapsed) % 3600) / 60,
 			int(tElapsed) % 60, s.c_str());
 }
@@ -62,6 +62,7 @@
 #include "crpropa/base64.h"
 
 #include <cstdio>
+#include <stdexcept>
 
 namespace crpropa {
 
@@ -497,6 +498,28 @@ std::vector< std::vector<uint32_t> > Random::getSeedThreads()
 	return seeds;
 }
 
+std::vector< std::vector<uint32_t> > Random::saveThreads(size_t n)
+{
+	if (n > MAX_THREAD)
+		throw std::runtime_error("crpropa::Random: more than MAX_THREAD threads!");
+	std::vector< std::vector<uint32_t> > states(n, std::vector<uint32_t>(SAVE));
+	for (size_t i = 0; i < n; ++i)
+		_tls[i].r.save(&states[i][0]);
+	return states;
+}
+
+void Random::loadThreads(const std::vector< std::vector<uint32_t> > &states)
+{
+	if (states.size() > MAX_THREAD)
+		throw std::runtime_error("crpropa::Random: more than MAX_THREAD threads!");
+	for (size_t i = 0; i < states.size(); ++i) {
+		std::vector<uint32_t> state(states[i]);
+		if (state.size() != SAVE)
+			throw std::runtime_error("crpropa::Random: invalid generator state");
+		_tls[i].r.load(&state[0]);
+	}
+}
+
 #else
 static Random _random;
 Random &Random::instance() {
@@ -511,6 +534,24 @@ std::vector< std::vector<uint32_t> > Random::getSeedThreads()
 		seeds.push_back(_random.getSeed() ); 
 	return seeds;
 }
+std::vector< std::vector<uint32_t> > Random::saveThreads(size_t n)
+{
+	std::vector< std::vector<uint32_t> > states;
+	if (n > 0) {
+		states.push_back(std::vector<uint32_t>(SAVE));
+		_random.save(&states[0][0]);
+	}
+	return states;
+}
+void Random::loadThreads(const std::vector< std::vector<uint32_t> > &states)
+{
+	if (states.empty())
+		return;
+	std::vector<uint32_t> state(states[0]);
+	if (state.size() != SAVE)
+		throw std::runtime_error("crpropa::Random: invalid generator state");
+	_random.load(&state[0]);
+}
 #endif
 
 const std::string Random::getSeed_base64() const
@@ -0,0 +1,75 @@
+#include "crpropa/RunTelemetry.h"
+
+#include <sstream>
+
+namespace crpropa {
+
+static void writeJSONArray(std::ostream &out, const std::vector<double> &values) {
+	out << "[";
+	for (size_t i = 0; i < values.size(); i++)
+		out << (i ? ", " : "") << values[i];
+	out << "]";
+}
+
+std::string RunTelemetry::toJSON() const {
+	std::stringstream ss;
+	ss.precision(9);
+	ss << "{\n";
+	ss << "  \"elapsed\": " << elapsed << ",\n";
+	ss << "  \"primaries\": " << primaries << ",\n";
+	ss << "  \"primariesFinished\": " << primariesFinished << ",\n";
+	ss << "  \"primariesPerSecond\": " << primariesPerSecond << ",\n";
+	ss << "  \"steps\": " << steps << ",\n";
+	ss << "  \"stepsPerSecond\": " << stepsPerSecond << ",\n";
+	ss << "  \"secondariesCreated\": " << secondariesCreated << ",\n";
+	ss << "  \"secondariesFinished\": " << secondariesFinished << ",\n";
+	ss << "  \"outputBacklog\": " << outputBacklog << ",\n";
+	ss << "  \"maxResidentMemory\": " << maxResidentMemory << ",\n";
+	ss << "  \"threadBusy\": ";
+	writeJSONArray(ss, threadBusy);
+	ss << ",\n  \"threadIdle\": ";
+	writeJSONArray(ss, threadIdle);
+	ss << "\n}\n";
+	return ss.str();
+}
+
+/** Help and type line of a metric, followed by its samples */
+static void writeMetricHeader(std::ostream &out, const std::string &name,
+		const std::string &type, const std::string &help) {
+	out << "# HELP crpropa_" << name << " " << help << "\n";
+	out << "# TYPE crpropa_" << name << " " << type << "\n";
+}
+
+template<typename T>
+static void writeMetric(std::ostream &out, const std::string &name,
+		const std::string &type, const std::string &help, T value) {
+	writeMetricHeader(out, name, type, help);
+	out << "crpropa_" << name << " " << value << "\n";
+}
+
+static void writeThreadMetric(std::ostream &out, const std::string &name,
+		const std::string &help, const std::vector<double> &values) {
+	writeMetricHeader(out, name, "counter", help);
+	for (size_t i = 0; i < values.size(); i++)
+		out << "crpropa_" << name << "{thread=\"" << i << "\"} " << values[i] << "\n";
+}
+
+std::string RunTelemetry::toPrometheus() const {
+	std::stringstream ss;
+	ss.precision(9);
+	writeMetric(ss, "elapsed_seconds", "gauge", "Time since the start of the run.", elapsed);
+	writeMetric(ss, "primaries", "gauge", "Number of primaries of the run.", primaries);
+	writeMetric(ss, "primaries_finished_total", "counter", "Propagated primaries.", primariesFinished);
+	writeMetric(ss, "primaries_per_second", "gauge", "Propagated primaries per second since the last update.", primariesPerSecond);
+	writeMetric(ss, "steps_total", "counter", "Propagation steps.", steps);
+	writeMetric(ss, "steps_per_second", "gauge", "Propagation steps per second since the last update.", stepsPerSecond);
+	writeMetric(ss, "secondaries_created_total", "counter", "Created secondaries.", secondariesCreated);
+	writeMetric(ss, "secondaries_finished_total", "counter", "Propagated secondaries.", secondariesFinished);
+	writeMetric(ss, "output_backlog", "gauge", "Buffered results of the outputs.", outputBacklog);
+	writeMetric(ss, "max_resident_memory_bytes", "gauge", "High-water mark of the resident memory.", maxResidentMemory);
+	writeThreadMetric(ss, "thread_busy_seconds_total", "Time a thread spent on primaries.", threadBusy);
+	writeThreadMetric(ss, "thread_idle_seconds_total", "Time a thread waited.", threadIdle);
+	return ss.str();
+}
+
+} // namespace crpropa
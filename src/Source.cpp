@@ -5,6 +5,8 @@
 #include "crpropa/Units.h"
 #include "crpropa/ParticleID.h"
 
+#include "kiss/logger.h"
+
 #ifdef CRPROPA_HAVE_MUPARSER
 #include "muParser.h"
 #endif
@@ -34,6 +36,10 @@ std::string Source::getDescription() const {
 	return ss.str();
 }
 
+const std::vector<ref_ptr<SourceFeature> > &Source::getFeatures() const {
+	return features;
+}
+
 // SourceList------------------------------------------------------------------
 void SourceList::add(Source* source, double weight) {
 	sources.push_back(source);
@@ -57,6 +63,105 @@ std::string SourceList::getDescription() const {
 	return ss.str();
 }
 
+const std::vector<ref_ptr<Source> > &SourceList::getSources() const {
+	return sources;
+}
+
+// SourceFromArrays -----------------------------------------------------------
+SourceFromArrays::SourceFromArrays() : next(0) {
+}
+
+void SourceFromArrays::add(int id, double energy, Vector3d position,
+		Vector3d direction, double weight) {
+	ids.push_back(id);
+	energies.push_back(energy);
+	positions.push_back(position);
+	directions.push_back(direction);
+	weights.push_back(weight);
+}
+
+void SourceFromArrays::setArrays(size_t n, const int *id, const double *energy,
+		const double *position, const double *direction, const double *weight) {
+	size_t offset = ids.size();
+	ids.insert(ids.end(), id, id + n);
+	energies.insert(energies.end(), energy, energy + n);
+	positions.resize(offset + n);
+	directions.resize(offset + n);
+	weights.resize(offset + n, 1.);
+	for (size_t i = 0; i < n; i++) {
+		const double *x = position + 3 * i;
+		const double *p = direction + 3 * i;
+		positions[offset + i] = Vector3d(x[0], x[1], x[2]);
+		directions[offset + i] = Vector3d(p[0], p[1], p[2]);
+		if (weight)
+			weights[offset + i] = weight[i];
+	}
+}
+
+size_t SourceFromArrays::size() const {
+	return ids.size();
+}
+
+size_t SourceFromArrays::remaining() const {
+	return (next < ids.size()) ? ids.size() - next : 0;
+}
+
+void SourceFromArrays::reset() {
+	next = 0;
+}
+
+std::string SourceFromArrays::saveCheckpoint() const {
+	std::stringstream ss;
+	ss << next;
+	return ss.str();
+}
+
+void SourceFromArrays::loadCheckpoint(const std::string &state) {
+	std::stringstream ss(state);
+	if (!(ss >> next))
+		throw std::runtime_error("SourceFromArrays: invalid checkpoint state");
+}
+
+void SourceFromArrays::clear() {
+	ids.clear();
+	energies.clear();
+	positions.clear();
+	directions.clear();
+	weights.clear();
+	next = 0;
+}
+
+ref_ptr<Candidate> SourceFromArrays::getCandidate() const {
+	size_t i;
+#if defined(OPENMP_3_1)
+	#pragma omp atomic capture
+	{i = next++;}
+#elif defined(__GNUC__)
+	i = __sync_fetch_and_add(&next, 1);
+#else
+	#pragma omp critical
+	{i = next++;}
+#endif
+	if (i >= ids.size()) {
+		// exactly one thread takes the first index past the end
+		if (i == ids.size()) {
+			KISS_LOG_WARNING << "SourceFromArrays: all " << ids.size()
+					<< " particles have been emitted, no further candidates";
+		}
+		return 0;
+	}
+
+	return new Candidate(ids[i], energies[i], positions[i], directions[i], 0,
+			weights[i]);
+}
+
+std::string SourceFromArrays::getDescription() const {
+	std::stringstream ss;
+	ss << "Source emitting " << ids.size() << " particles from arrays, "
+			<< remaining() << " remaining\n";
+	return ss.str();
+}
+
 // SourceFeature---------------------------------------------------------------
 void SourceFeature::prepareCandidate(Candidate& candidate) const {
 	ParticleState &source = candidate.source;
@@ -635,23 +740,45 @@ void SourcePulsarDistribution::setDescription() {
 }
 
 // ----------------------------------------------------------------------------
-SourceUniform1D::SourceUniform1D(double minD, double maxD, bool withCosmology) {
-	this->withCosmology = withCosmology;
-	if (withCosmology) {
-		this->minD = comoving2LightTravelDistance(minD);
-		this->maxD = comoving2LightTravelDistance(maxD);
+SourceUniform1D::SourceUniform1D(double minD, double maxD, bool withCosmology,
+		ref_ptr<Cosmology> cosmology) :
+		minDistance(minD), maxDistance(maxD), withCosmology(withCosmology),
+		cosmology(cosmology) {
+	updateDistances();
+}
+
+void SourceUniform1D::updateDistances() {
+	if (not withCosmology) {
+		minD = minDistance;
+		maxD = maxDistance;
+	} else if (cosmology.valid()) {
+		minD = cosmology->comoving2LightTravelDistance(minDistance);
+		maxD = cosmology->comoving2LightTravelDistance(maxDistance);
 	} else {
-		this->minD = minD;
-		this->maxD = maxD;
+		minD = comoving2LightTravelDistance(minDistance);
+		maxD = comoving2LightTravelDistance(maxDistance);
 	}
 	setDescription();
 }
 
+void SourceUniform1D::setCosmology(ref_ptr<Cosmology> cosmology) {
+	this->cosmology = cosmology;
+	updateDistances();
+}
+
+ref_ptr<Cosmology> SourceUniform1D::getCosmology() const {
+	return cosmology;
+}
+
 void SourceUniform1D::prepareParticle(ParticleState& particle) const {
 	Random& random = Random::instance();
 	double d = random.rand() * (maxD - minD) + minD;
-	if (withCosmology)
-		d = lightTravel2ComovingDistance(d);
+	if (withCosmology) {
+		if (cosmology.valid())
+			d = cosmology->lightTravel2ComovingDistance(d);
+		else
+			d = lightTravel2ComovingDistance(d);
+	}
 	particle.setPosition(Vector3d(d, 0, 0));
 }
 
@@ -927,14 +1054,28 @@ void SourceRedshiftEvolution::prepareCandidate(Candidate& candidate) const {
 }
 
 // ----------------------------------------------------------------------------
-SourceRedshift1D::SourceRedshift1D() {
+SourceRedshift1D::SourceRedshift1D(ref_ptr<Cosmology> cosmology) :
+		cosmology(cosmology) {
 	setDescription();
 }
 
+void SourceRedshift1D::setCosmology(ref_ptr<Cosmology> cosmology) {
+	this->cosmology = cosmology;
+}
+
+ref_ptr<Cosmology> SourceRedshift1D::getCosmology() const {
+	return cosmology;
+}
+
 void SourceRedshift1D::prepareCandidate(Candidate& candidate) const {
 	double d = candidate.source.getPosition().getR();
-	double z = comovingDistance2Redshift(d);
-	candidate.setRedshift(z);
+	if (not cosmology.valid()) {
+		candidate.setRedshift(comovingDistance2Redshift(d));
+		return;
+	}
+	if (d > cosmology->getMaximumComovingDistance())
+		throw std::runtime_error("Cosmology: d > dmax");
+	candidate.setRedshift(cosmology->comovingDistance2Redshift(d));
 }
 
 void SourceRedshift1D::setDescription() {
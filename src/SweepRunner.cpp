@@ -0,0 +1,149 @@
+#include "crpropa/SweepRunner.h"
+#include "crpropa/ProgressBar.h"
+#include "crpropa/Random.h"
+#include "crpropa/RunGuard.h"
+
+#include "kiss/logger.h"
+
+#if _OPENMP
+#include <omp.h>
+#endif
+
+#include <algorithm>
+#include <stdexcept>
+
+namespace crpropa {
+
+SweepRunner::SweepRunner(ModuleList *modules) :
+		modules(modules), count(0), showProgress(false), seed(0) {
+	if (modules == 0)
+		throw std::runtime_error("SweepRunner: no modules given");
+}
+
+size_t SweepRunner::add(SourceInterface *source, size_t count, Module *modules) {
+	if (source == 0)
+		throw std::runtime_error("SweepRunner: no source given");
+	Configuration c;
+	c.source = source;
+	c.modules = new ModuleList();
+	c.modules->add(this->modules);
+	if (modules)
+		c.modules->add(modules);
+	c.first = this->count;
+	configurations.push_back(c);
+	this->count += count;
+	return configurations.size() - 1;
+}
+
+size_t SweepRunner::size() const {
+	return configurations.size();
+}
+
+size_t SweepRunner::getCount() const {
+	return count;
+}
+
+ref_ptr<ModuleList> SweepRunner::getModules() const {
+	return modules;
+}
+
+ref_ptr<ModuleList> SweepRunner::getModules(size_t configuration) const {
+	if (configuration >= configurations.size())
+		throw std::runtime_error("SweepRunner: configuration index out of range");
+	return configurations[configuration].modules;
+}
+
+void SweepRunner::setShowProgress(bool show) {
+	showProgress = show;
+}
+
+void SweepRunner::setSeed(uint32_t seed) {
+	this->seed = seed;
+}
+
+uint32_t SweepRunner::getSeed() const {
+	return seed;
+}
+
+int SweepRunner::getNumberOfThreads() const {
+#if _OPENMP
+	int threads = omp_get_max_threads();
+#else
+	int threads = 1;
+#endif
+	bool directors = false;
+	for (size_t i = 0; (i < configurations.size()) and not directors; i++)
+		directors = configurations[i].modules->hasDirectors(configurations[i].source);
+	if (not directors)
+		return threads;
+
+	// the policy of the shared modules applies to the whole run
+	ModuleList::DirectorPolicy policy = modules->getDirectorPolicy();
+	if (policy == ModuleList::RefuseDirectors)
+		throw std::runtime_error("SweepRunner: modules or source features "
+				"implemented in Python cannot run in parallel");
+	if (policy == ModuleList::SerializeDirectors)
+		return 1;
+	KISS_LOG_WARNING << "SweepRunner: modules or source features implemented "
+			"in Python are serialized by the Python interpreter lock. The run will "
+			"not scale with the number of threads.";
+	return threads;
+}
+
+void SweepRunner::run(bool recursive, bool secondariesFirst) {
+	int threads = getNumberOfThreads();
+	uint64_t serialNumbers = modules->getSerialNumbersPerPrimary();
+	if (seed)
+		Candidate::reserveSerialNumberRanges(count, serialNumbers);
+
+	// index of the first primary of each configuration
+	std::vector<size_t> firsts(configurations.size());
+	for (size_t i = 0; i < configurations.size(); i++)
+		firsts[i] = configurations[i].first;
+
+	ProgressBar progressbar(count);
+	if (showProgress)
+		progressbar.start("Run SweepRunner");
+
+	RunGuard guard;
+
+	long n = count;
+#pragma omp parallel for schedule(dynamic, 1) num_threads(threads)
+	for (long i = 0; i < n; i++) {
+		if (RunGuard::stopped())
+			continue;
+
+		// the last configuration starting at or before i, skipping empty ones
+		size_t k = std::upper_bound(firsts.begin(), firsts.end(), (size_t) i) - firsts.begin() - 1;
+		const Configuration &c = configurations[k];
+
+		if (seed) {
+			size_t primary = i - c.first;
+			uint32_t key[4] = {seed, (uint32_t) k,
+					(uint32_t)((uint64_t) primary & 0xffffffff), (uint32_t)((uint64_t) primary >> 32)};
+			Random::instance().seed(key, 4);
+			// serial numbers independent of the order of the primaries, see ModuleList::runShard
+			Candidate::setThreadSerialNumberRange(1 + i * serialNumbers, serialNumbers);
+		}
+
+		try {
+			// a source with a limited number of particles may run out
+			ref_ptr<Candidate> candidate = c.source->getCandidate();
+			if (candidate.valid())
+				c.modules->run(candidate, recursive, secondariesFirst);
+		} catch (std::exception &e) {
+			RunGuard::stop("crpropa::SweepRunner::run: ", e);
+		}
+
+		if (seed)
+			Candidate::setThreadSerialNumberRange(0, 0);
+
+		if (showProgress)
+			progressbar.update();
+	}
+
+	for (size_t i = 0; i < configurations.size(); i++)
+		configurations[i].modules->finishRun();
+}
+
+} // namespace crpropa
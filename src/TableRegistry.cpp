@@ -0,0 +1,219 @@
+#include "crpropa/TableRegistry.h"
+#include "crpropa/Units.h"
+#include "crpropa/module/EMDoublePairProduction.h"
+#include "crpropa/module/EMInverseComptonScattering.h"
+#include "crpropa/module/EMPairProduction.h"
+#include "crpropa/module/EMTripletPairProduction.h"
+
+#include <sys/stat.h>
+
+#include <cmath>
+#include <fstream>
+#include <limits>
+#include <map>
+#include <sstream>
+#include <stdexcept>
+
+namespace crpropa {
+
+// Readers ---------------------------------------------------------------------
+static RateTable *readRateTable(const std::string &filename) {
+	std::ifstream infile(filename.c_str());
+	if (!infile.good())
+		throw std::runtime_error("TableRegistry: could not open file " + filename);
+
+	RateTable *table = new RateTable();
+	while (infile.good()) {
+		if (infile.peek() != '#') {
+			double a, b;
+			infile >> a >> b;
+			if (infile) {
+				table->energy.push_back(pow(10, a) * eV);
+				table->rate.push_back(b / Mpc);
+			}
+		}
+		infile.ignore(std::numeric_limits < std::streamsize > ::max(), '\n');
+	}
+	return table;
+}
+
+static RedshiftRateTable *readRedshiftRateTable(const std::string &prefix) {
+	std::string energyFile = prefix + "energies.txt";
+	std::string zFile = prefix + "redshifts.txt";
+	std::string rateFile = prefix + "rates.txt";
+
+	std::ifstream energies(energyFile.c_str());
+	if (!energies.good())
+		throw std::runtime_error("TableRegistry: could not open energy file " + energyFile);
+	std::ifstream redshifts(zFile.c_str());
+	if (!redshifts.good())
+		throw std::runtime_error("TableRegistry: could not open redshift file " + zFile);
+	std::ifstream rates(rateFile.c_str());
+	if (!rates.good())
+		throw std::runtime_error("TableRegistry: could not open rate file " + rateFile);
+
+	RedshiftRateTable *table = new RedshiftRateTable();
+	double a;
+	while (energies >> a)
+		table->energy.push_back(pow(10, a) * eV);
+	while (redshifts >> a)
+		table->redshift.push_back(a);
+	while (rates >> a)
+		table->rate.push_back(a / Mpc);
+	return table;
+}
+
+static CumulativeRateTable *readCumulativeRateTable(const std::string &filename) {
+	std::ifstream infile(filename.c_str());
+	if (!infile.good())
+		throw std::runtime_error("TableRegistry: could not open file " + filename);
+
+	CumulativeRateTable *table = new CumulativeRateTable();
+
+	// skip header
+	while (infile.peek() == '#')
+		infile.ignore(std::numeric_limits < std::streamsize > ::max(), '\n');
+
+	// read s values in first line
+	double a;
+	infile >> a; // skip first value
+	while (infile.good() and (infile.peek() != '\n')) {
+		infile >> a;
+		table->s.push_back(pow(10, a) * eV * eV);
+	}
+
+	// read all following lines: E, cdf values
+	while (infile.good()) {
+		infile >> a;
+		if (!infile)
+			break;  // end of file
+		table->energy.push_back(pow(10, a) * eV);
+		std::vector<double> cdf;
+		for (size_t i = 0; i < table->s.size(); i++) {
+			infile >> a;
+			cdf.push_back(a / Mpc);
+		}
+		table->cdf.push_back(cdf);
+	}
+	return table;
+}
+
+// Cache -----------------------------------------------------------------------
+struct TableEntry {
+	std::string version;
+	ref_ptr<const Referenced> table;
+};
+
+static std::map<std::string, TableEntry> &tableEntries() {
+	static std::map<std::string, TableEntry> entries;
+	return entries;
+}
+
+// modification time and size of the files, empty if one is missing
+static std::string fileVersion(const std::vector<std::string> &filenames) {
+	std::stringstream version;
+	for (size_t i = 0; i < filenames.size(); i++) {
+		struct stat s;
+		if (stat(filenames[i].c_str(), &s) != 0)
+			return "";
+		version << s.st_mtime << ":" << s.st_size << ";";
+	}
+	return version.str();
+}
+
+template<class T>
+static ref_ptr<const T> getTable(const std::string &kind, const std::string &name,
+		const std::vector<std::string> &files, T *(*read)(const std::string &)) {
+	std::string key = kind + ":" + name;
+	std::string version = fileVersion(files);
+
+	ref_ptr<const Referenced> cached;
+#pragma omp critical(TableRegistry)
+	{
+		std::map<std::string, TableEntry>::const_iterator i = tableEntries().find(key);
+		if ((i != tableEntries().end()) and (i->second.version == version))
+			cached = i->second.table;
+	}
+	if (cached.valid())
+		return static_cast<const T *>(cached.get());
+
+	// read outside of the lock, so that different tables are read in parallel
+	ref_ptr<const T> table = read(name);
+
+#pragma omp critical(TableRegistry)
+	{
+		TableEntry &entry = tableEntries()[key];
+		if (entry.table.valid() and (entry.version == version)) {
+			// read by another thread in the meantime, share its copy
+			table = static_cast<const T *>(entry.table.get());
+		} else {
+			entry.version = version;
+			entry.table = table.get();
+		}
+	}
+	return table;
+}
+
+ref_ptr<const RateTable> TableRegistry::getRateTable(const std::string &filename) {
+	return getTable<RateTable>("rate", filename,
+			std::vector<std::string>(1, filename), readRateTable);
+}
+
+ref_ptr<const RedshiftRateTable> TableRegistry::getRedshiftRateTable(const std::string &prefix) {
+	std::vector<std::string> files;
+	files.push_back(prefix + "energies.txt");
+	files.push_back(prefix + "redshifts.txt");
+	files.push_back(prefix + "rates.txt");
+	return getTable<RedshiftRateTable>("redshiftRate", prefix, files,
+			readRedshiftRateTable);
+}
+
+ref_ptr<const CumulativeRateTable> TableRegistry::getCumulativeRateTable(const std::string &filename) {
+	return getTable<CumulativeRateTable>("cdf", filename,
+			std::vector<std::string>(1, filename), readCumulativeRateTable);
+}
+
+void TableRegistry::prefetch(const std::vector<ref_ptr<PhotonField> > &photonFields) {
+	// constructing the modules reads their tables into the registry
+	int n = photonFields.size() * 4;
+	std::string error;
+#pragma omp parallel for schedule(dynamic, 1)
+	for (int i = 0; i < n; i++) {
+		try {
+			ref_ptr<PhotonField> field = photonFields[i / 4];
+			ref_ptr<Module> module;
+			switch (i % 4) {
+			case 0:
+				module = new EMPairProduction(field);
+				break;
+			case 1:
+				module = new EMDoublePairProduction(field);
+				break;
+			case 2:
+				module = new EMTripletPairProduction(field);
+				break;
+			default:
+				module = new EMInverseComptonScattering(field);
+			}
+		} catch (std::exception &e) {
+#pragma omp critical(TableRegistryError)
+			error = e.what();
+		}
+	}
+	if (!error.empty())
+		throw std::runtime_error(error);
+}
+
+size_t TableRegistry::size() {
+	size_t n;
+#pragma omp critical(TableRegistry)
+	n = tableEntries().size();
+	return n;
+}
+
+void TableRegistry::clear() {
+#pragma omp critical(TableRegistry)
+	tableEntries().clear();
+}
+
+} // namespace crpropa
@@ -0,0 +1,159 @@
+#include "crpropa/WeightWindow.h"
+#include "crpropa/Random.h"
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+namespace crpropa {
+
+WeightWindow::WeightWindow(double minEnergy, double maxEnergy, size_t nEnergyBins,
+		double maxDistance, size_t nDistanceBins) :
+		minEnergy(minEnergy), maxDistance(maxDistance), nEnergyBins(nEnergyBins),
+		nDistanceBins(nDistanceBins), width(2), maximumSplit(10),
+		particlesPerCell(1), warmup(false) {
+	if ((nEnergyBins == 0) or (minEnergy <= 0) or (maxEnergy <= minEnergy))
+		throw std::runtime_error("WeightWindow: invalid energy grid");
+	if ((nDistanceBins == 0) or (maxDistance < 0) or ((maxDistance == 0) and (nDistanceBins > 1)))
+		throw std::runtime_error("WeightWindow: invalid distance grid");
+	logStep = log(maxEnergy / minEnergy) / nEnergyBins;
+	targets.assign(nEnergyBins * nDistanceBins, 0.);
+}
+
+void WeightWindow::setOrigin(const Vector3d &origin) {
+	this->origin = origin;
+}
+
+Vector3d WeightWindow::getOrigin() const {
+	return origin;
+}
+
+void WeightWindow::setWidth(double width) {
+	if (width < 1)
+		throw std::runtime_error("WeightWindow: width must be at least 1");
+	this->width = width;
+}
+
+double WeightWindow::getWidth() const {
+	return width;
+}
+
+void WeightWindow::setMaximumSplit(size_t n) {
+	if (n == 0)
+		throw std::runtime_error("WeightWindow: at least one copy needed");
+	maximumSplit = n;
+}
+
+size_t WeightWindow::getMaximumSplit() const {
+	return maximumSplit;
+}
+
+void WeightWindow::setParticlesPerCell(double n) {
+	if (n <= 0)
+		throw std::runtime_error("WeightWindow: particles per cell must be positive");
+	particlesPerCell = n;
+}
+
+double WeightWindow::getParticlesPerCell() const {
+	return particlesPerCell;
+}
+
+size_t WeightWindow::getEnergyBins() const {
+	return nEnergyBins;
+}
+
+size_t WeightWindow::getDistanceBins() const {
+	return nDistanceBins;
+}
+
+size_t WeightWindow::getCell(double energy, double distance) const {
+	size_t outside = nEnergyBins * nDistanceBins;
+	if (energy < minEnergy)
+		return outside;
+	size_t e = log(energy / minEnergy) / logStep;
+	if (e >= nEnergyBins)
+		return outside;
+	size_t d = 0;
+	if (maxDistance > 0) {
+		if ((distance < 0) or (distance >= maxDistance))
+			return outside;
+		d = std::min(size_t(distance / maxDistance * nDistanceBins), nDistanceBins - 1);
+	}
+	return d * nEnergyBins + e;
+}
+
+double WeightWindow::getTargetWeight(size_t energyBin, size_t distanceBin) const {
+	if ((energyBin >= nEnergyBins) or (distanceBin >= nDistanceBins))
+		throw std::runtime_error("WeightWindow: cell index out of range");
+	return targets[distanceBin * nEnergyBins + energyBin];
+}
+
+void WeightWindow::setTargetWeight(size_t energyBin, size_t distanceBin, double weight) {
+	if ((energyBin >= nEnergyBins) or (distanceBin >= nDistanceBins))
+		throw std::runtime_error("WeightWindow: cell index out of range");
+	targets[distanceBin * nEnergyBins + energyBin] = weight;
+}
+
+void WeightWindow::startWarmup() {
+	std::fill(targets.begin(), targets.end(), 0.);
+	warmupWeights.assign(targets.size(), 0.);
+	warmup = true;
+}
+
+void WeightWindow::finishWarmup(size_t primaries) {
+	if (not warmup)
+		throw std::runtime_error("WeightWindow: no warm-up started");
+	if (primaries == 0)
+		throw std::runtime_error("WeightWindow: no primaries in the warm-up");
+	// weight per primary divided among the aimed candidates
+	for (size_t i = 0; i < targets.size(); i++)
+		targets[i] = warmupWeights[i] / primaries / particlesPerCell;
+	warmupWeights.clear();
+	warmup = false;
+}
+
+bool WeightWindow::isWarmup() const {
+	return warmup;
+}
+
+void WeightWindow::addSecondary(Candidate *candidate, int id, double energy,
+		const Vector3d &position, double probability, const std::string &tag, double weight) const {
+	Random &random = Random::instance();
+	size_t cell = getCell(energy, (position - origin).getR());
+	bool inside = cell < targets.size();
+
+	if (warmup and inside) {
+		// expected weight, independent of the thinning
+		double w = candidate->getWeight() * weight;
+		#pragma omp atomic
+		warmupWeights[cell] += w;
+	}
+
+	double target = inside ? targets[cell] : 0;
+	if (warmup or (target <= 0)) {
+		// thinning of the module
+		if ((probability < 1) and (random.rand() >= probability))
+			return;
+		candidate->addSecondary(id, energy, position, weight / probability, tag);
+		return;
+	}
+
+	// relative weights, the parent weight is multiplied by the Candidate
+	double parentWeight = candidate->getWeight();
+	double w = parentWeight * weight;
+	if (w < target / width) {
+		// Russian roulette
+		if (random.rand() >= w / target)
+			return;
+		candidate->addSecondary(id, energy, position, target / parentWeight, tag);
+	} else if (w > target * width) {
+		// split into copies of about the target weight
+		size_t n = std::min(size_t(ceil(w / target)), maximumSplit);
+		for (size_t i = 0; i < n; i++)
+			candidate->addSecondary(id, energy, position, weight / n, tag);
+	} else {
+		candidate->addSecondary(id, energy, position, weight, tag);
+	}
+}
+
+} // namespace crpropa
@@ -107,6 +107,35 @@ Vector3d RenormalizeMagneticField::getField(const Vector3d &position) {
 	Bmag = B.getR();
 	return B * p->Eval();
 }
+
+static std::vector<std::string> expressionMagneticFieldVariables() {
+	std::vector<std::string> v;
+	v.push_back("x");
+	v.push_back("y");
+	v.push_back("z");
+	v.push_back("r");
+	v.push_back("redshift");
+	return v;
+}
+
+ExpressionMagneticField::ExpressionMagneticField(const std::string &Bx,
+		const std::string &By, const std::string &Bz) {
+	std::vector<std::string> variables = expressionMagneticFieldVariables();
+	this->Bx = new Expression(Bx, variables);
+	this->By = new Expression(By, variables);
+	this->Bz = new Expression(Bz, variables);
+}
+
+Vector3d ExpressionMagneticField::getField(const Vector3d &position) const {
+	return getField(position, 0);
+}
+
+Vector3d ExpressionMagneticField::getField(const Vector3d &position,
+		double z) const {
+	double values[5] = {position.x, position.y, position.z, position.getR(), z};
+	return Vector3d(Bx->evaluate(values), By->evaluate(values),
+			Bz->evaluate(values));
+}
 #endif
 
 } // namespace crpropa
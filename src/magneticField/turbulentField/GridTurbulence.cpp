@@ -204,6 +204,60 @@ std::vector<std::pair<int, float>> GridTurbulence::getPowerSpectrum() const {
 	return gridPowerSpectrum(gridPtr);
 }
 
+double GridTurbulence::getPowerSpectrumDeviation() const {
+	std::vector<std::pair<int, float>> measured = getPowerSpectrum();
+
+	size_t n = gridPtr->getNx();
+	Vector3d spacing = gridPtr->getSpacing();
+	double kMin = spacing.x / spectrum.getLmax();
+	double kMax = spacing.x / spectrum.getLmin();
+	double lambda = 1 / spacing.x * 2 * M_PI;
+
+	// expected power per mode in the shells of gridPowerSpectrum, see initTurbulence
+	size_t kmax = n / 2;
+	std::vector<double> expected(kmax + 1, 0.);
+	std::vector<size_t> count(kmax + 1, 0);
+	for (size_t ix = 0; ix <= kmax; ix++) {
+		for (size_t iy = 0; iy <= kmax; iy++) {
+			for (size_t iz = 0; iz <= kmax; iz++) {
+				double r = std::sqrt(double(ix * ix + iy * iy + iz * iz));
+				size_t k = static_cast<size_t>(std::floor(r));
+				if (k > kmax || k == 0)
+					continue;
+				count[k] += 1;
+				double kk = r / n;
+				if ((kk < kMin) || (kk > kMax))
+					continue;
+				// the complex to real transform symmetrizes the modes in the
+				// planes iz = 0 and iz = n/2, which keeps half of their power
+				double w = ((iz == 0) || (2 * iz == n)) ? 0.5 : 1.;
+				expected[k] += w * spectrum.energySpectrum(kk * lambda);
+			}
+		}
+	}
+
+	// the normalization is arbitrary: fit it by least squares over the modes
+	double sumME = 0, sumEE = 0;
+	for (size_t i = 0; i < measured.size(); i++) {
+		size_t k = measured[i].first;
+		double e = expected[k] / count[k];
+		sumME += count[k] * measured[i].second * e;
+		sumEE += count[k] * e * e;
+	}
+	if (sumEE == 0)
+		throw std::runtime_error("GridTurbulence: no modes in the turbulent range");
+	double a = sumME / sumEE;
+
+	double deviation = 0, total = 0;
+	for (size_t i = 0; i < measured.size(); i++) {
+		size_t k = measured[i].first;
+		double e = a * expected[k] / count[k];
+		deviation += count[k] * std::fabs(measured[i].second - e);
+		total += count[k] * e;
+	}
+	return deviation / total;
+}
+
 void GridTurbulence::dumpToFile(std::string filename) const {
 	dumpGrid(gridPtr, filename);
 }
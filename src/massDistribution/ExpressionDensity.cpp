@@ -0,0 +1,82 @@
+#include "crpropa/massDistribution/ExpressionDensity.h"
+
+#ifdef CRPROPA_HAVE_MUPARSER
+#include <cmath>
+#include <sstream>
+
+namespace crpropa {
+
+static std::vector<std::string> expressionDensityVariables() {
+	std::vector<std::string> v;
+	v.push_back("x");
+	v.push_back("y");
+	v.push_back("z");
+	v.push_back("r");
+	v.push_back("rho");
+	return v;
+}
+
+ExpressionDensity::ExpressionDensity(const std::string &HI,
+		const std::string &HII, const std::string &H2) {
+	std::vector<std::string> variables = expressionDensityVariables();
+	if (!HI.empty())
+		this->HI = new Expression(HI, variables);
+	if (!HII.empty())
+		this->HII = new Expression(HII, variables);
+	if (!H2.empty())
+		this->H2 = new Expression(H2, variables);
+}
+
+double ExpressionDensity::evaluate(const ref_ptr<Expression> &expression,
+		const Vector3d &position) const {
+	if (!expression.valid())
+		return 0;
+	double values[5] = {position.x, position.y, position.z, position.getR(),
+			std::sqrt(position.x * position.x + position.y * position.y)};
+	return expression->evaluate(values);
+}
+
+double ExpressionDensity::getDensity(const Vector3d &position) const {
+	return getHIDensity(position) + getHIIDensity(position) + getH2Density(position);
+}
+
+double ExpressionDensity::getHIDensity(const Vector3d &position) const {
+	return evaluate(HI, position);
+}
+
+double ExpressionDensity::getHIIDensity(const Vector3d &position) const {
+	return evaluate(HII, position);
+}
+
+double ExpressionDensity::getH2Density(const Vector3d &position) const {
+	return evaluate(H2, position);
+}
+
+double ExpressionDensity::getNucleonDensity(const Vector3d &position) const {
+	return getHIDensity(position) + getHIIDensity(position) + 2 * getH2Density(position);
+}
+
+bool ExpressionDensity::getIsForHI() {
+	return HI.valid();
+}
+
+bool ExpressionDensity::getIsForHII() {
+	return HII.valid();
+}
+
+bool ExpressionDensity::getIsForH2() {
+	return H2.valid();
+}
+
+std::string ExpressionDensity::getDescription() {
+	std::stringstream s;
+	s << "ExpressionDensity:\n";
+	s << "HI: " << (HI.valid() ? HI->getExpression() : "not active") << "\n";
+	s << "HII: " << (HII.valid() ? HII->getExpression() : "not active") << "\n";
+	s << "H2: " << (H2.valid() ? H2->getExpression() : "not active");
+	return s.str();
+}
+
+}  // namespace crpropa
+
+#endif // CRPROPA_HAVE_MUPARSER
@@ -173,10 +173,8 @@ void ParticleSplitting::process(Candidate *candidate) const {
 		// No recursive split as the weights of the secondaries created
 		// before the split are not affected
 		ref_ptr<Candidate> new_candidate = candidate->clone(false);
+		// the clone has its own serial number, taken when it was created
 		new_candidate->parent = candidate;
-		uint64_t snr = Candidate::getNextSerialNumber();
-		Candidate::setNextSerialNumber(snr + 1);
-		new_candidate->setSerialNumber(snr);
 		candidate->addSecondary(new_candidate);
 	}
 };
@@ -263,5 +263,56 @@ void DetectionLength::process(Candidate *c) const {
 	}
 }
 
+//*****************************************************************************
+#ifdef CRPROPA_HAVE_MUPARSER
+ExpressionCondition::ExpressionCondition(const std::string &expression) {
+	setExpression(expression);
+}
+
+void ExpressionCondition::setExpression(const std::string &expression) {
+	std::vector<std::string> variables;
+	variables.push_back("E");
+	variables.push_back("id");
+	variables.push_back("A");
+	variables.push_back("Z");
+	variables.push_back("x");
+	variables.push_back("y");
+	variables.push_back("z");
+	variables.push_back("r");
+	variables.push_back("D");
+	variables.push_back("redshift");
+	variables.push_back("w");
+	this->expression = new Expression(expression, variables);
+}
+
+std::string ExpressionCondition::getExpression() const {
+	return expression->getExpression();
+}
+
+std::string ExpressionCondition::getDescription() const {
+	std::stringstream s;
+	s << "Expression condition: '" << expression->getExpression() << "', ";
+	s << "Flag: '" << rejectFlagKey << "' -> '" << rejectFlagValue << "', ";
+	s << "MakeInactive: " << (makeRejectedInactive ? "yes" : "no");
+	if (rejectAction.valid())
+		s << ", Action: " << rejectAction->getDescription();
+	return s.str();
+}
+
+void ExpressionCondition::process(Candidate *c) const {
+	const ParticleState &state = c->current;
+	int id = state.getId();
+	const Vector3d &position = state.getPosition();
+	double values[11] = {state.getEnergy(), (double) id,
+			(double) massNumber(id), (double) chargeNumber(id),
+			position.x, position.y, position.z, position.getR(),
+			c->getTrajectoryLength(), c->getRedshift(), c->getWeight()};
+
+	if (expression->evaluate(values) != 0)
+		reject(c);
+	else
+		accept(c);
+}
+#endif
 
 } // namespace crpropa
@@ -1,5 +1,7 @@
 #include "crpropa/module/DiffusionSDE.h"
+#include "crpropa/Common.h"
 
+#include <limits>
 
 using namespace crpropa;
 
@@ -16,11 +18,14 @@ const double b[] = { 37. / 378., 0, 250. / 621., 125. / 594., 0., 512.
 const double bs[] = { 2825. / 27648., 0., 18575. / 48384., 13525.
 		/ 55296., 277. / 14336., 1. / 4. };
 
+// doubles per thread in the diffusion tensor cache, one cache line
+const static size_t TENSOR_CACHE_STRIDE = 8;
+static_assert(TENSOR_CACHE_STRIDE * sizeof(double) == 64, "tensor cache stride must be one cache line");
 
 
 DiffusionSDE::DiffusionSDE(ref_ptr<MagneticField> magneticField, double tolerance,
 				 double minStep, double maxStep, double epsilon) :
-	minStep(0)
+	minStep(0), tensorCache(MAX_THREAD * TENSOR_CACHE_STRIDE)
 {
   	setMagneticField(magneticField);
   	setMaximumStep(maxStep);
@@ -32,7 +37,7 @@ DiffusionSDE::DiffusionSDE(ref_ptr<MagneticField> magneticField, double toleranc
 	}
 
 DiffusionSDE::DiffusionSDE(ref_ptr<MagneticField> magneticField, ref_ptr<AdvectionField> advectionField, double tolerance, double minStep, double maxStep, double epsilon) :
-  	minStep(0)
+  	minStep(0), tensorCache(MAX_THREAD * TENSOR_CACHE_STRIDE)
 {
 	setMagneticField(magneticField);
 	setAdvectionField(advectionField);
@@ -78,7 +83,7 @@ void DiffusionSDE::process(Candidate *candidate) const {
 
     // Calculate the Diffusion tensor
 	double BTensor[] = {0., 0., 0., 0., 0., 0., 0., 0., 0.};
-	calculateBTensor(rig, BTensor, PosIn, DirIn, z);
+	calculateBTensorCached(rig, BTensor);
 
 
     // Generate random numbers
@@ -99,31 +104,8 @@ void DiffusionSDE::process(Candidate *candidate) const {
 
 
 	double propTime = TStep * sqrt(h) / c_light;
-	size_t counter = 0;
-	double r=42.; //arbitrary number larger than one
-
-	do {
-		Vector3d PosOut = Vector3d(0.);
-		Vector3d PosErr = Vector3d(0.);
-	  	tryStep(PosIn, PosOut, PosErr, z, propTime);
-	    // calculate the relative position error r and the next time step h
-	  	r = PosErr.getR() / tolerance;
-	  	propTime *= 0.5;
-		counter += 1;
-
-    // Check for better break condition
-	} while (r > 1 && fabs(propTime) >= minStep/c_light);
-
-
-	size_t stepNumber = pow(2, counter-1);
-	double allowedTime = TStep * sqrt(h) / c_light / stepNumber;
-	Vector3d Start = PosIn;
-	Vector3d PosOut = Vector3d(0.);
-	Vector3d PosErr = Vector3d(0.);
-	for (size_t j=0; j<stepNumber; j++) {
-		tryStep(Start, PosOut, PosErr, z, allowedTime);
-		Start = PosOut;
-	}
+	size_t stepNumber = 1;
+	Vector3d PosOut = integrateFieldLine(PosIn, z, propTime, stepNumber);
 
     // Normalize the tangent vector
 	TVec = (PosOut-PosIn).getUnitVector();
@@ -229,21 +211,74 @@ void DiffusionSDE::process(Candidate *candidate) const {
 }
 
 
+Vector3d DiffusionSDE::integrateFieldLine(const Vector3d &PosIn, double z, double propTime, size_t &stepNumber) const {
+	double minTime = minStep / c_light;
+	double total = fabs(propTime);
+	double sign = (propTime < 0) ? -1. : 1.;
+	double remaining = total;
+	double step = total;
+	double smallest = total;
+
+	Vector3d pos = PosIn;
+	Vector3d k0 = getMagneticFieldAtPosition(pos, z).getUnitVector() * c_light;
+	stepNumber = 1;
+
+	while (remaining > 0) {
+		step = std::min(step, remaining);
+		Vector3d PosOut(0.);
+		Vector3d PosErr(0.);
+		tryStep(pos, k0, PosOut, PosErr, z, sign * step);
+		double r = PosErr.getR() / tolerance;
+
+		// vanishing field: the caller falls back to rectilinear propagation
+		if (std::isnan(r))
+			return PosOut;
+
+		if (r > 1 && step > minTime) {
+			// reject, the first stage k0 at pos is reused by the next try
+			step = std::max(minTime, step * std::max(0.1, 0.95 * pow(r, -0.25)));
+			continue;
+		}
+
+		// accept the substep
+		if (step < remaining)
+			smallest = std::min(smallest, step);
+		remaining -= step;
+		pos = PosOut;
+		if (remaining <= 0)
+			break;
+		k0 = getMagneticFieldAtPosition(pos, z).getUnitVector() * c_light;
+		// the local error scales with step^5, grow the step where the field line is smooth
+		step *= clip(0.95 * pow(r, -0.2), 0.1, 5.);
+	}
+
+	if (smallest > 0)
+		stepNumber = std::max(size_t(1), size_t(total / smallest + 0.5));
+	return pos;
+}
+
 void DiffusionSDE::tryStep(const Vector3d &PosIn, Vector3d &POut, Vector3d &PosErr,double z, double propStep) const {
+	Vector3d k0 = getMagneticFieldAtPosition(PosIn, z).getUnitVector() * c_light;
+	tryStep(PosIn, k0, POut, PosErr, z, propStep);
+}
+
+void DiffusionSDE::tryStep(const Vector3d &PosIn, const Vector3d &k0, Vector3d &POut, Vector3d &PosErr, double z, double propStep) const {
 
-	Vector3d k[] = {Vector3d(0.),Vector3d(0.),Vector3d(0.),Vector3d(0.),Vector3d(0.),Vector3d(0.)};
+	Vector3d k[] = {k0,Vector3d(0.),Vector3d(0.),Vector3d(0.),Vector3d(0.),Vector3d(0.)};
 	POut = PosIn;
 	//calculate the sum k_i * b_i
 	for (size_t i = 0; i < 6; i++) {
 
-		Vector3d y_n = PosIn;
-		for (size_t j = 0; j < i; j++)
-		  y_n += k[j] * a[i * 6 + j] * propStep;
+		if (i > 0) {
+			Vector3d y_n = PosIn;
+			for (size_t j = 0; j < i; j++)
+			  y_n += k[j] * a[i * 6 + j] * propStep;
 
-		// update k_i = direction of the regular magnetic mean field
-		Vector3d BField = getMagneticFieldAtPosition(y_n, z);
+			// update k_i = direction of the regular magnetic mean field
+			Vector3d BField = getMagneticFieldAtPosition(y_n, z);
 
-		k[i] = BField.getUnitVector() * c_light;
+			k[i] = BField.getUnitVector() * c_light;
+		}
 
 		POut += k[i] * b[i] * propStep;
 		PosErr +=  (k[i] * (b[i] - bs[i])) * propStep / kpc;
@@ -260,13 +295,33 @@ void DiffusionSDE::driftStep(const Vector3d &pos, Vector3d &linProp, double h) c
 void DiffusionSDE::calculateBTensor(double r, double BTen[], Vector3d pos, Vector3d dir, double z) const {
 
     double DifCoeff = scale * 6.1e24 * pow((std::abs(r) / 4.0e9), alpha);
-    BTen[0] = pow( 2  * DifCoeff, 0.5);
-    BTen[4] = pow(2 * epsilon * DifCoeff, 0.5);
-    BTen[8] = pow(2 * epsilon * DifCoeff, 0.5);
+    BTen[0] = sqrt(2 * DifCoeff);
+    BTen[4] = sqrt(2 * epsilon * DifCoeff);
+    BTen[8] = sqrt(2 * epsilon * DifCoeff);
     return;
 
 }
 
+void DiffusionSDE::calculateBTensorCached(double r, double BTen[]) const {
+	// per thread: rigidity followed by the three diagonal elements
+	double *cache = &tensorCache[threadIndex() * TENSOR_CACHE_STRIDE];
+	if (cache[0] != r) {
+		double DifCoeff = scale * 6.1e24 * pow((std::abs(r) / 4.0e9), alpha);
+		cache[1] = sqrt(2 * DifCoeff);
+		cache[2] = sqrt(2 * epsilon * DifCoeff);
+		cache[3] = cache[2];
+		cache[0] = r;
+	}
+	BTen[0] = cache[1];
+	BTen[4] = cache[2];
+	BTen[8] = cache[3];
+}
+
+void DiffusionSDE::clearTensorCache() {
+	// NaN never compares equal to a rigidity
+	for (size_t i = 0; i < tensorCache.size(); i += TENSOR_CACHE_STRIDE)
+		tensorCache[i] = std::numeric_limits<double>::quiet_NaN();
+}
 
 void DiffusionSDE::setMinimumStep(double min) {
 	if (min < 0)
@@ -295,6 +350,7 @@ void DiffusionSDE::setEpsilon(double e) {
 		throw std::runtime_error(
 				"DiffusionSDE: epsilon not in range 0-1");
 	epsilon = e;
+	clearTensorCache();
 }
 
 
@@ -303,6 +359,7 @@ void DiffusionSDE::setAlpha(double a) {
 		throw std::runtime_error(
 				"DiffusionSDE: alpha not in range 0-2");
 	alpha = a;
+	clearTensorCache();
 }
 
 void DiffusionSDE::setScale(double s) {
@@ -310,6 +367,7 @@ void DiffusionSDE::setScale(double s) {
 		throw std::runtime_error(
 				"DiffusionSDE: Scale error: Scale < 0");
 	scale = s;
+	clearTensorCache();
 }
 
 void DiffusionSDE::setMagneticField(ref_ptr<MagneticField> f) {
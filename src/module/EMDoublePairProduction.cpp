@@ -34,28 +34,16 @@ void EMDoublePairProduction::setThinning(double thinning) {
 	this->thinning = thinning;
 }
 
+void EMDoublePairProduction::setWeightWindow(ref_ptr<WeightWindow> weightWindow) {
+	this->weightWindow = weightWindow;
+}
+
+ref_ptr<WeightWindow> EMDoublePairProduction::getWeightWindow() const {
+	return weightWindow;
+}
+
 void EMDoublePairProduction::initRate(std::string filename) {
-	std::ifstream infile(filename.c_str());
-
-	if (!infile.good())
-		throw std::runtime_error("EMDoublePairProduction: could not open file " + filename);
-
-	// clear previously loaded interaction rates
-	tabEnergy.clear();
-	tabRate.clear();
-
-	while (infile.good()) {
-		if (infile.peek() != '#') {
-			double a, b;
-			infile >> a >> b;
-			if (infile) {
-				tabEnergy.push_back(pow(10, a) * eV);
-				tabRate.push_back(b / Mpc);
-			}
-		}
-		infile.ignore(std::numeric_limits < std::streamsize > ::max(), '\n');
-	}
-	infile.close();
+	rateTable = TableRegistry::getRateTable(filename);
 }
 
 
@@ -78,7 +66,10 @@ void EMDoublePairProduction::performInteraction(Candidate *candidate) const {
 
 	double f = Ee / E;
 
-	if (haveElectrons) {
+	if (haveElectrons and weightWindow.valid()) {
+		weightWindow->addSecondary(candidate, 11, Ee / (1 + z), pos, pow(1 - f, thinning), interactionTag);
+		weightWindow->addSecondary(candidate, -11, Ee / (1 + z), pos, pow(f, thinning), interactionTag);
+	} else if (haveElectrons) {
 		if (random.rand() < pow(1 - f, thinning)) {
 			double w = 1. / pow(1 - f, thinning);
 			candidate->addSecondary( 11, Ee / (1 + z), pos, w, interactionTag);
@@ -90,22 +81,28 @@ void EMDoublePairProduction::performInteraction(Candidate *candidate) const {
 	}
 }
 
-void EMDoublePairProduction::process(Candidate *candidate) const {
+double EMDoublePairProduction::getInteractionRate(int id, double energy, double z) const {
 	// check if photon
-	if (candidate->current.getId() != 22)
-		return;
+	if (id != 22)
+		return 0;
 
 	// scale the electron energy instead of background photons
-	double z = candidate->getRedshift();
-	double E = (1 + z) * candidate->current.getEnergy();
+	double E = (1 + z) * energy;
 
 	// check if in tabulated energy range
-	if (E < tabEnergy.front() or (E > tabEnergy.back()))
-		return;
+	if (E < rateTable->energy.front() or (E > rateTable->energy.back()))
+		return 0;
 
 	// interaction rate
-	double rate = interpolate(E, tabEnergy, tabRate);
-	rate *= pow_integer<2>(1 + z) * photonField->getRedshiftScaling(z);
+	double rate = interpolate(E, rateTable->energy, rateTable->rate);
+	return rate * pow_integer<2>(1 + z) * photonField->getRedshiftScaling(z);
+}
+
+void EMDoublePairProduction::process(Candidate *candidate) const {
+	double rate = getInteractionRate(candidate->current.getId(),
+			candidate->current.getEnergy(), candidate->getRedshift());
+	if (rate <= 0)
+		return;
 
 	// check for interaction
 	Random &random = Random::instance();
@@ -39,85 +39,20 @@ void EMInverseComptonScattering::setThinning(double thinning) {
 	this->thinning = thinning;
 }
 
-void EMInverseComptonScattering::initData(std::string basePath) {
-    // Define filenames based on the base path and file name conventions
-    std::string energyFile = basePath + "energies.txt";
-    std::string zFile = basePath + "redshifts.txt";
-    std::string rateFile = basePath + "rates.txt";
-
-    // clear previously loaded tables
-    tabICEnergy.clear();
-    tabICRate.clear();
-    tabICZ.clear();
-
-    // Read energies
-    std::ifstream infile(energyFile.c_str());
-    if (!infile.good()) throw std::runtime_error("Could not open energy file " + energyFile);
-    double logEnergy;
-    while (infile >> logEnergy) {
-        double energy = pow(10, logEnergy) * eV; // Convert log10(E) to E
-        tabICEnergy.push_back(energy);
-    }
-    infile.close();
-
-    // Read redshifts
-    infile.open(zFile.c_str());
-    if (!infile.good()) throw std::runtime_error("Could not open redshift file " + zFile);
-    double z;
-    while (infile >> z) tabICZ.push_back(z);
-    infile.close();
-
-    // Read rates and directly fill the tabRate
-    infile.open(rateFile.c_str());
-    if (!infile.good()) throw std::runtime_error("Could not open rate file " + rateFile);
-    double rate;
-    while (infile >> rate) {
-        tabICRate.push_back(rate / Mpc); // Adjust the rate if necessary
-    }
-    infile.close();
-
-    // Now, tabEnergy, tabZ, and tabRate are filled with the data from the files.
-    // Ensure they are correctly synchronized as per your logic.
+void EMInverseComptonScattering::setWeightWindow(ref_ptr<WeightWindow> weightWindow) {
+	this->weightWindow = weightWindow;
 }
 
+ref_ptr<WeightWindow> EMInverseComptonScattering::getWeightWindow() const {
+	return weightWindow;
+}
 
-void EMInverseComptonScattering::initCumulativeRate(std::string filename) {
-	std::ifstream infile(filename.c_str());
-
-	if (!infile.good())
-		throw std::runtime_error("EMInverseComptonScattering: could not open file " + filename);
-
-	// clear previously loaded tables
-	tabE.clear();
-	tabs.clear();
-	tabCDF.clear();
-	
-	// skip header
-	while (infile.peek() == '#')
-		infile.ignore(std::numeric_limits < std::streamsize > ::max(), '\n');
-
-	// read s values in first line
-	double a;
-	infile >> a; // skip first value
-	while (infile.good() and (infile.peek() != '\n')) {
-		infile >> a;
-		tabs.push_back(pow(10, a) * eV * eV);
-	}
+void EMInverseComptonScattering::initData(std::string basePath) {
+	rateTable = TableRegistry::getRedshiftRateTable(basePath);
+}
 
-	// read all following lines: E, cdf values
-	while (infile.good()) {
-		infile >> a;
-		if (!infile)
-			break;  // end of file
-		tabE.push_back(pow(10, a) * eV);
-		std::vector<double> cdf;
-		for (int i = 0; i < tabs.size(); i++) {
-			infile >> a;
-			cdf.push_back(a / Mpc);
-		}
-		tabCDF.push_back(cdf);
-	}
-	infile.close();
+void EMInverseComptonScattering::initCumulativeRate(std::string filename) {
+	cdfTable = TableRegistry::getCumulativeRateTable(filename);
 }
 
 // Class to calculate the energy distribution of the ICS photon and to sample from it
@@ -193,14 +128,14 @@ void EMInverseComptonScattering::performInteraction(Candidate *candidate) const
 	double z = candidate->getRedshift();
 	double E = candidate->current.getEnergy() * (1 + z);
 
-	if (E < tabE.front() or E > tabE.back())
+	if (E < cdfTable->energy.front() or E > cdfTable->energy.back())
 		return;
 
 	// sample the value of s
 	Random &random = Random::instance();
-	size_t i = closestIndex(E, tabE);
-	size_t j = random.randBin(tabCDF[i]);
-	double s_kin = pow(10, log10(tabs[j]) + (random.rand() - 0.5) * 0.1);
+	size_t i = closestIndex(E, cdfTable->energy);
+	size_t j = random.randBin(cdfTable->cdf[i]);
+	double s_kin = pow(10, log10(cdfTable->s[j]) + (random.rand() - 0.5) * 0.1);
 	double s = s_kin + mec2 * mec2;
 
 	// sample electron energy after scattering
@@ -210,7 +145,10 @@ void EMInverseComptonScattering::performInteraction(Candidate *candidate) const
 	// add up-scattered photon
 	double Esecondary = E - Enew;
 	double f = Enew / E;
-	if (havePhotons) {
+	if (havePhotons and weightWindow.valid()) {
+		Vector3d pos = random.randomInterpolatedPosition(candidate->previous.getPosition(), candidate->current.getPosition());
+		weightWindow->addSecondary(candidate, 22, Esecondary / (1 + z), pos, pow(1 - f, thinning), interactionTag);
+	} else if (havePhotons) {
 		if (random.rand() < pow(1 - f, thinning)) {
 			double w = 1. / pow(1 - f, thinning);
 			Vector3d pos = random.randomInterpolatedPosition(candidate->previous.getPosition(), candidate->current.getPosition());
@@ -222,22 +160,25 @@ void EMInverseComptonScattering::performInteraction(Candidate *candidate) const
 	candidate->current.setEnergy(Enew / (1 + z));
 }
 
-void EMInverseComptonScattering::process(Candidate *candidate) const {
+double EMInverseComptonScattering::getInteractionRate(int id, double E, double z) const {
 	// check if electron / positron
-	int id = candidate->current.getId();
 	if (abs(id) != 11)
-		return;
-	// scale the particle energy instead of background photons
-	double z = candidate->getRedshift();
-	double E = candidate->current.getEnergy();
+		return 0;
 
-	if ((E < tabICEnergy.front()) or (E > tabICEnergy.back()))
-		return;
+	if ((E < rateTable->energy.front()) or (E > rateTable->energy.back()))
+		return 0;
 
 	// interaction rate. 
 	// (1+z) factor is from the dl/dz modification.
-	double rate = interpolate2d(E, z, tabICEnergy, tabICZ, tabICRate)/(1+z); 
+	return interpolate2d(E, z, rateTable->energy, rateTable->redshift, rateTable->rate)/(1+z); 
 	// rate *= pow_integer<2>(1 + z) * photonField->getRedshiftScaling(z);
+}
+
+void EMInverseComptonScattering::process(Candidate *candidate) const {
+	double rate = getInteractionRate(candidate->current.getId(),
+			candidate->current.getEnergy(), candidate->getRedshift());
+	if (rate <= 0)
+		return;
 
 	// run this loop at least once to limit the step size
 	double step = candidate->getCurrentStep();
@@ -38,86 +38,20 @@ void EMPairProduction::setThinning(double thinning) {
 	this->thinning = thinning;
 }
 
-void EMPairProduction::initData(std::string basePath) {
-    // Define filenames based on the base path and file name conventions
-    std::string energyFile = basePath + "energies.txt";
-    std::string zFile = basePath + "redshifts.txt";
-    std::string rateFile = basePath + "rates.txt";
-
-    // clear previously loaded tables
-    tabEnergy.clear();
-    tabRate.clear();
-    tabZ.clear();
-
-    // Read energies
-    std::ifstream infile(energyFile.c_str());
-    if (!infile.good()) throw std::runtime_error("Could not open energy file " + energyFile);
-    double logEnergy;
-    while (infile >> logEnergy) {
-        double energy = pow(10, logEnergy) * eV; // Convert log10(E) to E
-        tabEnergy.push_back(energy);
-    }
-    infile.close();
-
-    // Read redshifts
-    infile.open(zFile.c_str());
-    if (!infile.good()) throw std::runtime_error("Could not open redshift file " + zFile);
-    double z;
-    while (infile >> z) tabZ.push_back(z);
-    infile.close();
-
-    // Read rates and directly fill the tabRate
-    infile.open(rateFile.c_str());
-    if (!infile.good()) throw std::runtime_error("Could not open rate file " + rateFile);
-    double rate;
-    while (infile >> rate) {
-        tabRate.push_back(rate / Mpc); // Adjust the rate if necessary
-    }
-    infile.close();
-
-    // Now, tabEnergy, tabZ, and tabRate are filled with the data from the files.
-    // Ensure they are correctly synchronized as per your logic.
+void EMPairProduction::setWeightWindow(ref_ptr<WeightWindow> weightWindow) {
+	this->weightWindow = weightWindow;
 }
 
+ref_ptr<WeightWindow> EMPairProduction::getWeightWindow() const {
+	return weightWindow;
+}
 
+void EMPairProduction::initData(std::string basePath) {
+	rateTable = TableRegistry::getRedshiftRateTable(basePath);
+}
 
 void EMPairProduction::initCumulativeRate(std::string filename) {
-	std::ifstream infile(filename.c_str());
-
-	if (!infile.good())
-		throw std::runtime_error("EMPairProduction: could not open file " + filename);
-
-	// clear previously loaded tables
-	tabE.clear();
-	tabs.clear();
-	tabCDF.clear();
-	
-	// skip header
-	while (infile.peek() == '#')
-		infile.ignore(std::numeric_limits < std::streamsize > ::max(), '\n');
-
-	// read s values in first line
-	double a;
-	infile >> a; // skip first value
-	while (infile.good() and (infile.peek() != '\n')) {
-		infile >> a;
-		tabs.push_back(pow(10, a) * eV * eV);
-	}
-
-	// read all following lines: E, cdf values
-	while (infile.good()) {
-		infile >> a;
-		if (!infile)
-			break;  // end of file
-		tabE.push_back(pow(10, a) * eV);
-		std::vector<double> cdf;
-		for (int i = 0; i < tabs.size(); i++) {
-			infile >> a;
-			cdf.push_back(a / Mpc);
-		}
-		tabCDF.push_back(cdf);
-	}
-	infile.close();
+	cdfTable = TableRegistry::getCumulativeRateTable(filename);
 }
 
 // Hold an data array to interpolate the energy distribution on
@@ -200,15 +134,15 @@ void EMPairProduction::performInteraction(Candidate *candidate) const {
 		return;
 
 	// check if in tabulated energy range
-	if (E < tabE.front() or (E > tabE.back()))
+	if (E < cdfTable->energy.front() or (E > cdfTable->energy.back()))
 		return;
 
 	// sample the value of s
 	Random &random = Random::instance();
-	size_t i = closestIndex(E, tabE);  // find closest tabulation point
-	size_t j = random.randBin(tabCDF[i]);
-	double lo = std::max(4 * mec2 * mec2, tabs[j-1]);  // first s-tabulation point below min(s_kin) = (2 me c^2)^2; ensure physical value
-	double hi = tabs[j];
+	size_t i = closestIndex(E, cdfTable->energy);  // find closest tabulation point
+	size_t j = random.randBin(cdfTable->cdf[i]);
+	double lo = std::max(4 * mec2 * mec2, cdfTable->s[j-1]);  // first s-tabulation point below min(s_kin) = (2 me c^2)^2; ensure physical value
+	double hi = cdfTable->s[j];
 	double s = lo + random.rand() * (hi - lo);
 
 	// sample electron / positron energy
@@ -223,6 +157,11 @@ void EMPairProduction::performInteraction(Candidate *candidate) const {
 
 	// sample random position along current step
 	Vector3d pos = random.randomInterpolatedPosition(candidate->previous.getPosition(), candidate->current.getPosition());
+	if (weightWindow.valid()) {
+		weightWindow->addSecondary(candidate, 11, Ep / (1 + z), pos, pow(f, thinning), interactionTag);
+		weightWindow->addSecondary(candidate, -11, Ee / (1 + z), pos, pow(1 - f, thinning), interactionTag);
+		return;
+	}
 	// apply sampling
 	if (random.rand() < pow(f, thinning)) {
 		double w = 1. / pow(f, thinning);
@@ -234,21 +173,26 @@ void EMPairProduction::performInteraction(Candidate *candidate) const {
 	}
 }
 
-void EMPairProduction::process(Candidate *candidate) const {
+double EMPairProduction::getInteractionRate(int id, double E, double z) const {
 	// check if photon
-	if (candidate->current.getId() != 22)
-		return;
+	if (id != 22)
+		return 0;
 
-	double z = candidate->getRedshift();
-	double E = candidate->current.getEnergy(); //delete the (z+1) factor
-	// check if in tabulated energy range
-	if ((E < tabEnergy.front()) or (E > tabEnergy.back()))
-		return;
+	// check if in tabulated energy range, no (z+1) factor
+	if ((E < rateTable->energy.front()) or (E > rateTable->energy.back()))
+		return 0;
 
 	// interaction rate. 
 	// (1+z) factor is from the dl/dz modification.
-	double rate = interpolate2d(E, z, tabEnergy, tabZ, tabRate)/(1+z); 
+	return interpolate2d(E, z, rateTable->energy, rateTable->redshift, rateTable->rate)/(1+z); 
 	// rate *= pow_integer<2>(1 + z) * photonField->getRedshiftScaling(z);
+}
+
+void EMPairProduction::process(Candidate *candidate) const {
+	double rate = getInteractionRate(candidate->current.getId(),
+			candidate->current.getEnergy(), candidate->getRedshift());
+	if (rate <= 0)
+		return;
 
 	// run this loop at least once to limit the step size 
 	double step = candidate->getCurrentStep();
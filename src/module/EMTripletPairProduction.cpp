@@ -37,68 +37,20 @@ void EMTripletPairProduction::setThinning(double thinning) {
 	this->thinning = thinning;
 }
 
+void EMTripletPairProduction::setWeightWindow(ref_ptr<WeightWindow> weightWindow) {
+	this->weightWindow = weightWindow;
+}
+
+ref_ptr<WeightWindow> EMTripletPairProduction::getWeightWindow() const {
+	return weightWindow;
+}
+
 void EMTripletPairProduction::initRate(std::string filename) {
-	std::ifstream infile(filename.c_str());
-
-	if (!infile.good())
-		throw std::runtime_error("EMTripletPairProduction: could not open file " + filename);
-
-	// clear previously loaded interaction rates
-	tabEnergy.clear();
-	tabRate.clear();
-
-	while (infile.good()) {
-		if (infile.peek() != '#') {
-			double a, b;
-			infile >> a >> b;
-			if (infile) {
-				tabEnergy.push_back(pow(10, a) * eV);
-				tabRate.push_back(b / Mpc);
-			}
-		}
-		infile.ignore(std::numeric_limits < std::streamsize > ::max(), '\n');
-	}
-	infile.close();
+	rateTable = TableRegistry::getRateTable(filename);
 }
 
 void EMTripletPairProduction::initCumulativeRate(std::string filename) {
-	std::ifstream infile(filename.c_str());
-
-	if (!infile.good())
-		throw std::runtime_error(
-				"EMTripletPairProduction: could not open file " + filename);
-
-	// clear previously loaded tables
-	tabE.clear();
-	tabs.clear();
-	tabCDF.clear();
-	
-	// skip header
-	while (infile.peek() == '#')
-		infile.ignore(std::numeric_limits < std::streamsize > ::max(), '\n');
-
-	// read s values in first line
-	double a;
-	infile >> a; // skip first value
-	while (infile.good() and (infile.peek() != '\n')) {
-		infile >> a;
-		tabs.push_back(pow(10, a) * eV * eV);
-	}
-
-	// read all following lines: E, cdf values
-	while (infile.good()) {
-		infile >> a;
-		if (!infile)
-			break;  // end of file
-		tabE.push_back(pow(10, a) * eV);
-		std::vector<double> cdf;
-		for (int i = 0; i < tabs.size(); i++) {
-			infile >> a;
-			cdf.push_back(a / Mpc);
-		}
-		tabCDF.push_back(cdf);
-	}
-	infile.close();
+	cdfTable = TableRegistry::getCumulativeRateTable(filename);
 }
 
 void EMTripletPairProduction::performInteraction(Candidate *candidate) const {
@@ -110,14 +62,14 @@ void EMTripletPairProduction::performInteraction(Candidate *candidate) const {
 	double z = candidate->getRedshift();
 	double E = candidate->current.getEnergy() * (1 + z);
 
-	if (E < tabE.front() or E > tabE.back())
+	if (E < cdfTable->energy.front() or E > cdfTable->energy.back())
 		return;
 
 	// sample the value of eps
 	Random &random = Random::instance();
-	size_t i = closestIndex(E, tabE);
-	size_t j = random.randBin(tabCDF[i]);
-	double s_kin = pow(10, log10(tabs[j]) + (random.rand() - 0.5) * 0.1);
+	size_t i = closestIndex(E, cdfTable->energy);
+	size_t j = random.randBin(cdfTable->cdf[i]);
+	double s_kin = pow(10, log10(cdfTable->s[j]) + (random.rand() - 0.5) * 0.1);
 	double eps = s_kin / 4. / E; // random background photon energy
 
 	// Use approximation from A. Mastichiadis et al., Astroph. Journ. 300:178-189 (1986), eq. 30.
@@ -129,13 +81,18 @@ void EMTripletPairProduction::performInteraction(Candidate *candidate) const {
 
 	if (haveElectrons) {
 		Vector3d pos = random.randomInterpolatedPosition(candidate->previous.getPosition(), candidate->current.getPosition());
-		if (random.rand() < pow(1 - f, thinning)) {
-			double w = 1. / pow(1 - f, thinning);
-			candidate->addSecondary(11, Epp / (1 + z), pos, w, interactionTag);
-		}
-		if (random.rand() < pow(f, thinning)) {
-			double w = 1. / pow(f, thinning);
-			candidate->addSecondary(-11, Epp / (1 + z), pos, w, interactionTag);
+		if (weightWindow.valid()) {
+			weightWindow->addSecondary(candidate, 11, Epp / (1 + z), pos, pow(1 - f, thinning), interactionTag);
+			weightWindow->addSecondary(candidate, -11, Epp / (1 + z), pos, pow(f, thinning), interactionTag);
+		} else {
+			if (random.rand() < pow(1 - f, thinning)) {
+				double w = 1. / pow(1 - f, thinning);
+				candidate->addSecondary(11, Epp / (1 + z), pos, w, interactionTag);
+			}
+			if (random.rand() < pow(f, thinning)) {
+				double w = 1. / pow(f, thinning);
+				candidate->addSecondary(-11, Epp / (1 + z), pos, w, interactionTag);
+			}
 		}
 	}
 	// Update the primary particle energy.
@@ -143,23 +100,28 @@ void EMTripletPairProduction::performInteraction(Candidate *candidate) const {
 	candidate->current.setEnergy((E - 2 * Epp) / (1. + z));
 }
 
-void EMTripletPairProduction::process(Candidate *candidate) const {
+double EMTripletPairProduction::getInteractionRate(int id, double energy, double z) const {
 	// check if electron / positron
-	int id = candidate->current.getId();
 	if (abs(id) != 11)
-		return;
+		return 0;
 
 	// scale the particle energy instead of background photons
-	double z = candidate->getRedshift();
-	double E = (1 + z) * candidate->current.getEnergy();
+	double E = (1 + z) * energy;
 
 	// check if in tabulated energy range
-	if ((E < tabEnergy.front()) or (E > tabEnergy.back()))
-		return;
+	if ((E < rateTable->energy.front()) or (E > rateTable->energy.back()))
+		return 0;
 
 	// cosmological scaling of interaction distance (comoving)
 	double scaling = pow_integer<2>(1 + z) * photonField->getRedshiftScaling(z);
-	double rate = scaling * interpolate(E, tabEnergy, tabRate);
+	return scaling * interpolate(E, rateTable->energy, rateTable->rate);
+}
+
+void EMTripletPairProduction::process(Candidate *candidate) const {
+	double rate = getInteractionRate(candidate->current.getId(),
+			candidate->current.getEnergy(), candidate->getRedshift());
+	if (rate <= 0)
+		return;
 
 	// run this loop at least once to limit the step size
 	double step = candidate->getCurrentStep();
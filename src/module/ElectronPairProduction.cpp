@@ -35,10 +35,32 @@ void ElectronPairProduction::setHaveElectrons(bool haveElectrons) {
 	}
 }
 
+bool ElectronPairProduction::getHaveElectrons() const {
+	return haveElectrons;
+}
+
 void ElectronPairProduction::setLimit(double limit) {
 	this->limit = limit;
 }
 
+void ElectronPairProduction::setMinimumSecondaryEnergy(double energy) {
+	minimumSecondaryEnergy = energy;
+	initMacroParticles();
+}
+
+double ElectronPairProduction::getMinimumSecondaryEnergy() const {
+	return minimumSecondaryEnergy;
+}
+
+void ElectronPairProduction::setMacroParticles(size_t nBins) {
+	macroParticles = nBins;
+	initMacroParticles();
+}
+
+size_t ElectronPairProduction::getMacroParticles() const {
+	return macroParticles;
+}
+
 void ElectronPairProduction::initRate(std::string filename) {
 	std::ifstream infile(filename.c_str());
 
@@ -81,6 +103,49 @@ void ElectronPairProduction::initSpectrum(std::string filename) {
 		}
 	}
 	infile.close();
+	initMacroParticles();
+}
+
+void ElectronPairProduction::initMacroParticles() {
+	macroEnergy.clear();
+	macroFraction.clear();
+	if ((macroParticles == 0) or tabSpectrum.empty())
+		return;
+
+	// electron energies are drawn log-uniformly in bins of 0.1 in log10(Ee/eV)
+	// from 10^6.95 eV, the mean energy of bin j is meanFactor * 10^(6.95 + 0.1 j) eV
+	double r = pow(10, 0.1);
+	double meanFactor = (r - 1) / log(r);
+
+	// first bin reaching above the minimum energy
+	size_t first = 0;
+	while ((first < 170) and (pow(10, 7.05 + 0.1 * first) * eV <= minimumSecondaryEnergy))
+		first++;
+	size_t nBins = std::min(macroParticles, 170 - first);
+
+	macroEnergy.resize(70);
+	macroFraction.resize(70);
+	for (size_t i = 0; i < 70; i++) {
+		const std::vector<double> &cdf = tabSpectrum[i];
+		double total = 0;
+		for (size_t j = 0; j < 170; j++)
+			total += (cdf[j] - (j > 0 ? cdf[j - 1] : 0)) * meanFactor * pow(10, 6.95 + 0.1 * j) * eV;
+
+		for (size_t b = 0; b < nBins; b++) {
+			double number = 0, energy = 0;
+			for (size_t j = first + b * (170 - first) / nBins; j < first + (b + 1) * (170 - first) / nBins; j++) {
+				double n = cdf[j] - (j > 0 ? cdf[j - 1] : 0);
+				// only the part of a bin straddling the minimum energy above it
+				double lower = pow(10, 6.95 + 0.1 * j) * eV;
+				double upper = lower * r;
+				lower = std::max(lower, minimumSecondaryEnergy);
+				number += n * log(upper / lower) / log(r);
+				energy += n * (upper - lower) / log(r);
+			}
+			macroEnergy[i].push_back(number > 0 ? energy / number : 0);
+			macroFraction[i].push_back(total > 0 ? energy / total : 0);
+		}
+	}
 }
 
 double ElectronPairProduction::lossLength(int id, double lf, double z) const {
@@ -103,6 +168,17 @@ double ElectronPairProduction::lossLength(int id, double lf, double z) const {
 	return 1. / rate;
 }
 
+double ElectronPairProduction::getEnergyLossRate(int id, double energy, double z) const {
+	if (not (isNucleus(id)))
+		return 0; // only nuclei
+
+	double lf = energy / (nuclearMass(id) * c_squared);
+	double losslen = lossLength(id, lf, z);
+	if (losslen >= std::numeric_limits<double>::max())
+		return 0;
+	return energy / losslen / (1 + z); // loss length in local frame
+}
+
 void ElectronPairProduction::process(Candidate *c) const {
 	int id = c->current.getId();
 	if (not (isNucleus(id)))
@@ -123,21 +199,36 @@ void ElectronPairProduction::process(Candidate *c) const {
 		i = std::min(std::max(i, 0), 69);
 		Random &random = Random::instance();
 
-		// draw pairs as long as their energy is smaller than the pair production energy loss
-		while (dE > 0) {
-			size_t j = random.randBin(tabSpectrum[i]);
-			double Ee = pow(10, 6.95 + (j + random.rand()) * 0.1) * eV;
-			double Epair = 2 * Ee; // NOTE: electron and positron in general don't have same lab frame energy, but averaged over many draws the result is consistent
-			// if the remaining energy is not sufficient check for random accepting
-			if (Epair > dE)
-				if (random.rand() > (dE / Epair))
-					break; // not accepted
-
-			// create pair and repeat with remaining energy
-			dE -= Epair;
-			Vector3d pos = random.randomInterpolatedPosition(c->previous.getPosition(), c->current.getPosition());
-			c->addSecondary( 11, Ee, pos, 1., interactionTag);
-			c->addSecondary(-11, Ee, pos, 1., interactionTag);
+		// macro-particles: one electron and positron per bin with the expected number of pairs as weight
+		if (macroParticles > 0) {
+			for (size_t b = 0; b < macroEnergy[i].size(); b++) {
+				double Ee = macroEnergy[i][b];
+				if ((macroFraction[i][b] <= 0) or (Ee < minimumSecondaryEnergy))
+					continue;
+				double w = dE * macroFraction[i][b] / (2 * Ee);
+				Vector3d pos = random.randomInterpolatedPosition(c->previous.getPosition(), c->current.getPosition());
+				c->addSecondary( 11, Ee, pos, w, interactionTag);
+				c->addSecondary(-11, Ee, pos, w, interactionTag);
+			}
+		} else {
+			// draw pairs as long as their energy is smaller than the pair production energy loss
+			while (dE > 0) {
+				size_t j = random.randBin(tabSpectrum[i]);
+				double Ee = pow(10, 6.95 + (j + random.rand()) * 0.1) * eV;
+				double Epair = 2 * Ee; // NOTE: electron and positron in general don't have same lab frame energy, but averaged over many draws the result is consistent
+				// if the remaining energy is not sufficient check for random accepting
+				if (Epair > dE)
+					if (random.rand() > (dE / Epair))
+						break; // not accepted
+
+				// create pair and repeat with remaining energy
+				dE -= Epair;
+				if (Ee < minimumSecondaryEnergy)
+					continue;
+				Vector3d pos = random.randomInterpolatedPosition(c->previous.getPosition(), c->current.getPosition());
+				c->addSecondary( 11, Ee, pos, 1., interactionTag);
+				c->addSecondary(-11, Ee, pos, 1., interactionTag);
+			}
 		}
 	}
 
@@ -0,0 +1,216 @@
+#include "crpropa/module/EventPropagation1D.h"
+#include "crpropa/Common.h"
+#include "crpropa/Cosmology.h"
+#include "crpropa/ModuleList.h"
+#include "crpropa/Random.h"
+#include "crpropa/module/ElectronPairProduction.h"
+#include "crpropa/module/Redshift.h"
+#include "crpropa/module/SynchrotronRadiation.h"
+
+#include "kiss/logger.h"
+
+#include <cmath>
+#include <sstream>
+#include <stdexcept>
+
+namespace crpropa {
+
+EventPropagation1D::EventPropagation1D(double minStep, double maxStep,
+		double tolerance) :
+		minStep(minStep), maxStep(maxStep), redshiftLosses(false) {
+	if (minStep > maxStep)
+		throw std::runtime_error("EventPropagation1D: minStep > maxStep");
+	setTolerance(tolerance);
+}
+
+bool EventPropagation1D::add(Module *module) {
+	ModuleList *list = dynamic_cast<ModuleList *>(module);
+	if (list) {
+		bool used = false;
+		for (ModuleList::iterator i = list->begin(); i != list->end(); i++)
+			used |= add(*i);
+		return used;
+	}
+
+	Redshift *redshift = dynamic_cast<Redshift *>(module);
+	if (redshift) {
+		redshiftLosses = true;
+		if (not cosmology.valid())
+			cosmology = redshift->getCosmology();
+		return true;
+	}
+
+	const CascadeInteraction *interaction = dynamic_cast<const CascadeInteraction *>(module);
+	const ContinuousLoss *loss = dynamic_cast<const ContinuousLoss *>(module);
+	if ((interaction == 0) and (loss == 0))
+		return false;
+
+	ElectronPairProduction *epp = dynamic_cast<ElectronPairProduction *>(module);
+	SynchrotronRadiation *syn = dynamic_cast<SynchrotronRadiation *>(module);
+	// the energy loss rate needs the RMS field strength
+	if (syn and syn->getField().valid())
+		throw std::runtime_error("EventPropagation1D: SynchrotronRadiation needs a RMS "
+				"field strength instead of a magnetic field");
+	if ((epp and epp->getHaveElectrons()) or (syn and syn->getHavePhotons())) {
+		KISS_LOG_WARNING << "EventPropagation1D: secondaries of "
+				<< module->getDescription() << " are not produced";
+	}
+
+	modules.push_back(module);
+	if (interaction)
+		interactions.push_back(interaction);
+	if (loss)
+		losses.push_back(loss);
+	return true;
+}
+
+void EventPropagation1D::setMinimumStep(double step) {
+	if (step > maxStep)
+		throw std::runtime_error("EventPropagation1D: minStep > maxStep");
+	minStep = step;
+}
+
+void EventPropagation1D::setMaximumStep(double step) {
+	if (minStep > step)
+		throw std::runtime_error("EventPropagation1D: minStep > maxStep");
+	maxStep = step;
+}
+
+void EventPropagation1D::setTolerance(double tolerance) {
+	if ((tolerance <= 0) or (tolerance >= 1))
+		throw std::runtime_error("EventPropagation1D: tolerance must be in (0, 1)");
+	this->tolerance = tolerance;
+}
+
+void EventPropagation1D::setRedshiftLosses(bool redshiftLosses) {
+	this->redshiftLosses = redshiftLosses;
+}
+
+void EventPropagation1D::setCosmology(ref_ptr<Cosmology> cosmology) {
+	this->cosmology = cosmology;
+}
+
+ref_ptr<Cosmology> EventPropagation1D::getCosmology() const {
+	return cosmology;
+}
+
+double EventPropagation1D::getMinimumStep() const {
+	return minStep;
+}
+
+double EventPropagation1D::getMaximumStep() const {
+	return maxStep;
+}
+
+double EventPropagation1D::getTolerance() const {
+	return tolerance;
+}
+
+bool EventPropagation1D::getRedshiftLosses() const {
+	return redshiftLosses;
+}
+
+double EventPropagation1D::lossRate(int id, double energy, double z) const {
+	double rate = 0;
+	for (size_t i = 0; i < losses.size(); i++)
+		rate += losses[i]->getEnergyLossRate(id, energy, z);
+	return rate;
+}
+
+void EventPropagation1D::process(Candidate *c) const {
+	c->previous = c->current;
+	int id = c->current.getId();
+	double E = c->current.getEnergy();
+	double z = c->getRedshift();
+	const Cosmology &cosmo = cosmology.valid() ? *cosmology : defaultCosmology();
+
+	// limit of observers and boundaries from the last step
+	double step = clip(c->getNextStep(), minStep, maxStep);
+
+	// limit the relative energy loss over the step
+	double dEdx = lossRate(id, E, z);
+	if (dEdx > 0)
+		step = std::min(step, tolerance * E / dEdx);
+	if (redshiftLosses and (z > 0))
+		step = std::min(step, tolerance * (1 + z) * c_light / cosmo.hubbleRate(z)); // dE / E = dz / (1 + z)
+
+	// jump to the next interaction if it happens within the step
+	std::vector<double> rates(interactions.size());
+	double totalRate = 0;
+	for (size_t i = 0; i < interactions.size(); i++) {
+		rates[i] = interactions[i]->getInteractionRate(id, E, z);
+		totalRate += rates[i];
+	}
+	Random &random = Random::instance();
+	bool interacts = false;
+	if (totalRate > 0) {
+		double freePath = -log(random.rand()) / totalRate;
+		if (freePath < step) {
+			step = freePath;
+			interacts = true;
+		}
+	}
+
+	c->setCurrentStep(step);
+	c->current.setPosition(c->current.getPosition() + c->current.getDirection() * step);
+
+	// redshift at the end of the step
+	double z1 = z;
+	if (redshiftLosses and (z > 0)) {
+		double d = cosmo.redshift2ComovingDistance(z) - step;
+		z1 = (d > 0) ? cosmo.comovingDistance2Redshift(d) : 0;
+	}
+
+	// continuous losses, RK4 in substeps of 1% energy loss
+	if (losses.size() and (dEdx > 0)) {
+		size_t n = std::max(1., ceil(100 * step * dEdx / E));
+		double h = step / n;
+		for (size_t i = 0; i < n; i++) {
+			double za = z + (z1 - z) * i / n;
+			double zm = z + (z1 - z) * (i + 0.5) / n;
+			double zb = z + (z1 - z) * (i + 1.) / n;
+			double k1 = lossRate(id, E, za);
+			double k2 = lossRate(id, std::max(0., E - 0.5 * h * k1), zm);
+			double k3 = lossRate(id, std::max(0., E - 0.5 * h * k2), zm);
+			double k4 = lossRate(id, std::max(0., E - h * k3), zb);
+			E -= h / 6 * (k1 + 2 * k2 + 2 * k3 + k4);
+		}
+	}
+
+	// adiabatic loss E ~ 1 / (1 + z)
+	if (z1 != z) {
+		E *= (1 + z1) / (1 + z);
+		c->setRedshift(z1);
+	}
+	c->current.setEnergy(std::max(0., E));
+
+	if (interacts) {
+		// choose the interaction by its rate at the start of the step
+		double r = random.rand() * totalRate;
+		size_t i = 0;
+		while ((i + 1 < interactions.size()) and (r >= rates[i])) {
+			r -= rates[i];
+			i++;
+		}
+		// secondaries are placed between previous and current position,
+		// the interaction happens at the end of the step
+		Vector3d x0 = c->previous.getPosition();
+		c->previous.setPosition(c->current.getPosition());
+		interactions[i]->performInteraction(c);
+		c->previous.setPosition(x0);
+	}
+
+	c->setNextStep(maxStep);
+}
+
+std::string EventPropagation1D::getDescription() const {
+	std::stringstream s;
+	s << "EventPropagation1D: " << interactions.size() << " interactions, "
+			<< losses.size() << " continuous losses";
+	if (redshiftLosses)
+		s << ", redshift";
+	s << ", step size = " << minStep / kpc << " - " << maxStep / kpc << " kpc";
+	return s.str();
+}
+
+} // namespace crpropa
@@ -6,7 +6,10 @@
 #include "kiss/logger.h"
 
 #include <hdf5.h>
+#include <algorithm>
 #include <cstring>
+#include <fstream>
+#include <sstream>
 
 const hsize_t RANK = 1;
 const hsize_t BUFFER_SIZE = 1024 * 16;
@@ -342,6 +345,13 @@ void HDF5Output::process(Candidate* candidate) const {
 	}
 }
 
+size_t HDF5Output::getBacklog() const {
+	size_t rows;
+	#pragma omp critical
+	rows = buffer.size();
+	return rows;
+}
+
 void HDF5Output::flush() const {
 	const_cast<HDF5Output*>(this)->lastFlush = time(NULL);
 	const_cast<HDF5Output*>(this)->candidatesSinceFlush = 0;
@@ -378,6 +388,123 @@ void HDF5Output::flush() const {
 	H5Fflush(file, H5F_SCOPE_GLOBAL);
 }
 
+std::string HDF5Output::saveCheckpoint() {
+	hsize_t rows = 0;
+	if (file >= 0) {
+		flush();
+		hid_t file_space = H5Dget_space(dset);
+		rows = H5Sget_simple_extent_npoints(file_space);
+		H5Sclose(file_space);
+	}
+	std::stringstream ss;
+	ss << count << " " << rows;
+	return ss.str();
+}
+
+void HDF5Output::loadCheckpoint(const std::string &state) {
+	std::stringstream ss(state);
+	size_t n;
+	hsize_t rows;
+	if (!(ss >> n >> rows))
+		throw std::runtime_error("crpropa::HDF5Output: invalid checkpoint state");
+
+	close();
+	buffer.clear();
+	count = n;
+	// without rows, the file is created by the first call of process
+	if (rows == 0)
+		return;
+
+	file = H5Fopen(filename.c_str(), H5F_ACC_RDWR, H5P_DEFAULT);
+	if (file < 0)
+		throw std::runtime_error(std::string("Cannot open file: ") + filename);
+	dset = H5Dopen2(file, "CRPROPA3", H5P_DEFAULT);
+	if (dset < 0)
+		throw std::runtime_error("crpropa::HDF5Output: no CRPROPA3 dataset in " + filename);
+	sid = H5Dget_type(dset);
+	dataspace = H5Dget_space(dset);
+	if (H5Sget_simple_extent_npoints(dataspace) < (hssize_t)rows)
+		throw std::runtime_error("crpropa::HDF5Output: " + filename + " is smaller than at the checkpoint");
+
+	hsize_t size[RANK] = {rows};
+	H5Dset_extent(dset, size);
+	H5Fflush(file, H5F_SCOPE_GLOBAL);
+
+	buffer.reserve(BUFFER_SIZE);
+	time(&lastFlush);
+}
+
+void HDF5Output::merge(const std::vector<std::string> &shards, const std::string &filename) {
+	hid_t out = H5Fcreate(filename.c_str(), H5F_ACC_TRUNC, H5P_DEFAULT, H5P_DEFAULT);
+	if (out < 0)
+		throw std::runtime_error(std::string("Cannot create file: ") + filename);
+
+	hid_t dset = -1, type = -1;
+	std::vector<char> rows;
+	for (size_t i = 0; i < shards.size(); i++) {
+		if (!std::ifstream(shards[i].c_str()).good()) {
+			KISS_LOG_WARNING << "HDF5Output::merge: skipping missing file " << shards[i];
+			continue;
+		}
+		hid_t in = H5Fopen(shards[i].c_str(), H5F_ACC_RDONLY, H5P_DEFAULT);
+		if (in < 0)
+			throw std::runtime_error(std::string("Cannot open file: ") + shards[i]);
+
+		if (dset < 0) {
+			// the first file is copied with its attributes and chunking
+			H5Ocopy(in, "CRPROPA3", out, "CRPROPA3", H5P_DEFAULT, H5P_DEFAULT);
+			dset = H5Dopen2(out, "CRPROPA3", H5P_DEFAULT);
+			if (dset < 0)
+				throw std::runtime_error("crpropa::HDF5Output: no CRPROPA3 dataset in " + shards[i]);
+			type = H5Dget_type(dset);
+			rows.resize(BUFFER_SIZE * H5Tget_size(type));
+			H5Fclose(in);
+			continue;
+		}
+
+		hid_t src = H5Dopen2(in, "CRPROPA3", H5P_DEFAULT);
+		if (src < 0)
+			throw std::runtime_error("crpropa::HDF5Output: no CRPROPA3 dataset in " + shards[i]);
+		hid_t srcType = H5Dget_type(src);
+		if (H5Tequal(type, srcType) <= 0)
+			throw std::runtime_error("crpropa::HDF5Output: " + shards[i] + " has different columns than the first file");
+
+		hid_t srcSpace = H5Dget_space(src);
+		hsize_t n = H5Sget_simple_extent_npoints(srcSpace);
+		for (hsize_t offset = 0; offset < n; offset += BUFFER_SIZE) {
+			hsize_t cnt[RANK] = {std::min(BUFFER_SIZE, n - offset)};
+			hid_t mspace = H5Screate_simple(RANK, cnt, NULL);
+
+			hsize_t srcOffset[RANK] = {offset};
+			H5Sselect_hyperslab(srcSpace, H5S_SELECT_SET, srcOffset, NULL, cnt, NULL);
+			H5Dread(src, type, mspace, srcSpace, H5P_DEFAULT, rows.data());
+
+			hid_t space = H5Dget_space(dset);
+			hsize_t size = H5Sget_simple_extent_npoints(space);
+			H5Sclose(space);
+			hsize_t newSize[RANK] = {size + cnt[0]};
+			H5Dset_extent(dset, newSize);
+			space = H5Dget_space(dset);
+			hsize_t dstOffset[RANK] = {size};
+			H5Sselect_hyperslab(space, H5S_SELECT_SET, dstOffset, NULL, cnt, NULL);
+			H5Dwrite(dset, type, mspace, space, H5P_DEFAULT, rows.data());
+			H5Sclose(space);
+			H5Sclose(mspace);
+		}
+
+		H5Sclose(srcSpace);
+		H5Tclose(srcType);
+		H5Dclose(src);
+		H5Fclose(in);
+	}
+
+	if (dset >= 0) {
+		H5Tclose(type);
+		H5Dclose(dset);
+	}
+	H5Fclose(out);
+}
+
 std::string HDF5Output::getDescription() const  {
 	return "HDF5Output";
 }
@@ -0,0 +1,426 @@
+#include "crpropa/module/HistogramOutput.h"
+#include "crpropa/Common.h"
+#include "crpropa/Version.h"
+
+#ifdef WITH_GALACTIC_LENSES
+#include "crpropa/magneticLens/Pixelization.h"
+#endif
+
+#ifdef CRPROPA_HAVE_HDF5
+#include <hdf5.h>
+#endif
+
+#include "kiss/logger.h"
+#include "kiss/string.h"
+
+#include <cmath>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+
+namespace crpropa {
+
+static const char *quantityName(HistogramOutput::Quantity quantity) {
+	switch (quantity) {
+	case HistogramOutput::Energy:
+		return "E";
+	case HistogramOutput::SourceEnergy:
+		return "E0";
+	case HistogramOutput::ParticleId:
+		return "ID";
+	case HistogramOutput::ArrivalDirection:
+		return "direction";
+	case HistogramOutput::TrajectoryLength:
+		return "D";
+	case HistogramOutput::Redshift:
+		return "z";
+	}
+	return "unknown";
+}
+
+HistogramOutput::HistogramOutput(const std::string &filename) :
+		filename(filename), nBins(1), pixelization(0), closed(false),
+		threadBins(MAX_THREAD, 0) {
+}
+
+HistogramOutput::~HistogramOutput() {
+	// a destructor must not throw, e.g. when the file cannot be written
+	try {
+		close();
+	} catch (std::exception &e) {
+		KISS_LOG_ERROR << e.what();
+	}
+	for (size_t i = 0; i < threadBins.size(); i++)
+		delete threadBins[i];
+#ifdef WITH_GALACTIC_LENSES
+	delete pixelization;
+#endif
+}
+
+void HistogramOutput::addAxis(const Axis &axis) {
+	for (size_t i = 0; i < threadBins.size(); i++)
+		if (threadBins[i])
+			throw std::runtime_error("HistogramOutput: cannot add axes after candidates have been processed");
+	if (axis.nBins == 0)
+		throw std::runtime_error("HistogramOutput: axis without bins");
+	axes.push_back(axis);
+	nBins *= axis.nBins;
+}
+
+void HistogramOutput::addLinearAxis(Quantity quantity, size_t n, double min,
+		double max) {
+	if (quantity == ArrivalDirection)
+		throw std::runtime_error("HistogramOutput: use addDirectionAxis for directions");
+	if (!(max > min))
+		throw std::runtime_error("HistogramOutput: max <= min");
+	Axis axis;
+	axis.quantity = quantity;
+	axis.type = LinearAxis;
+	axis.nBins = n;
+	axis.min = min;
+	axis.max = max;
+	addAxis(axis);
+}
+
+void HistogramOutput::addLogAxis(Quantity quantity, size_t n, double min,
+		double max) {
+	if (quantity == ArrivalDirection)
+		throw std::runtime_error("HistogramOutput: use addDirectionAxis for directions");
+	if (!(min > 0) || !(max > min))
+		throw std::runtime_error("HistogramOutput: logarithmic axis needs 0 < min < max");
+	Axis axis;
+	axis.quantity = quantity;
+	axis.type = LogAxis;
+	axis.nBins = n;
+	axis.min = std::log(min);
+	axis.max = std::log(max);
+	addAxis(axis);
+}
+
+void HistogramOutput::addIdAxis(const std::vector<int> &ids) {
+	Axis axis;
+	axis.quantity = ParticleId;
+	axis.type = IdAxis;
+	axis.nBins = ids.size();
+	axis.min = 0;
+	axis.max = 0;
+	axis.ids = ids;
+	addAxis(axis);
+}
+
+void HistogramOutput::addDirectionAxis(unsigned int order) {
+#ifdef WITH_GALACTIC_LENSES
+	if (pixelization)
+		throw std::runtime_error("HistogramOutput: only one direction axis is supported");
+	Pixelization *p = new Pixelization(order);
+	Axis axis;
+	axis.quantity = ArrivalDirection;
+	axis.type = DirectionAxis;
+	axis.nBins = p->nPix();
+	axis.min = 0;
+	axis.max = 0;
+	try {
+		addAxis(axis);
+	} catch (std::runtime_error &e) {
+		delete p;
+		throw;
+	}
+	pixelization = p;
+#else
+	throw std::runtime_error("HistogramOutput: CRPropa was built without galactic magnetic lens (Healpix) support");
+#endif
+}
+
+long HistogramOutput::binIndex(const Axis &axis, const Candidate *c) const {
+	if (axis.type == DirectionAxis) {
+#ifdef WITH_GALACTIC_LENSES
+		// same convention as ParticleMapsContainer
+		const Vector3d &p = c->current.getDirection();
+		double longitude = std::atan2(-p.y, -p.x);
+		double latitude = M_PI / 2 - std::acos(-p.z / p.getR());
+		return pixelization->direction2Pix(longitude, latitude);
+#else
+		return -1;
+#endif
+	}
+
+	if (axis.type == IdAxis) {
+		int id = c->current.getId();
+		for (size_t i = 0; i < axis.ids.size(); i++)
+			if (axis.ids[i] == id)
+				return i;
+		return -1;
+	}
+
+	double value = 0;
+	switch (axis.quantity) {
+	case Energy:
+		value = c->current.getEnergy();
+		break;
+	case SourceEnergy:
+		value = c->source.getEnergy();
+		break;
+	case ParticleId:
+		value = c->current.getId();
+		break;
+	case TrajectoryLength:
+		value = c->getTrajectoryLength();
+		break;
+	case Redshift:
+		value = c->getRedshift();
+		break;
+	default:
+		return -1;
+	}
+
+	if (axis.type == LogAxis) {
+		if (!(value > 0))
+			return -1;
+		value = std::log(value);
+	}
+	// also rejects NaN
+	if (!(value >= axis.min && value < axis.max))
+		return -1;
+	long i = static_cast<long>((value - axis.min) / (axis.max - axis.min) * axis.nBins);
+	return std::min(i, long(axis.nBins) - 1);
+}
+
+void HistogramOutput::process(Candidate *c) const {
+	if (axes.empty())
+		return;
+
+	std::vector<double> *&bins = threadBins[threadIndex()];
+	if (bins == 0)
+		bins = new std::vector<double>(nBins + 1, 0.);
+
+	size_t index = 0;
+	for (size_t i = 0; i < axes.size(); i++) {
+		long j = binIndex(axes[i], c);
+		if (j < 0) {
+			(*bins)[nBins] += c->getWeight();
+			return;
+		}
+		index = index * axes[i].nBins + j;
+	}
+	(*bins)[index] += c->getWeight();
+}
+
+std::vector<double> HistogramOutput::merge() const {
+	std::vector<double> histogram(nBins + 1, 0.);
+	for (size_t i = 0; i < threadBins.size(); i++) {
+		if (threadBins[i] == 0)
+			continue;
+		const std::vector<double> &bins = *threadBins[i];
+		for (size_t j = 0; j < bins.size(); j++)
+			histogram[j] += bins[j];
+	}
+	return histogram;
+}
+
+std::vector<double> HistogramOutput::getHistogram() const {
+	std::vector<double> histogram = merge();
+	histogram.pop_back();
+	return histogram;
+}
+
+double HistogramOutput::getOutsideWeight() const {
+	return merge().back();
+}
+
+void HistogramOutput::clear() {
+	for (size_t i = 0; i < threadBins.size(); i++) {
+		delete threadBins[i];
+		threadBins[i] = 0;
+	}
+}
+
+std::string HistogramOutput::saveCheckpoint() {
+	std::vector<double> histogram = merge();
+	std::stringstream ss;
+	ss.precision(17);
+	ss << histogram.size();
+	for (size_t i = 0; i < histogram.size(); i++)
+		ss << " " << histogram[i];
+	return ss.str();
+}
+
+void HistogramOutput::loadCheckpoint(const std::string &state) {
+	std::stringstream ss(state);
+	size_t n = 0;
+	if (!(ss >> n) || (n != nBins + 1))
+		throw std::runtime_error("HistogramOutput: the checkpoint does not match the axes");
+	std::vector<double> *bins = new std::vector<double>(n);
+	for (size_t i = 0; i < n; i++)
+		if (!(ss >> (*bins)[i])) {
+			delete bins;
+			throw std::runtime_error("HistogramOutput: invalid checkpoint state");
+		}
+	clear();
+	threadBins[0] = bins;
+}
+
+size_t HistogramOutput::getNumberOfAxes() const {
+	return axes.size();
+}
+
+std::vector<size_t> HistogramOutput::getShape() const {
+	std::vector<size_t> shape;
+	for (size_t i = 0; i < axes.size(); i++)
+		shape.push_back(axes[i].nBins);
+	return shape;
+}
+
+std::vector<double> HistogramOutput::getBinEdges(size_t i) const {
+	if (i >= axes.size())
+		throw std::runtime_error("HistogramOutput: axis index out of range");
+	const Axis &axis = axes[i];
+	std::vector<double> edges;
+	if (axis.type == IdAxis) {
+		edges.assign(axis.ids.begin(), axis.ids.end());
+	} else if (axis.type == DirectionAxis) {
+		for (size_t j = 0; j < axis.nBins; j++)
+			edges.push_back(j);
+	} else {
+		for (size_t j = 0; j <= axis.nBins; j++) {
+			double x = axis.min + (axis.max - axis.min) * j / axis.nBins;
+			edges.push_back((axis.type == LogAxis) ? std::exp(x) : x);
+		}
+	}
+	return edges;
+}
+
+void HistogramOutput::close() {
+	if (closed || filename.empty())
+		return;
+	closed = true;
+	std::vector<double> histogram = getHistogram();
+	if (kiss::ends_with(filename, ".h5"))
+		writeHDF5(histogram);
+	else
+		writeNpy(histogram);
+}
+
+void HistogramOutput::writeNpy(const std::vector<double> &histogram) const {
+	std::ofstream out(filename.c_str(), std::ios::binary);
+	if (!out)
+		throw std::runtime_error(std::string("Cannot create file: ") + filename);
+
+	// NPY format version 1.0
+	const uint16_t one = 1;
+	bool littleEndian = *reinterpret_cast<const char *>(&one) == 1;
+	std::stringstream header;
+	header << "{'descr': '" << (littleEndian ? '<' : '>')
+			<< "f8', 'fortran_order': False, 'shape': (";
+	for (size_t i = 0; i < axes.size(); i++)
+		header << axes[i].nBins << ", ";
+	header << "), }";
+	std::string dict = header.str();
+	// magic (6) + version (2) + length (2) + dict + '\n' aligned to 64 bytes
+	size_t total = 10 + dict.size() + 1;
+	dict.append((64 - total % 64) % 64, ' ');
+	dict.push_back('\n');
+
+	out.write("\x93NUMPY\x01\x00", 8);
+	unsigned char length[2] = { static_cast<unsigned char>(dict.size() & 0xff),
+			static_cast<unsigned char>(dict.size() >> 8) };
+	out.write(reinterpret_cast<const char *>(length), 2);
+	out.write(dict.data(), dict.size());
+	if (!histogram.empty())
+		out.write(reinterpret_cast<const char *>(&histogram[0]),
+				histogram.size() * sizeof(double));
+	if (!out)
+		throw std::runtime_error(std::string("Cannot write file: ") + filename);
+}
+
+#ifdef CRPROPA_HAVE_HDF5
+// HDF5 objects of writeHDF5, closed in reverse order also if an error is thrown
+class HDF5Objects {
+public:
+	HDF5Objects(const std::string &filename) : filename(filename) {
+	}
+	~HDF5Objects() {
+		close();
+	}
+	hid_t add(hid_t id, herr_t (*closeObject)(hid_t)) {
+		if (id < 0)
+			fail();
+		objects.push_back(std::make_pair(id, closeObject));
+		return id;
+	}
+	void check(herr_t status) const {
+		if (status < 0)
+			fail();
+	}
+	herr_t close() {
+		herr_t status = 0;
+		for (size_t i = objects.size(); i > 0; i--)
+			if (objects[i - 1].second(objects[i - 1].first) < 0)
+				status = -1;
+		objects.clear();
+		return status;
+	}
+	void fail() const {
+		throw std::runtime_error(std::string("Cannot write file: ") + filename);
+	}
+private:
+	std::string filename;
+	std::vector<std::pair<hid_t, herr_t (*)(hid_t)> > objects;
+};
+#endif
+
+void HistogramOutput::writeHDF5(const std::vector<double> &histogram) const {
+#ifdef CRPROPA_HAVE_HDF5
+	HDF5Objects h5(filename);
+	hid_t file = H5Fcreate(filename.c_str(), H5F_ACC_TRUNC, H5P_DEFAULT, H5P_DEFAULT);
+	if (file < 0)
+		throw std::runtime_error(std::string("Cannot create file: ") + filename);
+	h5.add(file, H5Fclose);
+
+	std::vector<hsize_t> dims(axes.size());
+	for (size_t i = 0; i < axes.size(); i++)
+		dims[i] = axes[i].nBins;
+	hid_t space = h5.add(H5Screate_simple(dims.size(), dims.empty() ? 0 : &dims[0], NULL), H5Sclose);
+	hid_t dset = h5.add(H5Dcreate2(file, "histogram", H5T_NATIVE_DOUBLE, space,
+			H5P_DEFAULT, H5P_DEFAULT, H5P_DEFAULT), H5Dclose);
+	if (!histogram.empty())
+		h5.check(H5Dwrite(dset, H5T_NATIVE_DOUBLE, H5S_ALL, H5S_ALL, H5P_DEFAULT, &histogram[0]));
+
+	hid_t strtype = h5.add(H5Tcopy(H5T_C_S1), H5Tclose);
+	h5.check(H5Tset_size(strtype, H5T_VARIABLE));
+	hid_t scalar = h5.add(H5Screate(H5S_SCALAR), H5Sclose);
+	const char *version = g_GIT_DESC;
+	hid_t attr = h5.add(H5Acreate2(dset, "Version", strtype, scalar, H5P_DEFAULT, H5P_DEFAULT), H5Aclose);
+	h5.check(H5Awrite(attr, strtype, &version));
+
+	for (size_t i = 0; i < axes.size(); i++) {
+		std::vector<double> edges = getBinEdges(i);
+		hsize_t n = edges.size();
+		std::stringstream name;
+		name << "axis" << i;
+		space = h5.add(H5Screate_simple(1, &n, NULL), H5Sclose);
+		dset = h5.add(H5Dcreate2(file, name.str().c_str(), H5T_NATIVE_DOUBLE, space,
+				H5P_DEFAULT, H5P_DEFAULT, H5P_DEFAULT), H5Dclose);
+		h5.check(H5Dwrite(dset, H5T_NATIVE_DOUBLE, H5S_ALL, H5S_ALL, H5P_DEFAULT, &edges[0]));
+		const char *quantity = quantityName(axes[i].quantity);
+		attr = h5.add(H5Acreate2(dset, "quantity", strtype, scalar, H5P_DEFAULT, H5P_DEFAULT), H5Aclose);
+		h5.check(H5Awrite(attr, strtype, &quantity));
+	}
+
+	// closing the file writes the data
+	h5.check(h5.close());
+#else
+	throw std::runtime_error("HistogramOutput: CRPropa was built without HDF5 support");
+#endif
+}
+
+std::string HistogramOutput::getDescription() const {
+	std::stringstream s;
+	s << "HistogramOutput: ";
+	for (size_t i = 0; i < axes.size(); i++)
+		s << quantityName(axes[i].quantity) << " (" << axes[i].nBins << ") ";
+	if (!filename.empty())
+		s << "-> " << filename;
+	return s.str();
+}
+
+} // namespace crpropa
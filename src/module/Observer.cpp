@@ -5,6 +5,7 @@
 
 #include "kiss/logger.h"
 
+#include <algorithm>
 #include <iostream>
 #include <cmath>
 
@@ -77,6 +78,28 @@ void Observer::setDeactivateOnDetection(bool deactivate) {
 	makeInactive = deactivate;
 }
 
+std::string Observer::saveCheckpoint() {
+	if (detectionAction.valid())
+		return detectionAction->saveCheckpoint();
+	return "";
+}
+
+void Observer::loadCheckpoint(const std::string &state) {
+	if (detectionAction.valid())
+		detectionAction->loadCheckpoint(state);
+}
+
+size_t Observer::getBacklog() const {
+	if (detectionAction.valid())
+		return detectionAction->getBacklog();
+	return 0;
+}
+
+void Observer::finishRun() {
+	if (detectionAction.valid())
+		detectionAction->finishRun();
+}
+
 // ObserverFeature ------------------------------------------------------------
 DetectionState ObserverFeature::checkDetection(Candidate *candidate) const {
 	return NOTHING;
@@ -249,64 +272,52 @@ std::string ObserverParticleIdVeto::getDescription() const {
 
 
 // ObserverTimeEvolution --------------------------------------------------------
-ObserverTimeEvolution::ObserverTimeEvolution() {}
+ObserverTimeEvolution::ObserverTimeEvolution() : slot(Candidate::allocateSlot()) {}
 
-ObserverTimeEvolution::ObserverTimeEvolution(double min, double dist, double numb) {
+ObserverTimeEvolution::ObserverTimeEvolution(double min, double dist, double numb) :
+		slot(Candidate::allocateSlot()) {
 	double max = min + numb * dist;
 	bool log = false;
 	addTimeRange(min, max, numb, log);
 }
 
-ObserverTimeEvolution::ObserverTimeEvolution(double min, double max, double numb, bool log) {
+ObserverTimeEvolution::ObserverTimeEvolution(double min, double max, double numb, bool log) :
+		slot(Candidate::allocateSlot()) {
 	addTimeRange(min, max, numb, log);
 }
 
+ObserverTimeEvolution::~ObserverTimeEvolution() {
+	Candidate::releaseSlot(slot);
+}
 
-DetectionState ObserverTimeEvolution::checkDetection(Candidate *c) const {
-
-	if (detList.size()) {
-		double length = c->getTrajectoryLength();
-		size_t index;
-		const std::string DI = "DetectionIndex";
-		std::string value;
-
-		// Load the last detection index
-		if (c->hasProperty(DI)) {
-			index = c->getProperty(DI).asUInt64();
-		}
-		else {
-			index = 0;
-		}
-
-		// Break if the particle has been detected once for all detList entries.
-		if (index > detList.size()) {
-			return NOTHING;
-		}
 
-		// Calculate the distance to next detection
-		double distance = length - detList[index];
+DetectionState ObserverTimeEvolution::checkDetection(Candidate *c) const {
+	// index of the next detection time of the candidate
+	size_t index = c->getSlot(slot);
 
-		// Limit next step and detect candidate.
-		// Increase the index by one in case of detection
-		if (distance < 0.) {
-			c->limitNextStep(-distance);
-			return NOTHING;
-		}
-		else {
+	// Break if the particle has been detected once for all detList entries.
+	if (index >= detList.size())
+		return NOTHING;
 
-			if (index < detList.size()-1) {
-				c->limitNextStep(detList[index+1]-length);
-			}
-			c->setProperty(DI, Variant::fromUInt64(index+1));
+	// Calculate the distance to next detection
+	double length = c->getTrajectoryLength();
+	double distance = length - detList[index];
 
-			return DETECTED;
-		}
+	// Limit next step and detect candidate.
+	// Increase the index by one in case of detection
+	if (distance < 0.) {
+		c->limitNextStep(-distance);
+		return NOTHING;
 	}
-	return NOTHING;
+
+	if (index < detList.size() - 1)
+		c->limitNextStep(detList[index + 1] - length);
+	c->setSlot(slot, index + 1);
+	return DETECTED;
 }
 
 void ObserverTimeEvolution::addTime(const double& t) {
-	detList.push_back(t);
+	detList.insert(std::upper_bound(detList.begin(), detList.end(), t), t);
 }
 
 void ObserverTimeEvolution::addTimeRange(double min, double max, double numb, bool log) {
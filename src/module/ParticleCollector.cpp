@@ -73,6 +73,47 @@ std::vector<ref_ptr<Candidate> >& ParticleCollector::getContainer() const {
         return container;
 }
 
+static void fillState(const ParticleState &state, double &E, double &X,
+		double &Y, double &Z, double &Px, double &Py, double &Pz) {
+	const Vector3d &x = state.getPosition();
+	const Vector3d &p = state.getDirection();
+	E = state.getEnergy();
+	X = x.x;
+	Y = x.y;
+	Z = x.z;
+	Px = p.x;
+	Py = p.y;
+	Pz = p.z;
+}
+
+static void fillRecord(CandidateRecord &r, const Candidate *c) {
+	r.D = c->getTrajectoryLength();
+	r.z = c->getRedshift();
+	r.W = c->getWeight();
+	r.SN = c->getSerialNumber();
+	r.SN0 = c->getSourceSerialNumber();
+	r.SN1 = c->getCreatedSerialNumber();
+	r.ID = c->current.getId();
+	r.ID0 = c->source.getId();
+	r.ID1 = c->created.getId();
+	r.reserved = 0;
+	fillState(c->current, r.E, r.X, r.Y, r.Z, r.Px, r.Py, r.Pz);
+	fillState(c->source, r.E0, r.X0, r.Y0, r.Z0, r.P0x, r.P0y, r.P0z);
+	fillState(c->created, r.E1, r.X1, r.Y1, r.Z1, r.P1x, r.P1y, r.P1z);
+}
+
+void ParticleCollector::getRecords(CandidateRecord *records) const {
+	for (size_t i = 0; i < container.size(); i++)
+		fillRecord(records[i], container[i].get());
+}
+
+std::vector<CandidateRecord> ParticleCollector::getRecords() const {
+	std::vector<CandidateRecord> records(container.size());
+	if (!records.empty())
+		getRecords(&records[0]);
+	return records;
+}
+
 void ParticleCollector::setClone(bool b) {
         clone = b;
 }
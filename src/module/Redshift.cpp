@@ -6,6 +6,17 @@
 
 namespace crpropa {
 
+Redshift::Redshift(ref_ptr<Cosmology> cosmology) : cosmology(cosmology) {
+}
+
+void Redshift::setCosmology(ref_ptr<Cosmology> cosmology) {
+	this->cosmology = cosmology;
+}
+
+ref_ptr<Cosmology> Redshift::getCosmology() const {
+	return cosmology;
+}
+
 void Redshift::process(Candidate *c) const {
 	double z = c->getRedshift();
 
@@ -13,8 +24,10 @@ void Redshift::process(Candidate *c) const {
 	if (z <= std::numeric_limits<double>::min())
 		return;
 
+	const Cosmology &cosmo = cosmology.valid() ? *cosmology : defaultCosmology();
+
 	// use small step approximation:  dz = H(z) / c * ds
-	double dz = hubbleRate(z) / c_light * c->getCurrentStep();
+	double dz = cosmo.hubbleRate(z) / c_light * c->getCurrentStep();
 	// modified dz
 	//double dz = hubbleRate(z)*(1+z) / c_light * c->getCurrentStep();
 
@@ -30,12 +43,24 @@ void Redshift::process(Candidate *c) const {
 }
 
 std::string Redshift::getDescription() const {
+	const Cosmology &cosmo = cosmology.valid() ? *cosmology : defaultCosmology();
 	std::stringstream s;
-	s << "Redshift: h0 = " << hubbleRate() / 1e5 * Mpc << ", omegaL = "
-			<< omegaL() << ", omegaM = " << omegaM();
+	s << "Redshift: h0 = " << cosmo.hubbleRate() / 1e5 * Mpc << ", omegaL = "
+			<< cosmo.omegaL() << ", omegaM = " << cosmo.omegaM();
 	return s.str();
 }
 
+FutureRedshift::FutureRedshift(ref_ptr<Cosmology> cosmology) : cosmology(cosmology) {
+}
+
+void FutureRedshift::setCosmology(ref_ptr<Cosmology> cosmology) {
+	this->cosmology = cosmology;
+}
+
+ref_ptr<Cosmology> FutureRedshift::getCosmology() const {
+	return cosmology;
+}
+
 void FutureRedshift::process(Candidate *c) const {
 	double z = c->getRedshift();
 
@@ -43,8 +68,10 @@ void FutureRedshift::process(Candidate *c) const {
 	if (z <= -1)
 		return;
 
+	const Cosmology &cosmo = cosmology.valid() ? *cosmology : defaultCosmology();
+
 	// use small step approximation:  dz = H(z) / c * ds
-	double dz = hubbleRate(z) / c_light * c->getCurrentStep();
+	double dz = cosmo.hubbleRate(z) / c_light * c->getCurrentStep();
 
 	// update redshift
 	c->setRedshift(z - dz);
@@ -55,9 +82,10 @@ void FutureRedshift::process(Candidate *c) const {
 }
 
 std::string FutureRedshift::getDescription() const {
+	const Cosmology &cosmo = cosmology.valid() ? *cosmology : defaultCosmology();
 	std::stringstream s;
-	s << "FutureRedshift: h0 = " << hubbleRate() / 1e5 * Mpc << ", omegaL = "
-			<< omegaL() << ", omegaM = " << omegaM();
+	s << "FutureRedshift: h0 = " << cosmo.hubbleRate() / 1e5 * Mpc << ", omegaL = "
+			<< cosmo.omegaL() << ", omegaM = " << cosmo.omegaM();
 	return s.str();
 }
 
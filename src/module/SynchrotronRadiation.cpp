@@ -2,6 +2,7 @@
 #include "crpropa/Units.h"
 #include "crpropa/Random.h"
 
+#include <algorithm>
 #include <fstream>
 #include <limits>
 #include <stdexcept>
@@ -13,6 +14,7 @@ SynchrotronRadiation::SynchrotronRadiation(ref_ptr<MagneticField> field, bool ha
 	setBrms(0);
 	initSpectrum();
 	setHavePhotons(havePhotons);
+	setThinning(thinning);
 	setLimit(limit);
 	setSecondaryThreshold(1e6 * eV);
 	setMaximumSamples(nSamples);
@@ -22,6 +24,7 @@ SynchrotronRadiation::SynchrotronRadiation(double Brms, bool havePhotons, double
 	setBrms(Brms);
 	initSpectrum();
 	setHavePhotons(havePhotons);
+	setThinning(thinning);
 	setLimit(limit);
 	setSecondaryThreshold(1e6 * eV);
 	setMaximumSamples(nSamples);
@@ -55,6 +58,14 @@ void SynchrotronRadiation::setThinning(double thinning) {
 	this->thinning = thinning;
 }
 
+void SynchrotronRadiation::setWeightWindow(ref_ptr<WeightWindow> weightWindow) {
+	this->weightWindow = weightWindow;
+}
+
+ref_ptr<WeightWindow> SynchrotronRadiation::getWeightWindow() const {
+	return weightWindow;
+}
+
 double SynchrotronRadiation::getThinning() {
 	return thinning;
 }
@@ -83,6 +94,15 @@ double SynchrotronRadiation::getSecondaryThreshold() const {
 	return secondaryThreshold;
 }
 
+void SynchrotronRadiation::setCollectivePhotons(size_t nBins) {
+	collectivePhotons = nBins;
+	initCollectivePhotons();
+}
+
+size_t SynchrotronRadiation::getCollectivePhotons() const {
+	return collectivePhotons;
+}
+
 void SynchrotronRadiation::initSpectrum() {
 	std::string filename = getDataPath("Synchrotron/spectrum.txt");
 	std::ifstream infile(filename.c_str());
@@ -106,6 +126,78 @@ void SynchrotronRadiation::initSpectrum() {
 		infile.ignore(std::numeric_limits < std::streamsize > ::max(), '\n');
 	}
 	infile.close();
+
+	// guide table for sampling, see sampleX
+	size_t n = tabCDF.size();
+	tabGuide.resize(n);
+	for (size_t k = 0; k < n; k++)
+		tabGuide[k] = std::lower_bound(tabCDF.begin(), tabCDF.end(),
+				tabCDF.back() * k / n) - tabCDF.begin();
+
+	initCollectivePhotons();
+}
+
+void SynchrotronRadiation::initCollectivePhotons() {
+	collectiveX.clear();
+	collectiveEnergy.clear();
+	if ((collectivePhotons == 0) or (tabx.size() < 2))
+		return;
+
+	// group the tabulation intervals into logarithmic bins, within an
+	// interval x is uniformly distributed
+	size_t nIntervals = tabx.size() - 1;
+	size_t nBins = std::min(collectivePhotons, nIntervals);
+	double totalEnergy = 0;
+	for (size_t j = 0; j < nBins; j++) {
+		double number = 0, energy = 0;
+		for (size_t i = j * nIntervals / nBins; i < (j + 1) * nIntervals / nBins; i++) {
+			double dN = tabCDF[i + 1] - tabCDF[i];
+			number += dN;
+			energy += dN * (tabx[i] + tabx[i + 1]) / 2;
+		}
+		collectiveX.push_back(number > 0 ? energy / number : 0);
+		collectiveEnergy.push_back(energy);
+		totalEnergy += energy;
+	}
+	for (size_t j = 0; j < nBins; j++)
+		collectiveEnergy[j] /= totalEnergy;
+}
+
+double SynchrotronRadiation::sampleX(Random &random) const {
+	// inverse of the piecewise linear CDF; the guide table gives the first
+	// candidate bin, on average less than two bins are searched
+	double u = random.rand() * tabCDF.back();
+	size_t n = tabGuide.size();
+	size_t i = tabGuide[std::min(size_t(u / tabCDF.back() * n), n - 1)];
+	while (tabCDF[i] < u)
+		i++;
+	i = std::max(i, size_t(1));
+	double dCDF = tabCDF[i] - tabCDF[i-1];
+	if (dCDF <= 0)
+		return tabx[i-1];
+	return tabx[i-1] + (u - tabCDF[i-1]) / dCDF * (tabx[i] - tabx[i-1]);
+}
+
+// energy loss per length in the local frame for the perpendicular field B
+static double lossRate(const ParticleState &state, double B) {
+	double charge = fabs(state.getCharge());
+	double Rg = state.getMomentum().getR() / charge / B; // gyroradius
+	double lf = state.getLorentzFactor();
+	return 1. / 6 / M_PI / epsilon0 * pow(lf * lf - 1, 2) * pow(charge / Rg, 2); // Jackson p. 770 (14.31)
+}
+
+double SynchrotronRadiation::getEnergyLossRate(int id, double energy, double z) const {
+	if (field.valid())
+		throw std::runtime_error("SynchrotronRadiation: energy loss rate only available for a RMS field strength");
+
+	ParticleState state;
+	state.setId(id);
+	state.setEnergy(energy);
+	if (state.getCharge() == 0)
+		return 0; // only charged particles
+
+	double B = sqrt(2. / 3) * Brms * pow(1 + z, 2); // average perpendicular field component, cosmological scaling
+	return lossRate(state, B) / (1 + z); // per comoving length
 }
 
 void SynchrotronRadiation::process(Candidate *candidate) const {
@@ -127,7 +219,7 @@ void SynchrotronRadiation::process(Candidate *candidate) const {
 
 	// calculate energy loss
 	double lf = candidate->current.getLorentzFactor();
-	double dEdx = 1. / 6 / M_PI / epsilon0 * pow(lf * lf - 1, 2) * pow(charge / Rg, 2); // Jackson p. 770 (14.31)
+	double dEdx = lossRate(candidate->current, B);
 	double step = candidate->getCurrentStep() / (1 + z); // step size in local frame
 	double dE = step * dEdx;
 
@@ -145,19 +237,31 @@ void SynchrotronRadiation::process(Candidate *candidate) const {
 	if (14 * Ecrit < secondaryThreshold)
 		return;
 
-	// draw photons up to the total energy loss
-	// if maximumSamples is reached before that, compensate the total energy afterwards
 	Random &random = Random::instance();
+
+	// collective photons: one photon per bin with the expected number of photons as weight
+	if (collectivePhotons > 0) {
+		for (size_t j = 0; j < collectiveX.size(); j++) {
+			double Ephoton = collectiveX[j] * Ecrit;
+			if ((collectiveEnergy[j] <= 0) or (Ephoton <= secondaryThreshold))
+				continue;
+			Vector3d pos = random.randomInterpolatedPosition(candidate->previous.getPosition(), candidate->current.getPosition());
+			double w = dE * collectiveEnergy[j] / Ephoton;
+			if (weightWindow.valid())
+				weightWindow->addSecondary(candidate, 22, Ephoton, pos, 1, interactionTag, w);
+			else
+				candidate->addSecondary(22, Ephoton, pos, w, interactionTag);
+		}
+		return;
+	}
+
+	// draw photons up to the total energy loss and add them directly
+	// if maximumSamples is reached before that, compensate the total energy afterwards
 	double dE0 = dE;
-	std::vector<double> energies;
+	size_t firstSecondary = candidate->secondaries.size();
 	int counter = 0;
 	while (dE > 0) {
-		// draw random value between 0 and maximum of corresponding cdf
-		// choose bin of s where cdf(x) = cdf_rand -> x_rand
-		size_t i = random.randBin(tabCDF); // draw random bin (upper bin boundary returned)
-		double binWidth = (tabx[i] - tabx[i-1]);
-		double x = tabx[i-1] + random.rand() * binWidth; // draw random x uniformly distributed in bin
-		double Ephoton = x * Ecrit;
+		double Ephoton = sampleX(random) * Ecrit;
 
 		// if the remaining energy is not sufficient check for random accepting
 		if (Ephoton > dE) {
@@ -171,32 +275,35 @@ void SynchrotronRadiation::process(Candidate *candidate) const {
 				break;			
 		}
 
-		// store energies in array
-		energies.push_back(Ephoton);
-
 		// energy loss
 		dE -= Ephoton;
 
 		// counter for sampling break condition;
 		counter++;
-	}
-
-	// while loop before gave total energy which is just a fraction of the required
-	double w1 = 1;
-	if (maximumSamples > 0 && dE > 0)
-		w1 = 1. / (1. - dE / dE0); 
 
-	// loop over sampled photons and attribute weights accordingly
-	for (int i = 0; i < energies.size(); i++) {
-		double Ephoton = energies[i];
-		double f = Ephoton / (E - dE0);
-		double w = w1 / pow(f, thinning);
+		// create only photons with energies above threshold
+		if (Ephoton <= secondaryThreshold)
+			continue;
 
 		// thinning procedure: accepts only a few random secondaries
-		if (random.rand() < pow(f, thinning)) {
+		double p = (thinning > 0) ? pow(Ephoton / (E - dE0), thinning) : 1;
+		if (weightWindow.valid()) {
 			Vector3d pos = random.randomInterpolatedPosition(candidate->previous.getPosition(), candidate->current.getPosition());
-			if (Ephoton > secondaryThreshold) // create only photons with energies above threshold
-				candidate->addSecondary(22, Ephoton, pos, w, interactionTag);
+			weightWindow->addSecondary(candidate, 22, Ephoton, pos, p, interactionTag);
+			continue;
+		}
+		if ((p < 1) and (random.rand() >= p))
+			continue;
+		Vector3d pos = random.randomInterpolatedPosition(candidate->previous.getPosition(), candidate->current.getPosition());
+		candidate->addSecondary(22, Ephoton, pos, 1. / p, interactionTag);
+	}
+
+	// while loop before gave total energy which is just a fraction of the required
+	if (maximumSamples > 0 && dE > 0) {
+		double w1 = 1. / (1. - dE / dE0);
+		for (size_t i = firstSecondary; i < candidate->secondaries.size(); i++) {
+			Candidate *secondary = candidate->secondaries[i];
+			secondary->setWeight(secondary->getWeight() * w1);
 		}
 	}
 }
@@ -212,6 +319,8 @@ std::string SynchrotronRadiation::getDescription() const {
 		s << ", synchrotron photons E > " << secondaryThreshold / eV << " eV";
 	else
 		s << ", no synchrotron photons";
+	if (collectivePhotons > 0)
+		s << ", collective photons in " << collectivePhotons << " bins";
 	if (maximumSamples > 0)
 		s << "maximum number of photon samples: " << maximumSamples;
 	if (thinning > 0)
@@ -7,10 +7,22 @@
 
 #include "kiss/string.h"
 
+#include <cmath>
 #include <cstdio>
+#include <fstream>
+#include <memory>
+#include <sstream>
 #include <stdexcept>
 #include <iostream>
 
+#ifndef _WIN32
+#include <unistd.h>
+#endif
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
 #ifdef CRPROPA_HAVE_ZLIB
 #include <izstream.hpp>
 #include <ozstream.hpp>
@@ -18,35 +30,188 @@
 
 namespace crpropa {
 
-TextOutput::TextOutput() : Output(), out(&std::cout), storeRandomSeeds(false) {
+static size_t fileSize(const std::string &filename) {
+	std::ifstream in(filename.c_str(), std::ios::binary | std::ios::ate);
+	if (!in)
+		throw std::runtime_error(std::string("Cannot open file: ") + filename);
+	return in.tellg();
+}
+
+static void resizeFile(const std::string &filename, size_t size) {
+#ifdef _WIN32
+	throw std::runtime_error("crpropa::TextOutput: resizing files is not supported on Windows");
+#else
+	if (::truncate(filename.c_str(), size) != 0)
+		throw std::runtime_error(std::string("Cannot resize file: ") + filename);
+#endif
 }
 
-TextOutput::TextOutput(OutputType outputtype) : Output(outputtype), out(&std::cout), storeRandomSeeds(false) {
+static bool inParallel() {
+#ifdef _OPENMP
+	return omp_in_parallel();
+#else
+	return false;
+#endif
 }
 
-TextOutput::TextOutput(std::ostream &out) : Output(), out(&out), storeRandomSeeds(false) {
+static const double powersOf10[] = { 1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7,
+		1e8, 1e9, 1e10, 1e11, 1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19,
+		1e20, 1e21, 1e22 };
+
+// a * 10^k, exact for |k| <= 22 up to the final rounding
+static double scale10(double a, int k) {
+	if (k >= 0) {
+		for (; k > 22; k -= 22)
+			a *= 1e22;
+		return a * powersOf10[k];
+	}
+	for (k = -k; k > 22; k -= 22)
+		a /= 1e22;
+	return a / powersOf10[k];
+}
+
+// writes value as printf("%8.5E") does, returns the number of characters
+static size_t formatScientific(char *buffer, double value) {
+	double a = std::fabs(value);
+	if (a == 0)
+		return std::sprintf(buffer, std::signbit(value) ? "-0.00000E+00" : "0.00000E+00");
+	// infinities, NaNs and the range of subnormals
+	if (!(a >= 1e-300 && a <= 1e300))
+		return std::sprintf(buffer, "%8.5E", value);
+
+	// six significant digits: 1e5 <= m < 1e6
+	int e = static_cast<int>(std::floor(std::log10(a)));
+	double m = scale10(a, 5 - e);
+	if (m < 99999.5) {
+		e--;
+		m = scale10(a, 5 - e);
+	} else if (m >= 999999.5) {
+		e++;
+		m = scale10(a, 5 - e);
+	}
+	double f = std::floor(m);
+	// too close to a tie for the scaled value, let printf round exactly
+	if (std::fabs(m - f - 0.5) < 1e-6)
+		return std::sprintf(buffer, "%8.5E", value);
+	unsigned long digits = static_cast<unsigned long>(f) + ((m - f > 0.5) ? 1 : 0);
+	if (digits >= 1000000) {
+		digits /= 10;
+		e++;
+	}
+	if (digits < 100000 || digits >= 1000000)
+		return std::sprintf(buffer, "%8.5E", value);
+
+	char *p = buffer;
+	if (value < 0)
+		*p++ = '-';
+	p[6] = '0' + digits % 10; digits /= 10;
+	p[5] = '0' + digits % 10; digits /= 10;
+	p[4] = '0' + digits % 10; digits /= 10;
+	p[3] = '0' + digits % 10; digits /= 10;
+	p[2] = '0' + digits % 10; digits /= 10;
+	p[1] = '.';
+	p[0] = '0' + digits;
+	p += 7;
+	*p++ = 'E';
+	*p++ = (e < 0) ? '-' : '+';
+	e = std::abs(e);
+	if (e >= 100) {
+		*p++ = '0' + e / 100;
+		e %= 100;
+	}
+	*p++ = '0' + e / 10;
+	*p++ = '0' + e % 10;
+	return p - buffer;
+}
+
+// writes value right aligned in a field of the given width, as printf("%10lu")
+static size_t formatInteger(char *buffer, unsigned long value, bool negative, int width) {
+	char digits[24];
+	int n = 0;
+	do {
+		digits[n++] = '0' + value % 10;
+		value /= 10;
+	} while (value > 0);
+	if (negative)
+		digits[n++] = '-';
+	size_t p = 0;
+	for (int i = n; i < width; i++)
+		buffer[p++] = ' ';
+	while (n > 0)
+		buffer[p++] = digits[--n];
+	return p;
+}
+
+static void appendScientific(std::string &line, double value) {
+	char buffer[32];
+	size_t n = formatScientific(buffer, value);
+	buffer[n++] = '\t';
+	line.append(buffer, n);
+}
+
+static void appendVector(std::string &line, const Vector3d &v) {
+	appendScientific(line, v.x);
+	appendScientific(line, v.y);
+	appendScientific(line, v.z);
+}
+
+static void appendSerial(std::string &line, uint64_t value) {
+	char buffer[32];
+	size_t n = formatInteger(buffer, value, false, 10);
+	buffer[n++] = '\t';
+	line.append(buffer, n);
+}
+
+static void appendId(std::string &line, int value) {
+	char buffer[32];
+	unsigned long magnitude = (value < 0) ? -static_cast<long>(value) : value;
+	size_t n = formatInteger(buffer, magnitude, value < 0, 10);
+	buffer[n++] = '\t';
+	line.append(buffer, n);
+}
+
+TextOutput::TextOutput() : Output(), out(&std::cout), storeRandomSeeds(false),
+		headerWritten(false), blockSize(1 << 16), buffers(MAX_THREAD) {
+}
+
+TextOutput::TextOutput(OutputType outputtype) : Output(outputtype), out(&std::cout), storeRandomSeeds(false),
+		headerWritten(false), blockSize(1 << 16), buffers(MAX_THREAD) {
+}
+
+TextOutput::TextOutput(std::ostream &out) : Output(), out(&out), storeRandomSeeds(false),
+		headerWritten(false), blockSize(1 << 16), buffers(MAX_THREAD) {
 }
 
 TextOutput::TextOutput(std::ostream &out,
-		OutputType outputtype) : Output(outputtype), out(&out), storeRandomSeeds(false) {
+		OutputType outputtype) : Output(outputtype), out(&out), storeRandomSeeds(false),
+		headerWritten(false), blockSize(1 << 16), buffers(MAX_THREAD) {
 }
 
-TextOutput::TextOutput(const std::string &filename) :  Output(), outfile(filename.c_str(),
-				std::ios::binary), out(&outfile),  filename(
-				filename), storeRandomSeeds(false) {
-	if (!outfile.is_open())
-		throw std::runtime_error(std::string("Cannot create file: ") + filename);
-	if (kiss::ends_with(filename, ".gz"))
-		gzip();
+TextOutput::TextOutput(const std::string &filename) :  Output(), out(&outfile),
+				filename(filename), storeRandomSeeds(false), headerWritten(false),
+				blockSize(1 << 16), buffers(MAX_THREAD) {
+	open(false);
 }
 
 TextOutput::TextOutput(const std::string &filename,
-				OutputType outputtype) : Output(outputtype), outfile(filename.c_str(),
-				std::ios::binary), out(&outfile), filename(
-				filename), storeRandomSeeds(false) {
+				OutputType outputtype, bool resume) : Output(outputtype), out(&outfile),
+				filename(filename), storeRandomSeeds(false), headerWritten(false),
+				blockSize(1 << 16), buffers(MAX_THREAD) {
+	open(resume);
+}
+
+void TextOutput::open(bool resume) {
+	bool compressed = kiss::ends_with(filename, ".gz");
+	if (resume && compressed)
+		throw std::runtime_error("crpropa::TextOutput: compressed output cannot be resumed from a checkpoint");
+	// the file is cut back to its size at the checkpoint by loadCheckpoint
+	if (resume)
+		outfile.open(filename.c_str(), std::ios::binary | std::ios::app);
+	else
+		outfile.open(filename.c_str(), std::ios::binary);
 	if (!outfile.is_open())
 		throw std::runtime_error(std::string("Cannot create file: ") + filename);
-	if (kiss::ends_with(filename, ".gz"))
+	if (compressed)
 		gzip();
 }
 
@@ -160,125 +325,191 @@ void TextOutput::process(Candidate *c) const {
 	if (fields.none() && properties.empty())
 		return;
 
-	char buffer[1024];
-	size_t p = 0;
-
-	std::locale old_locale = std::locale::global(std::locale::classic());
+	LineBuffer &buffer = buffers[threadIndex()];
+	std::string &line = buffer.data;
+	size_t start = line.size();
 
 	if (fields.test(TrajectoryLengthColumn))
-		p += std::sprintf(buffer + p, "%8.5E\t",
-				c->getTrajectoryLength() / lengthScale);
+		appendScientific(line, c->getTrajectoryLength() / lengthScale);
 
 	if (fields.test(RedshiftColumn))
-		p += std::sprintf(buffer + p, "%1.5E\t", c->getRedshift());
+		appendScientific(line, c->getRedshift());
 
 	if (fields.test(SerialNumberColumn))
-		p += std::sprintf(buffer + p, "%10lu\t",
-				c->getSerialNumber());
+		appendSerial(line, c->getSerialNumber());
 	if (fields.test(CurrentIdColumn))
-		p += std::sprintf(buffer + p, "%10i\t", c->current.getId());
+		appendId(line, c->current.getId());
 	if (fields.test(CurrentEnergyColumn))
-		p += std::sprintf(buffer + p, "%8.5E\t",
-				c->current.getEnergy() / energyScale);
+		appendScientific(line, c->current.getEnergy() / energyScale);
 	if (fields.test(CurrentPositionColumn)) {
 		if (oneDimensional) {
-			p += std::sprintf(buffer + p, "%8.5E\t",
-					c->current.getPosition().x / lengthScale);
+			appendScientific(line, c->current.getPosition().x / lengthScale);
 		} else {
-			const Vector3d pos = c->current.getPosition() / lengthScale;
-			p += std::sprintf(buffer + p, "%8.5E\t%8.5E\t%8.5E\t", pos.x, pos.y,
-					pos.z);
+			appendVector(line, c->current.getPosition() / lengthScale);
 		}
 	}
 	if (fields.test(CurrentDirectionColumn)) {
 		if (not oneDimensional) {
-			const Vector3d pos = c->current.getDirection();
-			p += std::sprintf(buffer + p, "%8.5E\t%8.5E\t%8.5E\t", pos.x, pos.y,
-					pos.z);
+			appendVector(line, c->current.getDirection());
 		}
 	}
 
 	if (fields.test(SerialNumberColumn))
-		p += std::sprintf(buffer + p, "%10lu\t", c->getSourceSerialNumber());
+		appendSerial(line, c->getSourceSerialNumber());
 	if (fields.test(SourceIdColumn))
-		p += std::sprintf(buffer + p, "%10i\t", c->source.getId());
+		appendId(line, c->source.getId());
 	if (fields.test(SourceEnergyColumn))
-		p += std::sprintf(buffer + p, "%8.5E\t",
-				c->source.getEnergy() / energyScale);
+		appendScientific(line, c->source.getEnergy() / energyScale);
 	if (fields.test(SourcePositionColumn)) {
 		if (oneDimensional) {
-			p += std::sprintf(buffer + p, "%8.5E\t",
-					c->source.getPosition().x / lengthScale);
+			appendScientific(line, c->source.getPosition().x / lengthScale);
 		} else {
-			const Vector3d pos = c->source.getPosition() / lengthScale;
-			p += std::sprintf(buffer + p, "%8.5E\t%8.5E\t%8.5E\t", pos.x, pos.y,
-					pos.z);
+			appendVector(line, c->source.getPosition() / lengthScale);
 		}
 	}
 	if (fields.test(SourceDirectionColumn)) {
 		if (not oneDimensional) {
-			const Vector3d pos = c->source.getDirection();
-			p += std::sprintf(buffer + p, "%8.5E\t%8.5E\t%8.5E\t", pos.x, pos.y,
-					pos.z);
+			appendVector(line, c->source.getDirection());
 		}
 
 	}
 
 	if (fields.test(SerialNumberColumn))
-		p += std::sprintf(buffer + p, "%10lu\t",
-				c->getCreatedSerialNumber());
+		appendSerial(line, c->getCreatedSerialNumber());
 	if (fields.test(CreatedIdColumn))
-		p += std::sprintf(buffer + p, "%10i\t", c->created.getId());
+		appendId(line, c->created.getId());
 	if (fields.test(CreatedEnergyColumn))
-		p += std::sprintf(buffer + p, "%8.5E\t",
-				c->created.getEnergy() / energyScale);
+		appendScientific(line, c->created.getEnergy() / energyScale);
 	if (fields.test(CreatedPositionColumn)) {
 		if (oneDimensional) {
-			p += std::sprintf(buffer + p, "%8.5E\t",
-					c->created.getPosition().x / lengthScale);
+			appendScientific(line, c->created.getPosition().x / lengthScale);
 		} else {
-			const Vector3d pos = c->created.getPosition() / lengthScale;
-			p += std::sprintf(buffer + p, "%8.5E\t%8.5E\t%8.5E\t", pos.x, pos.y,
-					pos.z);
+			appendVector(line, c->created.getPosition() / lengthScale);
 		}
 	}
 	if (fields.test(CreatedDirectionColumn)) {
 		if (not oneDimensional) {
-			const Vector3d pos = c->created.getDirection();
-			p += std::sprintf(buffer + p, "%8.5E\t%8.5E\t%8.5E\t", pos.x, pos.y,
-					pos.z);
+			appendVector(line, c->created.getDirection());
 		}
 	}
 	if (fields.test(WeightColumn)) {
-		p += std::sprintf(buffer + p, "%8.5E\t", c->getWeight());
+		appendScientific(line, c->getWeight());
 	}
 	if (fields.test(CandidateTagColumn)) {
-		p += std::sprintf(buffer + p, "%s\t", c->getTagOrigin().c_str());
+		line.append(c->getTagOrigin());
+		line.push_back('\t');
 	}
 
-	for(std::vector<Output::Property>::const_iterator iter = properties.begin();
-			iter != properties.end(); ++iter) {
-		  Variant v;
-			if (c->hasProperty((*iter).name)) {
-				v = c->getProperty((*iter).name);
-			} else {
-				v = (*iter).defaultValue;
-			}
-			p += std::sprintf(buffer + p, "%s", v.toString("\t").c_str());
-			p += std::sprintf(buffer + p, "\t");
+	if (!properties.empty()) {
+		// the numbers above are locale independent, Variant uses streams
+		std::locale old_locale = std::locale::global(std::locale::classic());
+		for(std::vector<Output::Property>::const_iterator iter = properties.begin();
+				iter != properties.end(); ++iter) {
+			  Variant v;
+				if (c->hasProperty((*iter).name)) {
+					v = c->getProperty((*iter).name);
+				} else {
+					v = (*iter).defaultValue;
+				}
+				line.append(v.toString("\t"));
+				line.push_back('\t');
+		}
+		std::locale::global(old_locale);
 	}
-	buffer[p - 1] = '\n';
-
-	std::locale::global(old_locale);
+	if (line.size() > start)
+		line[line.size() - 1] = '\n';
+	buffer.lines++;
+	buffer.backlog.store(buffer.lines, std::memory_order_relaxed);
+
+	// inside a parallel run, the lines are written in large blocks
+	if (!inParallel() || line.size() >= blockSize)
+		writeBlock(buffer);
+}
 
+void TextOutput::writeBlock(LineBuffer &buffer) const {
+	if (buffer.lines == 0)
+		return;
 #pragma omp critical
 	{
-		if (count == 0)
-			printHeader();
-		Output::process(c);
-		out->write(buffer, p);
+		if (out) {
+			if (!headerWritten) {
+				printHeader();
+				headerWritten = true;
+			}
+			count += buffer.lines;
+			out->write(buffer.data.data(), buffer.data.size());
+		}
+	}
+	buffer.data.clear();
+	buffer.lines = 0;
+	buffer.backlog.store(0, std::memory_order_relaxed);
+}
+
+void TextOutput::flush() {
+	for (size_t i = 0; i < buffers.size(); i++)
+		writeBlock(buffers[i]);
+	if (out)
+		out->flush();
+}
+
+void TextOutput::finishRun() {
+	flush();
+}
+
+void TextOutput::setBlockSize(size_t bytes) {
+	blockSize = bytes;
+}
+
+size_t TextOutput::getBlockSize() const {
+	return blockSize;
+}
+
+size_t TextOutput::getBacklog() const {
+	size_t lines = 0;
+	for (size_t i = 0; i < buffers.size(); i++)
+		lines += buffers[i].backlog.load(std::memory_order_relaxed);
+	return lines;
+}
+
+std::string TextOutput::saveCheckpoint() {
+	flush();
+	std::stringstream ss;
+	ss << count << " " << headerWritten;
+	if (!filename.empty()) {
+		if (out != &outfile)
+			throw std::runtime_error("crpropa::TextOutput: compressed output cannot be resumed from a checkpoint");
+		ss << " " << fileSize(filename);
 	}
+	return ss.str();
+}
 
+void TextOutput::loadCheckpoint(const std::string &state) {
+	std::stringstream ss(state);
+	size_t lines, size = 0;
+	bool header;
+	if (!(ss >> lines >> header) || (!filename.empty() && !(ss >> size)))
+		throw std::runtime_error("crpropa::TextOutput: invalid checkpoint state");
+
+	for (size_t i = 0; i < buffers.size(); i++) {
+		buffers[i].data.clear();
+		buffers[i].lines = 0;
+		buffers[i].backlog.store(0, std::memory_order_relaxed);
+	}
+	count = lines;
+	headerWritten = header;
+
+	if (filename.empty())
+		return;
+	if (out != &outfile)
+		throw std::runtime_error("crpropa::TextOutput: compressed output cannot be resumed from a checkpoint");
+	outfile.close();
+	if (fileSize(filename) < size)
+		throw std::runtime_error("crpropa::TextOutput: " + filename + " is smaller than at the checkpoint");
+	resizeFile(filename, size);
+	outfile.clear();
+	outfile.open(filename.c_str(), std::ios::binary | std::ios::app);
+	if (!outfile.is_open())
+		throw std::runtime_error(std::string("Cannot open file: ") + filename);
 }
 
 void TextOutput::load(const std::string &filename, ParticleCollector *collector){
@@ -350,11 +581,73 @@ void TextOutput::load(const std::string &filename, ParticleCollector *collector)
 	infile.close();
 }
 
+void TextOutput::merge(const std::vector<std::string> &shards, const std::string &filename) {
+	std::ofstream outfile(filename.c_str(), std::ios::binary);
+	if (!outfile.is_open())
+		throw std::runtime_error(std::string("Cannot create file: ") + filename);
+	// the compressing streams are deleted also if a shard cannot be read
+	std::unique_ptr<std::ostream> gzout;
+	std::ostream *out = &outfile;
+	if (kiss::ends_with(filename, ".gz")) {
+#ifdef CRPROPA_HAVE_ZLIB
+		gzout.reset(new zstream::ogzstream(outfile));
+		out = gzout.get();
+#else
+		throw std::runtime_error("CRPropa was built without Zlib compression!");
+#endif
+	}
+
+	// first line of the header with the column names
+	std::string columns;
+	for (size_t i = 0; i < shards.size(); i++) {
+		std::ifstream infile(shards[i].c_str(), std::ios::binary);
+		if (!infile.good())
+			throw std::runtime_error("crpropa::TextOutput: could not open file " + shards[i]);
+		std::unique_ptr<std::istream> gzin;
+		std::istream *in = &infile;
+		if (kiss::ends_with(shards[i], ".gz")) {
+#ifdef CRPROPA_HAVE_ZLIB
+			gzin.reset(new zstream::igzstream(infile));
+			in = gzin.get();
+#else
+			throw std::runtime_error("CRPropa was built without Zlib compression!");
+#endif
+		}
+
+		std::string line;
+		bool firstLine = true;
+		bool copyHeader = columns.empty();
+		while (std::getline(*in, line)) {
+			if (firstLine) {
+				firstLine = false;
+				if (copyHeader)
+					columns = line;
+				else if (line != columns)
+					throw std::runtime_error("crpropa::TextOutput: " + shards[i] + " has different columns than " + shards[0]);
+			}
+			if (!line.empty() && line[0] == '#' && !copyHeader)
+				continue;
+			out->write(line.data(), line.size());
+			out->put('\n');
+		}
+	}
+
+#ifdef CRPROPA_HAVE_ZLIB
+	zstream::ogzstream *zs = dynamic_cast<zstream::ogzstream *>(out);
+	if (zs)
+		zs->close();
+#endif
+	outfile.close();
+	if (!outfile)
+		throw std::runtime_error(std::string("Cannot write file: ") + filename);
+}
+
 std::string TextOutput::getDescription() const {
 	return "TextOutput";
 }
 
 void TextOutput::close() {
+	flush();
 #ifdef CRPROPA_HAVE_ZLIB
 	zstream::ogzstream *zs = dynamic_cast<zstream::ogzstream *>(out);
 	if (zs) {
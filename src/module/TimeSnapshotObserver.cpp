@@ -0,0 +1,268 @@
+#include "crpropa/module/TimeSnapshotObserver.h"
+#include "crpropa/Common.h"
+#include "crpropa/Units.h"
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+
+namespace crpropa {
+
+// SnapshotStore ---------------------------------------------------------------
+SnapshotStore::SnapshotStore() : threadColumns(MAX_THREAD, 0) {
+}
+
+SnapshotStore::~SnapshotStore() {
+	for (size_t i = 0; i < threadColumns.size(); i++)
+		delete threadColumns[i];
+}
+
+void SnapshotStore::add(size_t snapshot, double time, const Candidate *candidate,
+		const Vector3d &position) {
+	int i = threadIndex();
+	if (threadColumns[i] == 0)
+		threadColumns[i] = new Columns;
+	Columns &columns = *threadColumns[i];
+	columns.snapshot.push_back(snapshot);
+	columns.time.push_back(time);
+	columns.serialNumber.push_back(candidate->getSerialNumber());
+	columns.id.push_back(candidate->current.getId());
+	columns.energy.push_back(candidate->current.getEnergy());
+	columns.position.push_back(position);
+	columns.direction.push_back(candidate->current.getDirection());
+	columns.weight.push_back(candidate->getWeight());
+}
+
+size_t SnapshotStore::size() const {
+	size_t n = merged.size();
+	for (size_t i = 0; i < threadColumns.size(); i++)
+		if (threadColumns[i])
+			n += threadColumns[i]->size();
+	return n;
+}
+
+void SnapshotStore::clear() {
+	for (size_t i = 0; i < threadColumns.size(); i++) {
+		delete threadColumns[i];
+		threadColumns[i] = 0;
+	}
+	merged = Columns();
+}
+
+void SnapshotStore::merge() const {
+	// move the thread columns behind the already merged rows
+	bool added = false;
+	for (size_t i = 0; i < threadColumns.size(); i++) {
+		Columns *columns = threadColumns[i];
+		if (columns == 0)
+			continue;
+		merged.snapshot.insert(merged.snapshot.end(), columns->snapshot.begin(), columns->snapshot.end());
+		merged.time.insert(merged.time.end(), columns->time.begin(), columns->time.end());
+		merged.serialNumber.insert(merged.serialNumber.end(), columns->serialNumber.begin(), columns->serialNumber.end());
+		merged.id.insert(merged.id.end(), columns->id.begin(), columns->id.end());
+		merged.energy.insert(merged.energy.end(), columns->energy.begin(), columns->energy.end());
+		merged.position.insert(merged.position.end(), columns->position.begin(), columns->position.end());
+		merged.direction.insert(merged.direction.end(), columns->direction.begin(), columns->direction.end());
+		merged.weight.insert(merged.weight.end(), columns->weight.begin(), columns->weight.end());
+		delete columns;
+		threadColumns[i] = 0;
+		added = true;
+	}
+	if (not added)
+		return;
+
+	// sort by snapshot and serial number, stable to keep the order of rows
+	// of the same candidate
+	size_t n = merged.size();
+	std::vector<size_t> order(n);
+	for (size_t i = 0; i < n; i++)
+		order[i] = i;
+	const Columns &m = merged;
+	std::stable_sort(order.begin(), order.end(), [&m](size_t a, size_t b) {
+		if (m.snapshot[a] != m.snapshot[b])
+			return m.snapshot[a] < m.snapshot[b];
+		return m.serialNumber[a] < m.serialNumber[b];
+	});
+
+	Columns sorted;
+	sorted.snapshot.reserve(n);
+	sorted.time.reserve(n);
+	sorted.serialNumber.reserve(n);
+	sorted.id.reserve(n);
+	sorted.energy.reserve(n);
+	sorted.position.reserve(n);
+	sorted.direction.reserve(n);
+	sorted.weight.reserve(n);
+	for (size_t i = 0; i < n; i++) {
+		size_t j = order[i];
+		sorted.snapshot.push_back(merged.snapshot[j]);
+		sorted.time.push_back(merged.time[j]);
+		sorted.serialNumber.push_back(merged.serialNumber[j]);
+		sorted.id.push_back(merged.id[j]);
+		sorted.energy.push_back(merged.energy[j]);
+		sorted.position.push_back(merged.position[j]);
+		sorted.direction.push_back(merged.direction[j]);
+		sorted.weight.push_back(merged.weight[j]);
+	}
+	merged = sorted;
+}
+
+std::vector<std::string> SnapshotStore::getColumnNames() const {
+	const char *names[] = {"snapshot", "time", "serialNumber", "id", "energy",
+			"x", "y", "z", "px", "py", "pz", "weight"};
+	return std::vector<std::string>(names, names + sizeof(names) / sizeof(names[0]));
+}
+
+std::vector<double> SnapshotStore::getColumn(const std::string &name) const {
+	merge();
+	size_t n = merged.size();
+	std::vector<double> column(n);
+	for (size_t i = 0; i < n; i++) {
+		if (name == "snapshot")
+			column[i] = merged.snapshot[i];
+		else if (name == "time")
+			column[i] = merged.time[i];
+		else if (name == "serialNumber")
+			column[i] = merged.serialNumber[i];
+		else if (name == "id")
+			column[i] = merged.id[i];
+		else if (name == "energy")
+			column[i] = merged.energy[i];
+		else if (name == "x")
+			column[i] = merged.position[i].x;
+		else if (name == "y")
+			column[i] = merged.position[i].y;
+		else if (name == "z")
+			column[i] = merged.position[i].z;
+		else if (name == "px")
+			column[i] = merged.direction[i].x;
+		else if (name == "py")
+			column[i] = merged.direction[i].y;
+		else if (name == "pz")
+			column[i] = merged.direction[i].z;
+		else if (name == "weight")
+			column[i] = merged.weight[i];
+		else
+			throw std::runtime_error("SnapshotStore: unknown column " + name);
+	}
+	return column;
+}
+
+void SnapshotStore::write(const std::string &filename) const {
+	merge();
+	std::ofstream out(filename.c_str());
+	if (!out.good())
+		throw std::runtime_error("SnapshotStore: could not open " + filename);
+
+	out << "#\tsnapshot\tD\tSN\tID\tE\tX\tY\tZ\tPx\tPy\tPz\tW\n";
+	out << "#\n";
+	out << "# snapshot     Index of the time\n";
+	out << "# D            Trajectory length [Mpc]\n";
+	out << "# SN           Serial number\n";
+	out << "# ID           Particle type (PDG MC numbering scheme)\n";
+	out << "# E            Energy [EeV]\n";
+	out << "# X, Y, Z      Position [Mpc]\n";
+	out << "# Px, Py, Pz   Heading (unit vector of momentum)\n";
+	out << "# W            Weight\n";
+	out << "#\n";
+	out.precision(9);
+	for (size_t i = 0; i < merged.size(); i++) {
+		out << merged.snapshot[i] << "\t" << merged.time[i] / Mpc << "\t"
+				<< merged.serialNumber[i] << "\t" << merged.id[i] << "\t"
+				<< merged.energy[i] / EeV << "\t"
+				<< merged.position[i].x / Mpc << "\t"
+				<< merged.position[i].y / Mpc << "\t"
+				<< merged.position[i].z / Mpc << "\t"
+				<< merged.direction[i].x << "\t" << merged.direction[i].y << "\t"
+				<< merged.direction[i].z << "\t" << merged.weight[i] << "\n";
+	}
+}
+
+// TimeSnapshotObserver --------------------------------------------------------
+TimeSnapshotObserver::TimeSnapshotObserver(SnapshotStore *store) :
+		store(store), slot(Candidate::allocateSlot()), limitStep(true) {
+	if (!this->store.valid())
+		this->store = new SnapshotStore();
+}
+
+TimeSnapshotObserver::~TimeSnapshotObserver() {
+	Candidate::releaseSlot(slot);
+}
+
+void TimeSnapshotObserver::addTime(double time) {
+	times.insert(std::upper_bound(times.begin(), times.end(), time), time);
+}
+
+void TimeSnapshotObserver::addTimeRange(double min, double max, double numb, bool log) {
+	for (size_t i = 0; i < numb; i++) {
+		if (log == true) {
+			addTime(min * pow(max / min, i / (numb - 1.0)));
+		} else {
+			addTime(min + i * (max - min) / numb);
+		}
+	}
+}
+
+const std::vector<double> &TimeSnapshotObserver::getTimes() const {
+	return times;
+}
+
+void TimeSnapshotObserver::setLimitStep(bool limit) {
+	limitStep = limit;
+}
+
+bool TimeSnapshotObserver::getLimitStep() const {
+	return limitStep;
+}
+
+SnapshotStore *TimeSnapshotObserver::getStore() const {
+	return store;
+}
+
+void TimeSnapshotObserver::process(Candidate *c) const {
+	double length = c->getTrajectoryLength();
+	double step = c->getCurrentStep();
+	double start = length - step;
+
+	// the slot holds the index of the next time + 1, 0 for unseen candidates.
+	// The times in (start, length] are recorded: times up to the start of the
+	// step were passed before, e.g. by the parent of a secondary. Only the
+	// first step of a primary includes its start.
+	size_t cursor = c->getSlot(slot);
+	bool includeStart = (cursor == 0) and (c->parent == 0);
+	if (cursor > 0)
+		cursor--;
+	if (cursor > times.size())
+		cursor = times.size();
+	std::vector<double>::const_iterator it = includeStart
+			? std::lower_bound(times.begin() + cursor, times.end(), start)
+			: std::upper_bound(times.begin() + cursor, times.end(), start);
+	size_t index = it - times.begin();
+
+	if (index < times.size() and times[index] <= length) {
+		const Vector3d &x0 = c->previous.getPosition();
+		const Vector3d &x1 = c->current.getPosition();
+		for (; index < times.size() and times[index] <= length; index++) {
+			Vector3d position = x1;
+			if (step > 0)
+				position = x0 + (x1 - x0) * ((times[index] - start) / step);
+			store->add(index, times[index], c, position);
+		}
+	}
+	c->setSlot(slot, index + 1);
+
+	if (limitStep and index < times.size())
+		c->limitNextStep(times[index] - length);
+}
+
+std::string TimeSnapshotObserver::getDescription() const {
+	std::stringstream s;
+	s << "TimeSnapshotObserver: " << times.size() << " times";
+	if (times.size())
+		s << " from " << times.front() / kpc << " to " << times.back() / kpc << " kpc";
+	return s.str();
+}
+
+} // namespace crpropa
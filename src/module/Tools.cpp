@@ -108,12 +108,8 @@ void EmissionMapFiller::setEmissionMap(EmissionMap *emissionMap) {
 }
 
 void EmissionMapFiller::process(Candidate* candidate) const {
-	if (emissionMap) {
-		#pragma omp critical
-		{
-			emissionMap->fillMap(candidate->source);
-		}
-	}
+	if (emissionMap)
+		emissionMap->fillMap(candidate->source);
 }
 
 string EmissionMapFiller::getDescription() const {
@@ -2,11 +2,13 @@
 
 #include "crpropa/module/BreakCondition.h"
 #include "crpropa/module/Observer.h"
+#include "crpropa/module/TimeSnapshotObserver.h"
 #include "crpropa/module/Boundary.h"
 #include "crpropa/module/Tools.h"
 #include "crpropa/module/RestrictToRegion.h"
 #include "crpropa/ParticleID.h"
 #include "crpropa/Geometry.h"
+#include "crpropa/Units.h"
 
 #include "gtest/gtest.h"
 
@@ -156,6 +158,39 @@ TEST(DetectionLength, test) {
         EXPECT_TRUE(c.hasProperty("Rejected"));
 }
 
+#ifdef CRPROPA_HAVE_MUPARSER
+TEST(ExpressionCondition, test) {
+	ExpressionCondition condition("(E < 1*EeV) || (r > 10*Mpc)");
+	Candidate c;
+
+	c.current.setEnergy(2 * EeV);
+	c.current.setPosition(Vector3d(5 * Mpc, 0, 0));
+	condition.process(&c);
+	EXPECT_TRUE(c.isActive());
+
+	c.current.setPosition(Vector3d(0, 0, 11 * Mpc));
+	condition.process(&c);
+	EXPECT_FALSE(c.isActive());
+	EXPECT_TRUE(c.hasProperty("Rejected"));
+}
+
+TEST(ExpressionCondition, particleId) {
+	ExpressionCondition condition("Z > 1");
+	condition.setMakeRejectedInactive(false);
+	condition.setRejectFlag("Rejected", "heavy");
+	Candidate c;
+
+	c.current.setId(nucleusId(1, 1));
+	condition.process(&c);
+	EXPECT_FALSE(c.hasProperty("Rejected"));
+
+	c.current.setId(nucleusId(4, 2));
+	condition.process(&c);
+	EXPECT_TRUE(c.hasProperty("Rejected"));
+	EXPECT_TRUE(c.isActive());
+}
+#endif
+
 //** ============================= Observers ================================ */
 TEST(ObserverFeature, SmallSphere) {
 	// detect if the current position is inside and the previous outside of the sphere
@@ -304,6 +339,163 @@ TEST(ObserverFeature, TimeEvolutionLog) {
   EXPECT_TRUE(c.hasProperty("Detected"));
 }
 
+TEST(ObserverFeature, TimeEvolutionTwoObservers) {
+  // each observer keeps its own detection index
+  Observer obs1, obs2;
+  obs1.setDeactivateOnDetection(false);
+  obs2.setDeactivateOnDetection(false);
+  obs1.setFlag("Detected1", "Detected");
+  obs2.setFlag("Detected2", "Detected");
+  ref_ptr<ObserverTimeEvolution> times1 = new ObserverTimeEvolution();
+  times1->addTime(6);
+  times1->addTime(2); // kept sorted
+  EXPECT_DOUBLE_EQ(2, times1->getTimes()[0]);
+  obs1.add(times1);
+  obs2.add(new ObserverTimeEvolution(2, 4, 2));
+
+  Candidate c;
+  c.setTrajectoryLength(2);
+  obs1.process(&c);
+  obs2.process(&c);
+  EXPECT_TRUE(c.hasProperty("Detected1"));
+  EXPECT_TRUE(c.hasProperty("Detected2"));
+
+  // all times detected
+  c.removeProperty("Detected1");
+  c.setTrajectoryLength(6);
+  obs1.process(&c);
+  EXPECT_TRUE(c.hasProperty("Detected1"));
+  c.removeProperty("Detected1");
+  c.setTrajectoryLength(10);
+  obs1.process(&c);
+  EXPECT_FALSE(c.hasProperty("Detected1"));
+}
+
+TEST(TimeSnapshotObserver, limitStep) {
+  TimeSnapshotObserver obs;
+  obs.addTimeRange(5, 15, 2);
+  Candidate c;
+  c.setNextStep(10);
+  c.setCurrentStep(3);
+  c.setTrajectoryLength(3);
+
+  // no snapshot, limit next step
+  obs.process(&c);
+  EXPECT_EQ(0, obs.getStore()->size());
+  EXPECT_DOUBLE_EQ(2, c.getNextStep());
+
+  // first snapshot, limit to the second
+  c.setNextStep(10);
+  c.setCurrentStep(2);
+  c.setTrajectoryLength(5);
+  obs.process(&c);
+  EXPECT_EQ(1, obs.getStore()->size());
+  EXPECT_DOUBLE_EQ(5, c.getNextStep());
+
+  // same length again, no second row
+  c.setCurrentStep(0);
+  obs.process(&c);
+  EXPECT_EQ(1, obs.getStore()->size());
+}
+
+TEST(TimeSnapshotObserver, multipleTimesPerStep) {
+  ref_ptr<SnapshotStore> store = new SnapshotStore();
+  TimeSnapshotObserver obs(store);
+  obs.setLimitStep(false);
+  obs.addTime(4);
+  obs.addTime(2);
+  obs.addTime(8);
+  obs.addTime(20);
+
+  // one step from 0 to 10 along x passes three times
+  Candidate c(22, 1);
+  c.previous.setPosition(Vector3d(0, 0, 0));
+  c.current.setPosition(Vector3d(10, 0, 0));
+  c.setCurrentStep(10);
+  c.setTrajectoryLength(10);
+  c.setNextStep(100);
+  obs.process(&c);
+  EXPECT_DOUBLE_EQ(100, c.getNextStep());
+
+  EXPECT_EQ(3, store->size());
+  std::vector<double> snapshot = store->getColumn("snapshot");
+  std::vector<double> time = store->getColumn("time");
+  std::vector<double> x = store->getColumn("x");
+  std::vector<double> id = store->getColumn("id");
+  EXPECT_DOUBLE_EQ(0, snapshot[0]);
+  EXPECT_DOUBLE_EQ(2, snapshot[2]);
+  EXPECT_DOUBLE_EQ(2, time[0]);
+  EXPECT_DOUBLE_EQ(8, time[2]);
+  // positions interpolated along the step
+  EXPECT_DOUBLE_EQ(2, x[0]);
+  EXPECT_DOUBLE_EQ(4, x[1]);
+  EXPECT_DOUBLE_EQ(8, x[2]);
+  EXPECT_DOUBLE_EQ(22, id[1]);
+  EXPECT_THROW(store->getColumn("foo"), std::runtime_error);
+
+  // a secondary does not repeat the snapshots of its parent
+  c.addSecondary(11, 0.5);
+  ref_ptr<Candidate> s = c.secondaries[0];
+  obs.process(s);
+  EXPECT_EQ(3, store->size());
+  s->previous.setPosition(Vector3d(10, 0, 0));
+  s->current.setPosition(Vector3d(30, 0, 0));
+  s->setCurrentStep(20);
+  s->setTrajectoryLength(30);
+  obs.process(s);
+  EXPECT_EQ(4, store->size());
+  EXPECT_DOUBLE_EQ(20, store->getColumn("x")[3]);
+
+  store->clear();
+  EXPECT_EQ(0, store->size());
+}
+
+TEST(TimeSnapshotObserver, timeAtStepEnd) {
+  TimeSnapshotObserver obs;
+  obs.setLimitStep(false);
+  obs.addTime(0);
+  obs.addTime(5);
+
+  // the first step of a primary includes its start
+  Candidate c;
+  c.setCurrentStep(0);
+  c.setTrajectoryLength(0);
+  obs.process(&c);
+  EXPECT_EQ(1, obs.getStore()->size());
+
+  // secondary created in the step ending at 5, before the observer
+  c.setCurrentStep(5);
+  c.setTrajectoryLength(5);
+  c.addSecondary(11, 0.5);
+  ref_ptr<Candidate> s = c.secondaries[0];
+  obs.process(&c);
+  EXPECT_EQ(2, obs.getStore()->size());
+
+  // the next steps start at 5 and do not record it again
+  s->setCurrentStep(2);
+  s->setTrajectoryLength(7);
+  obs.process(s);
+  c.setCurrentStep(2);
+  c.setTrajectoryLength(7);
+  obs.process(&c);
+  EXPECT_EQ(2, obs.getStore()->size());
+}
+
+TEST(TimeSnapshotObserver, releaseSlot) {
+  size_t slot = Candidate::allocateSlot();
+  Candidate::releaseSlot(slot);
+  {
+    // the observer reuses the released slot
+    TimeSnapshotObserver obs;
+    size_t other = Candidate::allocateSlot();
+    EXPECT_NE(slot, other);
+    Candidate::releaseSlot(other);
+  }
+  // and returns it when destroyed
+  EXPECT_EQ(slot, Candidate::allocateSlot());
+  Candidate::releaseSlot(slot);
+}
+
 //** ========================= Boundaries =================================== */
 TEST(PeriodicBox, high) {
 	// Tests if the periodical boundaries place the particle back inside the box and translate the initial position accordingly.
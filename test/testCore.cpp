@@ -5,11 +5,16 @@
 	Common functions
  */
 
+#include <algorithm>
 #include <complex>
+#include <cstdio>
+#include <fstream>
+#include <thread>
 
 #include "crpropa/Candidate.h"
 #include "crpropa/base64.h"
 #include "crpropa/Common.h"
+#include "crpropa/Cosmology.h"
 #include "crpropa/Units.h"
 #include "crpropa/ParticleID.h"
 #include "crpropa/ParticleMass.h"
@@ -18,7 +23,9 @@
 #include "crpropa/GridTools.h"
 #include "crpropa/Geometry.h"
 #include "crpropa/EmissionMap.h"
+#include "crpropa/TableRegistry.h"
 #include "crpropa/Vector3.h"
+#include "crpropa/WeightWindow.h"
 
 #include <HepPID/ParticleIDMethods.hh>
 #include "gtest/gtest.h"
@@ -92,6 +99,18 @@ TEST(ParticleState, Charge) {
 	EXPECT_DOUBLE_EQ(0, particle.getCharge());
 }
 
+TEST(ParticleState, ChargeLeptons) {
+	// the shortcut for photons and leptons has to agree with HepPID
+	ParticleState particle;
+	int ids[] = {0, 22, 11, -11, 12, -12, 14, -14, 16, -16};
+	for (size_t i = 0; i < sizeof(ids) / sizeof(ids[0]); i++) {
+		particle.setId(ids[i]);
+		EXPECT_DOUBLE_EQ(HepPID::charge(ids[i]) * eplus, particle.getCharge());
+	}
+	particle.setId(-11);
+	EXPECT_DOUBLE_EQ(mass_electron, particle.getMass());
+}
+
 TEST(ParticleState, Rigidity) {
 	ParticleState particle;
 
@@ -200,6 +219,30 @@ TEST(Candidate, property) {
 	EXPECT_EQ("bar", value);
 }
 
+TEST(Candidate, slot) {
+	size_t slot1 = Candidate::allocateSlot();
+	size_t slot2 = Candidate::allocateSlot();
+	EXPECT_NE(slot1, slot2);
+
+	Candidate candidate;
+	EXPECT_EQ(0, candidate.getSlot(slot2)); // unset slots are 0
+	candidate.setSlot(slot2, 7);
+	EXPECT_EQ(7, candidate.getSlot(slot2));
+	EXPECT_EQ(0, candidate.getSlot(slot1));
+
+	// slots are inherited by secondaries and clones
+	candidate.addSecondary(22, 1);
+	EXPECT_EQ(7, candidate.secondaries[0]->getSlot(slot2));
+	ref_ptr<Candidate> cloned = candidate.clone();
+	EXPECT_EQ(7, cloned->getSlot(slot2));
+
+	// released slots are reused
+	Candidate::releaseSlot(slot1);
+	EXPECT_EQ(slot1, Candidate::allocateSlot());
+	Candidate::releaseSlot(slot1);
+	Candidate::releaseSlot(slot2);
+}
+
 TEST(Candidate, weight) {
     Candidate candidate;
     EXPECT_EQ (1., candidate.getWeight());
@@ -239,6 +282,30 @@ TEST(Candidate, addSecondary) {
 	EXPECT_EQ(15., s2.getWeight());
 }
 
+TEST(Candidate, addSecondaryPosition) {
+	Candidate c(22, 10, Vector3d(0, 0, 0), Vector3d(1, 0, 0));
+	c.setTrajectoryLength(10);
+	c.setProperty("foo", Variant(std::string("bar")));
+	c.current.setPosition(Vector3d(10, 0, 0));
+
+	c.addSecondary(11, 4, Vector3d(6, 0, 0), 0.5, "EMPP");
+	ref_ptr<Candidate> s = c.secondaries[0];
+
+	EXPECT_EQ(11, s->current.getId());
+	EXPECT_EQ(22, s->source.getId());
+	EXPECT_DOUBLE_EQ(4, s->current.getEnergy());
+	EXPECT_DOUBLE_EQ(-eplus, s->current.getCharge());
+	EXPECT_DOUBLE_EQ(6, s->getTrajectoryLength());
+	EXPECT_TRUE(Vector3d(6, 0, 0) == s->current.getPosition());
+	EXPECT_TRUE(Vector3d(6, 0, 0) == s->created.getPosition());
+	EXPECT_DOUBLE_EQ(0.5, s->getWeight());
+	EXPECT_TRUE(s->getTagOrigin() == "EMPP");
+	EXPECT_EQ("bar", s->getProperty("foo").asString());
+	EXPECT_TRUE(s->isActive());
+	EXPECT_EQ(c.getSerialNumber(), s->getCreatedSerialNumber());
+	EXPECT_NE(c.getSerialNumber(), s->getSerialNumber());
+}
+
 TEST(Candidate, candidateTag) {
 	Candidate c;
 
@@ -256,6 +323,37 @@ TEST(Candidate, serialNumber) {
 	EXPECT_EQ(43, c.getSourceSerialNumber());
 }
 
+TEST(Candidate, serialNumberBlocks) {
+	Candidate::setNextSerialNumber(0);
+	Candidate::setSerialNumberBlockSize(16);
+	const int n = 100;
+	std::vector<uint64_t> serials(4 * n);
+#pragma omp parallel for num_threads(4) schedule(static, n)
+	for (int i = 0; i < 4 * n; i++) {
+		Candidate c;
+		serials[i] = c.getSerialNumber();
+	}
+
+	// unique and taken in blocks, n = 100 numbers need 7 blocks per thread
+	std::vector<uint64_t> sorted(serials);
+	std::sort(sorted.begin(), sorted.end());
+	EXPECT_TRUE(std::adjacent_find(sorted.begin(), sorted.end()) == sorted.end());
+	EXPECT_LE(Candidate::getNextSerialNumber(), 4 * 7 * 16);
+	for (int i = 1; i < 4 * n; i++) {
+		if ((i % n != 0) && ((serials[i - 1] % 16) != 0))
+			EXPECT_EQ(serials[i - 1] + 1, serials[i]);
+	}
+
+	// outside of parallel regions the numbers are consecutive
+	Candidate::setNextSerialNumber(1000);
+	Candidate a, b;
+	EXPECT_EQ(1001, a.getSerialNumber());
+	EXPECT_EQ(1002, b.getSerialNumber());
+
+	Candidate::setSerialNumberBlockSize(256);
+	EXPECT_THROW(Candidate::setSerialNumberBlockSize(0), std::runtime_error);
+}
+
 TEST(common, digit) {
 	EXPECT_EQ(1, digit(1234, 1000));
 	EXPECT_EQ(2, digit(1234, 100));
@@ -331,6 +429,21 @@ TEST(common, gaussInt)
 	EXPECT_NEAR(gaussInt(([](double x){ return sin(x)*sin(x); }), 0, M_PI), M_PI/2., 1e-4);
 }
 
+struct alignas(64) CacheLineCounter {
+	uint64_t count;
+	CacheLineCounter() : count(0) {}
+};
+
+TEST(common, CacheLineAllocator) {
+	for (size_t n = 1; n < 20; n++) {
+		std::vector<CacheLineCounter, CacheLineAllocator<CacheLineCounter> > counters(n);
+		EXPECT_EQ(0, reinterpret_cast<uintptr_t>(counters.data()) % 64);
+		counters.resize(3 * n);
+		EXPECT_EQ(0, reinterpret_cast<uintptr_t>(&counters[1]) % 64);
+		EXPECT_EQ(0, counters.back().count);
+	}
+}
+
 TEST(Random, seed) {
 	Random &a = Random::instance();
 	Random &b = Random::instance();
@@ -978,6 +1091,95 @@ TEST(EmissionMap, merge) {
 	EXPECT_TRUE(cpm->getPdf()[bin] > 0);
 }
 
+TEST(EmissionMap, parallelFill) {
+	EmissionMap em(36, 18, 10);
+	const int n = 4000;
+#pragma omp parallel for num_threads(4)
+	for (int i = 0; i < n; i++)
+		em.fillMap(22 + i % 2, 1 * EeV, Vector3d(1, 0, 0), 0.5);
+
+	EXPECT_EQ(2, em.getMaps().size());
+	const std::vector<double> &pdf = em.getMap(22, 1 * EeV)->getPdf();
+	double sum = 0;
+	for (size_t i = 0; i < pdf.size(); i++)
+		sum += pdf[i];
+	EXPECT_DOUBLE_EQ(n / 4., sum);
+}
+
+TEST(EmissionMap, uniformNonIntegerWeights) {
+	// rounding leaves all scaled weights of the alias table just below 1
+	size_t sizes[3][2] = {{360, 180}, {360, 1}, {100, 1}};
+	double weights[3] = {0.1, 0.1, 0.3};
+	for (size_t k = 0; k < 3; k++) {
+		CylindricalProjectionMap cpm(sizes[k][0], sizes[k][1]);
+		std::vector<double> &pdf = cpm.getPdf();
+		std::fill(pdf.begin(), pdf.end(), weights[k]);
+		for (size_t i = 0; i < 1000; i++) {
+			Vector3d d = cpm.drawDirection();
+			EXPECT_NEAR(1, d.getR(), 1e-9);
+		}
+	}
+
+	// empty bins are never drawn
+	CylindricalProjectionMap cpm(100, 1);
+	std::vector<double> &pdf = cpm.getPdf();
+	for (size_t i = 0; i < pdf.size(); i++)
+		pdf[i] = (i % 2) ? 0.3 : 0;
+	for (size_t i = 0; i < 1000; i++)
+		EXPECT_EQ(1, cpm.binFromDirection(cpm.drawDirection()) % 2);
+}
+
+TEST(EmissionMap, fillFromThreads) {
+	// threads not created by OpenMP have their own caches
+	EmissionMap em(36, 18, 10);
+	const int n = 2000;
+	std::vector<std::thread> threads;
+	for (int t = 0; t < 4; t++)
+		threads.push_back(std::thread([&em, t]() {
+			for (int i = 0; i < n; i++)
+				em.fillMap(22 + t % 2, 1 * EeV, Vector3d(1, 0, 0), 0.5);
+		}));
+	for (size_t t = 0; t < threads.size(); t++)
+		threads[t].join();
+
+	const std::vector<double> &pdf = em.getMap(23, 1 * EeV)->getPdf();
+	double sum = 0;
+	for (size_t i = 0; i < pdf.size(); i++)
+		sum += pdf[i];
+	EXPECT_DOUBLE_EQ(n, sum);
+}
+
+TEST(EmissionMap, freeze) {
+	EmissionMap em(36, 18, 10);
+	Vector3d d1(1, 0, 0), d2(0, 1, 0);
+	em.fillMap(22, 1 * EeV, d1, 3);
+	em.fillMap(22, 1 * EeV, d2, 1);
+	em.fillMap(11, 10 * EeV, d2);
+	em.freeze();
+	EXPECT_TRUE(em.isFrozen());
+
+	// directions only from the filled bins, in proportion to their weight
+	size_t n = 4000, n1 = 0;
+	Vector3d d;
+	for (size_t i = 0; i < n; i++) {
+		EXPECT_TRUE(em.drawDirection(22, 1 * EeV, d));
+		bool in1 = d.getAngleTo(d1) < 0.3;
+		EXPECT_TRUE(in1 or d.getAngleTo(d2) < 0.3);
+		n1 += in1;
+	}
+	EXPECT_NEAR(0.75, double(n1) / n, 0.05);
+
+	EXPECT_TRUE(em.checkDirection(11, 10 * EeV, d2));
+	EXPECT_FALSE(em.checkDirection(11, 10 * EeV, d1));
+	EXPECT_FALSE(em.drawDirection(11, 1 * EeV, d));
+	EXPECT_FALSE(em.drawDirection(2212, 1 * EeV, d));
+
+	// a new map discards the lookup table
+	em.fillMap(11, 1 * EeV, d1);
+	EXPECT_FALSE(em.isFrozen());
+	EXPECT_TRUE(em.drawDirection(11, 1 * EeV, d));
+}
+
 
 TEST(Variant, copyToBuffer) {
 	double a = 23.42;
@@ -1075,6 +1277,177 @@ TEST(Geometry, ParaxialBox) {
 	EXPECT_NEAR(8., b.distance(Vector3d(-8., 0., 0.)), 1E-10);
 }
 
+// comoving distance by numerical integration of c / H(z)
+static double integrateComovingDistance(const Cosmology &c, double z) {
+	size_t n = 100000;
+	double d = 0;
+	for (size_t i = 0; i < n; i++)
+		d += c_light / c.hubbleRate((i + 0.5) * z / n) * z / n;
+	return d;
+}
+
+TEST(Cosmology, distances) {
+	Cosmology c;
+	double zs[] = {0.001, 0.1, 1, 10};
+	for (int i = 0; i < 4; i++) {
+		double z = zs[i];
+		double d = integrateComovingDistance(c, z);
+		EXPECT_NEAR(d, c.redshift2ComovingDistance(z), 1e-6 * d);
+		EXPECT_NEAR(z, c.comovingDistance2Redshift(d), 1e-6 * z);
+		EXPECT_NEAR((1 + z) * d, c.redshift2LuminosityDistance(z), 1e-6 * (1 + z) * d);
+		EXPECT_NEAR(z, c.luminosityDistance2Redshift((1 + z) * d), 1e-6 * z);
+		double t = c.redshift2LightTravelDistance(z);
+		EXPECT_LT(t, d);
+		EXPECT_NEAR(z, c.lightTravelDistance2Redshift(t), 1e-6 * z);
+		EXPECT_NEAR(t, c.comoving2LightTravelDistance(d), 1e-6 * t);
+		EXPECT_NEAR(d, c.lightTravel2ComovingDistance(t), 1e-6 * d);
+	}
+
+	// unchecked conversions clip to the tables
+	EXPECT_EQ(0, c.comovingDistance2Redshift(-1 * Mpc));
+	EXPECT_NEAR(100, c.comovingDistance2Redshift(1e6 * Gpc), 1e-9);
+
+	// batch conversion
+	double d[3] = {10 * Mpc, 100 * Mpc, 1 * Gpc};
+	double z[3];
+	c.comovingDistance2Redshift(d, z, 3);
+	for (int i = 0; i < 3; i++)
+		EXPECT_DOUBLE_EQ(c.comovingDistance2Redshift(d[i]), z[i]);
+}
+
+TEST(Cosmology, instances) {
+	// several cosmologies at the same time, the default one is unchanged
+	double d0 = redshift2ComovingDistance(1);
+	Cosmology a(0.7, 0.3), b(0.7, 0.5);
+	EXPECT_GT(a.redshift2ComovingDistance(1), b.redshift2ComovingDistance(1));
+	EXPECT_DOUBLE_EQ(0.7e5 / Mpc, a.H0());
+	EXPECT_DOUBLE_EQ(0.5, b.omegaL());
+	EXPECT_DOUBLE_EQ(d0, redshift2ComovingDistance(1));
+
+	// the default cosmology is replaced as a whole
+	ref_ptr<Cosmology> old = new Cosmology(defaultCosmology());
+	setCosmologyParameters(0.7, 0.3);
+	EXPECT_DOUBLE_EQ(a.redshift2ComovingDistance(1), redshift2ComovingDistance(1));
+	EXPECT_DOUBLE_EQ(d0, old->redshift2ComovingDistance(1));
+	setDefaultCosmology(old);
+	EXPECT_DOUBLE_EQ(d0, redshift2ComovingDistance(1));
+
+	// a replaced cosmology is freed when no thread uses it anymore
+	ref_ptr<Cosmology> c = new Cosmology(0.7, 0.4);
+	setDefaultCosmology(c);
+	EXPECT_DOUBLE_EQ(0.4, omegaM());
+	EXPECT_LT(1, c->getReferenceCount());
+	setDefaultCosmology(old);
+	EXPECT_DOUBLE_EQ(d0, redshift2ComovingDistance(1));
+	EXPECT_EQ(1, c->getReferenceCount());
+
+	// checked functions
+	EXPECT_THROW(comovingDistance2Redshift(-1), std::runtime_error);
+	EXPECT_THROW(redshift2ComovingDistance(101), std::runtime_error);
+}
+
+TEST(TableRegistry, sharedTables) {
+	std::string filename = "TableRegistry_test_rate.txt";
+	{
+		std::ofstream f(filename.c_str());
+		f << "# log10(E/eV) rate[1/Mpc]\n15 1\n16 2\n";
+	}
+	size_t n = TableRegistry::size();
+	ref_ptr<const RateTable> a = TableRegistry::getRateTable(filename);
+	ref_ptr<const RateTable> b = TableRegistry::getRateTable(filename);
+	EXPECT_EQ(a.get(), b.get());
+	EXPECT_EQ(n + 1, TableRegistry::size());
+	ASSERT_EQ(2, a->energy.size());
+	EXPECT_DOUBLE_EQ(1e16 * eV, a->energy[1]);
+	EXPECT_DOUBLE_EQ(2 / Mpc, a->rate[1]);
+
+	// a changed file is read again, the old table stays valid
+	{
+		std::ofstream f(filename.c_str());
+		f << "15 1\n16 2\n17 3\n";
+	}
+	ref_ptr<const RateTable> c = TableRegistry::getRateTable(filename);
+	EXPECT_NE(a.get(), c.get());
+	EXPECT_EQ(3, c->energy.size());
+	EXPECT_EQ(2, a->energy.size());
+	EXPECT_EQ(n + 1, TableRegistry::size());
+	std::remove(filename.c_str());
+
+	EXPECT_THROW(TableRegistry::getRateTable("TableRegistry_missing.txt"), std::runtime_error);
+}
+
+TEST(WeightWindow, cells) {
+	WeightWindow ww(1 * GeV, 1000 * GeV, 3, 10 * Mpc, 2);
+	EXPECT_EQ(0, ww.getCell(2 * GeV, 1 * Mpc));
+	EXPECT_EQ(2, ww.getCell(500 * GeV, 1 * Mpc));
+	EXPECT_EQ(4, ww.getCell(50 * GeV, 6 * Mpc));
+	EXPECT_EQ(6, ww.getCell(0.5 * GeV, 1 * Mpc)); // outside
+	EXPECT_EQ(6, ww.getCell(2 * GeV, 11 * Mpc));
+	EXPECT_THROW(ww.setTargetWeight(3, 0, 1), std::runtime_error);
+	EXPECT_THROW(WeightWindow(1 * GeV, 1 * GeV, 3), std::runtime_error);
+}
+
+TEST(WeightWindow, splitAndRoulette) {
+	WeightWindow ww(1 * GeV, 1000 * GeV, 3);
+	Vector3d pos(1, 0, 0);
+
+	// without target the thinning of the module applies
+	Candidate a;
+	ww.addSecondary(&a, 22, 2 * GeV, pos, 1, "T");
+	ASSERT_EQ(1, a.secondaries.size());
+	EXPECT_DOUBLE_EQ(1, a.secondaries[0]->getWeight());
+
+	// split into copies of the target weight
+	ww.setTargetWeight(0, 0, 10);
+	Candidate b;
+	b.setWeight(100);
+	ww.addSecondary(&b, 22, 2 * GeV, pos, 0.01, "T");
+	ASSERT_EQ(10, b.secondaries.size());
+	EXPECT_DOUBLE_EQ(10, b.secondaries[0]->getWeight());
+	ww.setMaximumSplit(4);
+	b.clearSecondaries();
+	ww.addSecondary(&b, 22, 2 * GeV, pos, 0.01, "T");
+	ASSERT_EQ(4, b.secondaries.size());
+	EXPECT_DOUBLE_EQ(25, b.secondaries[0]->getWeight());
+
+	// inside the window unchanged
+	Candidate c;
+	c.setWeight(15);
+	ww.addSecondary(&c, 22, 2 * GeV, pos, 0.01, "T");
+	ASSERT_EQ(1, c.secondaries.size());
+	EXPECT_DOUBLE_EQ(15, c.secondaries[0]->getWeight());
+
+	// Russian roulette conserves the weight on average
+	Candidate d;
+	for (size_t i = 0; i < 10000; i++)
+		ww.addSecondary(&d, 22, 2 * GeV, pos, 1, "T");
+	EXPECT_NEAR(1000, d.secondaries.size(), 150);
+	double w = 0;
+	for (size_t i = 0; i < d.secondaries.size(); i++) {
+		EXPECT_DOUBLE_EQ(10, d.secondaries[i]->getWeight());
+		w += d.secondaries[i]->getWeight();
+	}
+	EXPECT_NEAR(10000, w, 1500);
+}
+
+TEST(WeightWindow, warmup) {
+	WeightWindow ww(1 * GeV, 1000 * GeV, 3);
+	ww.setParticlesPerCell(2);
+	ww.startWarmup();
+	EXPECT_TRUE(ww.isWarmup());
+
+	// the expected weight is learned, independent of the thinning
+	Candidate c;
+	c.setWeight(3);
+	for (size_t i = 0; i < 100; i++)
+		ww.addSecondary(&c, 11, 2 * GeV, Vector3d(0.), 0.5, "T");
+	ww.finishWarmup(10);
+	EXPECT_FALSE(ww.isWarmup());
+	EXPECT_DOUBLE_EQ(300. / 10 / 2, ww.getTargetWeight(0, 0));
+	EXPECT_DOUBLE_EQ(0, ww.getTargetWeight(1, 0));
+	EXPECT_THROW(ww.finishWarmup(10), std::runtime_error);
+}
+
 int main(int argc, char **argv) {
 	::testing::InitGoogleTest(&argc, argv);
 	return RUN_ALL_TESTS();
@@ -3,6 +3,7 @@
 #include "crpropa/massDistribution/Ferriere.h"
 #include "crpropa/massDistribution/Nakanishi.h"
 #include "crpropa/massDistribution/ConstantDensity.h"
+#include "crpropa/massDistribution/ExpressionDensity.h"
 #include "crpropa/Units.h"
 #include "crpropa/Grid.h"
 
@@ -293,4 +294,20 @@ TEST(testGridDensity, testRetrunValue) {
 }
 
 
+#ifdef CRPROPA_HAVE_MUPARSER
+TEST(testExpressionDensity, SimpleTest) {
+	ExpressionDensity n("2/ccm", "", "1/ccm * exp(-abs(z) / kpc)");
+	Vector3d p(1*kpc, 0, 1*kpc);
+	EXPECT_NEAR(n.getHIDensity(p), 2e6, 1e-6);
+	EXPECT_DOUBLE_EQ(n.getHIIDensity(p), 0);
+	EXPECT_NEAR(n.getH2Density(p), 1e6 * exp(-1), 1e-6);
+	EXPECT_NEAR(n.getDensity(p), 2e6 + 1e6 * exp(-1), 1e-6);
+	EXPECT_NEAR(n.getNucleonDensity(p), 2e6 + 2e6 * exp(-1), 1e-6);
+
+	EXPECT_TRUE(n.getIsForHI());
+	EXPECT_FALSE(n.getIsForHII());
+	EXPECT_TRUE(n.getIsForH2());
+}
+#endif
+
 } //namespace crpropa
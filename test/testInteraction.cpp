@@ -1,4 +1,8 @@
 #include "crpropa/Candidate.h"
+#include "crpropa/CascadeSolver1D.h"
+#include "crpropa/ModuleList.h"
+#include "crpropa/Random.h"
+#include "crpropa/Source.h"
 #include "crpropa/Units.h"
 #include "crpropa/ParticleID.h"
 #include "crpropa/PhotonBackground.h"
@@ -13,6 +17,10 @@
 #include "crpropa/module/EMTripletPairProduction.h"
 #include "crpropa/module/EMInverseComptonScattering.h"
 #include "crpropa/module/SynchrotronRadiation.h"
+#include "crpropa/module/BreakCondition.h"
+#include "crpropa/module/Observer.h"
+#include "crpropa/module/ParticleCollector.h"
+#include "crpropa/module/SimplePropagation.h"
 #include "gtest/gtest.h"
 
 #include <fstream>
@@ -118,6 +126,64 @@ TEST(ElectronPairProduction, valuesCMB) {
 	}
 }
 
+TEST(ElectronPairProduction, macroParticles) {
+	// weighted pairs in a few bins carry the energy loss
+	ref_ptr<PhotonField> CMB_instance = new CMB();
+	ElectronPairProduction epp(CMB_instance, true);
+	epp.setMacroParticles(10);
+	EXPECT_EQ(10, epp.getMacroParticles());
+
+	Candidate c(nucleusId(1, 1), 1e20 * eV);
+	c.setCurrentStep(10 * Mpc);
+	epp.process(&c);
+	double dE = 1e20 * eV - c.current.getEnergy();
+	EXPECT_GT(dE, 0);
+	EXPECT_LE(c.secondaries.size(), 20);
+	double energy = 0;
+	for (size_t i = 0; i < c.secondaries.size(); i++)
+		energy += c.secondaries[i]->current.getEnergy() * c.secondaries[i]->getWeight();
+	EXPECT_NEAR(dE, energy, 1e-9 * dE);
+
+	// nothing below the minimum energy
+	epp.setMinimumSecondaryEnergy(1e15 * eV);
+	for (size_t k = 0; k < 2; k++) {
+		Candidate c2(nucleusId(1, 1), 1e20 * eV);
+		c2.setCurrentStep(10 * Mpc);
+		epp.process(&c2);
+		for (size_t i = 0; i < c2.secondaries.size(); i++)
+			EXPECT_GE(c2.secondaries[i]->current.getEnergy(), 1e15 * eV);
+		epp.setMacroParticles(0); // and with individual pairs
+	}
+}
+
+// energy of the weighted secondaries of one step of a 1e20 eV proton
+static double macroParticleEnergy(ElectronPairProduction &epp, double minimumEnergy) {
+	epp.setMinimumSecondaryEnergy(minimumEnergy);
+	Candidate c(nucleusId(1, 1), 1e20 * eV);
+	c.setCurrentStep(10 * Mpc);
+	epp.process(&c);
+	double energy = 0;
+	for (size_t i = 0; i < c.secondaries.size(); i++) {
+		EXPECT_GE(c.secondaries[i]->current.getEnergy(), minimumEnergy);
+		energy += c.secondaries[i]->current.getEnergy() * c.secondaries[i]->getWeight();
+	}
+	return energy;
+}
+
+TEST(ElectronPairProduction, macroParticlesMinimumEnergy) {
+	// a spectrum bin straddling the minimum energy contributes the part above it
+	ref_ptr<PhotonField> CMB_instance = new CMB();
+	ElectronPairProduction epp(CMB_instance, true);
+	epp.setMacroParticles(10);
+	double lower = pow(10, 14.95) * eV; // edges of a spectrum bin
+	double upper = pow(10, 15.05) * eV;
+	double below = macroParticleEnergy(epp, lower);
+	double inside = macroParticleEnergy(epp, pow(10, 15.) * eV);
+	double above = macroParticleEnergy(epp, upper);
+	EXPECT_GT(below, inside);
+	EXPECT_GT(inside, above);
+}
+
 TEST(ElectronPairProduction, interactionTag) {
 	
 	ref_ptr<PhotonField> CMB_instance = new CMB();
@@ -695,6 +761,41 @@ TEST(Redshift, limitRedshiftDecrease) {
 	EXPECT_DOUBLE_EQ(0, c.getRedshift());
 }
 
+TEST(Redshift, cosmology) {
+	// modules with different cosmologies in concurrent runs
+	ref_ptr<Cosmology> a = new Cosmology(0.7, 0.3);
+	ref_ptr<Cosmology> b = new Cosmology(0.6, 0.5);
+	Redshift ra(a), rb(b), rd;
+	EXPECT_EQ(a.get(), ra.getCosmology().get());
+	EXPECT_FALSE(rd.getCosmology().valid());
+
+	double z = 0.5, step = 10 * Mpc;
+	double za[100], zb[100];
+#pragma omp parallel for
+	for (int i = 0; i < 100; i++) {
+		Candidate c;
+		c.setRedshift(z);
+		c.setCurrentStep(step);
+		if (i % 2)
+			ra.process(&c);
+		else
+			rb.process(&c);
+		za[i] = zb[i] = c.getRedshift();
+	}
+	for (int i = 0; i < 100; i++) {
+		if (i % 2)
+			EXPECT_DOUBLE_EQ(z - a->hubbleRate(z) / c_light * step, za[i]);
+		else
+			EXPECT_DOUBLE_EQ(z - b->hubbleRate(z) / c_light * step, zb[i]);
+	}
+
+	Candidate c;
+	c.setRedshift(z);
+	c.setCurrentStep(step);
+	rd.process(&c);
+	EXPECT_DOUBLE_EQ(z - hubbleRate(z) / c_light * step, c.getRedshift());
+}
+
 // EMPairProduction -----------------------------------------------------------
 TEST(EMPairProduction, allBackgrounds) {
 	// Test if interaction data files are loaded.
@@ -1131,6 +1232,176 @@ TEST(SynchrtronRadiation, interactionTag) {
 	EXPECT_TRUE(s.getInteractionTag() == "myTag");
 }
 
+TEST(SynchrotronRadiation, collectivePhotons) {
+	SynchrotronRadiation s(1 * muG, true);
+	s.setSecondaryThreshold(0);
+	s.setCollectivePhotons(20);
+	EXPECT_EQ(20, s.getCollectivePhotons());
+
+	// one photon per bin, carrying the radiated energy
+	Candidate c(11, 10 * PeV);
+	c.setCurrentStep(1 * pc);
+	s.process(&c);
+	double dE = 10 * PeV - c.current.getEnergy();
+	EXPECT_GT(dE, 0);
+	EXPECT_LE(c.secondaries.size(), 20);
+	double radiated = 0;
+	for (size_t i = 0; i < c.secondaries.size(); i++)
+		radiated += c.secondaries[i]->current.getEnergy() * c.secondaries[i]->getWeight();
+	EXPECT_NEAR(dE, radiated, 1e-9 * dE);
+}
+
+TEST(SynchrotronRadiation, sampledPhotons) {
+	SynchrotronRadiation s(1 * muG, true);
+	s.setSecondaryThreshold(0);
+
+	// the sampled photons carry the radiated energy up to the last photon
+	Candidate c(11, 10 * PeV);
+	c.setCurrentStep(1e-4 * pc);
+	s.process(&c);
+	double dE = 10 * PeV - c.current.getEnergy();
+	double radiated = 0, largest = 0;
+	for (size_t i = 0; i < c.secondaries.size(); i++) {
+		double E = c.secondaries[i]->current.getEnergy();
+		EXPECT_DOUBLE_EQ(1, c.secondaries[i]->getWeight());
+		radiated += E;
+		largest = std::max(largest, E);
+	}
+	EXPECT_GT(c.secondaries.size(), 10);
+	EXPECT_LE(radiated, dE * (1 + 1e-12));
+	EXPECT_GT(radiated + largest, dE * 0.9);
+}
+
+// CascadeSolver1D ------------------------------------------------------------
+// Toy cascade with constant rates: photons turn into a pair sharing the energy,
+// electrons and positrons give 30% of their energy to a photon.
+class ToyCascade: public Module, public CascadeInteraction {
+public:
+	double getInteractionRate(int id, double, double) const {
+		if (id == 22)
+			return 1 / Mpc;
+		if (std::abs(id) == 11)
+			return 0.5 / Mpc;
+		return 0;
+	}
+
+	void interact(Candidate *candidate, const Vector3d &position) const {
+		double E = candidate->current.getEnergy();
+		if (candidate->current.getId() == 22) {
+			candidate->setActive(false);
+			candidate->addSecondary(11, E / 2, position);
+			candidate->addSecondary(-11, E / 2, position);
+		} else {
+			candidate->current.setEnergy(0.7 * E);
+			candidate->addSecondary(22, 0.3 * E, position);
+		}
+	}
+
+	void performInteraction(Candidate *candidate) const {
+		interact(candidate, candidate->current.getPosition());
+	}
+
+	void process(Candidate *candidate) const {
+		double rate = getInteractionRate(candidate->current.getId(), 0, 0);
+		if (rate == 0)
+			return;
+		// secondaries start at the point of interaction
+		double step = candidate->getCurrentStep();
+		Vector3d x0 = candidate->previous.getPosition();
+		Vector3d x1 = candidate->current.getPosition();
+		double travelled = 0;
+		Random &random = Random::instance();
+		while (candidate->isActive()) {
+			travelled += -log(random.rand()) / rate;
+			if (travelled > step)
+				break;
+			interact(candidate, x0 + (x1 - x0) * (travelled / step));
+		}
+		candidate->limitNextStep(0.1 / rate);
+	}
+};
+
+TEST(CascadeSolver1D, injectAndBins) {
+	CascadeSolver1D solver(1 * TeV, 1000 * TeV, 30);
+	std::vector<double> edges = solver.getBinEdges();
+	EXPECT_EQ(31, edges.size());
+	EXPECT_NEAR(1 * TeV, edges.front(), 1e-9 * TeV);
+	EXPECT_NEAR(1000 * TeV, edges.back(), 1e-6 * TeV);
+	EXPECT_NEAR(sqrt(edges[0] * edges[1]), solver.getEnergies()[0], 1e-9 * TeV);
+
+	solver.inject(22, 1.01 * edges[7], 2);
+	solver.inject(11, 0.5 * TeV); // outside, ignored
+	EXPECT_DOUBLE_EQ(2, solver.getSpectrum(22)[7]);
+	EXPECT_DOUBLE_EQ(0, solver.getSpectrum(11)[0]);
+	EXPECT_THROW(solver.inject(2212, 5 * TeV), std::runtime_error);
+
+	// without interactions the spectrum is unchanged
+	solver.propagate(1 * Mpc);
+	EXPECT_DOUBLE_EQ(2, solver.getSpectrum(22)[7]);
+	solver.clear();
+	EXPECT_DOUBLE_EQ(0, solver.getSpectrum(22)[7]);
+
+	EXPECT_TRUE(solver.add(new ToyCascade()));
+	// ignored modules are not held by the solver
+	ref_ptr<MinimumEnergy> minimumEnergy = new MinimumEnergy(1 * TeV);
+	EXPECT_FALSE(solver.add(minimumEnergy));
+}
+
+TEST(CascadeSolver1D, compareMonteCarlo) {
+	double E0 = 100 * TeV;
+	double Emin = E0 / 1000;
+	double distance = 5 * Mpc;
+
+	// Monte Carlo
+	ModuleList sim;
+	sim.setShowProgress(false);
+	sim.add(new SimplePropagation(1 * kpc, 0.05 * Mpc));
+	sim.add(new ToyCascade());
+	sim.add(new MinimumEnergy(Emin));
+	ref_ptr<ParticleCollector> collector = new ParticleCollector();
+	ref_ptr<Observer> observer = new Observer();
+	observer->add(new Observer1D());
+	observer->onDetection(collector);
+	sim.add(observer);
+
+	ref_ptr<Source> source = new Source();
+	source->add(new SourceParticleType(22));
+	source->add(new SourcePosition(distance));
+	source->add(new SourceEnergy(E0));
+	size_t nPrimaries = 2000;
+	Random::seedThreads(1);
+	sim.run(source, nPrimaries, true);
+
+	double mcNumber[3] = {0, 0, 0}, mcEnergy = 0;
+	for (ParticleCollector::iterator i = collector->begin(); i != collector->end(); i++) {
+		int id = (*i)->current.getId();
+		mcNumber[(id == 22) ? 0 : ((id == 11) ? 1 : 2)] += 1. / nPrimaries;
+		mcEnergy += (*i)->current.getEnergy() / nPrimaries;
+	}
+
+	// solver with the same modules
+	CascadeSolver1D solver(Emin, 2 * E0, 80);
+	EXPECT_TRUE(solver.add(&sim));
+	EXPECT_FALSE(solver.getRedshiftLosses());
+	solver.setStep(0.01 * Mpc);
+	solver.inject(22, E0);
+	solver.propagate(distance);
+
+	int ids[3] = {22, 11, -11};
+	std::vector<double> energies = solver.getEnergies();
+	double energy = 0;
+	for (size_t s = 0; s < 3; s++) {
+		std::vector<double> spectrum = solver.getSpectrum(ids[s]);
+		double number = 0;
+		for (size_t i = 0; i < spectrum.size(); i++) {
+			number += spectrum[i];
+			energy += spectrum[i] * energies[i];
+		}
+		EXPECT_NEAR(mcNumber[s], number, 0.05 * mcNumber[s]);
+	}
+	EXPECT_NEAR(mcEnergy, energy, 0.05 * mcEnergy);
+}
+
 int main(int argc, char **argv) {
 	::testing::InitGoogleTest(&argc, argv);
 	return RUN_ALL_TESTS();
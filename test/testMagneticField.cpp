@@ -41,6 +41,24 @@ TEST(testRenormalizeMagneticField, simpleTest) {
 	Vector3d b = modField.getField(Vector3d(5, 5, 5));
 	EXPECT_NEAR(b.getR(), 3*nG, 0.001);
 }
+
+TEST(testExpressionMagneticField, simpleTest) {
+	ExpressionMagneticField field("1*nG", "x / kpc * nG", "exp(-r / kpc) * muG");
+	Vector3d b = field.getField(Vector3d(2 * kpc, 0, 0));
+	EXPECT_NEAR(b.x, 1 * nG, 1e-6 * nG);
+	EXPECT_NEAR(b.y, 2 * nG, 1e-6 * nG);
+	EXPECT_NEAR(b.z, exp(-2) * muG, 1e-6 * muG);
+}
+
+TEST(testExpressionMagneticField, redshift) {
+	ExpressionMagneticField field("nG * (1 + redshift)^2", "0", "0");
+	EXPECT_NEAR(field.getField(Vector3d(0.), 1).x, 4 * nG, 1e-6 * nG);
+	EXPECT_NEAR(field.getField(Vector3d(0.)).x, 1 * nG, 1e-6 * nG);
+}
+
+TEST(testExpressionMagneticField, invalidExpression) {
+	EXPECT_THROW(ExpressionMagneticField("1*nG +", "0", "0"), std::runtime_error);
+}
 #endif
 
 TEST(testMagneticFieldList, SimpleTest) {
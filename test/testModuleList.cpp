@@ -1,11 +1,26 @@
 #include "crpropa/ModuleList.h"
+#include "crpropa/SweepRunner.h"
 #include "crpropa/Source.h"
 #include "crpropa/ParticleID.h"
 #include "crpropa/module/SimplePropagation.h"
 #include "crpropa/module/BreakCondition.h"
+#include "crpropa/module/ParticleCollector.h"
+#include "crpropa/module/TextOutput.h"
+#include "crpropa/Random.h"
 
 #include "gtest/gtest.h"
 
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <map>
+#include <sstream>
+#include <stdexcept>
+
+#if _OPENMP
+#include <omp.h>
+#endif
+
 namespace crpropa {
 
 TEST(ModuleList, process) {
@@ -55,8 +70,389 @@ TEST(ModuleList, runSource) {
 	modules.run(&source, 100, false);
 }
 
+TEST(ModuleList, runSourceFromArrays) {
+	// more primaries than particles: each particle is run once, the run ends normally
+	ModuleList modules;
+	ref_ptr<ParticleCollector> collector = new ParticleCollector();
+	MaximumTrajectoryLength *maxLength = new MaximumTrajectoryLength(0);
+	maxLength->onReject(collector);
+	modules.add(maxLength);
+	ref_ptr<SourceFromArrays> source = new SourceFromArrays();
+	for (size_t i = 0; i < 10; i++)
+		source->add(22, (i + 1) * EeV, Vector3d(0.), Vector3d(1, 0, 0));
+	modules.run(source.get(), 25, false);
+	EXPECT_EQ(10, collector->size());
+	EXPECT_EQ(0, source->remaining());
+
+	source->reset();
+	ref_ptr<ParticleCollector> collector2 = new ParticleCollector();
+	SweepRunner sweep(new ModuleList());
+	maxLength = new MaximumTrajectoryLength(0);
+	maxLength->onReject(collector2);
+	sweep.add(source, 25, maxLength);
+	sweep.run(false);
+	EXPECT_EQ(10, collector2->size());
+}
+
+static std::vector<double> sortedEnergies(const ParticleCollector &collector) {
+	std::vector<double> energies;
+	for (size_t i = 0; i < collector.size(); i++)
+		energies.push_back(collector[i]->current.getEnergy());
+	std::sort(energies.begin(), energies.end());
+	return energies;
+}
+
+TEST(SweepRunner, configurations) {
+	ref_ptr<ModuleList> modules = new ModuleList();
+	modules->add(new SimplePropagation());
+	SweepRunner sweep(modules);
+
+	// each configuration collects its own candidates at the end
+	std::vector<ref_ptr<ParticleCollector> > collectors;
+	double energies[3] = {1 * EeV, 2 * EeV, 3 * EeV};
+	size_t counts[3] = {10, 0, 25};
+	for (size_t i = 0; i < 3; i++) {
+		ref_ptr<Source> source = new Source();
+		source->add(new SourceParticleType(22));
+		source->add(new SourcePowerLawSpectrum(energies[i], 2 * energies[i], -2));
+		collectors.push_back(new ParticleCollector());
+		ref_ptr<MaximumTrajectoryLength> end = new MaximumTrajectoryLength(1 * Mpc);
+		end->onReject(collectors[i]);
+		EXPECT_EQ(i, sweep.add(source, counts[i], end));
+	}
+	EXPECT_EQ(3, sweep.size());
+	EXPECT_EQ(35, sweep.getCount());
+	EXPECT_EQ(2, sweep.getModules(0)->size());
+	EXPECT_EQ(1, sweep.getModules()->size());
+	EXPECT_THROW(sweep.getModules(3), std::runtime_error);
+
+	sweep.setSeed(42);
+	sweep.run();
+	for (size_t i = 0; i < 3; i++) {
+		ASSERT_EQ(counts[i], collectors[i]->size());
+		for (size_t j = 0; j < counts[i]; j++) {
+			EXPECT_DOUBLE_EQ(1 * Mpc, (*collectors[i])[j]->getTrajectoryLength());
+			EXPECT_GE((*collectors[i])[j]->current.getEnergy(), energies[i]);
+			EXPECT_LE((*collectors[i])[j]->current.getEnergy(), 2 * energies[i]);
+		}
+	}
+
+	// seeded runs give the same candidates with the same serial numbers
+	std::vector<double> first = sortedEnergies(*collectors[2]);
+	std::map<uint64_t, double> serials;
+	for (size_t j = 0; j < collectors[2]->size(); j++)
+		serials[(*collectors[2])[j]->getSerialNumber()] = (*collectors[2])[j]->current.getEnergy();
+	collectors[2]->clearContainer();
+	Candidate::setNextSerialNumber(12345);
+	sweep.run();
+	EXPECT_EQ(first, sortedEnergies(*collectors[2]));
+	for (size_t j = 0; j < collectors[2]->size(); j++) {
+		uint64_t serial = (*collectors[2])[j]->getSerialNumber();
+		ASSERT_EQ(1, serials.count(serial));
+		EXPECT_DOUBLE_EQ(serials[serial], (*collectors[2])[j]->current.getEnergy());
+	}
+}
+
+class PythonLikeModule: public Module {
+public:
+	void process(Candidate *candidate) const {
+		candidate->setActive(false);
+	}
+};
+
+static bool isPythonLikeModule(const Referenced *object) {
+	return dynamic_cast<const PythonLikeModule *>(object) != 0;
+}
+
+TEST(ModuleList, directorPolicy) {
+	ModuleList::setDirectorCheck(&isPythonLikeModule);
+	ModuleList modules;
+	modules.add(new SimplePropagation());
+	modules.add(new MaximumTrajectoryLength(1 * Mpc));
+	Source source;
+	source.add(new SourceParticleType(22));
+	EXPECT_FALSE(modules.hasDirectors(&source));
+
+	ModuleList *sublist = new ModuleList();
+	sublist->add(new PythonLikeModule());
+	modules.add(sublist);
+	EXPECT_TRUE(modules.hasDirectors(&source));
+
+	modules.setDirectorPolicy(ModuleList::RefuseDirectors);
+	EXPECT_THROW(modules.run(&source, 10, false), std::runtime_error);
+
+	modules.setDirectorPolicy(ModuleList::SerializeDirectors);
+	modules.run(&source, 10, false);
+	ModuleList::setDirectorCheck(0);
+}
+
+// throws when processing the candidate with the given serial number
+class FailingModule: public Module {
+public:
+	uint64_t failAt;
+	FailingModule(uint64_t failAt) : failAt(failAt) {
+	}
+	void process(Candidate *candidate) const {
+		if ((failAt > 0) && (candidate->getSerialNumber() == failAt))
+			throw std::runtime_error("FailingModule: simulated preemption");
+	}
+};
+
+static std::string readFile(const std::string &filename) {
+	std::ifstream in(filename.c_str(), std::ios::binary);
+	std::stringstream ss;
+	ss << in.rdbuf();
+	return ss.str();
+}
+
+static void runCheckpointed(const std::string &filename, uint64_t failAt, const std::string &checkpoint, bool resume) {
+	ModuleList modules;
+	modules.add(new SimplePropagation(1 * kpc, 1 * Mpc));
+	modules.add(new FailingModule(failAt));
+	MaximumTrajectoryLength *maxLength = new MaximumTrajectoryLength(1 * Mpc);
+	maxLength->onReject(new TextOutput(filename, Output::Event3D, resume));
+	modules.add(maxLength);
+
+	Source source;
+	source.add(new SourceIsotropicEmission());
+	source.add(new SourcePowerLawSpectrum(5 * EeV, 100 * EeV, -2));
+	source.add(new SourceParticleType(22));
+
+	if (resume) {
+		modules.resume(&source, checkpoint);
+	} else {
+		Random::seedThreads(42);
+		Candidate::setNextSerialNumber(0);
+		modules.setCheckpoint(checkpoint, 10);
+		modules.run(&source, 100, false);
+	}
+}
+
+TEST(ModuleList, checkpointResume) {
+#if _OPENMP
+	int threads = omp_get_max_threads();
+	omp_set_num_threads(1);
+#endif
+	// reference run without interruption
+	runCheckpointed("checkpoint_reference.txt", 0, "checkpoint_reference.ckpt", false);
+
+	// interrupted in the fourth block of primaries and resumed
+	runCheckpointed("checkpoint_resumed.txt", 35, "checkpoint_resumed.ckpt", false);
+	std::string interrupted = readFile("checkpoint_resumed.txt");
+	std::string checkpoint = readFile("checkpoint_resumed.ckpt");
+	EXPECT_NE(std::string::npos, checkpoint.find("completed 30\n"));
+	runCheckpointed("checkpoint_resumed.txt", 0, "checkpoint_resumed.ckpt", true);
+	checkpoint = readFile("checkpoint_resumed.ckpt");
+	EXPECT_NE(std::string::npos, checkpoint.find("completed 100\n"));
+
+	std::string reference = readFile("checkpoint_reference.txt");
+	std::string resumed = readFile("checkpoint_resumed.txt");
+	EXPECT_LT(interrupted.size(), reference.size());
+	EXPECT_EQ(reference, resumed);
+
+	std::remove("checkpoint_reference.txt");
+	std::remove("checkpoint_reference.ckpt");
+	std::remove("checkpoint_resumed.txt");
+	std::remove("checkpoint_resumed.ckpt");
+#if _OPENMP
+	omp_set_num_threads(threads);
+#endif
+}
+
+static std::vector<std::string> sortedLines(const std::string &text) {
+	std::vector<std::string> lines;
+	std::stringstream ss(text);
+	std::string line;
+	while (std::getline(ss, line))
+		lines.push_back(line);
+	std::sort(lines.begin(), lines.end());
+	return lines;
+}
+
+static void runShardToFile(const std::string &filename, size_t shard, size_t shards) {
+	ModuleList modules;
+	modules.add(new SimplePropagation(1 * kpc, 1 * Mpc));
+	MaximumTrajectoryLength *maxLength = new MaximumTrajectoryLength(1 * Mpc);
+	maxLength->onReject(new TextOutput(filename, Output::Event3D));
+	modules.add(maxLength);
+
+	Source source;
+	source.add(new SourceIsotropicEmission());
+	source.add(new SourcePowerLawSpectrum(5 * EeV, 100 * EeV, -2));
+	source.add(new SourceParticleType(22));
+	modules.runShard(&source, 100, shard, shards, 42, false);
+}
+
+TEST(ModuleList, runShard) {
+	// a single run and the same run in three shards, which are merged
+	runShardToFile("shard_all.txt", 0, 1);
+	std::vector<std::string> shards;
+	for (size_t i = 0; i < 3; i++) {
+		std::stringstream name;
+		name << "shard_" << i << ".txt";
+		runShardToFile(name.str(), i, 3);
+		shards.push_back(name.str());
+	}
+	TextOutput::merge(shards, "shard_merged.txt");
+
+	// with several threads, the order of the events may differ
+	std::vector<std::string> all = sortedLines(readFile("shard_all.txt"));
+	EXPECT_EQ(all, sortedLines(readFile("shard_merged.txt")));
+	EXPECT_NE(all, sortedLines(readFile("shard_0.txt")));
+
+	EXPECT_THROW(runShardToFile("shard_0.txt", 3, 3), std::runtime_error);
+
+	// a missing shard aborts the merge, the compressing stream is released
+	shards.push_back("shard_missing.txt");
+	EXPECT_THROW(TextOutput::merge(shards, "shard_merged.txt.gz"), std::runtime_error);
+	shards.pop_back();
+
+	std::remove("shard_all.txt");
+	std::remove("shard_merged.txt");
+	std::remove("shard_merged.txt.gz");
+	for (size_t i = 0; i < shards.size(); i++)
+		std::remove(shards[i].c_str());
+}
+
+TEST(ModuleList, serialNumberRange) {
+	Candidate::setThreadSerialNumberRange(1000, 2);
+	Candidate a, b;
+	EXPECT_EQ(1000, a.getSerialNumber());
+	EXPECT_EQ(1001, b.getSerialNumber());
+	// a used up range continues with the shared counter
+	Candidate::setNextSerialNumber(5000);
+	Candidate c;
+	EXPECT_EQ(5001, c.getSerialNumber());
+	Candidate::setThreadSerialNumberRange(0, 0);
+	Candidate d;
+	EXPECT_EQ(5002, d.getSerialNumber());
+
+	// ranges start at 1, the shared counter continues above them
+	Candidate::setNextSerialNumber(0);
+	Candidate::reserveSerialNumberRanges(10, 100);
+	EXPECT_EQ(1000, Candidate::getNextSerialNumber());
+	Candidate::reserveSerialNumberRanges(5, 100);
+	EXPECT_EQ(1000, Candidate::getNextSerialNumber());
+	EXPECT_THROW(Candidate::reserveSerialNumberRanges(UINT64_MAX / 2, 3), std::runtime_error);
+}
+
+// adds a secondary in every call
+class SecondaryModule: public Module {
+public:
+	void process(Candidate *candidate) const {
+		candidate->addSecondary(22, 1 * EeV);
+	}
+};
+
+TEST(ModuleList, profiling) {
+	ModuleList modules;
+	modules.add(new SimplePropagation(1 * kpc, 0.1 * Mpc));
+	modules.add(new SecondaryModule());
+	modules.add(new MaximumTrajectoryLength(1 * Mpc));
+	modules.setProfiling(true, 2);
+	EXPECT_TRUE(modules.isProfiling());
+
+	ref_ptr<Candidate> candidate = new Candidate(22, 1 * EeV);
+	modules.run(candidate, false);
+	uint64_t steps = modules.getProfileSteps();
+	EXPECT_GE(steps, 10);
+
+	std::vector<ModuleProfile> profile = modules.getProfile();
+	ASSERT_EQ(3, profile.size());
+	for (size_t i = 0; i < profile.size(); i++) {
+		EXPECT_EQ(steps, profile[i].calls);
+		EXPECT_EQ((steps + 1) / 2, profile[i].sampledCalls);
+		EXPECT_GE(profile[i].time, 0);
+	}
+	EXPECT_EQ(0, profile[0].secondaries);
+	EXPECT_EQ(steps, profile[1].secondaries);
+	EXPECT_EQ(modules[1]->getDescription(), profile[1].description);
+
+	modules.writeProfileJSON("profile_test.json");
+	std::string json = readFile("profile_test.json");
+	std::stringstream expected;
+	expected << "\"steps\": " << steps << ",";
+	EXPECT_NE(std::string::npos, json.find(expected.str()));
+	EXPECT_NE(std::string::npos, json.find("\"samplingInterval\": 2,"));
+	modules.writeProfileTrace("profile_test_trace.json");
+	std::string trace = readFile("profile_test_trace.json");
+	EXPECT_NE(std::string::npos, trace.find("\"ph\": \"X\""));
+	std::remove("profile_test.json");
+	std::remove("profile_test_trace.json");
+
+	modules.resetProfile();
+	EXPECT_EQ(0, modules.getProfileSteps());
+	modules.setProfiling(false);
+	modules.process(candidate);
+	EXPECT_EQ(0, modules.getProfileSteps());
+	EXPECT_THROW(modules.setProfiling(true, 0), std::runtime_error);
+}
+
+// one secondary in the first step of each primary
+class FirstStepSecondary: public Module {
+public:
+	void process(Candidate *candidate) const {
+		if (candidate->parent == 0 && candidate->secondaries.empty())
+			candidate->addSecondary(22, 1 * EeV);
+	}
+};
+
+class CountingTelemetryCallback: public TelemetryCallback {
+public:
+	size_t updates;
+	uint64_t lastFinished;
+	bool monotonic;
+	CountingTelemetryCallback() : updates(0), lastFinished(0), monotonic(true) {
+	}
+	void update(const RunTelemetry &telemetry) {
+		updates++;
+		if (telemetry.primariesFinished < lastFinished)
+			monotonic = false;
+		lastFinished = telemetry.primariesFinished;
+	}
+};
+
+TEST(ModuleList, telemetry) {
+	ModuleList modules;
+	modules.add(new SimplePropagation(1 * kpc, 0.1 * Mpc));
+	modules.add(new FirstStepSecondary());
+	modules.add(new MaximumTrajectoryLength(1 * Mpc));
+	ref_ptr<CountingTelemetryCallback> callback = new CountingTelemetryCallback();
+	modules.setTelemetryInterval(1e-9);
+	modules.setTelemetryCallback(callback);
+	modules.setTelemetryFile("telemetry_test.prom");
+
+	Source source;
+	source.add(new SourceParticleType(22));
+	source.add(new SourceEnergy(1 * EeV));
+	modules.run(&source, 20, true);
+
+	RunTelemetry telemetry = modules.getTelemetry();
+	EXPECT_EQ(20, telemetry.primaries);
+	EXPECT_EQ(20, telemetry.primariesFinished);
+	EXPECT_EQ(20, telemetry.secondariesCreated);
+	EXPECT_EQ(20, telemetry.secondariesFinished);
+	EXPECT_EQ(0, telemetry.getPendingSecondaries());
+	EXPECT_GE(telemetry.steps, 40 * 10);
+	EXPECT_EQ(0, telemetry.outputBacklog);
+	EXPECT_GT(telemetry.elapsed, 0);
+	ASSERT_GE(telemetry.threadBusy.size(), 1);
+	EXPECT_EQ(telemetry.threadBusy.size(), telemetry.threadIdle.size());
+	EXPECT_NEAR(telemetry.elapsed, telemetry.threadBusy[0] + telemetry.threadIdle[0], 1e-6);
+	EXPECT_GE(callback->updates, 2);
+	EXPECT_EQ(20, callback->lastFinished);
+	EXPECT_TRUE(callback->monotonic);
+
+	std::string prometheus = readFile("telemetry_test.prom");
+	EXPECT_NE(std::string::npos, prometheus.find("crpropa_primaries_finished_total 20\n"));
+	EXPECT_NE(std::string::npos, prometheus.find("crpropa_thread_busy_seconds_total{thread=\"0\"}"));
+	std::remove("telemetry_test.prom");
+
+	EXPECT_NE(std::string::npos, telemetry.toJSON().find("\"secondariesFinished\": 20,"));
+	EXPECT_THROW(modules.setTelemetryInterval(-1), std::runtime_error);
+}
+
 #if _OPENMP
-#include <omp.h>
 TEST(ModuleList, runOpenMP) {
 	ModuleList modules;
 	modules.add(new SimplePropagation());
@@ -69,6 +465,33 @@ TEST(ModuleList, runOpenMP) {
 	omp_set_num_threads(2);
 	modules.run(&source, 1000, false);
 }
+
+TEST(ModuleList, finishRun) {
+	// the lines buffered by the threads are written when run returns
+	std::stringstream stream;
+	ref_ptr<TextOutput> output = new TextOutput(stream, Output::Event1D);
+	output->setBlockSize(1 << 20);
+	ModuleList modules;
+	modules.add(new SimplePropagation(1 * kpc, 1 * Mpc));
+	MaximumTrajectoryLength *maxLength = new MaximumTrajectoryLength(1 * Mpc);
+	maxLength->onReject(output);
+	modules.add(maxLength);
+	Source source;
+	source.add(new SourceParticleType(nucleusId(1, 1)));
+	int threads = omp_get_max_threads();
+	omp_set_num_threads(4);
+	modules.run(&source, 100, false);
+	omp_set_num_threads(threads);
+
+	EXPECT_EQ(0, output->getBacklog());
+	EXPECT_EQ(100, output->size());
+	std::string line;
+	int lines = 0;
+	while (std::getline(stream, line))
+		if (line[0] != '#')
+			lines++;
+	EXPECT_EQ(100, lines);
+}
 #endif
 
 int main(int argc, char **argv) {
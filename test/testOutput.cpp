@@ -2,11 +2,13 @@
     Output
     TextOutput
     ParticleCollector
+    HistogramOutput
  */
 
 #include "CRPropa.h"
 
 #include "gtest/gtest.h"
+#include <fstream>
 #include <iostream>
 #include <string>
 
@@ -139,6 +141,93 @@ TEST(TextOutput, printHeader_Version) {
 	          g_GIT_DESC);
 }
 
+TEST(TextOutput, numberFormat) {
+	// the columns are formatted as with printf("%8.5E") and printf("%10i")
+	std::vector<double> values;
+	values.push_back(0);
+	values.push_back(-0.);
+	values.push_back(1);
+	values.push_back(-1.5);
+	values.push_back(999999.5);
+	values.push_back(9.999995);
+	values.push_back(1.234565e-7);
+	values.push_back(1e-310);
+	values.push_back(1e300);
+	values.push_back(-2.5e-250);
+	Random random(42);
+	for (int i = 0; i < 10000; i++)
+		values.push_back(random.randNorm() * std::pow(10., random.randUniform(-40, 40)));
+
+	std::stringstream stream;
+	TextOutput output(stream);
+	output.disableAll();
+	output.enable(Output::TrajectoryLengthColumn);
+	output.enable(Output::CurrentIdColumn);
+	output.setLengthScale(1);
+
+	std::string expected;
+	char buffer[64];
+	Candidate c(-11);
+	for (size_t i = 0; i < values.size(); i++) {
+		c.setTrajectoryLength(values[i]);
+		output.process(&c);
+		std::sprintf(buffer, "%8.5E\t%10i\n", values[i], -11);
+		expected += buffer;
+	}
+	output.close();
+
+	std::string written = stream.str();
+	written = written.substr(written.find("#\n# CRPropa version"));
+	written = written.substr(written.find("#\n", 3) + 2);
+	EXPECT_EQ(expected, written);
+	EXPECT_EQ(values.size(), output.size());
+}
+
+#ifdef _OPENMP
+TEST(TextOutput, parallelBlocks) {
+	// lines of different threads are collected and written in blocks
+	std::stringstream stream;
+	TextOutput output(stream, Output::Event3D);
+	output.setBlockSize(1000);
+	int n = 5000;
+#pragma omp parallel for num_threads(4)
+	for (int i = 0; i < n; i++) {
+		Candidate c(22, i * EeV);
+		output.process(&c);
+	}
+	output.close();
+
+	std::string line;
+	int lines = 0;
+	while (std::getline(stream, line))
+		if (line[0] != '#')
+			lines++;
+	EXPECT_EQ(n, lines);
+	EXPECT_EQ(n, output.size());
+}
+
+TEST(TextOutput, backlog) {
+	std::stringstream stream;
+	TextOutput output(stream, Output::Event3D);
+	output.setBlockSize(1 << 20);
+	int n = 1000;
+#pragma omp parallel num_threads(4)
+	{
+#pragma omp for
+		for (int i = 0; i < n; i++) {
+			Candidate c(22, i * EeV);
+			output.process(&c);
+		}
+		// all lines are buffered by the threads
+#pragma omp single
+		EXPECT_EQ(n, output.getBacklog());
+	}
+	output.flush();
+	EXPECT_EQ(0, output.getBacklog());
+	EXPECT_EQ(n, output.size());
+}
+#endif
+
 TEST(TextOutput, failOnIllegalOutputFile) {
 	EXPECT_THROW(
 	    TextOutput output("THIS_FOLDER_MUST_NOT_EXISTS_12345+/FILE.txt"),
@@ -153,6 +242,68 @@ TEST(HDF5Output, failOnIllegalOutputFile) {
 	EXPECT_THROW(out.open("THIS_FOLDER_MUST_NOT_EXISTS_12345+/FILE.h5"),
 	             std::runtime_error);
 }
+
+TEST(HDF5Output, checkpoint) {
+	std::string filename = "hdf5_checkpoint_test.h5";
+	Candidate c(22, EeV);
+	std::string state;
+	{
+		HDF5Output out(filename, Output::Event1D);
+		for (int i = 0; i < 5; i++)
+			out.process(&c);
+		state = out.saveCheckpoint();
+		// written after the checkpoint, removed when resuming
+		for (int i = 0; i < 3; i++)
+			out.process(&c);
+	}
+	{
+		HDF5Output out(filename, Output::Event1D);
+		out.loadCheckpoint(state);
+		EXPECT_EQ(5, out.size());
+		for (int i = 0; i < 2; i++)
+			out.process(&c);
+	}
+
+	hid_t file = H5Fopen(filename.c_str(), H5F_ACC_RDONLY, H5P_DEFAULT);
+	ASSERT_GE(file, 0);
+	hid_t dset = H5Dopen2(file, "CRPROPA3", H5P_DEFAULT);
+	hid_t space = H5Dget_space(dset);
+	EXPECT_EQ(7, H5Sget_simple_extent_npoints(space));
+	H5Sclose(space);
+	H5Dclose(dset);
+	H5Fclose(file);
+	std::remove(filename.c_str());
+}
+
+TEST(HDF5Output, merge) {
+	Candidate c(22, EeV);
+	std::vector<std::string> shards;
+	for (int i = 0; i < 3; i++) {
+		std::stringstream name;
+		name << "hdf5_merge_test_" << i << ".h5";
+		shards.push_back(name.str());
+		HDF5Output out(name.str(), Output::Event1D);
+		for (int j = 0; j <= i; j++)
+			out.process(&c);
+	}
+	// a shard without output
+	shards.push_back("hdf5_merge_test_missing.h5");
+	HDF5Output::merge(shards, "hdf5_merge_test.h5");
+
+	hid_t file = H5Fopen("hdf5_merge_test.h5", H5F_ACC_RDONLY, H5P_DEFAULT);
+	ASSERT_GE(file, 0);
+	hid_t dset = H5Dopen2(file, "CRPROPA3", H5P_DEFAULT);
+	hid_t space = H5Dget_space(dset);
+	EXPECT_EQ(6, H5Sget_simple_extent_npoints(space));
+	EXPECT_GT(H5Aexists(dset, "Version"), 0);
+	H5Sclose(space);
+	H5Dclose(dset);
+	H5Fclose(file);
+
+	std::remove("hdf5_merge_test.h5");
+	for (size_t i = 0; i < shards.size(); i++)
+		std::remove(shards[i].c_str());
+}
 #endif
 
 //-- ParticleCollector
@@ -187,6 +338,30 @@ TEST(ParticleCollector, reprocess) {
 	EXPECT_EQ(output[0], c);
 }
 
+TEST(ParticleCollector, getRecords) {
+	ref_ptr<Candidate> c = new Candidate(22, 1.5 * EeV, Vector3d(1, 2, 3),
+			Vector3d(0, 0, 1), 0, 0.5);
+	c->current.setEnergy(1 * EeV);
+	c->current.setPosition(Vector3d(4, 5, 6));
+	c->setTrajectoryLength(2 * Mpc);
+	ParticleCollector output;
+	output.process(c);
+	output.process(c);
+
+	std::vector<CandidateRecord> records = output.getRecords();
+	ASSERT_EQ(records.size(), 2);
+	EXPECT_EQ(records[1].ID, 22);
+	EXPECT_EQ(records[1].ID0, 22);
+	EXPECT_DOUBLE_EQ(records[1].D, 2 * Mpc);
+	EXPECT_DOUBLE_EQ(records[1].W, 0.5);
+	EXPECT_DOUBLE_EQ(records[1].E, 1 * EeV);
+	EXPECT_DOUBLE_EQ(records[1].E0, 1.5 * EeV);
+	EXPECT_DOUBLE_EQ(records[1].X, 4);
+	EXPECT_DOUBLE_EQ(records[1].Z0, 3);
+	EXPECT_DOUBLE_EQ(records[1].P1z, 1);
+	EXPECT_EQ(records[1].SN, c->getSerialNumber());
+}
+
 TEST(ParticleCollector, dumpload) {
 	ref_ptr<Candidate> c = new Candidate(nucleusId(1, 1), 1.234 * EeV);
 	c->current.setPosition(Vector3d(1, 2, 3));
@@ -270,6 +445,159 @@ TEST(ParticleCollector, runModuleList) {
 	modules.run(&candidates);
 }
 
+//-- HistogramOutput
+
+TEST(HistogramOutput, linearAndIdAxes) {
+	HistogramOutput h;
+	h.addIdAxis(std::vector<int>{22, 11});
+	h.addLinearAxis(HistogramOutput::Energy, 4, 0, 4 * EeV);
+	EXPECT_EQ(2, h.getNumberOfAxes());
+	EXPECT_EQ(2, h.getShape()[0]);
+	EXPECT_EQ(4, h.getShape()[1]);
+
+	Candidate c1(22, 0.5 * EeV);
+	c1.setWeight(2);
+	h.process(&c1);
+	Candidate c2(11, 3.5 * EeV);
+	h.process(&c2);
+	h.process(&c2);
+	Candidate c3(-11, 1 * EeV); // not in the id axis
+	h.process(&c3);
+	Candidate c4(22, 5 * EeV); // above the energy range
+	c4.setWeight(0.5);
+	h.process(&c4);
+
+	std::vector<double> histogram = h.getHistogram();
+	ASSERT_EQ(8, histogram.size());
+	EXPECT_DOUBLE_EQ(2, histogram[0]);
+	EXPECT_DOUBLE_EQ(2, histogram[4 + 3]);
+	double sum = 0;
+	for (size_t i = 0; i < histogram.size(); i++)
+		sum += histogram[i];
+	EXPECT_DOUBLE_EQ(4, sum);
+	EXPECT_DOUBLE_EQ(1.5, h.getOutsideWeight());
+
+	h.clear();
+	EXPECT_DOUBLE_EQ(0, h.getHistogram()[0]);
+	EXPECT_DOUBLE_EQ(0, h.getOutsideWeight());
+}
+
+TEST(HistogramOutput, logAxis) {
+	HistogramOutput h;
+	h.addLogAxis(HistogramOutput::Energy, 3, 1 * EeV, 1000 * EeV);
+	std::vector<double> edges = h.getBinEdges(0);
+	ASSERT_EQ(4, edges.size());
+	EXPECT_NEAR(10 * EeV, edges[1], 1e-9 * EeV);
+	EXPECT_NEAR(1000 * EeV, edges[3], 1e-9 * EeV);
+
+	Candidate c(22, 50 * EeV);
+	h.process(&c);
+	EXPECT_DOUBLE_EQ(1, h.getHistogram()[1]);
+
+	// axes cannot be changed once filled
+	EXPECT_THROW(h.addLinearAxis(HistogramOutput::Redshift, 2, 0, 1),
+	             std::runtime_error);
+	EXPECT_THROW(h.addLogAxis(HistogramOutput::Energy, 2, 0, 1),
+	             std::runtime_error);
+}
+
+TEST(HistogramOutput, parallelFill) {
+	HistogramOutput h;
+	h.addLinearAxis(HistogramOutput::Energy, 10, 0, 10 * EeV);
+	int n = 10000;
+#pragma omp parallel for num_threads(4)
+	for (int i = 0; i < n; i++) {
+		Candidate c(22, (i % 10 + 0.5) * EeV);
+		h.process(&c);
+	}
+	std::vector<double> histogram = h.getHistogram();
+	for (size_t i = 0; i < histogram.size(); i++)
+		EXPECT_DOUBLE_EQ(n / 10, histogram[i]);
+}
+
+TEST(HistogramOutput, checkpoint) {
+	HistogramOutput h1, h2;
+	h1.addLinearAxis(HistogramOutput::Energy, 2, 0, 2 * EeV);
+	h2.addLinearAxis(HistogramOutput::Energy, 2, 0, 2 * EeV);
+	Candidate c(22, 1.5 * EeV);
+	c.setWeight(0.25);
+	h1.process(&c);
+	h2.loadCheckpoint(h1.saveCheckpoint());
+	EXPECT_DOUBLE_EQ(0.25, h2.getHistogram()[1]);
+
+	HistogramOutput h3;
+	h3.addLinearAxis(HistogramOutput::Energy, 3, 0, 2 * EeV);
+	EXPECT_THROW(h3.loadCheckpoint(h1.saveCheckpoint()), std::runtime_error);
+}
+
+TEST(HistogramOutput, writeNpy) {
+	std::string filename = "histogram_output_test.npy";
+	{
+		HistogramOutput h(filename);
+		h.addIdAxis(std::vector<int>{22, 11, -11});
+		h.addLinearAxis(HistogramOutput::TrajectoryLength, 5, 0, 1 * Mpc);
+		Candidate c(11, EeV);
+		h.process(&c);
+		h.close();
+	}
+
+	std::ifstream in(filename.c_str(), std::ios::binary);
+	ASSERT_TRUE(in.good());
+	std::string data((std::istreambuf_iterator<char>(in)),
+	                 std::istreambuf_iterator<char>());
+	in.close();
+	std::remove(filename.c_str());
+
+	EXPECT_EQ(0, data.compare(0, 6, "\x93NUMPY"));
+	size_t headerLength = (unsigned char)data[8] + 256 * (unsigned char)data[9];
+	EXPECT_EQ(0, (10 + headerLength) % 64);
+	EXPECT_NE(std::string::npos, data.find("'shape': (3, 5, )"));
+	ASSERT_EQ(10 + headerLength + 15 * sizeof(double), data.size());
+	double value;
+	memcpy(&value, &data[10 + headerLength + 5 * sizeof(double)], sizeof(double));
+	EXPECT_DOUBLE_EQ(1, value);
+}
+
+TEST(HistogramOutput, closeInDestructor) {
+	// the error of a file that cannot be written is logged, not thrown
+	HistogramOutput *h = new HistogramOutput("THIS_FOLDER_MUST_NOT_EXISTS_12345+/FILE.npy");
+	h->addLinearAxis(HistogramOutput::Energy, 2, 0, 2 * EeV);
+	EXPECT_NO_THROW(delete h);
+}
+
+#ifdef CRPROPA_HAVE_HDF5
+TEST(HistogramOutput, writeHDF5) {
+	std::string filename = "histogram_output_test.h5";
+	{
+		HistogramOutput h(filename);
+		h.addLinearAxis(HistogramOutput::Energy, 4, 0, 4 * EeV);
+		Candidate c(22, 2.5 * EeV);
+		h.process(&c);
+		h.close();
+	}
+
+	hid_t file = H5Fopen(filename.c_str(), H5F_ACC_RDONLY, H5P_DEFAULT);
+	ASSERT_GE(file, 0);
+	hid_t dset = H5Dopen2(file, "histogram", H5P_DEFAULT);
+	ASSERT_GE(dset, 0);
+	double histogram[4];
+	EXPECT_GE(H5Dread(dset, H5T_NATIVE_DOUBLE, H5S_ALL, H5S_ALL, H5P_DEFAULT, histogram), 0);
+	EXPECT_DOUBLE_EQ(0, histogram[1]);
+	EXPECT_DOUBLE_EQ(1, histogram[2]);
+	H5Dclose(dset);
+	dset = H5Dopen2(file, "axis0", H5P_DEFAULT);
+	EXPECT_GE(dset, 0);
+	H5Dclose(dset);
+	H5Fclose(file);
+	std::remove(filename.c_str());
+
+	H5Eset_auto2(H5E_DEFAULT, NULL, NULL);
+	HistogramOutput h("THIS_FOLDER_MUST_NOT_EXISTS_12345+/FILE.h5");
+	h.addLinearAxis(HistogramOutput::Energy, 2, 0, 2 * EeV);
+	EXPECT_THROW(h.close(), std::runtime_error);
+}
+#endif
+
 int main(int argc, char **argv) {
 	::testing::InitGoogleTest(&argc, argv);
 	return RUN_ALL_TESTS();
@@ -3,6 +3,14 @@
 #include "crpropa/module/SimplePropagation.h"
 #include "crpropa/module/PropagationBP.h"
 #include "crpropa/module/PropagationCK.h"
+#include "crpropa/module/DiffusionSDE.h"
+#include "crpropa/module/EventPropagation1D.h"
+#include "crpropa/module/Observer.h"
+#include "crpropa/module/Redshift.h"
+#include "crpropa/module/SynchrotronRadiation.h"
+#include "crpropa/magneticField/MagneticField.h"
+#include "crpropa/Cosmology.h"
+#include "crpropa/ModuleList.h"
 #include "crpropa/magneticField/turbulentField/PlaneWaveTurbulence.h"
 
 #include "gtest/gtest.h"
@@ -548,6 +556,193 @@ TEST(testPropagationBP, neutron) {
 	EXPECT_EQ(Vector3d(0, 1, 0), c.current.getDirection());
 }
 
+// field lines are circles around the z-axis
+class CircularField: public MagneticField {
+public:
+	Vector3d getField(const Vector3d &pos) const {
+		return Vector3d(-pos.y, pos.x, 0) / kpc * nG;
+	}
+};
+
+TEST(DiffusionSDE, integrateFieldLineUniform) {
+	DiffusionSDE propa(new UniformMagneticField(Vector3d(0, 1, 0) * nG));
+	size_t stepNumber = 0;
+	Vector3d pos = propa.integrateFieldLine(Vector3d(1, 2, 3) * kpc, 0, -2 * kpc / c_light, stepNumber);
+	EXPECT_EQ(1, stepNumber);
+	EXPECT_NEAR(1 * kpc, pos.x, 1e-6 * kpc);
+	EXPECT_NEAR(0, pos.y, 1e-6 * kpc);
+	EXPECT_NEAR(3 * kpc, pos.z, 1e-6 * kpc);
+}
+
+TEST(DiffusionSDE, integrateFieldLineCircle) {
+	DiffusionSDE propa(new CircularField(), 1e-6, 0, 1 * kpc);
+	size_t stepNumber = 0;
+	// a quarter circle with radius 1 kpc
+	Vector3d pos = propa.integrateFieldLine(Vector3d(1, 0, 0) * kpc, 0, M_PI / 2 * kpc / c_light, stepNumber);
+	EXPECT_GT(stepNumber, 1);
+	EXPECT_NEAR(0, pos.x, 1e-4 * kpc);
+	EXPECT_NEAR(1 * kpc, pos.y, 1e-4 * kpc);
+	EXPECT_NEAR(0, pos.z, 1e-4 * kpc);
+}
+
+TEST(DiffusionSDE, parallelDiffusion) {
+	// without perpendicular diffusion the candidate stays on its field line
+	DiffusionSDE propa(new UniformMagneticField(Vector3d(0, 0, 1) * nG), 1e-4, 1 * pc, 1 * kpc, 0.);
+	Candidate c(-11, 1 * EeV, Vector3d(1, 2, 0) * kpc);
+	c.setNextStep(100 * pc);
+	for (int i = 0; i < 10; i++)
+		propa.process(&c);
+	EXPECT_TRUE(c.isActive());
+	EXPECT_NEAR(1 * kpc, c.current.getPosition().x, 1e-6 * kpc);
+	EXPECT_NEAR(2 * kpc, c.current.getPosition().y, 1e-6 * kpc);
+	EXPECT_NE(0, c.current.getPosition().z);
+}
+
+TEST(DiffusionSDE, tensorCache) {
+	// the cached tensor is recomputed after the parameters changed
+	DiffusionSDE propa(new UniformMagneticField(Vector3d(0, 0, 1) * nG), 1e-4, 1 * pc, 1 * kpc, 0.);
+	Candidate c(-11, 1 * EeV);
+	c.setNextStep(1 * kpc);
+	propa.process(&c);
+	double z1 = fabs(c.current.getPosition().z);
+	propa.setScale(0);
+	c.current.setPosition(Vector3d(0.));
+	c.current.setDirection(Vector3d(1, 0, 0));
+	propa.process(&c);
+	EXPECT_GT(z1, 0);
+	// no diffusion along the field: the fallback moves the candidate along its direction
+	EXPECT_DOUBLE_EQ(0, c.current.getPosition().z);
+}
+
+
+// photons are absorbed with a rate of 1 / Mpc
+class ToyAbsorption: public Module, public CascadeInteraction {
+public:
+	double getInteractionRate(int id, double, double) const {
+		return (id == 22) ? 1 / Mpc : 0;
+	}
+	void performInteraction(Candidate *candidate) const {
+		candidate->setActive(false);
+	}
+	void process(Candidate *) const {
+	}
+};
+
+// continuous loss -dE/dx = E^2 / (EeV Mpc)
+class ToyLoss: public Module, public ContinuousLoss {
+public:
+	double getEnergyLossRate(int, double energy, double) const {
+		return energy * energy / EeV / Mpc;
+	}
+	void process(Candidate *) const {
+	}
+};
+
+// counts the steps of all candidates
+class StepCounter: public Module {
+public:
+	mutable size_t steps;
+	StepCounter() : steps(0) {
+	}
+	void process(Candidate *) const {
+		steps++;
+	}
+};
+
+TEST(EventPropagation1D, add) {
+	EventPropagation1D propa;
+	ref_ptr<ModuleList> list = new ModuleList();
+	list->add(new ToyAbsorption());
+	list->add(new Redshift());
+	list->add(new SimplePropagation());
+	EXPECT_TRUE(propa.add(list));
+	EXPECT_TRUE(propa.getRedshiftLosses());
+	ref_ptr<SimplePropagation> simple = new SimplePropagation();
+	EXPECT_FALSE(propa.add(simple));
+	EXPECT_THROW(propa.setTolerance(0), std::runtime_error);
+
+	// synchrotron losses only with a RMS field strength
+	ref_ptr<SynchrotronRadiation> rms = new SynchrotronRadiation(1 * nG);
+	EXPECT_TRUE(propa.add(rms));
+	ref_ptr<SynchrotronRadiation> field = new SynchrotronRadiation(
+			new UniformMagneticField(Vector3d(0, 0, 1 * nG)));
+	EXPECT_THROW(propa.add(field), std::runtime_error);
+}
+
+TEST(EventPropagation1D, jumpToObserver) {
+	// without interactions only the observer limits the step
+	ModuleList m;
+	m.add(new EventPropagation1D());
+	ref_ptr<StepCounter> counter = new StepCounter();
+	m.add(counter);
+	ref_ptr<Observer> obs = new Observer();
+	obs->add(new Observer1D());
+	m.add(obs);
+
+	ref_ptr<Candidate> c = new Candidate(22, 1 * EeV, Vector3d(100, 0, 0) * Mpc);
+	m.run(c);
+	EXPECT_FALSE(c->isActive());
+	EXPECT_EQ(2, counter->steps); // minimum step, jump to the observer
+	EXPECT_NEAR(0, c->current.getPosition().x, 1e-6 * Mpc);
+}
+
+TEST(EventPropagation1D, interactions) {
+	// survival probability exp(-D / Mpc), one step per interaction
+	ref_ptr<EventPropagation1D> propa = new EventPropagation1D();
+	propa->add(new ToyAbsorption());
+	ModuleList m;
+	m.add(propa);
+	ref_ptr<StepCounter> counter = new StepCounter();
+	m.add(counter);
+	ref_ptr<Observer> obs = new Observer();
+	obs->add(new Observer1D());
+	obs->setFlag("Detected", "yes");
+	m.add(obs);
+
+	size_t n = 10000, detected = 0;
+	for (size_t i = 0; i < n; i++) {
+		ref_ptr<Candidate> c = new Candidate(22, 1 * EeV, Vector3d(2, 0, 0) * Mpc);
+		m.run(c);
+		if (c->hasProperty("Detected"))
+			detected++;
+	}
+	EXPECT_NEAR(exp(-2.), double(detected) / n, 0.01);
+	EXPECT_LE(counter->steps, 3 * n);
+}
+
+TEST(EventPropagation1D, continuousLoss) {
+	// E(x) = E0 / (1 + E0 x / (EeV Mpc))
+	ref_ptr<EventPropagation1D> propa = new EventPropagation1D();
+	propa->add(new ToyLoss());
+	ModuleList m;
+	m.add(propa);
+	ref_ptr<StepCounter> counter = new StepCounter();
+	m.add(counter);
+	ref_ptr<Observer> obs = new Observer();
+	obs->add(new Observer1D());
+	m.add(obs);
+
+	ref_ptr<Candidate> c = new Candidate(11, 1 * EeV, Vector3d(10, 0, 0) * Mpc);
+	m.run(c);
+	EXPECT_NEAR(1. / 11, c->current.getEnergy() / EeV, 1e-6);
+	EXPECT_LT(counter->steps, 100);
+}
+
+TEST(EventPropagation1D, redshift) {
+	// adiabatic loss from z = 0.1 to the observer
+	double z = 0.1;
+	double D = redshift2ComovingDistance(z);
+	EventPropagation1D propa;
+	propa.setRedshiftLosses(true);
+	Candidate c(22, 1 * EeV, Vector3d(D, 0, 0));
+	c.setRedshift(z);
+	c.setNextStep(D);
+	while (c.getRedshift() > 0)
+		propa.process(&c);
+	EXPECT_NEAR(1 / 1.1, c.current.getEnergy() / EeV, 1e-9);
+	EXPECT_NEAR(0, c.current.getPosition().x, 1e-6 * D);
+}
+
 
 int main(int argc, char **argv) {
 	::testing::InitGoogleTest(&argc, argv);
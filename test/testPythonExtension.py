@@ -73,6 +73,27 @@ class testCrossLanguagePolymorphism(unittest.TestCase):
             obs.process(candidate)
             self.assertEqual(i + 1, counter.value)
 
+    def test_ModuleListDirectorPolicy(self):
+        class DeactivatingModule(crp.Module):
+            def __init__(self):
+                crp.Module.__init__(self)
+
+            def process(self, candidate):
+                candidate.setActive(False)
+
+        source = crp.Source()
+        source.add(crp.SourceParticleType(22))
+        ml = crp.ModuleList()
+        ml.add(crp.MaximumTrajectoryLength(0))
+        self.assertFalse(ml.hasDirectors(source))
+        ml.add(DeactivatingModule())
+        self.assertTrue(ml.hasDirectors(source))
+
+        ml.setDirectorPolicy(crp.ModuleList.RefuseDirectors)
+        self.assertRaises(RuntimeError, ml.run, source, 10)
+        ml.setDirectorPolicy(crp.ModuleList.SerializeDirectors)
+        ml.run(source, 10)
+
     def testCustomMagneticField(self):
         class CustomMagneticField(crp.MagneticField):
             def __init__(self, val):
@@ -325,6 +346,74 @@ class testParticleCollector(unittest.TestCase):
         collector[0].getTrajectoryLength(),
         3.14, places=2)
 
+  if numpy_available:
+    def testParticleCollectorGetRecords(self):
+      source = crp.SourceFromArrays()
+      source.addArrays(np.array([22, 11]),
+                       np.array([1., 2.]) * crp.EeV,
+                       np.zeros((2, 3)),
+                       np.array([[1., 0, 0], [0, 1., 0]]),
+                       np.array([0.5, 1.]))
+      self.assertEqual(source.size(), 2)
+      sim = crp.ModuleList()
+      sim.add(crp.MaximumTrajectoryLength(3.14))
+      sim.add(crp.SimplePropagation(0.001, 0.001))
+      collector = crp.ParticleCollector()
+      sim.add(collector)
+      sim.run(source, 2)
+      records = collector.getRecords()
+      self.assertEqual(len(records), 2)
+      self.assertEqual(sorted(records['ID']), [11, 22])
+      self.assertAlmostEqual(sum(records['W']), 1.5)
+      self.assertTrue(np.allclose(records['D'], 3.14, atol=0.01))
+
+    def testHistogramOutputGetArray(self):
+      histogram = crp.HistogramOutput()
+      histogram.addLinearAxis(crp.HistogramOutput.Energy, 2, 0, 2 * crp.EeV)
+      histogram.addLinearAxis(crp.HistogramOutput.TrajectoryLength, 3, 0, 3)
+      c = crp.Candidate(22, 1.5 * crp.EeV)
+      c.setTrajectoryLength(2.5)
+      histogram.process(c)
+      a = histogram.getArray()
+      self.assertEqual(a.shape, (2, 3))
+      self.assertEqual(a[1, 2], 1.)
+      self.assertEqual(a.sum(), 1.)
+
+class testModuleListProfiling(unittest.TestCase):
+
+    def testGetProfile(self):
+      sim = crp.ModuleList()
+      sim.add(crp.SimplePropagation(0.001, 0.1))
+      sim.add(crp.MaximumTrajectoryLength(1.))
+      sim.setProfiling(True)
+      sim.run(crp.Candidate())
+      profile = sim.getProfile()
+      self.assertEqual(len(profile), 2)
+      self.assertEqual(profile[0].calls, sim.getProfileSteps())
+      self.assertEqual(profile[1].secondaries, 0)
+      self.assertTrue(profile[0].time >= 0)
+
+    def testTelemetryCallback(self):
+      class Callback(crp.TelemetryCallback):
+        def __init__(self):
+          crp.TelemetryCallback.__init__(self)
+          self.finished = []
+
+        def update(self, telemetry):
+          self.finished.append(telemetry.primariesFinished)
+
+      sim = crp.ModuleList()
+      sim.add(crp.SimplePropagation(0.001, 0.1))
+      sim.add(crp.MaximumTrajectoryLength(1.))
+      callback = Callback()
+      sim.setTelemetryInterval(1e-9)
+      sim.setTelemetryCallback(callback)
+      source = crp.Source()
+      source.add(crp.SourceParticleType(22))
+      sim.run(source, 10)
+      self.assertEqual(callback.finished[-1], 10)
+      self.assertEqual(sim.getTelemetry().primariesFinished, 10)
+
 class testGrid(unittest.TestCase):
   def testGridPropertiesConstructor(self):
     N = 32
@@ -1,6 +1,7 @@
 #include "crpropa/Source.h"
 #include "crpropa/Units.h"
 #include "crpropa/ParticleID.h"
+#include "crpropa/Random.h"
 
 #include "gtest/gtest.h"
 #include <stdexcept>
@@ -345,6 +346,46 @@ TEST(SourceRedshiftEvolution, testInRange) {
 	}
 }
 
+TEST(SourceRedshift1D, cosmology) {
+	Candidate c;
+	c.source.setPosition(Vector3d(1, 0, 0) * Gpc);
+	SourceRedshift1D source;
+	source.prepareCandidate(c);
+	EXPECT_DOUBLE_EQ(comovingDistance2Redshift(1 * Gpc), c.getRedshift());
+
+	// a larger Omega_m gives a larger H(z) at z > 0 and thus a shorter
+	// comoving distance to a given redshift: higher redshift at the same distance
+	ref_ptr<Cosmology> cosmology = new Cosmology(0.673, 0.5);
+	SourceRedshift1D source2(cosmology);
+	source2.prepareCandidate(c);
+	EXPECT_DOUBLE_EQ(cosmology->comovingDistance2Redshift(1 * Gpc), c.getRedshift());
+	EXPECT_GT(c.getRedshift(), comovingDistance2Redshift(1 * Gpc));
+
+	c.source.setPosition(Vector3d(1e6, 0, 0) * Gpc);
+	EXPECT_THROW(source2.prepareCandidate(c), std::runtime_error);
+}
+
+TEST(SourceUniform1D, cosmology) {
+	// the position is drawn uniformly in light-travel distance
+	Random::instance().seed(1);
+	double u = Random::instance().rand();
+	ref_ptr<Cosmology> cosmology = new Cosmology(0.673, 0.5);
+	double maxD = cosmology->comoving2LightTravelDistance(2 * Gpc);
+
+	ParticleState p;
+	SourceUniform1D source(0, 2 * Gpc, true, cosmology);
+	Random::instance().seed(1);
+	source.prepareParticle(p);
+	EXPECT_DOUBLE_EQ(cosmology->lightTravel2ComovingDistance(u * maxD), p.getPosition().x);
+
+	// without a cosmology the default one is used
+	source.setCosmology(0);
+	Random::instance().seed(1);
+	source.prepareParticle(p);
+	maxD = comoving2LightTravelDistance(2 * Gpc);
+	EXPECT_DOUBLE_EQ(lightTravel2ComovingDistance(u * maxD), p.getPosition().x);
+}
+
 TEST(Source, allPropertiesUsed) {
 	Source source;
 	source.add(new SourcePosition(Vector3d(10, 0, 0) * Mpc));
@@ -425,6 +466,38 @@ TEST(SourceList, luminosity) {
 	EXPECT_NEAR(80, meanE, 4); // this test can stochastically fail
 }
 
+TEST(SourceFromArrays, getCandidate) {
+	SourceFromArrays source;
+	source.add(22, 1 * EeV, Vector3d(1, 0, 0), Vector3d(0, 1, 0));
+	int id[2] = {11, -11};
+	double energy[2] = {2 * EeV, 3 * EeV};
+	double position[6] = {0, 0, 1, 0, 0, 2};
+	double direction[6] = {1, 0, 0, -1, 0, 0};
+	double weight[2] = {0.5, 0.25};
+	source.setArrays(2, id, energy, position, direction, weight);
+	EXPECT_EQ(source.size(), 3);
+
+	ref_ptr<Candidate> c = source.getCandidate();
+	EXPECT_EQ(c->source.getId(), 22);
+	EXPECT_DOUBLE_EQ(c->getWeight(), 1);
+	c = source.getCandidate();
+	EXPECT_EQ(c->created.getId(), 11);
+	EXPECT_DOUBLE_EQ(c->current.getEnergy(), 2 * EeV);
+	EXPECT_DOUBLE_EQ(c->getWeight(), 0.5);
+	c = source.getCandidate();
+	EXPECT_EQ(c->source.getId(), -11);
+	EXPECT_EQ(c->source.getPosition(), Vector3d(0, 0, 2));
+	EXPECT_EQ(c->source.getDirection(), Vector3d(-1, 0, 0));
+	EXPECT_EQ(source.remaining(), 0);
+
+	// all particles emitted
+	EXPECT_FALSE(source.getCandidate().valid());
+	EXPECT_FALSE(source.getCandidate().valid());
+	EXPECT_EQ(source.remaining(), 0);
+	source.reset();
+	EXPECT_EQ(source.remaining(), 3);
+}
+
 TEST(SourceTag, sourceTag) {
 	SourceTag tag("mySourceTag");
 	Candidate c;
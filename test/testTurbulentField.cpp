@@ -132,6 +132,26 @@ TEST(testGridTurbulence, Turbulence_seed) {
 	Vector3d pos(22 * Mpc);
 	EXPECT_FLOAT_EQ(tf1.getField(pos).x, tf2.getField(pos).x);
 }
+
+TEST(testGridTurbulence, powerSpectrum) {
+	size_t n = 64;
+	double spacing = 1 * Mpc;
+	double lMin = 2 * spacing;
+	double lMax = 32 * spacing;
+	double lBo = lMax / 6;
+	auto spectrum = TurbulenceSpectrum(1, lMin, lMax, lBo);
+	auto gp = GridProperties(Vector3d(0, 0, 0), n, spacing);
+	auto tf = GridTurbulence(spectrum, gp, 42);
+
+	// one point per shell 0 < k <= n/2
+	std::vector<std::pair<int, float>> points = tf.getPowerSpectrum();
+	ASSERT_EQ(n / 2, points.size());
+	EXPECT_EQ(1, points.front().first);
+	EXPECT_EQ(n / 2, points.back().first);
+
+	// the generated field follows the requested spectrum
+	EXPECT_LT(tf.getPowerSpectrumDeviation(), 0.1);
+}
 #endif // CRPROPA_HAVE_FFTW3F
 
 int main(int argc, char **argv) {